@@ -1,5 +1,7 @@
 #pragma once
 #include <atomic>
+#include <cstddef>
+#include <utility>
 
 /**
  * Multi-producer multi-consumer queue.
@@ -85,7 +87,7 @@ public:
       }
 
       mBuffer[writePos] = value;
-      mWritePosition.store(writePos, std::memory_order_release);
+      mWritePosition.store(nextWritePos, std::memory_order_release);
       return true;
    }
 
@@ -107,3 +109,105 @@ private:
    Type mBuffer[Size];
    alignas(64) std::atomic<std::size_t> mReadPosition = 0;
 };
+
+/**
+ * Bounded multi-producer, multi-consumer queue.
+ *
+ * Safe, can detect whether queue is full on push, or empty on pop. Each slot
+ * carries a sequence number which tells producers and consumers whether the
+ * slot is ready for them, so neither ever blocks the other.
+ *
+ * Size must be a power of two.
+ */
+template<typename Type, std::size_t Size>
+class BoundedAtomicQueue
+{
+   static_assert(Size && ((Size & (Size - 1)) == 0), "N must be a power of two");
+
+public:
+   BoundedAtomicQueue()
+   {
+      for (auto i = 0u; i < Size; ++i) {
+         mBuffer[i].sequence.store(i, std::memory_order_relaxed);
+      }
+   }
+
+   constexpr std::size_t capacity() const
+   {
+      return Size;
+   }
+
+   bool push(const Type &value)
+   {
+      return pushValue(value);
+   }
+
+   bool push(Type &&value)
+   {
+      return pushValue(std::move(value));
+   }
+
+   bool pop(Type &value)
+   {
+      auto readPos = mReadPosition.load(std::memory_order_relaxed);
+
+      while (true) {
+         auto &slot = mBuffer[readPos % Size];
+         auto sequence = slot.sequence.load(std::memory_order_acquire);
+         auto diff = static_cast<std::ptrdiff_t>(sequence) -
+                     static_cast<std::ptrdiff_t>(readPos + 1);
+
+         if (diff == 0) {
+            if (mReadPosition.compare_exchange_weak(readPos, readPos + 1,
+                                                    std::memory_order_relaxed)) {
+               value = std::move(slot.value);
+               slot.sequence.store(readPos + Size, std::memory_order_release);
+               return true;
+            }
+         } else if (diff < 0) {
+            // Queue is empty!
+            return false;
+         } else {
+            readPos = mReadPosition.load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+private:
+   template<typename Value>
+   bool pushValue(Value &&value)
+   {
+      auto writePos = mWritePosition.load(std::memory_order_relaxed);
+
+      while (true) {
+         auto &slot = mBuffer[writePos % Size];
+         auto sequence = slot.sequence.load(std::memory_order_acquire);
+         auto diff = static_cast<std::ptrdiff_t>(sequence) -
+                     static_cast<std::ptrdiff_t>(writePos);
+
+         if (diff == 0) {
+            if (mWritePosition.compare_exchange_weak(writePos, writePos + 1,
+                                                     std::memory_order_relaxed)) {
+               slot.value = std::forward<Value>(value);
+               slot.sequence.store(writePos + 1, std::memory_order_release);
+               return true;
+            }
+         } else if (diff < 0) {
+            // Queue is full!
+            return false;
+         } else {
+            writePos = mWritePosition.load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+   struct Slot
+   {
+      std::atomic<std::size_t> sequence;
+      Type value;
+   };
+
+   alignas(64) std::atomic<std::size_t> mWritePosition = 0;
+   alignas(64) std::atomic<std::size_t> mReadPosition = 0;
+   alignas(64) Slot mBuffer[Size];
+};
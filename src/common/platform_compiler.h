@@ -21,6 +21,14 @@
 #define NEVER_INLINE //nothing
 #endif
 
+// Macro to inline every call made by a function, recursively.  This is
+//  needed to inline helpers into a function with a different target ISA.
+#ifdef __GNUC__
+#define FLATTEN __attribute__((flatten))
+#else
+#define FLATTEN //nothing
+#endif
+
 // Macro to disable optimization when building with Clang on a function which
 //  both performs floating-point operations and checks exception flags that
 //  could be affected by those operations.  This is required because LLVM is
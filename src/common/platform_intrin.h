@@ -9,3 +9,39 @@
 #else
 #include <x86intrin.h>
 #endif
+
+// Macro to allow a function to use AVX2 instructions regardless of the
+//  compiler flags, callers must check platform::cpuHasAvx2 at runtime.
+#ifdef __GNUC__
+#define PLATFORM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PLATFORM_TARGET_AVX2 //nothing
+#endif
+
+namespace platform
+{
+
+inline bool
+cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7) {
+      return false;
+   }
+
+   // The OS must also save the upper halves of the YMM registers
+   __cpuid(info, 1);
+   if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) {
+      return false;
+   }
+
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+#else
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+
+} // namespace platform
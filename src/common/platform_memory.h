@@ -15,6 +15,13 @@ enum class ProtectFlags
    ReadWriteExecute
 };
 
+enum class AccessPattern
+{
+   Normal,
+   Sequential,
+   Random
+};
+
 using MapFileHandle = intptr_t;
 static constexpr MapFileHandle InvalidMapFileHandle = -1;
 
@@ -43,6 +50,15 @@ bool
 unmapViewOfFile(void *view,
                 size_t size);
 
+bool
+adviseMemoryAccess(void *address,
+                   size_t size,
+                   AccessPattern pattern);
+
+bool
+prefetchMemory(void *address,
+               size_t size);
+
 bool
 reserveMemory(uintptr_t address,
               size_t size);
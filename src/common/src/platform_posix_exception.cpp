@@ -35,18 +35,18 @@ static void
 dispatchException(Exception *exception,
                   void *context,
                   int signum,
-                  const struct sigaction *ourHandler,
                   const struct sigaction *sysHandler)
 {
-   // Reset to the original signal handler in case an exception handler
-   //  generates a signal of its own
-   sigaction(signum, sysHandler, nullptr);
-
-   static bool sInSignal = false;
+   // Faults are expected to happen frequently and concurrently on many
+   //  threads (e.g. memory write tracking), so our handler stays installed
+   //  and recursion is tracked per thread.
+   static thread_local bool sInSignal = false;
 
    // Avoid recursive signal handling (in case an exception handler looking
-   //  at a SIGILL causes a SIGSEGV, for example)
+   //  at a SIGILL causes a SIGSEGV, for example), fall back to the original
+   //  signal handler and let the faulting instruction re-run into it.
    if (sInSignal) {
+      sigaction(signum, sysHandler, nullptr);
       return;
    }
 
@@ -62,9 +62,6 @@ dispatchException(Exception *exception,
 
       sInSignal = false;
 
-      // Reinstall our signal handler
-      sigaction(signum, ourHandler, nullptr);
-
       if (func == HandledException) {
          // Exception handled, resume execution
          return;
@@ -80,23 +77,24 @@ dispatchException(Exception *exception,
       }
    }
 
-   // No exception handlers, found, so re-run the failing instruction to
-   //  call the original signal handler
-   return;
+   // No exception handlers found, so reset to the original signal handler
+   //  and re-run the failing instruction to call it
+   sInSignal = false;
+   sigaction(signum, sysHandler, nullptr);
 }
 
 static void
 segvHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = AccessViolationException { reinterpret_cast<uint64_t>(info->si_addr) };
-   dispatchException(&exception, context, signum, &sSegvHandler, &sSystemSegvHandler);
+   dispatchException(&exception, context, signum, &sSystemSegvHandler);
 }
 
 static void
 illHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = InvalidInstructionException { };
-   dispatchException(&exception, context, signum, &sIllHandler, &sSystemIllHandler);
+   dispatchException(&exception, context, signum, &sSystemIllHandler);
 }
 
 bool
@@ -107,9 +105,9 @@ installExceptionHandler(ExceptionHandler handler)
    if (!addedHandlers) {
       sigemptyset(&sSegvHandler.sa_mask);
 
-      // Set SA_RESETHAND so that a SEGV in the handler will terminate the
-      // program rather than going into an infinite loop.
-      sSegvHandler.sa_flags = SA_SIGINFO | SA_RESETHAND;
+      // We do not use SA_RESETHAND as handled faults must not uninstall our
+      // handler, recursive faults are instead caught in dispatchException.
+      sSegvHandler.sa_flags = SA_SIGINFO | SA_NODEFER;
 
       sSegvHandler.sa_sigaction = segvHandler;
       if (sigaction(SIGSEGV, &sSegvHandler, &sSystemSegvHandler) != 0) {
@@ -1,12 +1,24 @@
 #include "platform.h"
 #include "platform_fiber.h"
+#include "decaf_assert.h"
 #include "log.h"
 
 #ifdef PLATFORM_POSIX
-#include <array>
 #include <errno.h>
+#include <fmt/format.h>
+#include <mutex>
 #include <signal.h>
-#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+   // Use our own register swap instead of swapcontext, which does a
+   // rt_sigprocmask syscall on every switch.
+   #define FIBER_ASM_SWITCH
+#else
+   #include <ucontext.h>
+#endif
 
 #ifdef DECAF_VALGRIND
    #include <valgrind/valgrind.h>
@@ -18,22 +30,94 @@ namespace platform
 static const size_t
 DefaultStackSize = 1024 * 1024;
 
+// Number of freed stacks we keep around for reuse by new fibers.
+static const size_t
+MaxPooledStacks = 64;
+
 struct Fiber
 {
+#ifdef FIBER_ASM_SWITCH
+   void *stackPointer = nullptr;
+#else
    ucontext_t context;
+#endif
    FiberEntryPoint entry = nullptr;
    void *entryParam = nullptr;
 #ifdef DECAF_VALGRIND
    unsigned int valgrindStackId;
 #endif
-   std::array<char, DefaultStackSize> stack;
+
+   //! Base of the stack allocation, including the guard page.
+   uint8_t *stack = nullptr;
 };
 
-Fiber *
-getThreadFiber()
+static std::mutex
+sStackPoolMutex;
+
+static std::vector<uint8_t *>
+sStackPool;
+
+static size_t
+getStackGuardSize()
 {
-   auto fiber = new Fiber();
-   return fiber;
+   static const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+   return pageSize;
+}
+
+/**
+ * Allocate a fiber stack with a guard page at the bottom.
+ *
+ * The stack is reserved with MAP_NORESERVE so memory is only committed for
+ * the pages a fiber actually touches, which for most guest threads is a
+ * small fraction of the full stack.
+ */
+static uint8_t *
+allocateStack()
+{
+   {
+      std::unique_lock<std::mutex> lock { sStackPoolMutex };
+      if (!sStackPool.empty()) {
+         auto stack = sStackPool.back();
+         sStackPool.pop_back();
+         return stack;
+      }
+   }
+
+   auto guardSize = getStackGuardSize();
+   auto mapping = mmap(nullptr, guardSize + DefaultStackSize,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                       -1, 0);
+   if (mapping == MAP_FAILED) {
+      decaf_abort(fmt::format("Failed to allocate fiber stack, errno = {}", errno));
+   }
+
+   auto stack = reinterpret_cast<uint8_t *>(mapping);
+   if (mprotect(stack, guardSize, PROT_NONE) != 0) {
+      gLog->warn("Failed to protect fiber stack guard page, errno = {}", errno);
+   }
+
+   return stack;
+}
+
+static void
+freeStack(uint8_t *stack)
+{
+   {
+      std::unique_lock<std::mutex> lock { sStackPoolMutex };
+      if (sStackPool.size() < MaxPooledStacks) {
+         sStackPool.push_back(stack);
+         return;
+      }
+   }
+
+   munmap(stack, getStackGuardSize() + DefaultStackSize);
+}
+
+static uint8_t *
+getStackTop(Fiber *fiber)
+{
+   return fiber->stack + getStackGuardSize() + DefaultStackSize;
 }
 
 static void
@@ -42,23 +126,137 @@ fiberEntryPoint(Fiber *fiber)
    fiber->entry(fiber->entryParam);
 }
 
+#ifdef FIBER_ASM_SWITCH
+
+extern "C" void
+decafFiberSwitch(void **saveStackPointer,
+                 void *stackPointer);
+
+extern "C" void
+decafFiberStart();
+
+extern "C" void
+decafFiberEntry(Fiber *fiber)
+{
+   fiberEntryPoint(fiber);
+   decaf_abort("Fiber entry point returned");
+}
+
+/*
+decafFiberSwitch saves the callee saved registers of the System V ABI along
+with the SSE and x87 control words on the current stack, stores the stack
+pointer to *saveStackPointer and then restores the same state from the
+target stack.
+
+A new fiber's stack is set up so the first switch to it "returns" into
+decafFiberStart with the Fiber pointer in r12.
+*/
+asm(R"(
+   .text
+   .p2align 4
+   .globl decafFiberSwitch
+   .hidden decafFiberSwitch
+   .type decafFiberSwitch, @function
+decafFiberSwitch:
+   pushq %rbp
+   pushq %rbx
+   pushq %r12
+   pushq %r13
+   pushq %r14
+   pushq %r15
+   subq $8, %rsp
+   stmxcsr (%rsp)
+   fnstcw 4(%rsp)
+   movq %rsp, (%rdi)
+   movq %rsi, %rsp
+   ldmxcsr (%rsp)
+   fldcw 4(%rsp)
+   addq $8, %rsp
+   popq %r15
+   popq %r14
+   popq %r13
+   popq %r12
+   popq %rbx
+   popq %rbp
+   ret
+   .size decafFiberSwitch, .-decafFiberSwitch
+
+   .p2align 4
+   .globl decafFiberStart
+   .hidden decafFiberStart
+   .type decafFiberStart, @function
+decafFiberStart:
+   movq %r12, %rdi
+   call decafFiberEntry
+   ud2
+   .size decafFiberStart, .-decafFiberStart
+)");
+
+struct FiberSwitchFrame
+{
+   uint32_t mxcsr;
+   uint32_t fpucw;
+   uint64_t r15;
+   uint64_t r14;
+   uint64_t r13;
+   uint64_t r12;
+   uint64_t rbx;
+   uint64_t rbp;
+   uint64_t returnAddress;
+};
+
+static_assert(sizeof(FiberSwitchFrame) == 64);
+
+static void
+initialiseFiberContext(Fiber *fiber)
+{
+   // decafFiberStart must be entered with a 16 byte aligned stack, as if it
+   // were about to make a call, so leave a padding slot above the frame.
+   auto top = reinterpret_cast<uintptr_t>(getStackTop(fiber)) & ~uintptr_t { 15 };
+   auto frame = reinterpret_cast<FiberSwitchFrame *>(top - 16 - sizeof(FiberSwitchFrame));
+   *frame = FiberSwitchFrame { };
+   frame->mxcsr = 0x1F80;
+   frame->fpucw = 0x037F;
+   frame->r12 = reinterpret_cast<uint64_t>(fiber);
+   frame->returnAddress = reinterpret_cast<uint64_t>(&decafFiberStart);
+   fiber->stackPointer = frame;
+}
+
+#else
+
+static void
+initialiseFiberContext(Fiber *fiber)
+{
+   getcontext(&fiber->context);
+   fiber->context.uc_stack.ss_sp = fiber->stack + getStackGuardSize();
+   fiber->context.uc_stack.ss_size = DefaultStackSize;
+   fiber->context.uc_link = nullptr;
+
+   makecontext(&fiber->context, reinterpret_cast<void(*)()>(&fiberEntryPoint), 1, fiber);
+}
+
+#endif // FIBER_ASM_SWITCH
+
+Fiber *
+getThreadFiber()
+{
+   auto fiber = new Fiber();
+   return fiber;
+}
+
 Fiber *
 createFiber(FiberEntryPoint entry, void *entryParam)
 {
    auto fiber = new Fiber();
    fiber->entry = entry;
    fiber->entryParam = entryParam;
+   fiber->stack = allocateStack();
 
 #ifdef DECAF_VALGRIND
-   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(&fiber->stack[0], &fiber->stack[fiber->stack.size() - 1]);
+   fiber->valgrindStackId = VALGRIND_STACK_REGISTER(fiber->stack + getStackGuardSize(), getStackTop(fiber) - 1);
 #endif
 
-   getcontext(&fiber->context);
-   fiber->context.uc_stack.ss_sp = &fiber->stack[0];
-   fiber->context.uc_stack.ss_size = fiber->stack.size();
-   fiber->context.uc_link = nullptr;
-
-   makecontext(&fiber->context, reinterpret_cast<void(*)()>(&fiberEntryPoint), 1, fiber);
+   initialiseFiberContext(fiber);
    return fiber;
 }
 
@@ -66,20 +264,35 @@ void
 destroyFiber(Fiber *fiber)
 {
 #ifdef DECAF_VALGRIND
-   VALGRIND_STACK_DEREGISTER(fiber->valgrindStackId);
+   if (fiber->stack) {
+      VALGRIND_STACK_DEREGISTER(fiber->valgrindStackId);
+   }
 #endif
 
+   if (fiber->stack) {
+      freeStack(fiber->stack);
+   }
+
    delete fiber;
 }
 
 void
 swapToFiber(Fiber *current, Fiber *target)
 {
+#ifdef FIBER_ASM_SWITCH
+   if (!current) {
+      void *discardStackPointer = nullptr;
+      decafFiberSwitch(&discardStackPointer, target->stackPointer);
+   } else {
+      decafFiberSwitch(&current->stackPointer, target->stackPointer);
+   }
+#else
    if (!current) {
       setcontext(&target->context);
    } else {
       swapcontext(&current->context, &target->context);
    }
+#endif
 }
 
 } // namespace platform
@@ -160,7 +160,7 @@ mapViewOfFile(MapFileHandle handle,
       return nullptr;
    }
 
-   if (result != dst) {
+   if (dst && result != dst) {
       gLog->error("mapViewOfFile(offset: 0x{:X}, size: 0x{:X}, dst: {}) mmap returned unexpected address: {}",
                   offset, size, dst, result);
 
@@ -186,6 +186,65 @@ unmapViewOfFile(void *view,
 }
 
 
+/**
+ * Round an address range out to whole pages, as required by madvise.
+ */
+static void
+alignToPages(void *&address,
+             size_t &size)
+{
+   auto pageSize = getSystemPageSize();
+   auto start = reinterpret_cast<uintptr_t>(address) & ~(pageSize - 1);
+   auto end = reinterpret_cast<uintptr_t>(address) + size;
+   address = reinterpret_cast<void *>(start);
+   size = end - start;
+}
+
+
+bool
+adviseMemoryAccess(void *address,
+                   size_t size,
+                   AccessPattern pattern)
+{
+   auto advice = MADV_NORMAL;
+   switch (pattern) {
+   case AccessPattern::Sequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+   case AccessPattern::Random:
+      advice = MADV_RANDOM;
+      break;
+   case AccessPattern::Normal:
+   default:
+      advice = MADV_NORMAL;
+   }
+
+   alignToPages(address, size);
+   if (madvise(address, size, advice) == -1) {
+      gLog->debug("adviseMemoryAccess(address: {}, size: 0x{:X}, pattern: {}) madvise failed with error: {}",
+                  address, size, static_cast<int>(pattern), errno);
+      return false;
+   }
+
+   return true;
+}
+
+
+bool
+prefetchMemory(void *address,
+               size_t size)
+{
+   alignToPages(address, size);
+   if (madvise(address, size, MADV_WILLNEED) == -1) {
+      gLog->debug("prefetchMemory(address: {}, size: 0x{:X}) madvise failed with error: {}",
+                  address, size, errno);
+      return false;
+   }
+
+   return true;
+}
+
+
 bool
 reserveMemory(uintptr_t address,
               size_t size)
@@ -98,10 +98,11 @@ openMemoryMappedFile(const std::string &path,
 {
    // Only support READ ONLY for now
    decaf_check(flags == ProtectFlags::ReadOnly);
-   OFSTRUCT of;
-   auto fileHandle = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(OpenFile(path.c_str(), &of, OF_READ)));
-   if (!fileHandle) {
-      gLog->error("openMemoryMappedFile(\"{}\") OpenFile failed with error: {}",
+   auto fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                 NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                                 NULL);
+   if (fileHandle == INVALID_HANDLE_VALUE) {
+      gLog->error("openMemoryMappedFile(\"{}\") CreateFile failed with error: {}",
                   path, GetLastError());
       return InvalidMapFileHandle;
    }
@@ -197,6 +198,34 @@ unmapViewOfFile(void *view,
 }
 
 
+bool
+adviseMemoryAccess(void *address,
+                   size_t size,
+                   AccessPattern pattern)
+{
+   // Windows has no equivalent of madvise for mapped views
+   return false;
+}
+
+
+bool
+prefetchMemory(void *address,
+               size_t size)
+{
+   auto entry = WIN32_MEMORY_RANGE_ENTRY { };
+   entry.VirtualAddress = address;
+   entry.NumberOfBytes = size;
+
+   if (!PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0)) {
+      gLog->debug("prefetchMemory(address: {}, size: 0x{:X}) failed with error: {}",
+                  address, size, GetLastError());
+      return false;
+   }
+
+   return true;
+}
+
+
 bool
 reserveMemory(uintptr_t address,
               size_t size)
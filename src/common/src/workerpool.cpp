@@ -0,0 +1,182 @@
+#include "workerpool.h"
+#include "platform_thread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fmt/format.h>
+
+struct WorkerPool::Job
+{
+   const std::function<void(size_t)> *func;
+   size_t count;
+
+   //! Index of the next work item to be claimed
+   std::atomic<size_t> next { 0 };
+
+   //! Number of work items which have been completed
+   std::atomic<size_t> completed { 0 };
+
+   //! Number of workers currently running this job, protected by mMutex
+   size_t numWorkers = 0;
+};
+
+WorkerPool::WorkerPool(size_t numThreads,
+                       const std::string &name)
+{
+   mThreads.reserve(numThreads);
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      mThreads.emplace_back([this]() { workerEntry(); });
+      platform::setThreadName(&mThreads.back(), fmt::format("{} {}", name, i));
+   }
+}
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mRunning = false;
+   }
+
+   mWorkAvailable.notify_all();
+
+   for (auto &thread : mThreads) {
+      thread.join();
+   }
+}
+
+/**
+ * Leave one host thread free for the thread which is submitting the work.
+ */
+size_t
+WorkerPool::getDefaultNumThreads()
+{
+   auto numCores = static_cast<size_t>(std::thread::hardware_concurrency());
+   return std::max<size_t>(numCores, 1) - 1;
+}
+
+/**
+ * Calls func(index) for every index in [0, count), returning once they have
+ * all completed.
+ */
+void
+WorkerPool::parallelFor(size_t count,
+                        const std::function<void(size_t)> &func)
+{
+   if (count == 0) {
+      return;
+   }
+
+   if (count == 1 || mThreads.empty()) {
+      for (auto i = 0u; i < count; ++i) {
+         func(i);
+      }
+
+      return;
+   }
+
+   auto job = Job { };
+   job.func = &func;
+   job.count = count;
+
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mJobs.push_back(&job);
+   }
+
+   mWorkAvailable.notify_all();
+
+   // Help out with our own job, then wait for the workers to finish theirs.
+   // The job lives on our stack so we must also wait for every worker to
+   // stop touching it before returning.
+   runJob(&job);
+
+   std::unique_lock<std::mutex> lock { mMutex };
+   mJobs.erase(std::remove(mJobs.begin(), mJobs.end(), &job), mJobs.end());
+   mJobFinished.wait(lock, [&]() {
+      return job.numWorkers == 0 &&
+             job.completed.load(std::memory_order_acquire) == job.count;
+   });
+}
+
+/**
+ * Queue func to be run on a worker thread and return straight away, with no
+ * worker threads it is run on the calling thread before returning.
+ *
+ * The caller is responsible for waiting for the task to complete, tasks
+ * which have not started when the pool is destroyed are never run.
+ */
+void
+WorkerPool::post(std::function<void()> func)
+{
+   if (mThreads.empty()) {
+      func();
+      return;
+   }
+
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mTasks.push_back(std::move(func));
+   }
+
+   mWorkAvailable.notify_one();
+}
+
+/**
+ * Claim and run work items from job until there are none left.
+ */
+void
+WorkerPool::runJob(Job *job)
+{
+   while (true) {
+      auto index = job->next.fetch_add(1, std::memory_order_relaxed);
+      if (index >= job->count) {
+         break;
+      }
+
+      (*job->func)(index);
+      job->completed.fetch_add(1, std::memory_order_release);
+   }
+}
+
+void
+WorkerPool::workerEntry()
+{
+   std::unique_lock<std::mutex> lock { mMutex };
+
+   while (true) {
+      // Drop any jobs which have had all of their work items claimed
+      while (!mJobs.empty() &&
+             mJobs.front()->next.load(std::memory_order_relaxed) >= mJobs.front()->count) {
+         mJobs.pop_front();
+      }
+
+      if (!mRunning) {
+         break;
+      }
+
+      if (!mTasks.empty()) {
+         auto task = std::move(mTasks.front());
+         mTasks.pop_front();
+         lock.unlock();
+         task();
+         lock.lock();
+         continue;
+      }
+
+      if (mJobs.empty()) {
+         mWorkAvailable.wait(lock);
+         continue;
+      }
+
+      auto job = mJobs.front();
+      job->numWorkers++;
+      lock.unlock();
+      runJob(job);
+      lock.lock();
+
+      if (--job->numWorkers == 0) {
+         mJobFinished.notify_all();
+      }
+   }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed size pool of worker threads for splitting up data parallel work.
+ *
+ * The thread calling parallelFor participates in the work, so a pool with
+ * zero worker threads simply runs everything on the calling thread.
+ * Multiple threads may call parallelFor concurrently, their jobs are queued
+ * and processed in submission order.
+ *
+ * Single tasks can also be posted to run in the background, these are
+ * picked up before any parallelFor job.
+ */
+class WorkerPool
+{
+   struct Job;
+
+public:
+   WorkerPool(size_t numThreads,
+              const std::string &name = "WorkerPool");
+   ~WorkerPool();
+
+   WorkerPool(const WorkerPool &) = delete;
+   WorkerPool &operator=(const WorkerPool &) = delete;
+
+   size_t
+   getNumThreads() const
+   {
+      return mThreads.size();
+   }
+
+   void
+   parallelFor(size_t count,
+               const std::function<void(size_t)> &func);
+
+   void
+   post(std::function<void()> func);
+
+   static size_t
+   getDefaultNumThreads();
+
+private:
+   void
+   workerEntry();
+
+   static void
+   runJob(Job *job);
+
+private:
+   bool mRunning = true;
+   std::mutex mMutex;
+   std::condition_variable mWorkAvailable;
+   std::condition_variable mJobFinished;
+   std::deque<Job *> mJobs;
+   std::deque<std::function<void()>> mTasks;
+   std::vector<std::thread> mThreads;
+};
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <condition_variable>
 #include <libgpu/gpu_graphicsdriver.h>
+#include <libgpu/gpu_nulldriver.h>
 #include <libdecaf/decaf_nullinputdriver.h>
 #include <mutex>
 #include <thread>
@@ -75,5 +76,13 @@ DecafCLI::run(const std::string &gamePath)
       graphicsThread.join();
    }
 
+   auto debugInfo = decaf::getGraphicsDriver()->getDebugInfo();
+   if (debugInfo && debugInfo->type == gpu::GraphicsDriverType::Null) {
+      auto nullInfo = static_cast<gpu::NullDriverDebugInfo *>(debugInfo);
+      gCliLog->info("GPU processed {} frames, {} draws, {} register writes, {} timestamps",
+                    nullInfo->numSwaps, nullInfo->numDraws,
+                    nullInfo->numRegisterWrites, nullInfo->numEopEvents);
+   }
+
    return result;
 }
@@ -27,6 +27,13 @@ JitProfilingWindow::setDebugData(DebugData *debugData)
       const auto &stats = mDebugData->jitStats();
       ui->labelJitCodeSize->setText(QString{ "%1 mb" }.arg(stats.usedCodeCacheSize / 1.0e6, 0, 'f', 2));
       ui->labelJitDataSize->setText(QString{ "%1 mb" }.arg(stats.usedDataCacheSize / 1.0e6, 0, 'f', 2));
+
+      auto totalExits = stats.chainedExits + stats.lookedUpExits;
+      auto chainedPercent = totalExits ? (100.0 * stats.chainedExits) / totalExits : 0.0;
+      ui->labelJitChainedExits->setText(QString{ "%1 / %2 (%3%)" }
+                                           .arg(stats.chainedExits)
+                                           .arg(totalExits)
+                                           .arg(chainedPercent, 0, 'f', 1));
    });
 
    mJitProfilingModel = new JitProfilingModel { this };
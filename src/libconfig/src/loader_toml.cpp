@@ -99,12 +99,44 @@ translateViewMode(const std::string &text)
    return { };
 }
 
+static const char *
+translateWriteTrackBackend(cpu::MemorySettings::WriteTrackBackend backend)
+{
+   if (backend == cpu::MemorySettings::PageGuard) {
+      return "page_guard";
+   } else if (backend == cpu::MemorySettings::PageScan) {
+      return "page_scan";
+   }
+
+   return "";
+}
+
+static std::optional<cpu::MemorySettings::WriteTrackBackend>
+translateWriteTrackBackend(const std::string &text)
+{
+   if (text == "page_guard") {
+      return cpu::MemorySettings::PageGuard;
+   } else if (text == "page_scan") {
+      return cpu::MemorySettings::PageScan;
+   }
+
+   return { };
+}
+
 bool
 loadFromTOML(const toml::table &config,
              cpu::Settings &cpuSettings)
 {
    readValue(config, "mem.writetrack", cpuSettings.memory.writeTrackEnabled);
 
+   if (auto mem = config.get_as<toml::table>("mem"); mem) {
+      if (auto text = mem->get_as<std::string>("writetrack_backend"); text) {
+         if (auto backend = translateWriteTrackBackend(**text); backend) {
+            cpuSettings.memory.writeTrackBackend = *backend;
+         }
+      }
+   }
+
    readValue(config, "jit.enabled", cpuSettings.jit.enabled);
    readValue(config, "jit.verify", cpuSettings.jit.verify);
    readValue(config, "jit.verify_addr", cpuSettings.jit.verifyAddress);
@@ -112,6 +144,10 @@ loadFromTOML(const toml::table &config,
    readValue(config, "jit.data_cache_size_mb", cpuSettings.jit.dataCacheSizeMB);
    readArray(config, "jit.opt_flags", cpuSettings.jit.optimisationFlags);
    readValue(config, "jit.rodata_read_only", cpuSettings.jit.rodataReadOnly);
+   readValue(config, "jit.tiered_compilation", cpuSettings.jit.tieredCompilation);
+   readValue(config, "jit.tiered_compile_threshold", cpuSettings.jit.tieredCompileThreshold);
+   readValue(config, "jit.tiered_compile_threads", cpuSettings.jit.tieredCompileThreads);
+   readValue(config, "jit.cache_directory", cpuSettings.jit.cacheDirectory);
    return true;
 }
 
@@ -124,6 +160,7 @@ loadFromTOML(const toml::table &config,
    readValue(config, "debugger.break_on_exit", decafSettings.debugger.break_on_exit);
    readValue(config, "debugger.gdb_stub", decafSettings.debugger.gdb_stub);
    readValue(config, "debugger.gdb_stub_port", decafSettings.debugger.gdb_stub_port);
+   readValue(config, "debugger.validate_threads", decafSettings.debugger.validate_threads);
 
    readValue(config, "gx2.dump_textures", decafSettings.gx2.dump_textures);
    readValue(config, "gx2.dump_shaders", decafSettings.gx2.dump_shaders);
@@ -133,6 +170,7 @@ loadFromTOML(const toml::table &config,
    readValue(config, "log.directory", decafSettings.log.directory);
    readValue(config, "log.hle_trace", decafSettings.log.hle_trace);
    readValue(config, "log.hle_trace_res", decafSettings.log.hle_trace_res);
+   readValue(config, "log.hle_trace_binary", decafSettings.log.hle_trace_binary);
    readArray(config, "log.hle_trace_filters", decafSettings.log.hle_trace_filters);
    readValue(config, "log.level", decafSettings.log.level);
    readValue(config, "log.to_file", decafSettings.log.to_file);
@@ -149,6 +187,7 @@ loadFromTOML(const toml::table &config,
    }
 
    readValue(config, "sound.dump_sounds", decafSettings.sound.dump_sounds);
+   readValue(config, "sound.decode_threads", decafSettings.sound.decode_threads);
 
    readValue(config, "system.region", decafSettings.system.region);
    readValue(config, "system.hfio_path", decafSettings.system.hfio_path);
@@ -162,6 +201,9 @@ loadFromTOML(const toml::table &config,
    readArray(config, "system.lle_modules", decafSettings.system.lle_modules);
    readValue(config, "system.dump_hle_rpl", decafSettings.system.dump_hle_rpl);
    readArray(config, "system.title_directories", decafSettings.system.title_directories);
+   readValue(config, "system.ios_worker_threads", decafSettings.system.ios_worker_threads);
+   readValue(config, "system.rpl_section_cache", decafSettings.system.rpl_section_cache);
+   readValue(config, "system.rpl_section_cache_path", decafSettings.system.rpl_section_cache_path);
    return true;
 }
 
@@ -172,6 +214,9 @@ loadFromTOML(const toml::table &config,
    readValue(config, "gpu.debug", gpuSettings.debug.debug_enabled);
    readValue(config, "gpu.dump_shaders", gpuSettings.debug.dump_shaders);
    readValue(config, "gpu.dump_shader_binaries_only", gpuSettings.debug.dump_shader_binaries_only);
+   readValue(config, "shader_cache.enabled", gpuSettings.shaderCache.enabled);
+   readValue(config, "shader_cache.path", gpuSettings.shaderCache.path);
+   readValue(config, "shader_cache.preload", gpuSettings.shaderCache.preload);
 
    auto display = config.get_as<toml::table>("display");
    if (display) {
@@ -218,6 +263,10 @@ bool
 saveToTOML(toml::table &config,
            const cpu::Settings &cpuSettings)
 {
+   auto mem = config.insert("mem", toml::table()).first->second.as_table();
+   mem->insert_or_assign("writetrack", cpuSettings.memory.writeTrackEnabled);
+   mem->insert_or_assign("writetrack_backend", translateWriteTrackBackend(cpuSettings.memory.writeTrackBackend));
+
    auto jit = config.insert("jit", toml::table()).first->second.as_table();
    jit->insert_or_assign("enabled", cpuSettings.jit.enabled);
    jit->insert_or_assign("verify", cpuSettings.jit.verify);
@@ -225,6 +274,10 @@ saveToTOML(toml::table &config,
    jit->insert_or_assign("code_cache_size_mb", cpuSettings.jit.codeCacheSizeMB);
    jit->insert_or_assign("data_cache_size_mb", cpuSettings.jit.dataCacheSizeMB);
    jit->insert_or_assign("rodata_read_only", cpuSettings.jit.rodataReadOnly);
+   jit->insert_or_assign("tiered_compilation", cpuSettings.jit.tieredCompilation);
+   jit->insert_or_assign("tiered_compile_threshold", cpuSettings.jit.tieredCompileThreshold);
+   jit->insert_or_assign("tiered_compile_threads", cpuSettings.jit.tieredCompileThreads);
+   jit->insert_or_assign("cache_directory", cpuSettings.jit.cacheDirectory);
 
    auto opt_flags = toml::array();
    for (auto &flag : cpuSettings.jit.optimisationFlags) {
@@ -246,6 +299,7 @@ saveToTOML(toml::table &config,
    debugger->insert_or_assign("break_on_exit", decafSettings.debugger.break_on_exit);
    debugger->insert_or_assign("gdb_stub", decafSettings.debugger.gdb_stub);
    debugger->insert_or_assign("gdb_stub_port", decafSettings.debugger.gdb_stub_port);
+   debugger->insert_or_assign("validate_threads", decafSettings.debugger.validate_threads);
 
    // gx2
    auto gx2 = config.insert("gx2", toml::table()).first->second.as_table();
@@ -259,6 +313,7 @@ saveToTOML(toml::table &config,
    log->insert_or_assign("directory", decafSettings.log.directory);
    log->insert_or_assign("hle_trace", decafSettings.log.hle_trace);
    log->insert_or_assign("hle_trace_res", decafSettings.log.hle_trace_res);
+   log->insert_or_assign("hle_trace_binary", decafSettings.log.hle_trace_binary);
    log->insert_or_assign("level", decafSettings.log.level);
    log->insert_or_assign("to_file", decafSettings.log.to_file);
    log->insert_or_assign("to_stdout", decafSettings.log.to_stdout);
@@ -279,6 +334,7 @@ saveToTOML(toml::table &config,
    // sound
    auto sound = config.insert("sound", toml::table()).first->second.as_table();
    sound->insert_or_assign("dump_sounds", decafSettings.sound.dump_sounds);
+   sound->insert_or_assign("decode_threads", decafSettings.sound.decode_threads);
 
    // system
    auto system = config.insert("system", toml::table()).first->second.as_table();
@@ -291,6 +347,9 @@ saveToTOML(toml::table &config,
    system->insert_or_assign("slc_path", decafSettings.system.slc_path);
    system->insert_or_assign("content_path", decafSettings.system.content_path);
    system->insert_or_assign("time_scale", decafSettings.system.time_scale);
+   system->insert_or_assign("ios_worker_threads", decafSettings.system.ios_worker_threads);
+   system->insert_or_assign("rpl_section_cache", decafSettings.system.rpl_section_cache);
+   system->insert_or_assign("rpl_section_cache_path", decafSettings.system.rpl_section_cache_path);
 
    auto lle_modules = toml::array();
    for (auto &name : decafSettings.system.lle_modules) {
@@ -329,6 +388,12 @@ saveToTOML(toml::table &config,
    backgroundColour.push_back(gpuSettings.display.backgroundColour[1]);
    backgroundColour.push_back(gpuSettings.display.backgroundColour[2]);
    display->insert_or_assign("background_colour", std::move(backgroundColour));
+
+   // shader_cache
+   auto shaderCache = config.insert("shader_cache", toml::table()).first->second.as_table();
+   shaderCache->insert_or_assign("enabled", gpuSettings.shaderCache.enabled);
+   shaderCache->insert_or_assign("path", gpuSettings.shaderCache.path);
+   shaderCache->insert_or_assign("preload", gpuSettings.shaderCache.preload);
    return true;
 }
 
@@ -63,6 +63,9 @@ join();
 void
 halt();
 
+uint64_t
+getInterpreterInstructionCount();
+
 using Tracer = ::Tracer;
 
 Tracer *
@@ -39,14 +39,40 @@ struct JitSettings
       "X86_STORE_IMMEDIATE",
    };
 
+   //! Compile new blocks with minimal optimisations and recompile hot blocks
+   //! with the full optimisation flags on background threads
+   bool tieredCompilation = false;
+
+   //! Number of executions before a block is recompiled with full optimisations
+   unsigned int tieredCompileThreshold = 1000;
+
+   //! Number of background threads used to recompile hot blocks
+   unsigned int tieredCompileThreads = 1;
+
+   //! Directory to store the persistent JIT code cache in, empty to disable
+   std::string cacheDirectory;
+
    //! Treat .rodata sections as read-only regardless of RPL/RPX flags
    bool rodataReadOnly = true;
 };
 
 struct MemorySettings
 {
+   enum WriteTrackBackend
+   {
+      //! Write-protect tracked pages and catch the resulting access violation
+      PageGuard,
+
+      //! Query written pages from the kernel without taking any faults,
+      //! currently only supported on Linux, falls back to PageGuard
+      PageScan,
+   };
+
    //! Whether page guards for write tracking is enabled or not.
    bool writeTrackEnabled = false;
+
+   //! Mechanism used to detect writes to tracked memory
+   WriteTrackBackend writeTrackBackend = WriteTrackBackend::PageGuard;
 };
 
 struct Settings
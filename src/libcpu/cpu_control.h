@@ -2,6 +2,7 @@
 #include "state.h"
 
 #include <chrono>
+#include <string>
 
 namespace cpu
 {
@@ -32,6 +33,14 @@ void
 addJitReadOnlyRange(uint32_t address,
                     uint32_t size);
 
+void
+addJitCacheModule(const std::string &name,
+                  uint32_t textAddress,
+                  uint32_t textSize);
+
+void
+removeJitCacheModule(uint32_t textAddress);
+
 void
 interrupt(int core_idx,
           uint32_t flags);
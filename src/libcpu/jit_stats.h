@@ -41,6 +41,16 @@ struct CodeBlock
    //! Guest address of PPC code.
    uint32_t address;
 
+   //! Optimisation tier the code was compiled with.
+   uint32_t tier;
+
+   //! Number of executions counted towards promoting a baseline block, kept
+   //! apart from profileData so profiling does not change when it happens.
+   std::atomic<uint64_t> tieredCount;
+
+   //! Set once a baseline block has been queued for optimisation.
+   std::atomic<bool> tieredQueued;
+
    //! Host address of compiled code.
    void *code;
 
@@ -60,11 +70,25 @@ static constexpr CodeBlockIndex CodeBlockIndexUncompiled = -1;
 static constexpr CodeBlockIndex CodeBlockIndexCompiling = -2;
 static constexpr CodeBlockIndex CodeBlockIndexError = -3;
 
+//! Block was compiled with a minimal set of optimisations for fast translation.
+static constexpr uint32_t CodeBlockTierBaseline = 0;
+
+//! Block was compiled with the full set of optimisation flags.
+static constexpr uint32_t CodeBlockTierOptimised = 1;
+
 struct JitStats
 {
    uint64_t totalTimeInCodeBlocks = 0;
    uint64_t usedCodeCacheSize = 0;
    uint64_t usedDataCacheSize = 0;
+
+   //! Number of block exits which libbinrec chained straight to the next
+   //! block, counted while profiling.
+   uint64_t chainedExits = 0;
+
+   //! Number of block exits which returned to the dispatcher and looked up
+   //! the next block there, counted while profiling.
+   uint64_t lookedUpExits = 0;
    gsl::span<CodeBlock> compiledBlocks;
 };
 
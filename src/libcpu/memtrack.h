@@ -1,5 +1,6 @@
 #pragma once
 #include "address.h"
+#include "cpu_config.h"
 #include <common/decaf_assert.h>
 #include "mmu.h"
 
@@ -45,4 +46,11 @@ MemtrackState
 getMemoryState(PhysicalAddress physicalAddress,
                uint32_t size);
 
+/**
+ * The write tracking backend in use, which may differ from the configured
+ * one if it is not supported by the host.
+ */
+MemorySettings::WriteTrackBackend
+getMemtrackBackend();
+
 } // namespace cpu
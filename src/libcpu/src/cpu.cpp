@@ -58,6 +58,14 @@ initialise()
       };
       backend->setOptFlags(settings->jit.optimisationFlags);
       backend->setVerifyEnabled(settings->jit.verify, settings->jit.verifyAddress);
+
+      if (!settings->jit.verify) {
+         backend->setTieredCompilation(settings->jit.tieredCompilation,
+                                       settings->jit.tieredCompileThreshold,
+                                       settings->jit.tieredCompileThreads);
+         backend->setCacheDirectory(settings->jit.cacheDirectory);
+      }
+
       jit::setBackend(backend);
    }
 
@@ -68,6 +76,7 @@ void
 clearInstructionCache()
 {
    cpu::jit::clearCache(0, 0xFFFFFFFF);
+   interpreter::clearInstructionCache();
 }
 
 void
@@ -75,6 +84,7 @@ invalidateInstructionCache(uint32_t address,
                            uint32_t size)
 {
    cpu::jit::clearCache(address, size);
+   interpreter::invalidateInstructionCache(address, size);
 }
 
 void
@@ -84,6 +94,20 @@ addJitReadOnlyRange(uint32_t address,
    jit::addReadOnlyRange(address, size);
 }
 
+void
+addJitCacheModule(const std::string &name,
+                  uint32_t textAddress,
+                  uint32_t textSize)
+{
+   jit::addCacheModule(name, textAddress, textSize);
+}
+
+void
+removeJitCacheModule(uint32_t textAddress)
+{
+   jit::removeCacheModule(textAddress);
+}
+
 void
 coreEntryPoint(Core *core)
 {
@@ -126,6 +150,9 @@ join()
    }
 
    internal::joinAlarmThread();
+
+   // All cores have stopped so it is now safe to save the JIT cache
+   jit::saveCache();
 }
 
 void
@@ -162,6 +189,16 @@ setBranchTraceHandler(BranchTraceHandler handler)
    gBranchTraceHandler = handler;
 }
 
+/**
+ * Number of instructions run by the interpreter on all cores, this does not
+ * include code run by the JIT.
+ */
+uint64_t
+getInterpreterInstructionCount()
+{
+   return interpreter::getInstructionCount();
+}
+
 std::chrono::steady_clock::time_point
 tbToTimePoint(uint64_t ticks)
 {
@@ -5,15 +5,295 @@
 #include <common/platform.h>
 #ifdef PLATFORM_POSIX
 
+#include "cpu_config.h"
+
+#include <array>
+#include <atomic>
+#include <common/log.h>
+#include <common/platform_exception.h>
+#include <common/platform_memory.h>
+#include <common/rangecombiner.h>
+#include <cstring>
+#include <sys/mman.h>
+#include <vector>
+
+#ifdef PLATFORM_LINUX
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// PAGEMAP_SCAN and asynchronous userfaultfd write-protection were added in
+// Linux 6.7, define them ourselves so we can build against older headers.
+#ifndef PAGEMAP_SCAN
+#define PAGE_IS_WRITTEN (1 << 1)
+#define PM_SCAN_WP_MATCHING (1 << 0)
+#define PM_SCAN_CHECK_WPASYNC (1 << 1)
+
+struct page_region
+{
+   __u64 start;
+   __u64 end;
+   __u64 categories;
+};
+
+struct pm_scan_arg
+{
+   __u64 size;
+   __u64 flags;
+   __u64 start;
+   __u64 end;
+   __u64 walk_end;
+   __u64 vec;
+   __u64 vec_len;
+   __u64 max_pages;
+   __u64 category_inverted;
+   __u64 category_mask;
+   __u64 category_anyof_mask;
+   __u64 return_mask;
+};
+
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#endif
+
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+
+#ifndef UFFD_FEATURE_WP_HUGETLBFS_SHMEM
+#define UFFD_FEATURE_WP_HUGETLBFS_SHMEM (1 << 12)
+#endif
+
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#endif
+#endif // PLATFORM_LINUX
+
 namespace cpu
 {
 
+static constexpr uint64_t PhysTrackSetBit = 0x8000000000000000;
+static constexpr uint64_t PhysIsMappedBit = 0x4000000000000000;
+static constexpr uint32_t VirtTrackSetBit = 0x80000000;
+static constexpr uint32_t VirtIsMappedBit = 0x40000000;
+
+struct MappedArea
+{
+   cpu::VirtualAddress virtAddr;
+   cpu::PhysicalAddress physAddr;
+   uint32_t size;
+};
+
+static uintptr_t sPhysBaseAddress = 0;
+static uintptr_t sVirtBaseAddress = 0;
+static uint64_t sPageSizeBits = 0;
+static std::atomic<uint32_t> *sVirtLookup = nullptr;
+static std::atomic<uint64_t> *sTrackCount = nullptr;
+static std::vector<MappedArea> sVirtMap;
+static bool sUsePageScan = false;
+
+#ifdef PLATFORM_LINUX
+static int sUserfaultFd = -1;
+static int sPagemapFd = -1;
+#endif
+
 namespace internal
 {
 
+/**
+ * Handle a write to a write-protected page.
+ *
+ * This runs inside the SIGSEGV handler so it must only use async signal safe
+ * functions, luckily mprotect is one of them.
+ */
+static platform::ExceptionResumeFunc
+writeExceptionHandler(platform::Exception *exception)
+{
+   if (exception->type != platform::Exception::AccessViolation) {
+      return platform::UnhandledException;
+   }
+
+   // We do not verify that the SET bit is set since another thread may be
+   // racing us.  Instead we only check that the region was mapped, if it was
+   // mapped then it is meant to be writable and we can safely unprotect it.
+   auto info = reinterpret_cast<platform::AccessViolationException *>(exception);
+   auto memoryAddress = static_cast<uintptr_t>(info->address);
+
+   if (memoryAddress < sVirtBaseAddress ||
+       memoryAddress >= sVirtBaseAddress + 0x100000000) {
+      return platform::UnhandledException;
+   }
+
+   auto lookupIdx = (memoryAddress - sVirtBaseAddress) >> sPageSizeBits;
+   auto oldLookupValue = sVirtLookup[lookupIdx].fetch_and(~VirtTrackSetBit);
+   if (!(oldLookupValue & VirtIsMappedBit)) {
+      // This was an unmapped range to begin with, it's a real segfault.
+      return platform::UnhandledException;
+   }
+
+   // Increment the counter of the physical page to mark it as having changed
+   auto trackIdx = oldLookupValue & ~(VirtTrackSetBit | VirtIsMappedBit);
+   sTrackCount[trackIdx].fetch_add(1);
+
+   // Finally we reprotect the memory to its normal state
+   auto pageAddress = sVirtBaseAddress + (lookupIdx << sPageSizeBits);
+   if (mprotect(reinterpret_cast<void *>(pageAddress),
+                size_t { 1 } << sPageSizeBits,
+                PROT_READ | PROT_WRITE) != 0) {
+      return platform::UnhandledException;
+   }
+
+   return platform::HandledException;
+}
+
+#ifdef PLATFORM_LINUX
+
+/**
+ * Set up write tracking using userfaultfd in asynchronous write-protect mode.
+ *
+ * Writes to a write-protected page are resolved by the kernel without
+ * notifying us, which simply marks the page as written.  We later collect
+ * and re-protect the written pages with the PAGEMAP_SCAN ioctl, so tracking
+ * a page costs no signal and no userspace round trip.
+ */
+static bool
+initialisePageScan()
+{
+   auto uffd = static_cast<int>(syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY));
+   if (uffd < 0) {
+      return false;
+   }
+
+   auto api = uffdio_api { };
+   api.api = UFFD_API;
+   api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED | UFFD_FEATURE_WP_HUGETLBFS_SHMEM;
+   if (ioctl(uffd, UFFDIO_API, &api) != 0) {
+      close(uffd);
+      return false;
+   }
+
+   auto pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+   if (pagemap < 0) {
+      close(uffd);
+      return false;
+   }
+
+   // Make sure the kernel understands PAGEMAP_SCAN
+   auto args = pm_scan_arg { };
+   args.size = sizeof(args);
+   args.start = sVirtBaseAddress;
+   args.end = sVirtBaseAddress;
+   args.category_mask = PAGE_IS_WRITTEN;
+   args.return_mask = PAGE_IS_WRITTEN;
+   if (ioctl(pagemap, PAGEMAP_SCAN, &args) < 0) {
+      close(pagemap);
+      close(uffd);
+      return false;
+   }
+
+   sUserfaultFd = uffd;
+   sPagemapFd = pagemap;
+   sUsePageScan = true;
+   return true;
+}
+
+
+/**
+ * Collect the pages written since the last scan of a virtual range and
+ * write-protect them again, incrementing the counter of each written page.
+ */
+static void
+scanWrittenPages(uintptr_t startPage,
+                 uintptr_t lastPage)
+{
+   auto regions = std::array<page_region, 64> { };
+   auto start = sVirtBaseAddress + (startPage << sPageSizeBits);
+   auto end = sVirtBaseAddress + ((lastPage + 1) << sPageSizeBits);
+
+   while (start < end) {
+      auto args = pm_scan_arg { };
+      args.size = sizeof(args);
+      args.flags = PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC;
+      args.start = start;
+      args.end = end;
+      args.vec = reinterpret_cast<uintptr_t>(regions.data());
+      args.vec_len = regions.size();
+      args.category_mask = PAGE_IS_WRITTEN;
+      args.return_mask = PAGE_IS_WRITTEN;
+
+      auto count = ioctl(sPagemapFd, PAGEMAP_SCAN, &args);
+      if (count < 0 || args.walk_end <= start) {
+         // The range could not be scanned, most likely it is no longer
+         // registered with userfaultfd, so we must assume it was written.
+         for (auto i = (start - sVirtBaseAddress) >> sPageSizeBits; i <= lastPage; ++i) {
+            auto lookupValue = sVirtLookup[i].load();
+            if (lookupValue & VirtIsMappedBit) {
+               sTrackCount[lookupValue & ~(VirtTrackSetBit | VirtIsMappedBit)].fetch_add(1);
+            }
+         }
+         break;
+      }
+
+      for (auto i = 0; i < count; ++i) {
+         auto regionStartPage = (regions[i].start - sVirtBaseAddress) >> sPageSizeBits;
+         auto regionEndPage = (regions[i].end - sVirtBaseAddress) >> sPageSizeBits;
+
+         for (auto page = regionStartPage; page < regionEndPage; ++page) {
+            auto lookupValue = sVirtLookup[page].load();
+            if (lookupValue & VirtIsMappedBit) {
+               sTrackCount[lookupValue & ~(VirtTrackSetBit | VirtIsMappedBit)].fetch_add(1);
+            }
+         }
+      }
+
+      start = args.walk_end;
+   }
+}
+
+#endif // PLATFORM_LINUX
+
 void
 initialiseMemtrack()
 {
+   if (!config()->memory.writeTrackEnabled) {
+      return;
+   }
+
+   auto pageSize = platform::getSystemPageSize();
+   auto pageSizeBits = 0;
+   auto i = pageSize;
+   while (i >>= 1) pageSizeBits++;
+
+   sPhysBaseAddress = cpu::getBasePhysicalAddress();
+   sVirtBaseAddress = cpu::getBaseVirtualAddress();
+   sPageSizeBits = pageSizeBits;
+
+   auto numtrackTableEntries = 0x100000000 >> pageSizeBits;
+
+   // Initialise the lookup table to 0 (unmapped)
+   sVirtLookup = new std::atomic<uint32_t>[numtrackTableEntries];
+   std::memset(sVirtLookup, 0x00, numtrackTableEntries * sizeof(uint32_t));
+
+   // Initialise the tracking table to all 0's
+   sTrackCount = new std::atomic<uint64_t>[numtrackTableEntries];
+   std::memset(sTrackCount, 0x00, numtrackTableEntries * sizeof(uint64_t));
+
+#ifdef PLATFORM_LINUX
+   if (config()->memory.writeTrackBackend == MemorySettings::PageScan) {
+      if (initialisePageScan()) {
+         gLog->info("Using page scan for memory write tracking");
+         return;
+      }
+
+      gLog->warn("Page scan memory write tracking is not supported by this kernel, falling back to page guards");
+   }
+#endif
+
+   // Install the exception handler, this happens before the cpu installs its
+   // own host exception handler so we will always see write faults first.
+   platform::installExceptionHandler(writeExceptionHandler);
 }
 
 void
@@ -21,17 +301,109 @@ registerTrackedRange(VirtualAddress virtualAddress,
                      PhysicalAddress physicalAddress,
                      uint32_t size)
 {
+   if (!sTrackCount) {
+      return;
+   }
+
+   if (size == 0) {
+      return;
+   }
+
+   // We have to remove any conflicting virtual mappings before we can proceed,
+   // see the matching comment in cpu_memtrack_win.cpp.
+   for (auto iter = sVirtMap.begin(); iter != sVirtMap.end(); ) {
+      if (virtualAddress >= iter->virtAddr && virtualAddress < iter->virtAddr + iter->size) {
+         iter = sVirtMap.erase(iter);
+      } else {
+         ++iter;
+      }
+   }
+
+   // Add an entry to the mappings list
+   sVirtMap.push_back({ virtualAddress, physicalAddress, size });
+
+   // Apply the neccessary changes to the tracking tables
+   auto firstPhysPage = physicalAddress.getAddress() >> sPageSizeBits;
+   auto firstPage = virtualAddress.getAddress() >> sPageSizeBits;
+   auto lastPage = (virtualAddress.getAddress() + (size - 1)) >> sPageSizeBits;
+
+   for (auto pageIdx = firstPage, physPageIdx = firstPhysPage;
+        pageIdx <= lastPage;
+        ++pageIdx, ++physPageIdx)
+   {
+      auto oldPhysPage = sVirtLookup[pageIdx].exchange(VirtIsMappedBit | static_cast<uint32_t>(physPageIdx));
+      if (oldPhysPage & VirtIsMappedBit) {
+         decaf_abort("write tracker attempted to register an already registered page");
+      }
+
+      // Mark the page as changed, the next time it is checked for changes the
+      // correct protection will be applied.
+      sTrackCount[physPageIdx].fetch_add(1);
+   }
+
+#ifdef PLATFORM_LINUX
+   if (sUserfaultFd >= 0) {
+      // Unmapping the memory will automatically unregister it again
+      auto reg = uffdio_register { };
+      reg.range.start = sVirtBaseAddress + (firstPage << sPageSizeBits);
+      reg.range.len = (lastPage - firstPage + 1) << sPageSizeBits;
+      reg.mode = UFFDIO_REGISTER_MODE_WP;
+      if (ioctl(sUserfaultFd, UFFDIO_REGISTER, &reg) != 0) {
+         gLog->warn("Failed to register 0x{:08X} for page scan write tracking",
+                    virtualAddress.getAddress());
+      }
+   }
+#endif
 }
 
 void
 unregisterTrackedRange(VirtualAddress virtualAddress,
                        uint32_t size)
 {
+   if (!sTrackCount) {
+      return;
+   }
+
+   if (size == 0) {
+      return;
+   }
+
+   // Remove the entry from the mappings list
+   for (auto iter = sVirtMap.begin(); iter != sVirtMap.end(); ++iter) {
+      if (iter->virtAddr == virtualAddress && iter->size == size) {
+         sVirtMap.erase(iter);
+         break;
+      }
+   }
+
+   // Apply the neccessary changes to the tracking tables
+   auto firstPage = virtualAddress.getAddress() >> sPageSizeBits;
+   auto lastPage = firstPage + ((size - 1) >> sPageSizeBits);
+
+   for (auto pageIdx = firstPage; pageIdx <= lastPage; ++pageIdx) {
+      auto oldPhysPage = sVirtLookup[pageIdx].exchange(0x00000000);
+      if (!(oldPhysPage & VirtIsMappedBit)) {
+         decaf_abort("write tracker attempted to unregister an already unregister page");
+      }
+
+      // The memory map has already been unmapped, so any protection we
+      // applied to this page has gone with it.
+      sTrackCount[oldPhysPage & ~(VirtTrackSetBit | VirtIsMappedBit)].fetch_add(1);
+   }
 }
 
 void
 clearTrackedRanges()
 {
+   if (!sTrackCount) {
+      return;
+   }
+
+   // Resetting the tracked ranges is as simple as clearing the lookup table
+   // we are using to translate virtual addresses to physical pages.
+   auto numtrackTableEntries = 0x100000000 >> sPageSizeBits;
+   std::memset(sVirtLookup, 0x00, numtrackTableEntries * sizeof(uint32_t));
+   sVirtMap.clear();
 }
 
 } // namespace internal
@@ -40,11 +412,104 @@ MemtrackState
 getMemoryState(PhysicalAddress physicalAddress,
                uint32_t size)
 {
-   // POSIX always hashes for the moment.  This is due to my inability to actually
-   // test any sort of implementation on a linux system.
-   auto physPtr = reinterpret_cast<void *>(cpu::getBasePhysicalAddress() + physicalAddress.getAddress());
-   auto hashVal = DataHash {}.write(physPtr, size);
-   return MemtrackState { hashVal.value() };
+   if (!sTrackCount) {
+      // If the write tracking system is not enabled, we simply hash.
+      auto physPtr = reinterpret_cast<void *>(cpu::getBasePhysicalAddress() + physicalAddress.getAddress());
+      auto hashVal = DataHash {}.write(physPtr, size);
+      return MemtrackState { hashVal.value() };
+   }
+
+   if (size == 0) {
+      return MemtrackState { 0 };
+   }
+
+#ifdef PLATFORM_LINUX
+   if (sUsePageScan) {
+      // Collect any writes first so they are included in the returned state,
+      // this also write-protects the pages again for the future.
+      for (auto &area : sVirtMap) {
+         if (physicalAddress < area.physAddr || physicalAddress >= area.physAddr + area.size) {
+            continue;
+         }
+
+         auto virtualAddress = area.virtAddr + (physicalAddress - area.physAddr);
+         uintptr_t startAddr = virtualAddress.getAddress();
+         uintptr_t endAddr = startAddr + (size - 1);
+         internal::scanWrittenPages(startAddr >> sPageSizeBits, endAddr >> sPageSizeBits);
+      }
+   }
+#endif
+
+   // The state is the sum of the change counters of every page in the range
+   uint64_t pageIndexTotal = 0;
+
+   {
+      uintptr_t startAddr = physicalAddress.getAddress();
+      uintptr_t endAddr = startAddr + (size - 1);
+
+      auto startPage = startAddr >> sPageSizeBits;
+      auto lastPage = endAddr >> sPageSizeBits;
+
+      for (auto i = startPage; i <= lastPage; ++i) {
+         auto pageData = sTrackCount[i].load();
+         auto pageCount = pageData & ~(PhysTrackSetBit);
+         pageIndexTotal += pageCount;
+      }
+   }
+
+   if (sUsePageScan) {
+      return MemtrackState { pageIndexTotal };
+   }
+
+   // Write-protect all these regions for the future
+   for (auto &area : sVirtMap) {
+      if (physicalAddress < area.physAddr || physicalAddress >= area.physAddr + area.size) {
+         continue;
+      }
+
+      auto virtualAddress = area.virtAddr + (physicalAddress - area.physAddr);
+
+      uintptr_t startAddr = virtualAddress.getAddress();
+      uintptr_t endAddr = startAddr + (size - 1);
+
+      auto startPage = startAddr >> sPageSizeBits;
+      auto lastPage = endAddr >> sPageSizeBits;
+
+      auto pagePtr = reinterpret_cast<uint8_t *>(sVirtBaseAddress + (startPage << sPageSizeBits));
+      auto pageSize = uint64_t { 1 } << sPageSizeBits;
+
+      auto protectCombiner = makeRangeCombiner<void *, uint8_t *, uint64_t>(
+         [=](void *, uint8_t *pagePtr, uint64_t pageSize)
+         {
+            if (mprotect(pagePtr, pageSize, PROT_READ) != 0) {
+               decaf_abort("Attempted to write-track a weird page");
+            }
+         });
+
+      for (auto i = startPage; i <= lastPage; ++i) {
+         auto oldTrackValue = sVirtLookup[i].fetch_or(VirtTrackSetBit | VirtIsMappedBit);
+         if (!(oldTrackValue & VirtIsMappedBit)) {
+            decaf_abort("Attempted to write-track unmapped memory");
+         }
+
+         if (!(oldTrackValue & VirtTrackSetBit)) {
+            // If we weren't previous tracking this memory, we need to add it.
+            protectCombiner.push(nullptr, pagePtr, pageSize);
+         }
+
+         pagePtr += pageSize;
+      }
+
+      protectCombiner.flush();
+   }
+
+   return MemtrackState { pageIndexTotal };
+}
+
+MemorySettings::WriteTrackBackend
+getMemtrackBackend()
+{
+   return sUsePageScan ? MemorySettings::PageScan : MemorySettings::PageGuard;
 }
 
 } // namespace cpu
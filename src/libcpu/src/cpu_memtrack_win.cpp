@@ -306,6 +306,12 @@ getMemoryState(PhysicalAddress physicalAddress,
    return MemtrackState { pageIndexTotal };
 }
 
+MemorySettings::WriteTrackBackend
+getMemtrackBackend()
+{
+   return MemorySettings::PageGuard;
+}
+
 } // namespace cpu
 
 #endif // PLATFORM_WINDOWS
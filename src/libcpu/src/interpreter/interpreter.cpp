@@ -2,13 +2,18 @@
 #include "cpu_internal.h"
 #include "espresso/espresso_instructionset.h"
 #include "interpreter.h"
+#include "interpreter_cache.h"
 #include "interpreter_insreg.h"
 #include "mem.h"
 #include "trace.h"
 
+#include <array>
+#include <atomic>
 #include <cfenv>
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <common/platform_compiler.h>
+#include <memory>
 
 namespace cpu
 {
@@ -16,13 +21,41 @@ namespace cpu
 namespace interpreter
 {
 
-static std::vector<instrfptr_t>
-sInstructionMap;
+struct InstructionHandler
+{
+   instrfptr_t fptr = nullptr;
+   espresso::InstructionInfo *info = nullptr;
+
+   //! The instruction may change nia or switch to another core.
+   bool endsBlock = false;
+};
+
+static std::vector<InstructionHandler>
+sInstructionHandlers;
+
+static std::unique_ptr<InstructionCache>
+sInstructionCache;
+
+//! Instructions executed per core, only ever written by its own core.
+static std::array<std::atomic<uint64_t>, 3>
+sInstructionCount { };
+
+static bool
+isBlockEnd(espresso::InstructionID id)
+{
+   return espresso::isBranchInstruction(id)
+      || id == InstructionID::kc
+      || id == InstructionID::sc
+      || id == InstructionID::rfi
+      || id == InstructionID::tw
+      || id == InstructionID::twi;
+}
 
 void
 initialise()
 {
-   sInstructionMap.resize(static_cast<size_t>(espresso::InstructionID::InstructionCount), nullptr);
+   sInstructionHandlers.clear();
+   sInstructionHandlers.resize(static_cast<size_t>(espresso::InstructionID::InstructionCount));
 
    // Register instruction handlers
    registerBranchInstructions();
@@ -32,6 +65,15 @@ initialise()
    registerLoadStoreInstructions();
    registerPairedInstructions();
    registerSystemInstructions();
+
+   for (auto i = 0u; i < sInstructionHandlers.size(); ++i) {
+      auto id = static_cast<espresso::InstructionID>(i);
+      auto &handler = sInstructionHandlers[i];
+      handler.info = espresso::findInstructionInfo(id);
+      handler.endsBlock = isBlockEnd(id);
+   }
+
+   sInstructionCache = std::make_unique<InstructionCache>();
 }
 
 instrfptr_t
@@ -39,17 +81,17 @@ getInstructionHandler(espresso::InstructionID id)
 {
    auto instrId = static_cast<size_t>(id);
 
-   if (instrId >= sInstructionMap.size()) {
+   if (instrId >= sInstructionHandlers.size()) {
       return nullptr;
    }
 
-   return sInstructionMap[instrId];
+   return sInstructionHandlers[instrId].fptr;
 }
 
 void
 registerInstruction(espresso::InstructionID id, instrfptr_t fptr)
 {
-   sInstructionMap[static_cast<size_t>(id)] = fptr;
+   sInstructionHandlers[static_cast<size_t>(id)].fptr = fptr;
 }
 
 bool
@@ -58,48 +100,152 @@ hasInstruction(espresso::InstructionID id)
    return getInstructionHandler(id) != nullptr;
 }
 
-Core *
-step_one(Core *core)
+void
+clearInstructionCache()
 {
-   // Check if we hit any breakpoints
-   if (testBreakpoint(core->nia)) {
-      core->interrupt.fetch_or(DBGBREAK_INTERRUPT);
-      this_core::checkInterrupts();
+   if (sInstructionCache) {
+      sInstructionCache->clear();
    }
+}
 
-   auto cia = core->nia;
-   core->cia = cia;
-   core->nia = cia + 4;
+void
+invalidateInstructionCache(uint32_t address,
+                           uint32_t size)
+{
+   if (sInstructionCache) {
+      sInstructionCache->invalidate(address, size);
+   }
+}
+
+uint64_t
+getInstructionCount()
+{
+   auto count = uint64_t { 0 };
+
+   for (auto &coreCount : sInstructionCount) {
+      count += coreCount.load(std::memory_order_relaxed);
+   }
+
+   return count;
+}
 
-   auto instr = mem::read<espresso::Instruction>(cia);
+static void
+addInstructionCount(uint32_t coreId,
+                    uint64_t count)
+{
+   auto &coreCount = sInstructionCount[coreId];
+   coreCount.store(coreCount.load(std::memory_order_relaxed) + count,
+                   std::memory_order_relaxed);
+}
+
+static NEVER_INLINE InstructionCache::Entry
+decodeEntry(uint32_t address,
+            std::atomic<InstructionCache::Entry> &entry)
+{
+   auto generation = sInstructionCache->getGeneration();
+   auto instr = mem::read<espresso::Instruction>(address);
    auto data = espresso::decodeInstruction(instr);
 
    if (!data) {
-      gLog->error("Could not decode instruction at {:08x} = {:08x}", cia, instr.value);
+      gLog->error("Could not decode instruction at {:08x} = {:08x}", address, instr.value);
    }
    decaf_check(data);
 
-   auto trace = traceInstructionStart(instr, data, core);
-   auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
-
-   if (!fptr) {
+   if (!sInstructionHandlers[static_cast<size_t>(data->id)].fptr) {
       gLog->error("Unimplemented interpreter instruction {}", data->name);
    }
-   decaf_check(fptr);
+   decaf_check(sInstructionHandlers[static_cast<size_t>(data->id)].fptr);
+
+   auto value = InstructionCache::makeEntry(instr, data->id);
+   entry.store(value);
+
+   // If the address was invalidated whilst we were decoding we may have read
+   // the old instruction, so don't let anyone else use it.
+   if (sInstructionCache->getGeneration() != generation) {
+      entry.store(0);
+   }
+
+   return value;
+}
+
+static inline const InstructionHandler &
+fetchInstruction(uint32_t address,
+                 espresso::Instruction &instr)
+{
+   auto &entry = sInstructionCache->getEntry(address);
+   auto value = entry.load(std::memory_order_relaxed);
+
+   if (UNLIKELY(!value)) {
+      value = decodeEntry(address, entry);
+   }
 
-   fptr(core, instr);
+   instr = InstructionCache::getEntryInstruction(value);
+   return sInstructionHandlers[static_cast<size_t>(InstructionCache::getEntryId(value))];
+}
 
-   if (data->id == InstructionID::kc) {
+Core *
+step_one(Core *core)
+{
+   // Check if we hit any breakpoints
+   if (testBreakpoint(core->nia)) {
+      core->interrupt.fetch_or(DBGBREAK_INTERRUPT);
+      this_core::checkInterrupts();
+   }
+
+   auto coreId = core->id;
+   auto cia = core->nia;
+   core->cia = cia;
+   core->nia = cia + 4;
+
+   auto instr = espresso::Instruction { };
+   auto &handler = fetchInstruction(cia, instr);
+   auto trace = traceInstructionStart(instr, handler.info, core);
+   handler.fptr(core, instr);
+
+   if (handler.info->id == InstructionID::kc) {
       // If this is a KC, there is the potential that we are running on a
       //  different core now.  Lets make sure that we are using the right one.
       core = this_core::state();
    }
 
    decaf_check(core->cia == cia);
-   traceInstructionEnd(trace, instr, data, core);
+   traceInstructionEnd(trace, instr, handler.info, core);
+   addInstructionCount(coreId, 1);
    return core;
 }
 
+/**
+ * Run instructions until the end of the current basic block.
+ *
+ * Breakpoints are implemented by writing a tw instruction into memory and
+ * invalidating the instruction cache, so only the instruction which ends the
+ * block can be a breakpoint. That instruction goes through step_one which
+ * handles breakpoints and changing core after a kc.
+ */
+static Core *
+runBlock(Core *core)
+{
+   auto executed = uint64_t { 0 };
+
+   while (true) {
+      auto cia = core->nia;
+      auto instr = espresso::Instruction { };
+      auto &handler = fetchInstruction(cia, instr);
+
+      if (UNLIKELY(handler.endsBlock)) {
+         break;
+      }
+
+      core->cia = cia;
+      core->nia = cia + 4;
+      handler.fptr(core, instr);
+      ++executed;
+   }
+
+   addInstructionCount(core->id, executed);
+   return step_one(core);
+}
+
 void
 resume()
 {
@@ -110,7 +256,13 @@ resume()
    auto core = cpu::this_core::state();
    while (core->nia != cpu::CALLBACK_ADDR) {
       this_core::checkInterrupts();
-      core = step_one(this_core::state());
+      core = this_core::state();
+
+      if (UNLIKELY(core->tracer)) {
+         core = step_one(core);
+      } else {
+         core = runBlock(core);
+      }
    }
 }
 
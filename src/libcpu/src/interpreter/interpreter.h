@@ -16,6 +16,16 @@ step_one(Core *core);
 void
 resume();
 
+void
+clearInstructionCache();
+
+void
+invalidateInstructionCache(uint32_t address,
+                           uint32_t size);
+
+uint64_t
+getInstructionCount();
+
 } // namespace interpreter
 
 } // namespace cpu
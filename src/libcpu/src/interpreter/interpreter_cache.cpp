@@ -0,0 +1,98 @@
+#include "interpreter_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cpu
+{
+
+namespace interpreter
+{
+
+InstructionCache::InstructionCache()
+{
+   mIndex = new std::atomic<std::atomic<Entry> *>[Level1Size];
+   std::memset(mIndex, 0, sizeof(mIndex[0]) * Level1Size);
+}
+
+InstructionCache::~InstructionCache()
+{
+   for (auto i = 0u; i < Level1Size; ++i) {
+      delete[] mIndex[i].load();
+   }
+
+   delete[] mIndex;
+}
+
+
+/**
+ * Forget every decoded instruction.
+ *
+ * The second level tables are kept, they may still be in use by a core
+ * which is in the middle of running a block.
+ */
+void
+InstructionCache::clear()
+{
+   mGeneration.fetch_add(1);
+
+   for (auto i = 0u; i < Level1Size; ++i) {
+      auto level2 = mIndex[i].load(std::memory_order_acquire);
+
+      for (auto j = 0u; level2 && j < Level2Size; ++j) {
+         level2[j].store(0, std::memory_order_relaxed);
+      }
+   }
+}
+
+
+/**
+ * Forget any decoded instructions in the range [address, address + size).
+ */
+void
+InstructionCache::invalidate(uint32_t address,
+                             uint32_t size)
+{
+   if (!size) {
+      return;
+   }
+
+   mGeneration.fetch_add(1);
+
+   auto start = static_cast<uint64_t>(address & ~3u);
+   auto end = std::min<uint64_t>(static_cast<uint64_t>(address) + size,
+                                 0x100000000ull);
+
+   for (auto addr = start; addr < end; ) {
+      auto level1 = static_cast<uint32_t>(addr >> 16);
+      auto level1End = std::min<uint64_t>((static_cast<uint64_t>(level1) + 1) << 16, end);
+      auto level2 = mIndex[level1].load(std::memory_order_acquire);
+
+      for (; level2 && addr < level1End; addr += 4) {
+         level2[(addr & 0xFFFC) >> 2].store(0, std::memory_order_relaxed);
+      }
+
+      addr = level1End;
+   }
+}
+
+std::atomic<InstructionCache::Entry> *
+InstructionCache::allocateLevel2(uint32_t address)
+{
+   auto &slot = mIndex[address >> 16];
+   auto newLevel2 = new std::atomic<Entry>[Level2Size];
+   std::memset(newLevel2, 0, sizeof(newLevel2[0]) * Level2Size);
+
+   auto level2 = static_cast<std::atomic<Entry> *>(nullptr);
+   if (slot.compare_exchange_strong(level2, newLevel2)) {
+      return newLevel2;
+   }
+
+   // compare_exchange updates level2 if another core beat us to it
+   delete[] newLevel2;
+   return level2;
+}
+
+} // namespace interpreter
+
+} // namespace cpu
@@ -0,0 +1,105 @@
+#pragma once
+#include "espresso/espresso_instruction.h"
+#include "espresso/espresso_instructionid.h"
+
+#include <atomic>
+#include <common/platform_compiler.h>
+#include <cstdint>
+
+namespace cpu
+{
+
+namespace interpreter
+{
+
+/**
+ * Cache of pre-decoded instructions for the interpreter.
+ *
+ * Each guest instruction address maps to a single 64 bit entry holding the
+ * instruction word and its decoded InstructionID, so a core can read both
+ * with one relaxed atomic load while another core decodes or invalidates
+ * neighbouring entries. An entry of 0 means the instruction has not been
+ * decoded yet.
+ *
+ * The index is split into two levels the same as the JIT's CodeCache, the
+ * second level is allocated the first time an address inside it is run.
+ */
+class InstructionCache
+{
+   static constexpr size_t Level1Size = 0x10000;
+   static constexpr size_t Level2Size = 0x4000;
+
+public:
+   using Entry = uint64_t;
+
+   InstructionCache();
+   ~InstructionCache();
+
+   static Entry
+   makeEntry(espresso::Instruction instr,
+             espresso::InstructionID id)
+   {
+      return (static_cast<uint64_t>(instr.value) << 32)
+           | (static_cast<uint64_t>(id) << 1)
+           | 1;
+   }
+
+   static espresso::Instruction
+   getEntryInstruction(Entry entry)
+   {
+      return { static_cast<uint32_t>(entry >> 32) };
+   }
+
+   static espresso::InstructionID
+   getEntryId(Entry entry)
+   {
+      return static_cast<espresso::InstructionID>((entry & 0xFFFFFFFF) >> 1);
+   }
+
+   /**
+    * Get the entry for an instruction address, allocating its second level
+    * table if needed.
+    */
+   std::atomic<Entry> &
+   getEntry(uint32_t address)
+   {
+      auto level2 = mIndex[address >> 16].load(std::memory_order_acquire);
+
+      if (UNLIKELY(!level2)) {
+         level2 = allocateLevel2(address);
+      }
+
+      return level2[(address & 0xFFFC) >> 2];
+   }
+
+   /**
+    * Generation of the cache, incremented by every invalidation.
+    *
+    * A decode which raced with an invalidation of the same address must not
+    * be stored, as it may have read the old instruction from memory.
+    */
+   uint32_t
+   getGeneration()
+   {
+      return mGeneration.load();
+   }
+
+   void
+   clear();
+
+   void
+   invalidate(uint32_t address,
+              uint32_t size);
+
+private:
+   std::atomic<Entry> *
+   allocateLevel2(uint32_t address);
+
+private:
+   std::atomic<std::atomic<Entry> *> *mIndex = nullptr;
+   std::atomic<uint32_t> mGeneration { 0 };
+};
+
+} // namespace interpreter
+
+} // namespace cpu
@@ -3,6 +3,7 @@
 #include "cpu_internal.h"
 #include "espresso/espresso_spr.h"
 #include "espresso/espresso_instructionset.h"
+#include "interpreter.h"
 #include "interpreter_insreg.h"
 #include "mem.h"
 
@@ -35,6 +36,16 @@ INS(ecowx, (rd), (ra, rb), (), (opcd == 31, xo1 == 438), "")
 static void
 icbi(cpu::Core *state, Instruction instr)
 {
+   uint32_t addr;
+
+   if (instr.rA == 0) {
+      addr = 0;
+   } else {
+      addr = state->gpr[instr.rA];
+   }
+
+   addr += state->gpr[instr.rB];
+   cpu::interpreter::invalidateInstructionCache(align_down(addr, 32), 32);
 }
 
 // Data Cache Block Flush
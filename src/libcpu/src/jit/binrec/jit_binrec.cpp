@@ -39,6 +39,7 @@ BinrecBackend::BinrecBackend(size_t codeCacheSize,
 
 BinrecBackend::~BinrecBackend()
 {
+   stopOptimiserThreads();
    mCodeCache.free();
 }
 
@@ -87,6 +88,7 @@ BinrecBackend::initialiseCore(uint32_t id)
 void
 BinrecBackend::addReadOnlyRange(uint32_t address, uint32_t size)
 {
+   std::unique_lock<std::mutex> lock { mReadOnlyRangeMutex };
    mReadOnlyRanges.emplace_back(address, size);
 }
 
@@ -94,15 +96,21 @@ void
 BinrecBackend::clearCache(uint32_t address, uint32_t size)
 {
    if (address == 0 && size == 0xFFFFFFFF) {
+      // Any block an optimiser thread is still translating is now stale,
+      // the publish lock is only held briefly so this does not wait for a
+      // whole translation.
+      mCacheGeneration.fetch_add(1);
+      std::unique_lock<std::mutex> lock { mOptimiserPublishMutex };
       mCodeCache.clear();
       mTotalProfileTime = 0;
    } else {
       mCodeCache.invalidate(address, size);
+      invalidateCacheModules(address, size);
    }
 }
 
 BinrecHandle *
-BinrecBackend::createBinrecHandle()
+BinrecBackend::createBinrecHandle(const BinrecOptimisationFlags &optFlags)
 {
    binrec::Setup setup;
    std::memset(&setup, 0, sizeof(setup));
@@ -144,17 +152,20 @@ BinrecBackend::createBinrecHandle()
       return nullptr;
    }
 
-   handle->set_optimization_flags(mOptFlags.common, mOptFlags.guest, mOptFlags.host);
+   handle->set_optimization_flags(optFlags.common, optFlags.guest, optFlags.host);
    handle->enable_branch_exit_test(true);
-   handle->enable_chaining(mOptFlags.useChaining);
+   handle->enable_chaining(optFlags.useChaining);
 
    if (mVerifyEnabled && mVerifyAddress == 0) {
       handle->set_pre_insn_callback(brVerifyPreHandler);
       handle->set_post_insn_callback(brVerifyPostHandler);
    }
 
-   for (const auto &range : mReadOnlyRanges) {
-      handle->add_readonly_region(range.first, range.second);
+   {
+      std::unique_lock<std::mutex> lock { mReadOnlyRangeMutex };
+      for (const auto &range : mReadOnlyRanges) {
+         handle->add_readonly_region(range.first, range.second);
+      }
    }
 
    return handle;
@@ -210,7 +221,13 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
    // If block is uncompiled, let's try mark it as compiling!
    if (UNLIKELY(blockIndex == CodeBlockIndexUncompiled)) {
       if (!indexPtr->compare_exchange_strong(blockIndex, CodeBlockIndexCompiling)) {
-         // Another thread has started compiling, wait for it to finish.
+         // Another thread has started compiling, in tiered mode we do not
+         // wait and instead let the caller fall back to the interpreter.
+         if (mTieredEnabled && blockIndex == CodeBlockIndexCompiling) {
+            return nullptr;
+         }
+
+         // Otherwise wait for it to finish.
          while (blockIndex == CodeBlockIndexCompiling) {
             using namespace std::chrono_literals;
             std::this_thread::sleep_for(10us);
@@ -240,9 +257,11 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
       return block;
    }
 
+   // In tiered mode the guest cores only compile baseline blocks, hot
+   // blocks are recompiled with the full optimisation flags later.
    auto handle = mHandles[core->id];
    if (!handle) {
-      handle = createBinrecHandle();
+      handle = createBinrecHandle(mTieredEnabled ? mBaselineOptFlags : mOptFlags);
       mHandles[core->id] = handle;
    }
 
@@ -256,24 +275,84 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
       }
    }
 
+   auto tier = mTieredEnabled ? CodeBlockTierBaseline : CodeBlockTierOptimised;
+   auto block = compileCodeBlock(handle, core, address, tier);
+   if (!block) {
+      indexPtr->store(CodeBlockIndexError);
+      return nullptr;
+   }
+
+   indexPtr->store(mCodeCache.getIndex(block));
+
+   // Clear any floating-point exceptions raised by the translation so
+   // the translated code doesn't pick them up.
+   std::feclearexcept(FE_ALL_EXCEPT);
+   return block;
+}
+
+
+/**
+ * Translate the code at address into a new code block.
+ *
+ * The block is not published in the code cache index, this is left to the
+ * caller.  Returns nullptr if translation failed.
+ */
+CodeBlock *
+BinrecBackend::compileCodeBlock(BinrecHandle *handle,
+                                BinrecCore *core,
+                                uint32_t address,
+                                uint32_t tier)
+{
+   void *buffer = nullptr;
+   auto size = long { 0 };
+
+   if (!translateCodeBlock(handle, core, address, &buffer, &size)) {
+      return nullptr;
+   }
+
+   return createTranslatedCodeBlock(address, tier, buffer, size);
+}
+
+
+/**
+ * Translate the code at address without touching the code cache, the
+ * returned buffer must be passed to createTranslatedCodeBlock.
+ */
+bool
+BinrecBackend::translateCodeBlock(BinrecHandle *handle,
+                                  BinrecCore *core,
+                                  uint32_t address,
+                                  void **buffer,
+                                  long *size)
+{
    // In extreme cases (such as dense floating-point code with no
    // optimizations enabled), translation could fail due to internal
    // libbinrec limits, so try repeatedly with smaller code ranges if
    // the first translation attempt fails.
    auto limit = 4096u;
-   auto size = long { 0 };
-   void *buffer = nullptr;
 
-   while (!handle->translate(core, address, address + limit - 1, &buffer, &size)) {
+   while (!handle->translate(core, address, address + limit - 1, buffer, size)) {
       limit /= 2;
 
       if (limit < 256) {
          gLog->warn("Failed to translate code at 0x{:X}", address);
-         indexPtr->store(CodeBlockIndexError);
-         return nullptr;
+         return false;
       }
    }
 
+   return true;
+}
+
+
+/**
+ * Copy a translation into a new code block and free its buffer.
+ */
+CodeBlock *
+BinrecBackend::createTranslatedCodeBlock(uint32_t address,
+                                         uint32_t tier,
+                                         void *buffer,
+                                         long size)
+{
 #ifdef PLATFORM_WINDOWS
    // First 8 bytes of buffer is offset to start of code
    auto codeOffset = *reinterpret_cast<uint64_t *>(buffer);
@@ -288,13 +367,9 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
    auto unwindSize = size_t { 0 };
 #endif
 
-   auto block = mCodeCache.registerCodeBlock(address, code, codeSize, unwindInfo, unwindSize);
+   auto block = mCodeCache.createCodeBlock(address, tier, code, codeSize, unwindInfo, unwindSize);
    decaf_check(block);
    free(buffer);
-
-   // Clear any floating-point exceptions raised by the translation so
-   // the translated code doesn't pick them up.
-   std::feclearexcept(FE_ALL_EXCEPT);
    return block;
 }
 
@@ -368,6 +443,10 @@ BinrecBackend::resumeExecution()
 #endif
 
          if (LIKELY(block)) {
+            if (UNLIKELY(mTieredEnabled)) {
+               updateTieredCount(core, block);
+            }
+
             auto entry = reinterpret_cast<BinrecEntry>(block->code);
             core = entry(core, memBase);
          } else {
@@ -381,9 +460,17 @@ BinrecBackend::resumeExecution()
             core = reinterpret_cast<BinrecCore *>(this_core::state());
          }
       } else { // mProfilingMask != 0
+         if (block && mProfilingMask & (1 << core->id)) {
+            mLookedUpExits.fetch_add(1, std::memory_order_relaxed);
+         }
+
          const uint64_t start = rdtsc();
 
          if (block) {
+            if (mTieredEnabled) {
+               updateTieredCount(core, block);
+            }
+
             auto entry = reinterpret_cast<BinrecEntry>(block->code);
             core = entry(core, memBase);
          } else {
@@ -415,6 +502,8 @@ bool
 BinrecBackend::sampleStats(JitStats &stats)
 {
    stats.totalTimeInCodeBlocks = mTotalProfileTime;
+   stats.chainedExits = mChainedExits;
+   stats.lookedUpExits = mLookedUpExits;
    stats.compiledBlocks = mCodeCache.getCompiledCodeBlocks();
    stats.usedCodeCacheSize = mCodeCache.getCodeCacheSize();
    stats.usedDataCacheSize = mCodeCache.getDataCacheSize();
@@ -437,6 +526,8 @@ BinrecBackend::resetProfileStats()
 
    // Clear generic stats
    mTotalProfileTime = 0;
+   mChainedExits = 0;
+   mLookedUpExits = 0;
 }
 
 
@@ -466,11 +557,24 @@ BinrecBackend::getProfilingMask()
 void *
 brChainLookup(BinrecCore *core, ppcaddr_t address)
 {
-   auto block = core->backend->getCodeBlock(core, address);
+   auto backend = core->backend;
+   auto block = backend->getCodeBlock(core, address);
    if (!block) {
       return nullptr;
    }
 
+   if (backend->isTieredEnabled()) {
+      backend->updateTieredCount(core, block);
+   }
+
+#ifdef DECAF_JIT_ALLOW_PROFILING
+   // The translated code jumps straight to the block we return, so this
+   // exit does not go back through the dispatcher
+   if (backend->isProfilingCore(core->id)) {
+      backend->countChainedExit();
+   }
+#endif
+
    return block->code;
 }
 
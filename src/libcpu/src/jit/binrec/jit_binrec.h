@@ -5,7 +5,13 @@
 #include "jit/jit_codecache.h"
 #include "jit/jit_backend.h"
 
+#include <array>
+#include <atomic>
 #include <binrec++.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
@@ -76,6 +82,17 @@ public:
    addReadOnlyRange(uint32_t address,
                     uint32_t size) override;
 
+   void
+   addCacheModule(const std::string &name,
+                  uint32_t address,
+                  uint32_t size) override;
+
+   void
+   removeCacheModule(uint32_t address) override;
+
+   void
+   saveCache() override;
+
    bool
    sampleStats(JitStats &stats) override;
 
@@ -95,11 +112,103 @@ public:
    void
    setVerifyEnabled(bool enabled, uint32_t address = 0);
 
+   void
+   setCacheDirectory(const std::string &path);
+
+   void
+   setTieredCompilation(bool enabled,
+                        unsigned threshold,
+                        unsigned numThreads);
+
+   bool
+   isTieredEnabled() const
+   {
+      return mTieredEnabled;
+   }
+
+   bool
+   isProfilingCore(uint32_t id) const
+   {
+      return !!(mProfilingMask & (1 << id));
+   }
+
+   //! Count a block exit which libbinrec chained to the next block.
+   void
+   countChainedExit()
+   {
+      mChainedExits.fetch_add(1, std::memory_order_relaxed);
+   }
+
    CodeBlock *
    getCodeBlock(BinrecCore *core, uint32_t address);
 
+   /**
+    * Count an execution of a baseline block and queue it for optimisation
+    * once it becomes hot.
+    *
+    * The count is not updated atomically, losing the odd increment to a race
+    * between cores is harmless. The queued flag makes sure the block is only
+    * queued once, even if the exact threshold value is skipped.
+    */
+   void
+   updateTieredCount(BinrecCore *core,
+                     CodeBlock *block)
+   {
+      if (block->tier != CodeBlockTierBaseline) {
+         return;
+      }
+
+      auto count = block->tieredCount.load(std::memory_order_relaxed) + 1;
+      block->tieredCount.store(count, std::memory_order_relaxed);
+
+      if (UNLIKELY(count >= mTieredThreshold) &&
+          !block->tieredQueued.load(std::memory_order_relaxed) &&
+          !block->tieredQueued.exchange(true)) {
+         queueOptimise(core, block->address);
+      }
+   }
+
 protected:
-   BinrecHandle *createBinrecHandle();
+   BinrecHandle *createBinrecHandle(const BinrecOptimisationFlags &optFlags);
+
+   CodeBlock *
+   compileCodeBlock(BinrecHandle *handle,
+                    BinrecCore *core,
+                    uint32_t address,
+                    uint32_t tier);
+
+   bool
+   translateCodeBlock(BinrecHandle *handle,
+                      BinrecCore *core,
+                      uint32_t address,
+                      void **buffer,
+                      long *size);
+
+   CodeBlock *
+   createTranslatedCodeBlock(uint32_t address,
+                             uint32_t tier,
+                             void *buffer,
+                             long size);
+
+   /**
+    * A hot block waiting to be recompiled, along with the GQRs of the core
+    * which queued it for the translator to use with PPC_CONSTANT_GQRS.
+    */
+   struct OptimiseRequest
+   {
+      uint32_t address;
+      std::array<espresso::GraphicsQuantisationRegister, 8> gqr;
+   };
+
+   void
+   queueOptimise(BinrecCore *core,
+                 uint32_t address);
+
+   void
+   optimiserThreadEntry();
+
+   void
+   stopOptimiserThreads();
 
    inline CodeBlock *
    getCodeBlockFast(BinrecCore *core, uint32_t address);
@@ -130,15 +239,68 @@ protected:
    static void
    brVerifyPostHandler(BinrecCore *core, uint32_t address);
 
+   struct CacheModule
+   {
+      std::string name;
+      uint32_t address;
+      uint32_t size;
+      uint64_t hash;
+
+      //! Hash of the read-only ranges when the module was added, saving uses
+      //! the same value so the key matches the next load of the module.
+      uint64_t readOnlyHash;
+
+      //! Set when part of the module's code was invalidated after loading.
+      bool invalidated;
+   };
+
+   uint64_t
+   getCacheConfigHash();
+
+   uint64_t
+   getCacheReadOnlyHash();
+
+   std::string
+   getCacheModulePath(const CacheModule &module);
+
+   void
+   saveCacheModule(const CacheModule &module);
+
+   void
+   invalidateCacheModules(uint32_t address,
+                          uint32_t size);
+
 private:
    CodeCache mCodeCache;
    std::array<BinrecHandle *, 3> mHandles;
    BinrecOptimisationFlags mOptFlags;
+   BinrecOptimisationFlags mBaselineOptFlags;
+   std::mutex mReadOnlyRangeMutex;
    std::vector<std::pair<ppcaddr_t, uint32_t>> mReadOnlyRanges;
    std::atomic<uint64_t> mTotalProfileTime { 0 };
+   std::atomic<uint64_t> mChainedExits { 0 };
+   std::atomic<uint64_t> mLookedUpExits { 0 };
    uint32_t mProfilingMask = 0;
    bool mVerifyEnabled = false;
    uint32_t mVerifyAddress = 0;
+   bool mTieredEnabled = false;
+   uint64_t mTieredThreshold = 0;
+   std::vector<std::thread> mOptimiserThreads;
+   std::mutex mOptimiserMutex;
+   std::condition_variable mOptimiserCondition;
+   std::deque<OptimiseRequest> mOptimiserQueue;
+
+   //! Held by the optimiser threads only while adding a finished block to
+   //! the code cache, so a full clear never races with that.
+   std::mutex mOptimiserPublishMutex;
+
+   //! Incremented by each full clear of the code cache, blocks the
+   //! optimiser translated in an older generation are thrown away.
+   std::atomic<uint32_t> mCacheGeneration { 0 };
+   bool mOptimiserRunning = false;
+   std::string mCacheDirectory;
+   std::mutex mCacheModuleMutex;
+   std::vector<CacheModule> mCacheModules;
 };
 
 } // namespace jit
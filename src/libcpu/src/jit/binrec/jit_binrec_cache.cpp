@@ -0,0 +1,204 @@
+#include "cpu_config.h"
+#include "jit_binrec.h"
+#include "jit/jit_persistentcache.h"
+#include "mem.h"
+
+#include <common/datahash.h>
+#include <common/log.h>
+#include <common/platform_dir.h>
+#include <fmt/core.h>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+void
+BinrecBackend::setCacheDirectory(const std::string &path)
+{
+   mCacheDirectory = path;
+
+   if (!mCacheDirectory.empty()) {
+      platform::createDirectory(mCacheDirectory);
+   }
+}
+
+
+/**
+ * Hash everything which affects the generated code other than the guest code
+ * itself, if any of this changes then previously cached blocks are invalid.
+ */
+uint64_t
+BinrecBackend::getCacheConfigHash()
+{
+   struct CacheConfig
+   {
+      uint32_t version;
+      uint32_t common;
+      uint32_t guest;
+      uint32_t host;
+      uint32_t useChaining;
+      uint32_t hostFeatures;
+      uint32_t coreSize;
+      uint32_t rodataReadOnly;
+   };
+
+   auto config = CacheConfig { };
+   config.version = PersistentCacheVersion;
+   config.common = mOptFlags.common;
+   config.guest = mOptFlags.guest;
+   config.host = mOptFlags.host;
+   config.useChaining = mOptFlags.useChaining ? 1 : 0;
+   config.hostFeatures = static_cast<uint32_t>(binrec::native_features());
+   config.coreSize = static_cast<uint32_t>(sizeof(BinrecCore));
+   config.rodataReadOnly = cpu::config()->jit.rodataReadOnly ? 1 : 0;
+   return DataHash {}.write(config).value();
+}
+
+
+/**
+ * Hash the contents of the read-only ranges, libbinrec folds loads from these
+ * into the generated code so cached blocks are only valid for the same data.
+ */
+uint64_t
+BinrecBackend::getCacheReadOnlyHash()
+{
+   std::unique_lock<std::mutex> lock { mReadOnlyRangeMutex };
+   auto hash = uint64_t { 0 };
+
+   for (const auto &range : mReadOnlyRanges) {
+      hash = XXH64(&range.first, sizeof(range.first), hash);
+      hash = XXH64(&range.second, sizeof(range.second), hash);
+      hash = XXH64(mem::translate(range.first), range.second, hash);
+   }
+
+   return hash;
+}
+
+
+std::string
+BinrecBackend::getCacheModulePath(const CacheModule &module)
+{
+   return fmt::format("{}/{}_{:016X}.jitcache",
+                      mCacheDirectory, module.name, module.hash);
+}
+
+
+void
+BinrecBackend::saveCacheModule(const CacheModule &module)
+{
+   if (module.invalidated) {
+      return;
+   }
+
+   auto key = PersistentCacheKey { };
+   key.moduleHash = module.hash;
+   key.configHash = getCacheConfigHash();
+   key.readOnlyHash = module.readOnlyHash;
+   key.textAddress = module.address;
+   key.textSize = module.size;
+
+   auto path = getCacheModulePath(module);
+   auto numBlocks = savePersistentCache(mCodeCache, path, key);
+   if (numBlocks) {
+      gLog->debug("Saved {} JIT blocks for {} to {}", numBlocks, module.name, path);
+   }
+}
+
+
+/**
+ * Register a module's text section with the persistent code cache and load
+ * any blocks previously compiled for it.
+ *
+ * The module's text must already be fully relocated, and any read-only ranges
+ * its code loads from must already be registered.
+ */
+void
+BinrecBackend::addCacheModule(const std::string &name,
+                              uint32_t address,
+                              uint32_t size)
+{
+   if (mCacheDirectory.empty() || !size) {
+      return;
+   }
+
+   auto module = CacheModule { };
+   module.name = name;
+   module.address = address;
+   module.size = size;
+   module.hash = DataHash {}.write(mem::translate(address), size).value();
+   module.readOnlyHash = getCacheReadOnlyHash();
+   module.invalidated = false;
+
+   auto key = PersistentCacheKey { };
+   key.moduleHash = module.hash;
+   key.configHash = getCacheConfigHash();
+   key.readOnlyHash = module.readOnlyHash;
+   key.textAddress = address;
+   key.textSize = size;
+
+   auto path = getCacheModulePath(module);
+   auto numBlocks = loadPersistentCache(mCodeCache, path, key);
+   if (numBlocks) {
+      gLog->info("Loaded {} JIT blocks for {} from {}", numBlocks, name, path);
+   }
+
+   std::unique_lock<std::mutex> lock { mCacheModuleMutex };
+   mCacheModules.push_back(std::move(module));
+}
+
+
+/**
+ * Save a module's compiled blocks and stop tracking it.
+ */
+void
+BinrecBackend::removeCacheModule(uint32_t address)
+{
+   std::unique_lock<std::mutex> lock { mCacheModuleMutex };
+
+   for (auto itr = mCacheModules.begin(); itr != mCacheModules.end(); ++itr) {
+      if (itr->address == address) {
+         saveCacheModule(*itr);
+         mCacheModules.erase(itr);
+         break;
+      }
+   }
+}
+
+
+/**
+ * Save the compiled blocks of all registered modules.
+ */
+void
+BinrecBackend::saveCache()
+{
+   std::unique_lock<std::mutex> lock { mCacheModuleMutex };
+
+   for (const auto &module : mCacheModules) {
+      saveCacheModule(module);
+   }
+}
+
+
+/**
+ * Code inside a module was modified after loading, so the blocks compiled
+ * from it no longer match the module's hash and must not be saved.
+ */
+void
+BinrecBackend::invalidateCacheModules(uint32_t address,
+                                      uint32_t size)
+{
+   std::unique_lock<std::mutex> lock { mCacheModuleMutex };
+
+   for (auto &module : mCacheModules) {
+      if (address < module.address + module.size &&
+          module.address < address + size) {
+         module.invalidated = true;
+      }
+   }
+}
+
+} // namespace jit
+
+} // namespace cpu
@@ -0,0 +1,173 @@
+#include "cpu_breakpoints.h"
+#include "jit_binrec.h"
+
+#include <common/log.h>
+#include <common/platform_thread.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <memory>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+/**
+ * Enable tiered compilation.
+ *
+ * Guest cores compile new blocks with a minimal set of optimisations, once a
+ * block has been executed threshold times it is queued to be recompiled with
+ * the full optimisation flags by a pool of background threads.
+ *
+ * Must be called after setOptFlags and before any code is compiled.
+ */
+void
+BinrecBackend::setTieredCompilation(bool enabled,
+                                    unsigned threshold,
+                                    unsigned numThreads)
+{
+   stopOptimiserThreads();
+
+   mTieredEnabled = enabled && threshold > 0 && numThreads > 0;
+   mTieredThreshold = threshold;
+
+   if (!mTieredEnabled) {
+      return;
+   }
+
+   // Baseline blocks keep only the basic optimisations, chaining is left as
+   // configured because it only affects how blocks are linked together.
+   mBaselineOptFlags.common = mOptFlags.common & binrec::Optimize::BASIC;
+   mBaselineOptFlags.guest = 0;
+   mBaselineOptFlags.host = 0;
+   mBaselineOptFlags.useChaining = mOptFlags.useChaining;
+
+   mOptimiserRunning = true;
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      mOptimiserThreads.emplace_back(&BinrecBackend::optimiserThreadEntry, this);
+      platform::setThreadName(&mOptimiserThreads.back(),
+                              fmt::format("JIT Optimiser #{}", i));
+   }
+}
+
+
+/**
+ * Queue a hot baseline block to be recompiled with full optimisations.
+ *
+ * The GQRs of the queueing core are copied with the request because the
+ * optimiser has no core of its own for PPC_CONSTANT_GQRS to read them from.
+ */
+void
+BinrecBackend::queueOptimise(BinrecCore *core,
+                             uint32_t address)
+{
+   auto request = OptimiseRequest { };
+   request.address = address;
+   std::copy(std::begin(core->gqr), std::end(core->gqr), request.gqr.begin());
+
+   std::unique_lock<std::mutex> lock { mOptimiserMutex };
+   mOptimiserQueue.push_back(request);
+   mOptimiserCondition.notify_one();
+}
+
+
+void
+BinrecBackend::stopOptimiserThreads()
+{
+   {
+      std::unique_lock<std::mutex> lock { mOptimiserMutex };
+      mOptimiserRunning = false;
+      mOptimiserQueue.clear();
+      mOptimiserCondition.notify_all();
+   }
+
+   for (auto &thread : mOptimiserThreads) {
+      if (thread.joinable()) {
+         thread.join();
+      }
+   }
+
+   mOptimiserThreads.clear();
+}
+
+
+void
+BinrecBackend::optimiserThreadEntry()
+{
+   auto handle = createBinrecHandle(mOptFlags);
+   if (!handle) {
+      gLog->error("Failed to create binrec handle for JIT optimiser thread");
+      return;
+   }
+
+   // Only the GQRs are read from the state when translating, they are
+   // filled in from each request.
+   auto state = std::make_unique<BinrecCore>();
+
+   while (true) {
+      auto request = OptimiseRequest { };
+
+      {
+         std::unique_lock<std::mutex> lock { mOptimiserMutex };
+         mOptimiserCondition.wait(lock, [&]() {
+            return !mOptimiserRunning || !mOptimiserQueue.empty();
+         });
+
+         if (!mOptimiserRunning) {
+            break;
+         }
+
+         request = mOptimiserQueue.front();
+         mOptimiserQueue.pop_front();
+      }
+
+      // Make sure the address still points to a baseline block, it may have
+      // been queued twice or invalidated since.
+      auto address = request.address;
+      auto generation = mCacheGeneration.load();
+      auto indexPtr = mCodeCache.getIndexPointer(address);
+      auto baselineIndex = indexPtr->load();
+      if (baselineIndex < 0) {
+         continue;
+      }
+
+      auto baselineBlock = mCodeCache.getBlockByIndex(baselineIndex);
+      if (baselineBlock->tier != CodeBlockTierBaseline ||
+          baselineBlock->address != address ||
+          hasBreakpoint(address)) {
+         continue;
+      }
+
+      std::copy(request.gqr.begin(), request.gqr.end(), std::begin(state->gqr));
+
+      void *buffer = nullptr;
+      auto size = long { 0 };
+      if (!translateCodeBlock(handle, state.get(), address, &buffer, &size)) {
+         continue;
+      }
+
+      // A full clear of the code cache during translation makes the result
+      // stale, the baseline block it replaces is gone.
+      std::unique_lock<std::mutex> publishLock { mOptimiserPublishMutex };
+      if (mCacheGeneration.load() != generation) {
+         free(buffer);
+         continue;
+      }
+
+      auto block = createTranslatedCodeBlock(address, CodeBlockTierOptimised,
+                                             buffer, size);
+
+      // Only swap in the optimised block if nothing has changed the index
+      // whilst we were compiling, otherwise the new block is just leaked.
+      indexPtr->compare_exchange_strong(baselineIndex, mCodeCache.getIndex(block));
+   }
+
+   delete handle;
+}
+
+} // namespace jit
+
+} // namespace cpu
@@ -71,6 +71,47 @@ addReadOnlyRange(uint32_t address, uint32_t size)
 }
 
 
+/**
+ * Register a module's text section with the persistent code cache, this will
+ * load any previously compiled blocks for the module.
+ */
+void
+addCacheModule(const std::string &name, uint32_t address, uint32_t size)
+{
+   if (sBackend) {
+      sBackend->addCacheModule(name, address, size);
+   }
+}
+
+
+/**
+ * Save a module's compiled blocks to the persistent code cache and stop
+ * tracking it, to be called before the module's memory is freed.
+ */
+void
+removeCacheModule(uint32_t address)
+{
+   if (sBackend) {
+      sBackend->removeCacheModule(address);
+   }
+}
+
+
+/**
+ * Save the compiled blocks of all registered modules to the persistent code
+ * cache.
+ *
+ * This function must not be called while any JIT code is being executed.
+ */
+void
+saveCache()
+{
+   if (sBackend) {
+      sBackend->saveCache();
+   }
+}
+
+
 /**
  * Begin executing guest code on the current core.
  */
@@ -1,6 +1,8 @@
 #pragma once
 #include "jit_backend.h"
 
+#include <string>
+
 namespace cpu
 {
 
@@ -22,6 +24,15 @@ clearCache(uint32_t address, uint32_t size);
 void
 addReadOnlyRange(uint32_t address, uint32_t size);
 
+void
+addCacheModule(const std::string &name, uint32_t address, uint32_t size);
+
+void
+removeCacheModule(uint32_t address);
+
+void
+saveCache();
+
 void
 resume();
 
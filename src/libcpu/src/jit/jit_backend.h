@@ -2,6 +2,7 @@
 #include "jit_stats.h"
 #include "state.h"
 #include <cstdint>
+#include <string>
 
 namespace cpu
 {
@@ -30,6 +31,18 @@ public:
    virtual void
    addReadOnlyRange(uint32_t address, uint32_t size) = 0;
 
+   //! Register a loaded module's text section with the persistent code cache.
+   virtual void
+   addCacheModule(const std::string &name, uint32_t address, uint32_t size) = 0;
+
+   //! Save and unregister a module's text section from the persistent code cache.
+   virtual void
+   removeCacheModule(uint32_t address) = 0;
+
+   //! Save all registered modules to the persistent code cache.
+   virtual void
+   saveCache() = 0;
+
    //! Sample JIT stats.
    virtual bool
    sampleStats(JitStats &stats) = 0;
@@ -275,16 +275,18 @@ CodeCache::setBlockIndex(uint32_t address,
 
 
 /**
- * Register a block of code in the CodeCache.
+ * Create a block of code in the CodeCache.
  *
- * This will allocate memory for the code and data, and update the code block index.
+ * This will allocate memory for the code and data, but will not update the
+ * code block index.
  */
 CodeBlock *
-CodeCache::registerCodeBlock(uint32_t address,
-                             void *code,
-                             size_t size,
-                             void *unwindInfo,
-                             size_t unwindSize)
+CodeCache::createCodeBlock(uint32_t address,
+                           uint32_t tier,
+                           void *code,
+                           size_t size,
+                           void *unwindInfo,
+                           size_t unwindSize)
 {
    auto dataAddress = allocate(mDataAllocator, sizeof(CodeBlock), 1);
    auto codeAddress = allocate(mCodeAllocator, size, 16);
@@ -292,6 +294,9 @@ CodeCache::registerCodeBlock(uint32_t address,
    // Setup me block
    auto block = reinterpret_cast<CodeBlock *>(dataAddress);
    block->address = address;
+   block->tier = tier;
+   block->tieredCount = 0;
+   block->tieredQueued = false;
    block->code = reinterpret_cast<void *>(codeAddress);
    block->codeSize = static_cast<uint32_t>(size);
    std::memcpy(block->code, code, size);
@@ -313,6 +318,24 @@ CodeCache::registerCodeBlock(uint32_t address,
    RtlAddFunctionTable(&block->unwindInfo.rtlFuncTable, 1, mReserveAddress);
 #endif
 
+   return block;
+}
+
+
+/**
+ * Register a block of code in the CodeCache.
+ *
+ * This will allocate memory for the code and data, and update the code block index.
+ */
+CodeBlock *
+CodeCache::registerCodeBlock(uint32_t address,
+                             uint32_t tier,
+                             void *code,
+                             size_t size,
+                             void *unwindInfo,
+                             size_t unwindSize)
+{
+   auto block = createCodeBlock(address, tier, code, size, unwindInfo, unwindSize);
    auto index = getIndex(block);
    auto indexPtr = getIndexPointer(address);
    indexPtr->store(index);
@@ -120,8 +120,17 @@ public:
    setBlockIndex(uint32_t address,
                  CodeBlockIndex index);
 
+   CodeBlock *
+   createCodeBlock(uint32_t address,
+                   uint32_t tier,
+                   void *code,
+                   size_t size,
+                   void *unwindInfo,
+                   size_t unwindSize);
+
    CodeBlock *
    registerCodeBlock(uint32_t address,
+                     uint32_t tier,
                      void *code,
                      size_t size,
                      void *unwindInfo,
@@ -0,0 +1,236 @@
+#include "jit_persistentcache.h"
+
+#include <common/log.h>
+#include <common/platform.h>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+struct PersistentCacheFileHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint64_t moduleHash;
+   uint64_t configHash;
+   uint64_t readOnlyHash;
+   uint32_t textAddress;
+   uint32_t textSize;
+   uint32_t numBlocks;
+   uint32_t reserved;
+};
+
+struct PersistentCacheBlockHeader
+{
+   uint32_t address;
+   uint32_t codeSize;
+   uint32_t unwindSize;
+};
+
+// Sanity limit for a single block read from disk, translations are limited
+// to 4096 bytes of guest code so this is very generous.
+static constexpr uint32_t MaxPersistentBlockCodeSize = 1024 * 1024;
+
+
+/**
+ * Load compiled code blocks from a persistent cache file.
+ *
+ * Blocks are only registered for addresses which are still uncompiled, so it
+ * is safe to call this whilst other cores are executing.
+ *
+ * Returns the number of blocks loaded.
+ */
+size_t
+loadPersistentCache(CodeCache &codeCache,
+                    const std::string &path,
+                    const PersistentCacheKey &key)
+{
+   std::ifstream fh { path, std::ifstream::binary };
+   if (!fh.is_open()) {
+      return 0;
+   }
+
+   auto header = PersistentCacheFileHeader { };
+   if (!fh.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+      return 0;
+   }
+
+   if (header.magic != PersistentCacheMagic ||
+       header.version != PersistentCacheVersion ||
+       header.moduleHash != key.moduleHash ||
+       header.configHash != key.configHash ||
+       header.readOnlyHash != key.readOnlyHash ||
+       header.textAddress != key.textAddress ||
+       header.textSize != key.textSize) {
+      return 0;
+   }
+
+   auto textEnd = static_cast<uint64_t>(key.textAddress) + key.textSize;
+   auto code = std::vector<uint8_t> { };
+   auto unwind = std::vector<uint8_t> { };
+   auto numLoaded = size_t { 0 };
+
+   for (auto i = 0u; i < header.numBlocks; ++i) {
+      auto blockHeader = PersistentCacheBlockHeader { };
+      if (!fh.read(reinterpret_cast<char *>(&blockHeader), sizeof(blockHeader))) {
+         break;
+      }
+
+      if (blockHeader.address < key.textAddress ||
+          blockHeader.address >= textEnd ||
+          (blockHeader.address & 3) ||
+          blockHeader.codeSize == 0 ||
+          blockHeader.codeSize > MaxPersistentBlockCodeSize) {
+         gLog->warn("Corrupt JIT cache file {}", path);
+         break;
+      }
+
+#ifdef PLATFORM_WINDOWS
+      if (blockHeader.unwindSize > CodeBlockUnwindInfo::MaxUnwindInfoSize) {
+         gLog->warn("Corrupt JIT cache file {}", path);
+         break;
+      }
+#else
+      if (blockHeader.unwindSize != 0) {
+         gLog->warn("Corrupt JIT cache file {}", path);
+         break;
+      }
+#endif
+
+      unwind.resize(blockHeader.unwindSize);
+      code.resize(blockHeader.codeSize);
+
+      if (!fh.read(reinterpret_cast<char *>(unwind.data()), unwind.size()) ||
+          !fh.read(reinterpret_cast<char *>(code.data()), code.size())) {
+         break;
+      }
+
+      // Only claim addresses which nobody else has compiled or started
+      // compiling yet.
+      auto indexPtr = codeCache.getIndexPointer(blockHeader.address);
+      auto expected = CodeBlockIndexUncompiled;
+      if (!indexPtr->compare_exchange_strong(expected, CodeBlockIndexCompiling)) {
+         continue;
+      }
+
+      codeCache.registerCodeBlock(blockHeader.address,
+                                  CodeBlockTierOptimised,
+                                  code.data(), code.size(),
+                                  unwind.data(), unwind.size());
+      ++numLoaded;
+   }
+
+   return numLoaded;
+}
+
+
+/**
+ * Save all compiled code blocks which lie inside the key's text section to
+ * a persistent cache file.
+ *
+ * Blocks are found through the code cache index rather than the list of
+ * compiled blocks, a block only appears in the index once it has been fully
+ * written, so this is safe to call whilst other cores are compiling.
+ *
+ * Returns the number of blocks saved.
+ */
+size_t
+savePersistentCache(CodeCache &codeCache,
+                    const std::string &path,
+                    const PersistentCacheKey &key)
+{
+   auto textEnd = static_cast<uint64_t>(key.textAddress) + key.textSize;
+   auto blocks = std::vector<CodeBlock *> { };
+
+   for (auto address = static_cast<uint64_t>(key.textAddress & ~3u);
+        address < textEnd; address += 4) {
+      auto indexPtr = codeCache.getConstIndexPointer(static_cast<uint32_t>(address));
+      if (!indexPtr) {
+         // Nothing has been compiled in this 64KB page
+         address = (address | 0xFFFF) - 3;
+         continue;
+      }
+
+      auto index = indexPtr->load();
+      if (index < 0) {
+         continue;
+      }
+
+      // Only save blocks compiled with the full optimisation flags, this also
+      // skips trampolines which are indexed under their caller's address
+      auto block = codeCache.getBlockByIndex(index);
+      if (block->address != address ||
+          block->tier != CodeBlockTierOptimised) {
+         continue;
+      }
+
+      blocks.push_back(block);
+   }
+
+   if (blocks.empty()) {
+      return 0;
+   }
+
+   // Write to a temporary file first so we never leave a truncated cache
+   auto tmpPath = path + ".tmp";
+   std::ofstream fh { tmpPath, std::ofstream::binary };
+   if (!fh.is_open()) {
+      gLog->warn("Could not open JIT cache file {} for writing", tmpPath);
+      return 0;
+   }
+
+   auto header = PersistentCacheFileHeader { };
+   header.magic = PersistentCacheMagic;
+   header.version = PersistentCacheVersion;
+   header.moduleHash = key.moduleHash;
+   header.configHash = key.configHash;
+   header.readOnlyHash = key.readOnlyHash;
+   header.textAddress = key.textAddress;
+   header.textSize = key.textSize;
+   header.numBlocks = static_cast<uint32_t>(blocks.size());
+   header.reserved = 0;
+   fh.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+   for (auto block : blocks) {
+      auto blockHeader = PersistentCacheBlockHeader { };
+      blockHeader.address = block->address;
+      blockHeader.codeSize = block->codeSize;
+#ifdef PLATFORM_WINDOWS
+      blockHeader.unwindSize = block->unwindInfo.size;
+#else
+      blockHeader.unwindSize = 0;
+#endif
+      fh.write(reinterpret_cast<const char *>(&blockHeader), sizeof(blockHeader));
+
+#ifdef PLATFORM_WINDOWS
+      fh.write(reinterpret_cast<const char *>(block->unwindInfo.data.data()),
+               block->unwindInfo.size);
+#endif
+      fh.write(reinterpret_cast<const char *>(block->code), block->codeSize);
+   }
+
+   fh.close();
+   if (!fh) {
+      gLog->warn("Failed to write JIT cache file {}", tmpPath);
+      std::remove(tmpPath.c_str());
+      return 0;
+   }
+
+   std::remove(path.c_str());
+   if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      gLog->warn("Failed to rename JIT cache file {} to {}", tmpPath, path);
+      std::remove(tmpPath.c_str());
+      return 0;
+   }
+
+   return blocks.size();
+}
+
+} // namespace jit
+
+} // namespace cpu
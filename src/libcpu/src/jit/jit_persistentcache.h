@@ -0,0 +1,51 @@
+#pragma once
+#include "jit_codecache.h"
+
+#include <cstdint>
+#include <string>
+
+namespace cpu
+{
+
+namespace jit
+{
+
+static constexpr uint32_t PersistentCacheMagic = 0x4354494A; // "JITC"
+static constexpr uint32_t PersistentCacheVersion = 2;
+
+/**
+ * Identifies the set of compiled blocks stored in a persistent cache file.
+ *
+ * A cache file is only loaded if every field matches exactly.
+ */
+struct PersistentCacheKey
+{
+   //! Hash of the module's relocated text section.
+   uint64_t moduleHash;
+
+   //! Hash of the JIT configuration used to translate the blocks.
+   uint64_t configHash;
+
+   //! Hash of the read-only ranges whose data may be folded into the blocks.
+   uint64_t readOnlyHash;
+
+   //! Guest address of the module's text section.
+   uint32_t textAddress;
+
+   //! Size of the module's text section.
+   uint32_t textSize;
+};
+
+size_t
+loadPersistentCache(CodeCache &codeCache,
+                    const std::string &path,
+                    const PersistentCacheKey &key);
+
+size_t
+savePersistentCache(CodeCache &codeCache,
+                    const std::string &path,
+                    const PersistentCacheKey &key);
+
+} // namespace jit
+
+} // namespace cpu
@@ -14,6 +14,9 @@ struct DebuggerSettings
    bool break_on_exit = true;
    bool gdb_stub = false;
    unsigned gdb_stub_port = 2159;
+
+   //! Validate every active thread on each reschedule, this is slow!
+   bool validate_threads = false;
 };
 
 struct Gx2Settings
@@ -36,6 +39,10 @@ struct LogSettings
    bool branch_trace = false;
    bool hle_trace = false;
    bool hle_trace_res = false;
+
+   //! Write the HLE trace to hle-trace.bin in the log directory as binary
+   //! records instead of formatting each call to the log.
+   bool hle_trace_binary = false;
    std::vector<std::string> hle_trace_filters =
    {
       "+.*",
@@ -53,6 +60,10 @@ struct LogSettings
 struct SoundSettings
 {
    bool dump_sounds = false;
+
+   //! Number of threads used to decode voices, including the audio thread.
+   //! 0 picks a number based on the host CPU, 1 decodes on the audio thread.
+   unsigned int decode_threads = 0;
 };
 
 enum class SystemRegion
@@ -81,6 +92,9 @@ struct SystemSettings
    double time_scale = 1.0;
    std::vector<std::string> lle_modules;
    bool dump_hle_rpl = false; // TODO: Move this to a debug api command?
+   unsigned int ios_worker_threads = 0; // 0 = pick based on host cpu count
+   bool rpl_section_cache = false; // Store inflated RPL sections on disk
+   std::string rpl_section_cache_path = "rpl_cache";
 };
 
 struct Settings
@@ -302,6 +302,88 @@ struct CafeVoice
    bool loopingEnabled;
 };
 
+struct CafeSchedulerStats
+{
+   //! Number of times the scheduler lock was acquired.
+   uint64_t lockAcquisitions = 0;
+
+   //! Number of acquisitions which found the lock already held.
+   uint64_t lockContentions = 0;
+
+   //! Total time spent waiting for a contended lock.
+   uint64_t lockWaitTimeNs = 0;
+
+   //! Total time the lock was held for.
+   uint64_t lockHoldTimeNs = 0;
+
+   //! Longest time the lock was held for in one go.
+   uint64_t lockMaxHoldTimeNs = 0;
+
+   //! Number of thread switches performed by the scheduler.
+   uint64_t contextSwitches = 0;
+};
+
+struct CafeAudioTimingHistogram
+{
+   //! Bucket N counts frames which took [2^N, 2^(N+1)) microseconds.
+   std::array<uint64_t, 16> buckets = { };
+   uint64_t count = 0;
+   uint64_t totalNs = 0;
+   uint64_t maxNs = 0;
+};
+
+struct CafeAudioTimings
+{
+   CafeAudioTimingHistogram decode;
+   CafeAudioTimingHistogram mix;
+   CafeAudioTimingHistogram auxCallbacks;
+};
+
+struct CafeKernelLockStats
+{
+   //! Name of the code site which acquires the lock.
+   std::string name;
+
+   //! Number of times the lock was acquired from this site.
+   uint64_t acquisitions = 0;
+
+   //! Number of acquisitions which found the lock already held.
+   uint64_t contentions = 0;
+
+   //! Number of pause iterations spent spinning on a held lock.
+   uint64_t spins = 0;
+
+   //! Number of times we gave up spinning and blocked.
+   uint64_t parks = 0;
+
+   //! Total time the lock was held for.
+   uint64_t holdTimeNs = 0;
+
+   //! Longest time the lock was held for in one go.
+   uint64_t maxHoldTimeNs = 0;
+};
+
+struct IosWorkerQueueStats
+{
+   //! FSA client handle (or other key) these statistics are for.
+   uint32_t key = 0;
+
+   uint64_t submitted = 0;
+   uint64_t completed = 0;
+
+   //! Number of tasks currently queued or running.
+   uint64_t depth = 0;
+   uint64_t maxDepth = 0;
+
+   //! Time from submission until the task started running.
+   uint64_t totalWaitNs = 0;
+   uint64_t maxWaitNs = 0;
+
+   //! Time spent running tasks.
+   uint64_t totalRunNs = 0;
+   uint64_t maxRunNs = 0;
+};
+
 enum class Pm4CaptureState
 {
    Disabled,
@@ -334,6 +416,12 @@ bool sampleCafeMemorySegments(std::vector<CafeMemorySegment> &segments);
 bool sampleCafeRunningThread(int coreId, CafeThread &info);
 bool sampleCafeThreads(std::vector<CafeThread> &threads);
 bool sampleCafeVoices(std::vector<CafeVoice> &voiceInfos);
+bool sampleCafeSchedulerStats(CafeSchedulerStats &stats);
+bool sampleCafeKernelLockStats(std::vector<CafeKernelLockStats> &stats);
+bool sampleCafeAudioTimings(CafeAudioTimings &timings);
+
+// IOS
+bool sampleIosWorkerQueueStats(std::vector<IosWorkerQueueStats> &stats);
 
 // pm4 capture
 Pm4CaptureState pm4CaptureState();
@@ -0,0 +1,126 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace decaf::hletrace
+{
+
+#pragma pack(push, 1)
+
+/*
+A binary HLE trace starts with a TraceFileHeader followed by a sequence of
+blocks, each a TraceBlock header followed by size bytes of data.
+
+A Functions block holds the metadata of the functions which can appear in
+the trace: numEntries TraceFunction, each followed by its name and then
+numParams TraceParam. The writer appends another Functions block before any
+records which refer to a function it has not described yet.
+
+A Records block holds numEntries TraceRecord. Records from each core are in
+order, records from different cores are interleaved in the order they were
+drained from the per core ring buffers, use the timestamp to order them.
+*/
+static const std::array<char, 4> TraceMagic =
+{
+   'D', 'H', 'L', 'T'
+};
+
+static constexpr uint32_t TraceVersion = 1;
+
+//! Number of r3..r10 saved in a record.
+static constexpr auto TraceNumGprs = 8u;
+
+//! Number of stack arguments saved in a record, r11 onwards.
+static constexpr auto TraceNumStackArgs = 4u;
+
+//! Number of f1..f8 saved in a record.
+static constexpr auto TraceNumFprs = 8u;
+
+//! Maximum length of the string argument saved in a record, including the
+//! null terminator.
+static constexpr auto TraceMaxStringLength = 32u;
+
+struct TraceFileHeader
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+};
+
+struct TraceBlock
+{
+   enum Type : uint32_t
+   {
+      Invalid,
+      Functions,
+      Records,
+   };
+
+   Type type;
+   uint32_t numEntries;
+   uint32_t size;
+};
+
+//! Same values as cafe::detail::RegisterType.
+enum class TraceRegisterType : uint8_t
+{
+   Gpr32,
+   Gpr64,
+   Fpr,
+   Void,
+   VarArgs,
+};
+
+struct TraceParam
+{
+   enum Flags : uint8_t
+   {
+      Signed = 1 << 0,
+      Pointer = 1 << 1,
+      String = 1 << 2,
+   };
+
+   TraceRegisterType type;
+   uint8_t index;
+   uint8_t flags;
+};
+
+struct TraceFunction
+{
+   uint32_t id;
+   uint8_t isMemberFunction;
+   uint8_t numParams;
+   uint16_t nameLength;
+   TraceParam returnValue;
+};
+
+struct TraceRecord
+{
+   enum Type : uint8_t
+   {
+      Call,
+      Return,
+   };
+
+   //! Host time in nanoseconds.
+   uint64_t timestamp;
+   uint32_t functionId;
+   Type type;
+   uint8_t core;
+   uint16_t numStackArgs;
+   uint32_t lr;
+   uint32_t sp;
+
+   //! r3..r10 for a Call, r3 and r4 for a Return.
+   uint32_t gpr[TraceNumGprs];
+   uint32_t stack[TraceNumStackArgs];
+
+   //! f1..f8 for a Call, f1 for a Return.
+   double fpr[TraceNumFprs];
+
+   //! Prefix of the first string argument of a Call, truncated to fit.
+   char string[TraceMaxStringLength];
+};
+
+#pragma pack(pop)
+
+} // namespace decaf::hletrace
@@ -22,6 +22,7 @@ struct CapturePacket
       MemoryLoad,
       RegisterSnapshot,
       SetBuffer,
+      MemoryReference,
    };
 
    Type type;
@@ -71,6 +72,115 @@ struct CaptureSetBuffer
    uint32_t height;
 };
 
+/*
+Chunked captures start with a CaptureFileHeader followed by a sequence of
+chunks, each a CaptureChunk header followed by compressedSize bytes of data.
+
+Packets and Keyframe chunks contain the same packet stream as the original
+format, except memory is written as MemoryReference packets which refer to
+a block of memory stored in a MemoryBlocks chunk by the hash of its
+contents, so a block is only stored once no matter how many times or at
+which addresses it is loaded.
+
+Each frame starts with a Keyframe chunk, which holds everything needed to
+start replaying from that frame: a register snapshot, the display buffers
+and a reference to every memory range loaded so far. When replaying
+sequentially only the keyframe of the first frame is used.
+
+The file ends with an Index chunk followed by a CaptureFileTrailer, the
+index holds the offset of every keyframe and the location of every memory
+block so a reader can seek to any frame without reading what comes before.
+*/
+static const std::array<char, 4> ChunkedCaptureMagic =
+{
+   'D', 'P', 'M', 'C'
+};
+
+static constexpr uint32_t ChunkedCaptureVersion = 1;
+
+struct CaptureFileHeader
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+};
+
+struct CaptureChunk
+{
+   enum Type : uint32_t
+   {
+      Invalid,
+      Packets,
+      Keyframe,
+      MemoryBlocks,
+      Index,
+   };
+
+   enum Compression : uint32_t
+   {
+      None,
+      Zlib,
+   };
+
+   Type type;
+   Compression compression;
+   uint32_t uncompressedSize;
+   uint32_t compressedSize;
+
+   //! The frame a Keyframe chunk starts.
+   uint32_t frame;
+};
+
+struct CaptureMemoryReference
+{
+   CaptureMemoryLoad::MemoryType type;
+   phys_addr address;
+   uint32_t size;
+   uint64_t hash[2];
+};
+
+//! Header of each block in a MemoryBlocks chunk, followed by size bytes.
+struct CaptureMemoryBlock
+{
+   uint64_t hash[2];
+   uint32_t size;
+};
+
+//! Index chunk data starts with this header, followed by numFrames
+//! CaptureFrameIndex and then numBlocks CaptureBlockIndex.
+struct CaptureIndexHeader
+{
+   uint32_t numFrames;
+   uint32_t numBlocks;
+};
+
+struct CaptureFrameIndex
+{
+   //! File offset of the frame's Keyframe chunk.
+   uint64_t chunkOffset;
+
+   //! Timestamp of the first packet in the frame.
+   uint64_t timestamp;
+};
+
+struct CaptureBlockIndex
+{
+   uint64_t hash[2];
+   uint32_t size;
+
+   //! File offset of the MemoryBlocks chunk holding this block.
+   uint64_t chunkOffset;
+
+   //! Offset of the block's data within the uncompressed chunk.
+   uint32_t dataOffset;
+};
+
+struct CaptureFileTrailer
+{
+   //! File offset of the Index chunk.
+   uint64_t indexOffset;
+   std::array<char, 4> magic;
+};
+
 #pragma pack(pop)
 
 } // namespace decaf::pm4
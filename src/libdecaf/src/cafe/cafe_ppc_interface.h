@@ -283,6 +283,7 @@ struct function_traits<ReturnType(ArgTypes...)>
    static constexpr auto num_args = sizeof...(ArgTypes);
    static constexpr auto has_return_value = !std::is_void<ReturnType>::value;
    static constexpr std::array<RuntimeParamInfo, num_args> runtime_param_info = make_runtime_param_info<num_args>(param_info {});
+   static constexpr RuntimeParamInfo runtime_return_info = make_runtime_param_info<1>(std::tuple<return_info> {})[0];
 };
 
 template<typename ObjectType, typename ReturnType, typename... ArgTypes>
@@ -297,6 +298,7 @@ struct function_traits<ReturnType(ObjectType::*)(ArgTypes...)>
    static constexpr auto num_args = sizeof...(ArgTypes);
    static constexpr auto has_return_value = !std::is_void<ReturnType>::value;
    static constexpr std::array<RuntimeParamInfo, num_args> runtime_param_info = make_runtime_param_info<num_args>(param_info{});
+   static constexpr RuntimeParamInfo runtime_return_info = make_runtime_param_info<1>(std::tuple<return_info> {})[0];
 };
 
 template<typename ObjectType, typename ReturnType, typename... ArgTypes>
@@ -131,6 +131,12 @@ mainCoreEntryPoint(cpu::Core *core)
    internal::finishInitAndPreload();
 }
 
+static internal::SpinLockSite
+sSubCoreEntryLockSite { "subCoreEntryPoint" };
+
+static internal::SpinLockSite
+sSetSubCoreEntryLockSite { "setSubCoreEntryContext" };
+
 static void
 subCoreEntryPoint(cpu::Core *core)
 {
@@ -141,7 +147,7 @@ subCoreEntryPoint(cpu::Core *core)
    internal::ipckDriverOpen();
 
    while (!sStopping.load()) {
-      internal::kernelLockAcquire();
+      internal::kernelLockAcquire(sSubCoreEntryLockSite);
       auto entryContext = sSubCoreEntryContexts[core->id];
       internal::kernelLockRelease();
 
@@ -166,7 +172,7 @@ void
 setSubCoreEntryContext(int coreId,
                        virt_ptr<Context> context)
 {
-   internal::kernelLockAcquire();
+   internal::kernelLockAcquire(sSetSubCoreEntryLockSite);
    sSubCoreEntryContexts[coreId] = context;
    internal::kernelLockRelease();
 
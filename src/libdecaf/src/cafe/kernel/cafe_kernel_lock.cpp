@@ -1,27 +1,154 @@
 #include "cafe_kernel_lock.h"
+#include <algorithm>
 #include <atomic>
+#include <common/platform.h>
 #include <libcpu/cpu_control.h>
+#include <thread>
+
+#ifdef PLATFORM_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(PLATFORM_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 namespace cafe::kernel::internal
 {
 
+/*
+Lock acquisition first spins on the lock with an exponentially increasing
+number of pause instructions between attempts.  If the lock is still held
+after MaxSpinRounds it is most likely that the holder's host thread has been
+descheduled, so rather than burning the rest of our timeslice we block on
+the lock word until the holder releases it.
+*/
+static constexpr auto MaxSpinRounds = 16;
+static constexpr auto MaxSpinBackoff = 64u;
+
 static SpinLock
 sKernelLock { 0 };
 
-bool
-spinLockAcquire(SpinLock &spinLock,
-                uint32_t value)
+static std::atomic<SpinLockSite *>
+sFirstSpinLockSite { nullptr };
+
+SpinLockSite::SpinLockSite(const char *name) :
+   name(name)
+{
+   next = sFirstSpinLockSite.load();
+   while (!sFirstSpinLockSite.compare_exchange_weak(next, this)) {
+   }
+}
+
+SpinLockSite *
+getFirstSpinLockSite()
+{
+   return sFirstSpinLockSite.load();
+}
+
+static inline void
+cpuRelax()
+{
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+   _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+   asm volatile("yield");
+#endif
+}
+
+static void
+waitOnValue(std::atomic<uint32_t> &value,
+            uint32_t expected)
+{
+#ifdef PLATFORM_LINUX
+   syscall(SYS_futex, reinterpret_cast<uint32_t *>(&value), FUTEX_WAIT_PRIVATE,
+           expected, nullptr, nullptr, 0);
+#elif defined(PLATFORM_WINDOWS)
+   WaitOnAddress(&value, &expected, sizeof(expected), INFINITE);
+#else
+   if (value.load() == expected) {
+      std::this_thread::yield();
+   }
+#endif
+}
+
+static void
+wakeOneWaiter(std::atomic<uint32_t> &value)
+{
+#ifdef PLATFORM_LINUX
+   syscall(SYS_futex, reinterpret_cast<uint32_t *>(&value), FUTEX_WAKE_PRIVATE,
+           1, nullptr, nullptr, 0);
+#elif defined(PLATFORM_WINDOWS)
+   WakeByAddressSingle(&value);
+#endif
+}
+
+static inline bool
+tryAcquire(SpinLock &spinLock,
+           uint32_t value)
 {
    auto expected = 0u;
+   return spinLock.value.compare_exchange_strong(expected, value, std::memory_order_acquire);
+}
 
+bool
+spinLockAcquire(SpinLock &spinLock,
+                uint32_t value,
+                SpinLockSite &site)
+{
    if (!value) {
       return false;
    }
 
-   while (!spinLock.value.compare_exchange_weak(expected, value, std::memory_order_acquire)) {
-      expected = 0;
+   if (!tryAcquire(spinLock, value)) {
+      site.contentions.fetch_add(1, std::memory_order_relaxed);
+
+      // Spin with exponential backoff
+      auto acquired = false;
+      auto backoff = 1u;
+      auto spins = uint64_t { 0 };
+
+      for (auto round = 0; round < MaxSpinRounds && !acquired; ++round) {
+         for (auto i = 0u; i < backoff; ++i) {
+            cpuRelax();
+         }
+
+         spins += backoff;
+         backoff = std::min(backoff * 2, MaxSpinBackoff);
+         acquired = spinLock.value.load(std::memory_order_relaxed) == 0 &&
+                    tryAcquire(spinLock, value);
+      }
+
+      site.spins.fetch_add(spins, std::memory_order_relaxed);
+
+      // Block until the lock is released
+      if (!acquired) {
+         site.parks.fetch_add(1, std::memory_order_relaxed);
+         spinLock.waiters.fetch_add(1);
+
+         while (true) {
+            auto current = spinLock.value.load();
+            if (current == 0 && tryAcquire(spinLock, value)) {
+               break;
+            }
+
+            if (current != 0) {
+               waitOnValue(spinLock.value, current);
+            }
+         }
+
+         spinLock.waiters.fetch_sub(1);
+      }
    }
 
+   spinLock.site = &site;
+   spinLock.acquireTime = std::chrono::steady_clock::now();
+   site.acquisitions.fetch_add(1, std::memory_order_relaxed);
    return true;
 }
 
@@ -29,15 +156,33 @@ bool
 spinLockRelease(SpinLock &spinLock,
                 uint32_t expected)
 {
-   auto value = spinLock.value.exchange(0, std::memory_order_release);
+   if (auto site = spinLock.site) {
+      auto holdTime = static_cast<uint64_t>(
+         std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - spinLock.acquireTime).count());
+      site->holdTimeNs.fetch_add(holdTime, std::memory_order_relaxed);
+
+      if (holdTime > site->maxHoldTimeNs.load(std::memory_order_relaxed)) {
+         site->maxHoldTimeNs.store(holdTime, std::memory_order_relaxed);
+      }
+
+      spinLock.site = nullptr;
+   }
+
+   auto value = spinLock.value.exchange(0, std::memory_order_seq_cst);
+
+   if (spinLock.waiters.load() != 0) {
+      wakeOneWaiter(spinLock.value);
+   }
+
    return (value == expected);
 }
 
 
 void
-kernelLockAcquire()
+kernelLockAcquire(SpinLockSite &site)
 {
-   spinLockAcquire(sKernelLock, cpu::this_core::id() + 1);
+   spinLockAcquire(sKernelLock, cpu::this_core::id() + 1, site);
 }
 
 void
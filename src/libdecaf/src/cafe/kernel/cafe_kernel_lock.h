@@ -1,27 +1,71 @@
 #pragma once
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 
 namespace cafe::kernel::internal
 {
 
+/**
+ * Lock statistics for a single place in the code which acquires a SpinLock.
+ *
+ * Sites are expected to be declared with static storage duration, they add
+ * themselves to a global list on construction which is never removed from.
+ */
+struct SpinLockSite
+{
+   SpinLockSite(const char *name);
+
+   const char *name;
+   SpinLockSite *next = nullptr;
+
+   //! Number of times the lock was acquired from this site.
+   std::atomic<uint64_t> acquisitions { 0 };
+
+   //! Number of acquisitions which found the lock already held.
+   std::atomic<uint64_t> contentions { 0 };
+
+   //! Number of pause iterations spent spinning on a held lock.
+   std::atomic<uint64_t> spins { 0 };
+
+   //! Number of times we gave up spinning and blocked.
+   std::atomic<uint64_t> parks { 0 };
+
+   //! Total time the lock was held for.
+   std::atomic<uint64_t> holdTimeNs { 0 };
+
+   //! Longest time the lock was held for in one go.
+   std::atomic<uint64_t> maxHoldTimeNs { 0 };
+};
+
 struct SpinLock
 {
    std::atomic<uint32_t> value;
+
+   //! Number of threads blocked waiting for value to change.
+   std::atomic<uint32_t> waiters { 0 };
+
+   //! Only accessed by the thread holding the lock.
+   SpinLockSite *site = nullptr;
+   std::chrono::steady_clock::time_point acquireTime;
 };
 
 bool
 spinLockAcquire(SpinLock &spinLock,
-                uint32_t value);
+                uint32_t value,
+                SpinLockSite &site);
 
 bool
 spinLockRelease(SpinLock &spinLock,
                 uint32_t expected);
 
 void
-kernelLockAcquire();
+kernelLockAcquire(SpinLockSite &site);
 
 void
 kernelLockRelease();
 
+SpinLockSite *
+getFirstSpinLockSite();
+
 } // namespace cafe::kernel::internal
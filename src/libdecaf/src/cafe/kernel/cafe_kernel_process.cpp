@@ -12,7 +12,6 @@
 
 #include <array>
 #include <libcpu/cpu_control.h>
-#include <libcpu/cpu_config.h>
 
 namespace cafe::kernel::internal
 {
@@ -302,44 +301,6 @@ loadGameProcess(std::string_view rpx,
       static_cast<uint32_t>(partitionData->ramPartitionAllocation.availStart - partitionData->ramPartitionAllocation.dataStart),
       0);
 
-   // Notify jit of read only sections in the RPX
-   if (cpu::config()->jit.rodataReadOnly) {
-      auto loadedRpx = cafe::loader::getGlobalStorage()->loadedRpx;
-      auto shStrSection = virt_ptr<char> { nullptr };
-      if (auto shstrndx = loadedRpx->elfHeader.shstrndx) {
-         shStrSection = virt_cast<char *>(loadedRpx->sectionAddressBuffer[shstrndx]);
-      }
-
-      for (auto i = 0u; i < loadedRpx->elfHeader.shnum; ++i) {
-         auto sectionHeader =
-            virt_cast<loader::rpl::SectionHeader *>(
-               virt_cast<virt_addr>(loadedRpx->sectionHeaderBuffer) +
-               (i * loadedRpx->elfHeader.shentsize));
-         auto sectionAddress = loadedRpx->sectionAddressBuffer[i];
-         if (!sectionAddress ||
-             sectionHeader->type != loader::rpl::SHT_PROGBITS) {
-            continue;
-         }
-
-         if (shStrSection && sectionHeader->name) {
-            auto name = shStrSection + sectionHeader->name;
-            if (strcmp(name.get(), ".rodata") == 0) {
-               cpu::addJitReadOnlyRange(sectionAddress.getAddress(),
-                                        sectionHeader->size);
-               continue;
-            }
-         }
-
-         if (!(sectionHeader->flags & loader::rpl::SHF_WRITE)) {
-            // TODO: Fix me
-            // When we have a small section, e.g. .syscall section with
-            // sectionHeader->size == 8, we seem to break binrec
-            //cpu::addJitReadOnlyRange(sectionAddress.getAddress(),
-            //                         sectionHeader->size);
-         }
-      }
-   }
-
    // Run the HLE relocation for coreinit.
    auto &startInfo = cafe::loader::getKernelIpcStorage()->startInfo;
    auto coreinitRpl = startInfo.coreinit;
@@ -30,6 +30,12 @@ sUserDriversData = nullptr;
 static internal::SpinLock
 sDriverLock { 0 };
 
+static internal::SpinLockSite
+sRegisterDriverLockSite { "registerUserDriver" };
+
+static internal::SpinLockSite
+sDeregisterDriverLockSite { "deregisterUserDriver" };
+
 int32_t
 registerUserDriver(virt_ptr<const char> name,
                    uint32_t nameLen,
@@ -50,7 +56,7 @@ registerUserDriver(virt_ptr<const char> name,
       *currentUpid = upid;
    }
 
-   internal::spinLockAcquire(sDriverLock, cpu::this_core::id() + 1);
+   internal::spinLockAcquire(sDriverLock, cpu::this_core::id() + 1, sRegisterDriverLockSite);
 
    // Check if this driver has already been registered
    for (auto itr = sUserDriversData->registeredDrivers; itr; itr = itr->next) {
@@ -94,7 +100,7 @@ deregisterUserDriver(virt_ptr<const char> name,
    // Remove driver with same name & upid from list
    auto upid = internal::getCurrentUniqueProcessId();
    auto prev = virt_ptr<UserDriver> { nullptr };
-   internal::spinLockAcquire(sDriverLock, cpu::this_core::id() + 1);
+   internal::spinLockAcquire(sDriverLock, cpu::this_core::id() + 1, sDeregisterDriverLockSite);
    for (auto itr = sUserDriversData->registeredDrivers; itr; itr = itr->next) {
       if (std::strncmp(virt_addrof(itr->name).get(), nameCopy.get(), 64) == 0) {
          if (itr->ownerUpid == upid) {
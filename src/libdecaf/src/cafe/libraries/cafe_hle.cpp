@@ -1,4 +1,5 @@
 #include "cafe_hle.h"
+#include "cafe_hle_trace.h"
 
 #include "avm/avm.h"
 #include "camera/camera.h"
@@ -72,6 +73,7 @@
 
 #include <common/log.h>
 #include <array>
+#include <filesystem>
 #include <libcpu/cpu_formatters.h>
 #include <regex>
 
@@ -90,6 +92,20 @@ registerLibrary(Library *library)
    library->generate();
 }
 
+static void
+applyTraceSettings(const decaf::LogSettings &settings)
+{
+   if (settings.hle_trace && settings.hle_trace_binary) {
+      auto path = std::filesystem::path { settings.directory } / "hle-trace.bin";
+      startBinaryTrace(path.string());
+   } else {
+      stopBinaryTrace();
+   }
+
+   setTraceEnabled(settings.hle_trace);
+   applyTraceFilters(settings.hle_trace_filters);
+}
+
 void
 initialiseLibraries()
 {
@@ -167,14 +183,12 @@ initialiseLibraries()
       []() {
          decaf::registerConfigChangeListener(
             [](const decaf::Settings &settings) {
-               setTraceEnabled(settings.log.hle_trace);
-               applyTraceFilters(settings.log.hle_trace_filters);
+               applyTraceSettings(settings.log);
             });
       });
 
    // Apply trace config
-   setTraceEnabled(decaf::config()->log.hle_trace);
-   applyTraceFilters(decaf::config()->log.hle_trace_filters);
+   applyTraceSettings(decaf::config()->log);
 }
 
 Library *
@@ -1,5 +1,6 @@
 #pragma once
 #include "cafe_hle_library_symbol.h"
+#include "cafe_hle_trace.h"
 #include "cafe/cafe_ppc_interface_invoke_host.h"
 #include "cafe/cafe_ppc_interface_trace_host.h"
 
@@ -49,6 +50,13 @@ struct TracingWrapper
    static inline cpu::Core *wrapped(cpu::Core *core, uint32_t kcId)
    {
       if (FunctionTraceEnabled && traceEnabled) {
+         if (BinaryTraceEnabled) {
+            hle::traceCall<FunctionType>(core, traceId);
+            core = invoke<FunctionType, Func>(core);
+            internal::traceReturn(core, traceId);
+            return core;
+         }
+
          invoke_trace<FunctionType>(core, traceName.c_str());
       }
 
@@ -57,6 +65,7 @@ struct TracingWrapper
 
    static inline std::string traceName = "_missingName";
    static inline bool traceEnabled = false;
+   static inline uint32_t traceId = 0;
 };
 
 template<typename FunctionType, FunctionType Func>
@@ -64,6 +73,8 @@ inline std::unique_ptr<LibraryFunction>
 makeLibraryFunction(const std::string &name)
 {
    TracingWrapper<FunctionType, Func>::traceName = name;
+   TracingWrapper<FunctionType, Func>::traceId =
+      hle::registerTraceFunction<FunctionType>(name);
 
    auto libraryFunction = new LibraryFunction(
       TracingWrapper<FunctionType, Func>::wrapped,
@@ -0,0 +1,360 @@
+#include "cafe_hle_trace.h"
+#include "decaf_hletrace.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <common/atomicqueue.h>
+#include <common/log.h>
+#include <common/platform_thread.h>
+#include <cstring>
+#include <fstream>
+#include <libcpu/be2_struct.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using decaf::hletrace::TraceBlock;
+using decaf::hletrace::TraceFileHeader;
+using decaf::hletrace::TraceFunction;
+using decaf::hletrace::TraceParam;
+using decaf::hletrace::TraceRecord;
+using decaf::hletrace::TraceRegisterType;
+
+namespace cafe::hle
+{
+
+std::atomic<bool> BinaryTraceEnabled { false };
+
+//! Number of records each core can have waiting for the writer thread, once
+//! full further records are dropped.
+static constexpr size_t RingSize = 16 * 1024;
+
+struct TraceFunctionInfo
+{
+   TraceFunction function;
+   std::string name;
+   std::vector<TraceParam> params;
+};
+
+using TraceRing = SingleAtomicQueue<TraceRecord, RingSize>;
+
+static std::mutex sFunctionsMutex;
+static std::vector<TraceFunctionInfo> sFunctions;
+
+//! Each ring has one producer, the core it belongs to, and one consumer, the
+//! writer thread.
+static std::array<TraceRing, 3> sRings;
+static std::array<std::atomic<uint64_t>, 3> sDroppedRecords;
+
+static std::mutex sWriterMutex;
+static std::thread sWriterThread;
+static std::atomic<bool> sWriterRunning { false };
+static std::ofstream sOut;
+static std::string sOutPath;
+static size_t sNumFunctionsWritten = 0;
+
+static TraceParam
+makeTraceParam(const detail::RuntimeParamInfo &info)
+{
+   auto param = TraceParam { };
+   param.type = static_cast<TraceRegisterType>(info.reg_type);
+   param.index = static_cast<uint8_t>(info.reg_index);
+   param.flags = 0;
+
+   if (info.is_signed) {
+      param.flags |= TraceParam::Signed;
+   }
+
+   if (info.is_pointer) {
+      param.flags |= TraceParam::Pointer;
+   }
+
+   if (info.is_string) {
+      param.flags |= TraceParam::String;
+   }
+
+   return param;
+}
+
+static uint64_t
+getTimestamp()
+{
+   return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void
+pushRecord(uint32_t coreId,
+           const TraceRecord &record)
+{
+   if (!sRings[coreId].push(record)) {
+      sDroppedRecords[coreId].fetch_add(1, std::memory_order_relaxed);
+   }
+}
+
+namespace internal
+{
+
+uint32_t
+registerTraceFunction(const std::string &name,
+                      bool isMemberFunction,
+                      const detail::RuntimeParamInfo &returnInfo,
+                      const detail::RuntimeParamInfo *params,
+                      size_t numParams)
+{
+   std::unique_lock<std::mutex> lock { sFunctionsMutex };
+   auto &info = sFunctions.emplace_back();
+   info.name = name;
+   info.function.id = static_cast<uint32_t>(sFunctions.size() - 1);
+   info.function.isMemberFunction = isMemberFunction ? 1 : 0;
+   info.function.numParams = static_cast<uint8_t>(numParams);
+   info.function.nameLength = static_cast<uint16_t>(name.size());
+   info.function.returnValue = makeTraceParam(returnInfo);
+
+   for (auto i = 0u; i < numParams; ++i) {
+      info.params.push_back(makeTraceParam(params[i]));
+   }
+
+   return info.function.id;
+}
+
+void
+traceCall(cpu::Core *core,
+          uint32_t functionId,
+          uint32_t numStackArgs,
+          int stringRegIndex)
+{
+   auto record = TraceRecord { };
+   record.timestamp = getTimestamp();
+   record.functionId = functionId;
+   record.type = TraceRecord::Call;
+   record.core = static_cast<uint8_t>(core->id);
+   record.lr = core->lr;
+   record.sp = core->gpr[1];
+
+   for (auto i = 0u; i < decaf::hletrace::TraceNumGprs; ++i) {
+      record.gpr[i] = core->gpr[3 + i];
+   }
+
+   // Args come after the backchain from the caller (8 bytes).
+   numStackArgs = std::min(numStackArgs, decaf::hletrace::TraceNumStackArgs);
+   record.numStackArgs = static_cast<uint16_t>(numStackArgs);
+
+   for (auto i = 0u; i < numStackArgs; ++i) {
+      record.stack[i] =
+         *virt_cast<uint32_t *>(virt_addr { core->gpr[1] + 8 + 4 * i });
+   }
+
+   for (auto i = 0u; i < decaf::hletrace::TraceNumFprs; ++i) {
+      record.fpr[i] = core->fpr[1 + i].paired0;
+   }
+
+   if (stringRegIndex >= 0) {
+      auto address = uint32_t { 0 };
+      if (stringRegIndex <= 10) {
+         address = core->gpr[stringRegIndex];
+      } else if (static_cast<uint32_t>(stringRegIndex - 11) < numStackArgs) {
+         address = record.stack[stringRegIndex - 11];
+      }
+
+      if (address) {
+         auto str = virt_cast<const char *>(virt_addr { address }).get();
+         for (auto i = 0u; i < decaf::hletrace::TraceMaxStringLength - 1 && str[i]; ++i) {
+            record.string[i] = str[i];
+         }
+      }
+   }
+
+   pushRecord(core->id, record);
+}
+
+void
+traceReturn(cpu::Core *core,
+            uint32_t functionId)
+{
+   auto record = TraceRecord { };
+   record.timestamp = getTimestamp();
+   record.functionId = functionId;
+   record.type = TraceRecord::Return;
+   record.core = static_cast<uint8_t>(core->id);
+   record.lr = core->lr;
+   record.sp = core->gpr[1];
+   record.gpr[0] = core->gpr[3];
+   record.gpr[1] = core->gpr[4];
+   record.fpr[0] = core->fpr[1].paired0;
+   pushRecord(core->id, record);
+}
+
+} // namespace internal
+
+static void
+writeBlock(TraceBlock::Type type,
+           uint32_t numEntries,
+           const void *data,
+           size_t size)
+{
+   auto block = TraceBlock { };
+   block.type = type;
+   block.numEntries = numEntries;
+   block.size = static_cast<uint32_t>(size);
+   sOut.write(reinterpret_cast<const char *>(&block), sizeof(TraceBlock));
+   sOut.write(reinterpret_cast<const char *>(data), size);
+}
+
+//! Write the metadata of any functions registered since the last call.
+static void
+writeNewFunctions()
+{
+   std::unique_lock<std::mutex> lock { sFunctionsMutex };
+   if (sNumFunctionsWritten == sFunctions.size()) {
+      return;
+   }
+
+   auto data = std::vector<char> { };
+   auto append =
+      [&](const void *src, size_t size) {
+         auto offset = data.size();
+         data.resize(offset + size);
+         std::memcpy(data.data() + offset, src, size);
+      };
+
+   for (auto i = sNumFunctionsWritten; i < sFunctions.size(); ++i) {
+      auto &info = sFunctions[i];
+      append(&info.function, sizeof(TraceFunction));
+      append(info.name.data(), info.name.size());
+      append(info.params.data(), info.params.size() * sizeof(TraceParam));
+   }
+
+   writeBlock(TraceBlock::Functions,
+              static_cast<uint32_t>(sFunctions.size() - sNumFunctionsWritten),
+              data.data(), data.size());
+   sNumFunctionsWritten = sFunctions.size();
+}
+
+static void
+writerThread()
+{
+   auto records = std::vector<TraceRecord> { };
+   records.reserve(RingSize);
+
+   while (true) {
+      // Read running before draining so the final pass after stop still
+      // picks up anything pushed before BinaryTraceEnabled was cleared.
+      auto running = sWriterRunning.load();
+      auto record = TraceRecord { };
+
+      // Limit each pass so a busy core cannot keep us draining forever
+      for (auto &ring : sRings) {
+         for (auto i = 0u; i < RingSize && ring.pop(record); ++i) {
+            records.push_back(record);
+         }
+      }
+
+      if (!records.empty()) {
+         writeNewFunctions();
+         writeBlock(TraceBlock::Records,
+                    static_cast<uint32_t>(records.size()),
+                    records.data(), records.size() * sizeof(TraceRecord));
+         records.clear();
+      } else if (running) {
+         std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+      }
+
+      if (!running) {
+         break;
+      }
+   }
+
+   sOut.flush();
+}
+
+/**
+ * Throw away anything left in the rings.
+ *
+ * A core can still be inside a traced call when BinaryTraceEnabled is
+ * cleared, so records may arrive after the writer's final pass. Those must
+ * not end up at the start of the next trace file.
+ */
+static void
+discardRecords()
+{
+   auto record = TraceRecord { };
+
+   for (auto &ring : sRings) {
+      while (ring.pop(record)) {
+      }
+   }
+}
+
+bool
+startBinaryTrace(const std::string &path)
+{
+   std::unique_lock<std::mutex> lock { sWriterMutex };
+   if (sWriterThread.joinable()) {
+      if (sOutPath == path) {
+         return true;
+      }
+
+      lock.unlock();
+      stopBinaryTrace();
+      lock.lock();
+   }
+
+   sOut.open(path, std::fstream::binary | std::fstream::trunc);
+   if (!sOut.is_open()) {
+      gLog->error("Failed to open HLE trace file {}", path);
+      return false;
+   }
+
+   auto header = TraceFileHeader { };
+   header.magic = decaf::hletrace::TraceMagic;
+   header.version = decaf::hletrace::TraceVersion;
+   sOut.write(reinterpret_cast<const char *>(&header), sizeof(TraceFileHeader));
+
+   sOutPath = path;
+   sNumFunctionsWritten = 0;
+   writeNewFunctions();
+
+   discardRecords();
+
+   for (auto &dropped : sDroppedRecords) {
+      dropped.store(0);
+   }
+
+   sWriterRunning = true;
+   sWriterThread = std::thread { writerThread };
+   platform::setThreadName(&sWriterThread, "HLE Trace Writer");
+   BinaryTraceEnabled = true;
+   return true;
+}
+
+void
+stopBinaryTrace()
+{
+   std::unique_lock<std::mutex> lock { sWriterMutex };
+   if (!sWriterThread.joinable()) {
+      return;
+   }
+
+   BinaryTraceEnabled = false;
+   sWriterRunning = false;
+   sWriterThread.join();
+   sOut.close();
+   discardRecords();
+
+   for (auto i = 0u; i < sDroppedRecords.size(); ++i) {
+      auto dropped = sDroppedRecords[i].load();
+      if (dropped) {
+         gLog->warn("HLE trace dropped {} records from core {}, the writer could not keep up",
+                    dropped, i);
+      }
+   }
+
+   gLog->info("Wrote HLE trace to {}", sOutPath);
+   sOutPath.clear();
+}
+
+} // namespace cafe::hle
@@ -0,0 +1,110 @@
+#pragma once
+#include "cafe/cafe_ppc_interface.h"
+
+#include <atomic>
+#include <cstdint>
+#include <libcpu/state.h>
+#include <string>
+
+namespace cafe::hle
+{
+
+extern std::atomic<bool> BinaryTraceEnabled;
+
+namespace internal
+{
+
+uint32_t
+registerTraceFunction(const std::string &name,
+                      bool isMemberFunction,
+                      const detail::RuntimeParamInfo &returnInfo,
+                      const detail::RuntimeParamInfo *params,
+                      size_t numParams);
+
+void
+traceCall(cpu::Core *core,
+          uint32_t functionId,
+          uint32_t numStackArgs,
+          int stringRegIndex);
+
+void
+traceReturn(cpu::Core *core,
+            uint32_t functionId);
+
+//! Number of words of stack arguments a function reads, r11 onwards.
+template<size_t NumParams>
+constexpr uint32_t
+getTraceNumStackArgs(const std::array<detail::RuntimeParamInfo, NumParams> &params)
+{
+   auto numStackArgs = 0;
+
+   for (auto &param : params) {
+      auto lastIndex = param.reg_index;
+      if (param.reg_type == detail::RegisterType::Gpr64) {
+         lastIndex += 1;
+      } else if (param.reg_type != detail::RegisterType::Gpr32) {
+         continue;
+      }
+
+      if (lastIndex > 10 && lastIndex - 10 > numStackArgs) {
+         numStackArgs = lastIndex - 10;
+      }
+   }
+
+   return static_cast<uint32_t>(numStackArgs);
+}
+
+//! Register index of the first string argument, or -1 if there is none.
+template<size_t NumParams>
+constexpr int
+getTraceStringRegIndex(const std::array<detail::RuntimeParamInfo, NumParams> &params)
+{
+   for (auto &param : params) {
+      if (param.reg_type == detail::RegisterType::Gpr32 && param.is_string) {
+         return param.reg_index;
+      }
+   }
+
+   return -1;
+}
+
+} // namespace internal
+
+//! Register a host function with the binary tracer, returns its function id.
+template<typename FunctionType>
+uint32_t
+registerTraceFunction(const std::string &name)
+{
+   using func_traits = detail::function_traits<FunctionType>;
+   return internal::registerTraceFunction(name,
+                                          func_traits::is_member_function,
+                                          func_traits::runtime_return_info,
+                                          func_traits::runtime_param_info.data(),
+                                          func_traits::runtime_param_info.size());
+}
+
+//! Record a host function call from a guest context in the binary trace.
+template<typename FunctionType>
+void
+traceCall(cpu::Core *core,
+          uint32_t functionId)
+{
+   using func_traits = detail::function_traits<FunctionType>;
+   constexpr auto numStackArgs = internal::getTraceNumStackArgs(func_traits::runtime_param_info);
+   constexpr auto stringRegIndex = internal::getTraceStringRegIndex(func_traits::runtime_param_info);
+   internal::traceCall(core, functionId, numStackArgs, stringRegIndex);
+}
+
+/**
+ * Start writing a binary trace to path.
+ *
+ * Calls are recorded into a ring buffer per core and written to the file by
+ * a background thread, see decaf_hletrace.h for the format.
+ */
+bool
+startBinaryTrace(const std::string &path);
+
+void
+stopBinaryTrace();
+
+} // namespace cafe::hle
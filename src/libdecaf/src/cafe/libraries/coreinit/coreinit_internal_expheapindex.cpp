@@ -0,0 +1,200 @@
+#include "coreinit_internal_expheapindex.h"
+
+#include <common/align.h>
+#include <common/bitutils.h>
+#include <common/decaf_assert.h>
+
+namespace cafe::coreinit::internal
+{
+
+uint32_t
+ExpHeapFreeIndex::getAlignedSize(uint32_t block,
+                                 uint32_t blockSize,
+                                 uint32_t alignment,
+                                 MEMExpHeapDirection dir)
+{
+   auto dataStart = static_cast<uint32_t>(block + BlockHeaderSize);
+   auto dataEnd = static_cast<uint32_t>(dataStart + blockSize);
+
+   if (dir == MEMExpHeapDirection::FromStart) {
+      auto alignedDataStart = align_up(dataStart, alignment);
+
+      if (alignedDataStart >= dataEnd) {
+         return 0;
+      }
+
+      return dataEnd - alignedDataStart;
+   } else if (dir == MEMExpHeapDirection::FromEnd) {
+      auto alignedDataEnd = align_down(dataEnd, alignment);
+
+      if (alignedDataEnd <= dataStart) {
+         return 0;
+      }
+
+      return alignedDataEnd - dataStart;
+   } else {
+      decaf_abort("Unexpected ExpHeap direction");
+   }
+}
+
+size_t
+ExpHeapFreeIndex::getSizeClass(uint32_t blockSize)
+{
+   if (!blockSize) {
+      return 0;
+   }
+
+   auto log2 = static_cast<size_t>(31 - clz(blockSize));
+   if (log2 < 2) {
+      return log2 * NumSubClasses;
+   }
+
+   // The two bits below the highest set bit select the sub class
+   auto subClass = static_cast<size_t>((blockSize >> (log2 - 2)) & 3);
+   return log2 * NumSubClasses + subClass;
+}
+
+void
+ExpHeapFreeIndex::clear()
+{
+   mFreeBlocks.clear();
+   mFreeBySize.clear();
+   mUsedBlocks.clear();
+   mTotalFreeSize = 0;
+   mNumUnsortedLinks = 0;
+
+   for (auto &sizeClass : mFreeBySizeClass) {
+      sizeClass.clear();
+   }
+}
+
+void
+ExpHeapFreeIndex::insertFree(uint32_t block,
+                             uint32_t blockSize)
+{
+   auto inserted = mFreeBlocks.emplace(block, blockSize).second;
+   decaf_check(inserted);
+
+   mFreeBySizeClass[getSizeClass(blockSize)].emplace(block, blockSize);
+   mFreeBySize.emplace(blockSize, block);
+   mTotalFreeSize += blockSize;
+}
+
+void
+ExpHeapFreeIndex::removeFree(uint32_t block)
+{
+   auto itr = mFreeBlocks.find(block);
+   decaf_check(itr != mFreeBlocks.end());
+
+   auto blockSize = itr->second;
+   mFreeBySizeClass[getSizeClass(blockSize)].erase(block);
+   mFreeBySize.erase({ blockSize, block });
+   mFreeBlocks.erase(itr);
+   mTotalFreeSize -= blockSize;
+}
+
+void
+ExpHeapFreeIndex::resizeFree(uint32_t block,
+                             uint32_t blockSize)
+{
+   removeFree(block);
+   insertFree(block, blockSize);
+}
+
+uint32_t
+ExpHeapFreeIndex::findFreeBefore(uint32_t address) const
+{
+   auto itr = mFreeBlocks.lower_bound(address);
+   if (itr == mFreeBlocks.begin()) {
+      return 0;
+   }
+
+   return (--itr)->first;
+}
+
+uint32_t
+ExpHeapFreeIndex::findFreeAfter(uint32_t address) const
+{
+   auto itr = mFreeBlocks.lower_bound(address);
+   if (itr == mFreeBlocks.end()) {
+      return 0;
+   }
+
+   return itr->first;
+}
+
+uint32_t
+ExpHeapFreeIndex::findFree(uint32_t size,
+                           uint32_t alignment,
+                           MEMExpHeapDirection dir,
+                           MEMExpHeapMode mode) const
+{
+   if (mode == MEMExpHeapMode::FirstFree) {
+      return findFirstFree(size, alignment, dir);
+   } else {
+      return findNearestSize(size, alignment, dir);
+   }
+}
+
+uint32_t
+ExpHeapFreeIndex::findFirstFree(uint32_t size,
+                                uint32_t alignment,
+                                MEMExpHeapDirection dir) const
+{
+   auto found = uint32_t { 0 };
+
+   // Blocks in lower size classes are all smaller than size. Search the
+   // largest classes first, every block in them usually fits so we quickly
+   // get an upper bound on the address of the first block which fits.
+   for (auto sizeClass = NumSizeClasses; sizeClass-- > getSizeClass(size); ) {
+      for (auto &[block, blockSize] : mFreeBySizeClass[sizeClass]) {
+         if (found && block >= found) {
+            break;
+         }
+
+         if (getAlignedSize(block, blockSize, alignment, dir) >= size) {
+            found = block;
+            break;
+         }
+      }
+   }
+
+   return found;
+}
+
+uint32_t
+ExpHeapFreeIndex::findNearestSize(uint32_t size,
+                                  uint32_t alignment,
+                                  MEMExpHeapDirection dir) const
+{
+   auto found = uint32_t { 0 };
+   auto bestAlignedSize = 0xFFFFFFFFu;
+
+   for (auto itr = mFreeBySize.lower_bound({ size, 0u }); itr != mFreeBySize.end(); ++itr) {
+      auto [blockSize, block] = *itr;
+
+      // Aligning loses less than alignment bytes, so once blocks are this
+      // much larger than the best so far none of them can beat it.
+      if (found && static_cast<uint64_t>(blockSize) >=
+                   static_cast<uint64_t>(bestAlignedSize) + alignment) {
+         break;
+      }
+
+      auto alignedSize = getAlignedSize(block, blockSize, alignment, dir);
+      if (alignedSize < size) {
+         continue;
+      }
+
+      // Equal sizes are won by the lowest address, which is the first one
+      // the guest free list would find
+      if (alignedSize < bestAlignedSize ||
+          (alignedSize == bestAlignedSize && block < found)) {
+         found = block;
+         bestAlignedSize = alignedSize;
+      }
+   }
+
+   return found;
+}
+
+} // namespace cafe::coreinit::internal
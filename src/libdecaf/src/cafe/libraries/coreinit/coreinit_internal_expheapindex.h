@@ -0,0 +1,197 @@
+#pragma once
+#include "coreinit_enum.h"
+
+#include <array>
+#include <common/decaf_assert.h>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <utility>
+
+namespace cafe::coreinit::internal
+{
+
+/**
+ * Host side index of the blocks of a MEMExpHeap.
+ *
+ * The guest free list is kept exactly as before, this only shadows it so an
+ * allocation does not have to walk the whole list:
+ *  - free blocks by address, to find the neighbours of released memory.
+ *  - free blocks by size class then address, for FirstFree allocation.
+ *  - free blocks by size then address, for NearestSize allocation.
+ *  - the set of used blocks, to validate frees without walking the used
+ *    list.
+ *
+ * Blocks are identified by the guest address of their MEMExpHeapBlock, as
+ * free blocks never have alignment space this is also where their memory
+ * starts.
+ *
+ * The searches answer by address, which is only the same as the guest list
+ * order while the free list is sorted by address. It usually is, but with
+ * reuseAlignSpace the space left either side of an aligned allocation is
+ * inserted in the opposite order, so the index also counts the links in
+ * the free list which go backwards. The heap must walk the guest list
+ * itself while isFreeListSorted is false.
+ */
+class ExpHeapFreeIndex
+{
+   //! Each power of two is split into 4 size classes, so a FirstFree
+   //! search has few blocks too small for it in the smallest class it has
+   //! to look at.
+   static constexpr size_t NumSubClasses = 4;
+   static constexpr size_t NumSizeClasses = 32 * NumSubClasses;
+
+public:
+   //! sizeof(MEMExpHeapBlock), the header before the data of each block.
+   static constexpr uint32_t BlockHeaderSize = 0x14;
+
+   /**
+    * Size of the block which is usable when its data is aligned, this is
+    * the same as the size the guest free list search compares against.
+    */
+   static uint32_t
+   getAlignedSize(uint32_t block,
+                  uint32_t blockSize,
+                  uint32_t alignment,
+                  MEMExpHeapDirection dir);
+
+   void
+   clear();
+
+   void
+   insertFree(uint32_t block,
+              uint32_t blockSize);
+
+   void
+   removeFree(uint32_t block);
+
+   void
+   resizeFree(uint32_t block,
+              uint32_t blockSize);
+
+   bool
+   containsFree(uint32_t block) const
+   {
+      return mFreeBlocks.find(block) != mFreeBlocks.end();
+   }
+
+   //! Record a link from prev to next in the guest free list, 0 for none.
+   void
+   insertFreeLink(uint32_t prev,
+                  uint32_t next)
+   {
+      if (prev && next && next < prev) {
+         mNumUnsortedLinks++;
+      }
+   }
+
+   //! Record a link from prev to next being removed from the free list.
+   void
+   removeFreeLink(uint32_t prev,
+                  uint32_t next)
+   {
+      if (prev && next && next < prev) {
+         decaf_check(mNumUnsortedLinks > 0);
+         mNumUnsortedLinks--;
+      }
+   }
+
+   //! Whether the guest free list is in address order.
+   bool
+   isFreeListSorted() const
+   {
+      return mNumUnsortedLinks == 0;
+   }
+
+   //! Free block with the highest address below address, or 0.
+   uint32_t
+   findFreeBefore(uint32_t address) const;
+
+   //! Free block with the lowest address at or above address, or 0.
+   uint32_t
+   findFreeAfter(uint32_t address) const;
+
+   /**
+    * Find the free block an allocation is made from.
+    *
+    * Gives the same block a walk of the guest free list would, as long as
+    * the free list is sorted:
+    *  - FirstFree, the lowest addressed block which fits, which is the
+    *    first one in the list.
+    *  - NearestSize, the block with the smallest aligned size which fits,
+    *    the lowest addressed one if there are several.
+    *
+    * Returns 0 if no block fits.
+    */
+   uint32_t
+   findFree(uint32_t size,
+            uint32_t alignment,
+            MEMExpHeapDirection dir,
+            MEMExpHeapMode mode) const;
+
+   uint32_t
+   getTotalFreeSize() const
+   {
+      return mTotalFreeSize;
+   }
+
+   size_t
+   getNumFreeBlocks() const
+   {
+      return mFreeBlocks.size();
+   }
+
+   void
+   insertUsed(uint32_t block)
+   {
+      mUsedBlocks.insert(block);
+   }
+
+   void
+   removeUsed(uint32_t block)
+   {
+      mUsedBlocks.erase(block);
+   }
+
+   bool
+   containsUsed(uint32_t block) const
+   {
+      return mUsedBlocks.find(block) != mUsedBlocks.end();
+   }
+
+private:
+   static size_t
+   getSizeClass(uint32_t blockSize);
+
+   uint32_t
+   findFirstFree(uint32_t size,
+                 uint32_t alignment,
+                 MEMExpHeapDirection dir) const;
+
+   uint32_t
+   findNearestSize(uint32_t size,
+                   uint32_t alignment,
+                   MEMExpHeapDirection dir) const;
+
+private:
+   //! Block address to block size.
+   std::map<uint32_t, uint32_t> mFreeBlocks;
+
+   //! Block address to block size, for each size class.
+   std::array<std::map<uint32_t, uint32_t>, NumSizeClasses> mFreeBySizeClass;
+
+   //! Pairs of block size and block address.
+   std::set<std::pair<uint32_t, uint32_t>> mFreeBySize;
+
+   std::unordered_set<uint32_t> mUsedBlocks;
+
+   //! Sum of the size of the free blocks, wraps the same as the guest sum.
+   uint32_t mTotalFreeSize = 0;
+
+   //! Number of links in the guest free list to a lower address.
+   size_t mNumUnsortedLinks = 0;
+};
+
+} // namespace cafe::coreinit::internal
@@ -1,9 +1,13 @@
 #include "coreinit.h"
+#include "coreinit_internal_expheapindex.h"
 #include "coreinit_memexpheap.h"
 #include "coreinit_memory.h"
 
 #include <common/log.h>
 #include <libcpu/cpu_formatters.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace cafe::coreinit
 {
@@ -14,6 +18,66 @@ FreeTag = uint16_t { 0x4654 }; // 'FR'
 static constexpr auto
 UsedTag = uint16_t { 0x5544 }; // 'UD'
 
+using internal::ExpHeapFreeIndex;
+static_assert(ExpHeapFreeIndex::BlockHeaderSize == sizeof(MEMExpHeapBlock));
+
+//! Host side index of each heap's blocks, keyed by the heap's address.
+static std::mutex sFreeIndexMutex;
+static std::unordered_map<uint32_t, std::unique_ptr<ExpHeapFreeIndex>> sFreeIndices;
+
+static uint32_t
+getBlockAddress(virt_ptr<MEMExpHeapBlock> block)
+{
+   return static_cast<uint32_t>(virt_cast<virt_addr>(block));
+}
+
+static virt_ptr<MEMExpHeapBlock>
+getBlockFromAddress(uint32_t address)
+{
+   return virt_cast<MEMExpHeapBlock *>(virt_addr { address });
+}
+
+/**
+ * Get the index of a heap's blocks, building it from the guest lists if
+ * the heap does not have one yet.
+ */
+static ExpHeapFreeIndex &
+getFreeIndex(virt_ptr<MEMExpHeap> heap)
+{
+   std::unique_lock<std::mutex> lock { sFreeIndexMutex };
+   auto &index = sFreeIndices[static_cast<uint32_t>(virt_cast<virt_addr>(heap))];
+
+   if (!index) {
+      index = std::make_unique<ExpHeapFreeIndex>();
+
+      for (auto block = heap->freeList.head; block; block = block->next) {
+         index->insertFree(getBlockAddress(block), block->blockSize);
+
+         if (block->next) {
+            index->insertFreeLink(getBlockAddress(block),
+                                  getBlockAddress(block->next));
+         }
+      }
+
+      for (auto block = heap->usedList.head; block; block = block->next) {
+         index->insertUsed(getBlockAddress(block));
+      }
+   }
+
+   return *index;
+}
+
+/**
+ * Drop the index of a heap, the next getFreeIndex rebuilds it from the
+ * guest lists.
+ */
+static void
+eraseFreeIndex(virt_ptr<MEMExpHeap> heap)
+{
+   std::unique_lock<std::mutex> lock { sFreeIndexMutex };
+   sFreeIndices.erase(static_cast<uint32_t>(virt_cast<virt_addr>(heap)));
+}
+
 static virt_ptr<uint8_t>
 getBlockMemStart(virt_ptr<MEMExpHeapBlock> block)
 {
@@ -41,19 +105,6 @@ getUsedMemBlock(virt_ptr<void> mem)
    return block;
 }
 
-static bool
-listContainsBlock(virt_ptr<MEMExpHeapBlockList> list,
-                  virt_ptr<MEMExpHeapBlock> block)
-{
-   for (auto i = list->head; i; i = i->next) {
-      if (i == block) {
-         return true;
-      }
-   }
-
-   return false;
-}
-
 static void
 insertBlock(virt_ptr<MEMExpHeapBlockList> list,
             virt_ptr<MEMExpHeapBlock> prev,
@@ -85,8 +136,6 @@ static void
 removeBlock(virt_ptr<MEMExpHeapBlockList> list,
             virt_ptr<MEMExpHeapBlock> block)
 {
-   decaf_check(listContainsBlock(list, block));
-
    if (block->prev) {
       block->prev->next = block->next;
    } else {
@@ -103,38 +152,88 @@ removeBlock(virt_ptr<MEMExpHeapBlockList> list,
    block->next = nullptr;
 }
 
+/**
+ * Insert a block into the free list after prev, which is not always the
+ * block before it in memory.
+ */
+static void
+insertFreeBlock(virt_ptr<MEMExpHeap> heap,
+                ExpHeapFreeIndex &index,
+                virt_ptr<MEMExpHeapBlock> prev,
+                virt_ptr<MEMExpHeapBlock> block)
+{
+   auto next = prev ? prev->next : heap->freeList.head;
+   index.removeFreeLink(getBlockAddress(prev), getBlockAddress(next));
+   index.insertFreeLink(getBlockAddress(prev), getBlockAddress(block));
+   index.insertFreeLink(getBlockAddress(block), getBlockAddress(next));
+
+   insertBlock(virt_addrof(heap->freeList), prev, block);
+   index.insertFree(getBlockAddress(block), block->blockSize);
+}
+
+static void
+removeFreeBlock(virt_ptr<MEMExpHeap> heap,
+                ExpHeapFreeIndex &index,
+                virt_ptr<MEMExpHeapBlock> block)
+{
+   auto prev = block->prev;
+   auto next = block->next;
+   decaf_check(index.containsFree(getBlockAddress(block)));
+   index.removeFreeLink(getBlockAddress(prev), getBlockAddress(block));
+   index.removeFreeLink(getBlockAddress(block), getBlockAddress(next));
+   index.insertFreeLink(getBlockAddress(prev), getBlockAddress(next));
+
+   removeBlock(virt_addrof(heap->freeList), block);
+   index.removeFree(getBlockAddress(block));
+}
+
 static uint32_t
 getAlignedBlockSize(virt_ptr<MEMExpHeapBlock> block,
                     uint32_t alignment,
                     MEMExpHeapDirection dir)
 {
-   if (dir == MEMExpHeapDirection::FromStart) {
-      auto dataStart = virt_cast<uint8_t *>(block) + sizeof(MEMExpHeapBlock);
-      auto dataEnd = dataStart + block->blockSize;
-      auto alignedDataStart = align_up(dataStart, alignment);
+   return ExpHeapFreeIndex::getAlignedSize(getBlockAddress(block),
+                                           block->blockSize,
+                                           alignment,
+                                           dir);
+}
 
-      if (alignedDataStart >= dataEnd) {
-         return 0;
-      }
+/**
+ * Find the free block to allocate from by walking the guest free list, for
+ * when it is not sorted and the index would give a different block.
+ */
+static virt_ptr<MEMExpHeapBlock>
+findFreeBlockInList(virt_ptr<MEMExpHeap> heap,
+                    uint32_t size,
+                    uint32_t alignment,
+                    MEMExpHeapDirection dir,
+                    MEMExpHeapMode mode)
+{
+   auto foundBlock = virt_ptr<MEMExpHeapBlock> { nullptr };
+   auto bestAlignedSize = 0xFFFFFFFFu;
 
-      return static_cast<uint32_t>(dataEnd - alignedDataStart);
-   } else if (dir == MEMExpHeapDirection::FromEnd) {
-      auto dataStart = virt_cast<uint8_t *>(block) + sizeof(MEMExpHeapBlock);
-      auto dataEnd = dataStart + block->blockSize;
-      auto alignedDataEnd = align_down(dataEnd, alignment);
+   for (auto block = heap->freeList.head; block; block = block->next) {
+      auto alignedSize = getAlignedBlockSize(block, alignment, dir);
 
-      if (alignedDataEnd <= dataStart) {
-         return 0;
+      if (alignedSize >= size) {
+         if (mode == MEMExpHeapMode::FirstFree) {
+            foundBlock = block;
+            break;
+         } else {
+            if (alignedSize < bestAlignedSize) {
+               foundBlock = block;
+               bestAlignedSize = alignedSize;
+            }
+         }
       }
-
-      return static_cast<uint32_t>(alignedDataEnd - dataStart);
-   } else {
-      decaf_abort("Unexpected ExpHeap direction");
    }
+
+   return foundBlock;
 }
 
 static virt_ptr<MEMExpHeapBlock>
 createUsedBlockFromFreeBlock(virt_ptr<MEMExpHeap> heap,
+                             ExpHeapFreeIndex &index,
                              virt_ptr<MEMExpHeapBlock> freeBlock,
                              uint32_t size,
                              uint32_t alignment,
@@ -149,7 +248,7 @@ createUsedBlockFromFreeBlock(virt_ptr<MEMExpHeap> heap,
 
    // Free blocks should never have alignment...
    decaf_check(!freeBlockAttribs.alignment());
-   removeBlock(virt_addrof(heap->freeList), freeBlock);
+   removeFreeBlock(heap, index, freeBlock);
 
    // Find where we are going to start
    auto alignedDataStart = virt_ptr<uint8_t> { };
@@ -183,7 +282,7 @@ createUsedBlockFromFreeBlock(virt_ptr<MEMExpHeap> heap,
          freeBlock->prev = nullptr;
          freeBlock->tag = FreeTag;
 
-         insertBlock(virt_addrof(heap->freeList), freeBlockPrev, freeBlock);
+         insertFreeBlock(heap, index, freeBlockPrev, freeBlock);
          topSpaceRemain = 0;
       }
    }
@@ -200,7 +299,7 @@ createUsedBlockFromFreeBlock(virt_ptr<MEMExpHeap> heap,
          freeBlock->prev = nullptr;
          freeBlock->tag = FreeTag;
 
-         insertBlock(virt_addrof(heap->freeList), freeBlockPrev, freeBlock);
+         insertFreeBlock(heap, index, freeBlockPrev, freeBlock);
          bottomSpaceRemain = 0;
       }
    }
@@ -215,6 +314,7 @@ createUsedBlockFromFreeBlock(virt_ptr<MEMExpHeap> heap,
    alignedBlock->tag = UsedTag;
 
    insertBlock(virt_addrof(heap->usedList), nullptr, alignedBlock);
+   index.insertUsed(getBlockAddress(alignedBlock));
 
    if (heap->header.flags & MEMHeapFlags::ZeroAllocated) {
       memset(alignedDataStart, 0, size);
@@ -228,6 +328,7 @@ createUsedBlockFromFreeBlock(virt_ptr<MEMExpHeap> heap,
 
 static void
 releaseMemory(virt_ptr<MEMExpHeap> heap,
+              ExpHeapFreeIndex &index,
               virt_ptr<uint8_t> memStart,
               virt_ptr<uint8_t> memEnd)
 {
@@ -243,12 +344,22 @@ releaseMemory(virt_ptr<MEMExpHeap> heap,
    virt_ptr<MEMExpHeapBlock> prevBlock = nullptr;
    virt_ptr<MEMExpHeapBlock> nextBlock = heap->freeList.head;
 
-   for (auto block = heap->freeList.head; block; block = block->next) {
-      if (getBlockMemStart(block) < memStart) {
-         prevBlock = block;
-         nextBlock = block->next;
-      } else if (block >= prevBlock) {
-         break;
+   if (index.isFreeListSorted()) {
+      auto memStartAddress = static_cast<uint32_t>(virt_cast<virt_addr>(memStart));
+      auto prevAddress = index.findFreeBefore(memStartAddress);
+
+      if (prevAddress) {
+         prevBlock = getBlockFromAddress(prevAddress);
+         nextBlock = prevBlock->next;
+      }
+   } else {
+      for (auto block = heap->freeList.head; block; block = block->next) {
+         if (getBlockMemStart(block) < memStart) {
+            prevBlock = block;
+            nextBlock = block->next;
+         } else if (block >= prevBlock) {
+            break;
+         }
       }
    }
 
@@ -261,6 +372,7 @@ releaseMemory(virt_ptr<MEMExpHeap> heap,
       if (memStart == prevMemEnd) {
          // Previous block absorbs the new memory
          prevBlock->blockSize += static_cast<uint32_t>(memEnd - memStart);
+         index.resizeFree(getBlockAddress(prevBlock), prevBlock->blockSize);
 
          // Our free block becomes the previous one
          freeBlock = prevBlock;
@@ -277,7 +389,7 @@ releaseMemory(virt_ptr<MEMExpHeap> heap,
       freeBlock->prev = nullptr;
       freeBlock->tag = FreeTag;
 
-      insertBlock(virt_addrof(heap->freeList), prevBlock, freeBlock);
+      insertFreeBlock(heap, index, prevBlock, freeBlock);
    }
 
    if (nextBlock) {
@@ -290,8 +402,9 @@ releaseMemory(virt_ptr<MEMExpHeap> heap,
          //  are directly adjacent to each other in memory.
          auto nextBlockEnd = getBlockMemEnd(nextBlock);
          freeBlock->blockSize += static_cast<uint32_t>(nextBlockEnd - nextBlockStart);
+         index.resizeFree(getBlockAddress(freeBlock), freeBlock->blockSize);
 
-         removeBlock(virt_addrof(heap->freeList), nextBlock);
+         removeFreeBlock(heap, index, nextBlock);
       }
    }
 }
@@ -340,6 +453,11 @@ MEMCreateExpHeapEx(virt_ptr<void> base,
    heap->groupId = uint16_t { 0 };
    heap->attribs = MEMExpHeapAttribs::get(0);
 
+   // Replace the index of any previous heap at this address
+   auto &index = getFreeIndex(heap);
+   index.clear();
+   index.insertFree(getBlockAddress(firstBlock), firstBlock->blockSize);
+
    return virt_cast<MEMHeapHeader *>(heap);
 }
 
@@ -350,6 +468,7 @@ MEMDestroyExpHeap(MEMHeapHandle handle)
    decaf_check(heap);
    decaf_check(heap->header.tag == MEMHeapTag::ExpandedHeap);
    internal::unregisterHeap(virt_addrof(heap->header));
+   eraseFreeIndex(heap);
    return heap;
 }
 
@@ -369,74 +488,46 @@ MEMAllocFromExpHeapEx(MEMHeapHandle handle,
    decaf_check(alignment != 0);
 
    internal::HeapLock lock { virt_addrof(heap->header) };
+   auto &index = getFreeIndex(heap);
+   auto dir = MEMExpHeapDirection::FromStart;
    virt_ptr<MEMExpHeapBlock> newBlock = nullptr;
 
    size = align_up(size, 4);
 
    if (alignment > 0) {
-      auto foundBlock = virt_ptr<MEMExpHeapBlock> { nullptr };
-      auto bestAlignedSize = 0xFFFFFFFFu;
-
       alignment = std::max(4, alignment);
-      decaf_check((alignment & 0x3) == 0);
-
-      for (auto block = heap->freeList.head; block; block = block->next) {
-         auto alignedSize = getAlignedBlockSize(block,
-                                                alignment,
-                                                MEMExpHeapDirection::FromStart);
-
-         if (alignedSize >= size) {
-            if (expHeapFlags.allocMode() == MEMExpHeapMode::FirstFree) {
-               foundBlock = block;
-               break;
-            } else {
-               if (alignedSize < bestAlignedSize) {
-                  foundBlock = block;
-                  bestAlignedSize = alignedSize;
-               }
-            }
-         }
-      }
-
-      if (foundBlock) {
-         newBlock = createUsedBlockFromFreeBlock(heap,
-                                                 foundBlock,
-                                                 size,
-                                                 alignment,
-                                                 MEMExpHeapDirection::FromStart);
-      }
    } else {
       alignment = std::max(4, -alignment);
-      decaf_check((alignment & 0x3) == 0);
+      dir = MEMExpHeapDirection::FromEnd;
+   }
 
-      auto foundBlock = virt_ptr<MEMExpHeapBlock> { nullptr };
-      auto bestAlignedSize = 0xFFFFFFFFu;
+   decaf_check((alignment & 0x3) == 0);
 
-      for (auto block = heap->freeList.head; block; block = block->next) {
-         auto alignedSize = getAlignedBlockSize(block,
-                                                alignment,
-                                                MEMExpHeapDirection::FromEnd);
+   auto foundBlock = virt_ptr<MEMExpHeapBlock> { nullptr };
 
-         if (alignedSize >= size) {
-            if (expHeapFlags.allocMode() == MEMExpHeapMode::FirstFree) {
-               foundBlock = block;
-               break;
-            } else {
-               if (alignedSize < bestAlignedSize) {
-                  foundBlock = block;
-                  bestAlignedSize = alignedSize;
-               }
-            }
-         }
+   if (index.isFreeListSorted()) {
+      auto foundAddress = index.findFree(size,
+                                         static_cast<uint32_t>(alignment),
+                                         dir,
+                                         expHeapFlags.allocMode());
+      if (foundAddress) {
+         foundBlock = getBlockFromAddress(foundAddress);
       }
+   } else {
+      foundBlock = findFreeBlockInList(heap,
+                                       size,
+                                       static_cast<uint32_t>(alignment),
+                                       dir,
+                                       expHeapFlags.allocMode());
+   }
 
-      if (foundBlock) {
-         newBlock = createUsedBlockFromFreeBlock(heap,
-                                                 foundBlock,
-                                                 size,
-                                                 alignment,
-                                                 MEMExpHeapDirection::FromEnd);
-      }
+   if (foundBlock) {
+      newBlock = createUsedBlockFromFreeBlock(heap,
+                                              index,
+                                              foundBlock,
+                                              size,
+                                              alignment,
+                                              dir);
    }
 
    if (!newBlock) {
@@ -459,10 +550,12 @@ MEMFreeToExpHeap(MEMHeapHandle handle,
    }
 
    internal::HeapLock lock { virt_addrof(heap->header) };
+   auto &index = getFreeIndex(heap);
 
    // Find the block
    auto dataStart = virt_cast<uint8_t *>(mem);
    auto block = virt_cast<MEMExpHeapBlock *>(dataStart - sizeof(MEMExpHeapBlock));
+   decaf_check(index.containsUsed(getBlockAddress(block)));
 
    // Get the bounding region for this block
    auto memStart = getBlockMemStart(block);
@@ -470,9 +563,10 @@ MEMFreeToExpHeap(MEMHeapHandle handle,
 
    // Remove the block from the used list
    removeBlock(virt_addrof(heap->usedList), block);
+   index.removeUsed(getBlockAddress(block));
 
    // Release the memory back to the heap free list
-   releaseMemory(heap, memStart, memEnd);
+   releaseMemory(heap, index, memStart, memEnd);
 }
 
 MEMExpHeapMode
@@ -522,6 +616,10 @@ MEMAdjustExpHeap(MEMHeapHandle handle)
       lastFreeBlock->prev->next = nullptr;
    }
 
+   // This leaves the list's head and tail as they were, so rather than
+   // shadowing that the index is rebuilt from the guest lists.
+   eraseFreeIndex(heap);
+
    // Move the heaps end pointer to the true start point of this block
    heap->header.dataEnd = getBlockMemStart(lastFreeBlock);
 
@@ -537,6 +635,7 @@ MEMResizeForMBlockExpHeap(MEMHeapHandle handle,
 {
    auto heap = virt_cast<MEMExpHeap *>(handle);
    internal::HeapLock lock { virt_addrof(heap->header) };
+   auto &index = getFreeIndex(heap);
    size = align_up(size, 4);
 
    auto block = getUsedMemBlock(ptr);
@@ -549,23 +648,33 @@ MEMResizeForMBlockExpHeap(MEMHeapHandle handle,
          auto releasedMemStart = releasedMemEnd - releasedSpace;
 
          block->blockSize -= releasedSpace;
-         releaseMemory(heap, releasedMemStart, releasedMemEnd);
+         releaseMemory(heap, index, releasedMemStart, releasedMemEnd);
       }
    } else if (size > block->blockSize) {
       auto blockMemEnd = getBlockMemEnd(block);
       auto freeBlock = virt_ptr<MEMExpHeapBlock> { nullptr };
 
-      for (auto i = heap->freeList.head; i; i = i->next) {
-         auto freeBlockMemStart = getBlockMemStart(i);
+      if (index.isFreeListSorted()) {
+         // Free blocks have no alignment space, so the block following ours
+         // in memory starts exactly where our memory ends
+         auto blockMemEndAddress = static_cast<uint32_t>(virt_cast<virt_addr>(blockMemEnd));
 
-         if (freeBlockMemStart == blockMemEnd) {
-            freeBlock = i;
-            break;
+         if (index.containsFree(blockMemEndAddress)) {
+            freeBlock = getBlockFromAddress(blockMemEndAddress);
          }
+      } else {
+         for (auto i = heap->freeList.head; i; i = i->next) {
+            auto freeBlockMemStart = getBlockMemStart(i);
 
-         // Free list is sorted, so we only need to search a little bit
-         if (freeBlockMemStart > blockMemEnd) {
-            break;
+            if (freeBlockMemStart == blockMemEnd) {
+               freeBlock = i;
+               break;
+            }
+
+            // The guest stops here even though the list is not sorted
+            if (freeBlockMemStart > blockMemEnd) {
+               break;
+            }
          }
       }
 
@@ -579,7 +688,7 @@ MEMResizeForMBlockExpHeap(MEMHeapHandle handle,
       auto freeMemSize = static_cast<uint32_t>(freeBlockMemEnd - freeBlockMemStart);
 
       // Drop the free block from the list of free regions
-      removeBlock(virt_addrof(heap->freeList), freeBlock);
+      removeFreeBlock(heap, index, freeBlock);
 
       // Adjust the sizing of the free area and the block
       auto newAllocSize = (size - block->blockSize);
@@ -597,7 +706,7 @@ MEMResizeForMBlockExpHeap(MEMHeapHandle handle,
       //  the memory back to the heap.  Otherwise we just tack the remainder
       //  onto the end of the block we resized.
       if (freeMemSize >= sizeof(MEMExpHeapBlock) + 0x4) {
-         releaseMemory(heap, freeBlockMemEnd - freeMemSize, freeBlockMemEnd);
+         releaseMemory(heap, index, freeBlockMemEnd - freeMemSize, freeBlockMemEnd);
       } else {
          block->blockSize += freeMemSize;
       }
@@ -610,14 +719,8 @@ uint32_t
 MEMGetTotalFreeSizeForExpHeap(MEMHeapHandle handle)
 {
    auto heap = virt_cast<MEMExpHeap *>(handle);
-   auto freeSize = 0u;
    internal::HeapLock lock { virt_addrof(heap->header) };
-
-   for (auto block = heap->freeList.head; block; block = block->next) {
-      freeSize += block->blockSize;
-   }
-
-   return freeSize;
+   return getFreeIndex(heap).getTotalFreeSize();
 }
 
 uint32_t
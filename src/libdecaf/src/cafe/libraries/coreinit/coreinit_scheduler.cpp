@@ -13,21 +13,37 @@
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <libdecaf/decaf_config.h>
 #include <fmt/format.h>
 #include <iterator>
 #include <libcpu/cpu_formatters.h>
+#include <mutex>
 
 namespace cafe::coreinit
 {
 
+/*
+Each core has a run queue per priority level, a ready thread is appended to
+the queue for its priority on every core it has affinity for.  A bitmap of
+the non-empty queues lets us find the highest priority ready thread without
+walking any lists.  Appending keeps threads of equal priority in FIFO order,
+which matches the old sorted run queue.
+
+OSThread::coreRunQueueN records which queue the thread is in for core N so
+it can be removed even after its priority has changed.
+*/
+static constexpr auto NumRunQueuePriorities = 128u;
+
 struct StaticSchedulerData
 {
    struct PerCoreData
    {
       be2_val<bool> schedulerEnabled;
-      be2_struct<OSThreadQueue> runQueue;
+      be2_array<OSThreadQueue, NumRunQueuePriorities> runQueue;
+      std::array<uint64_t, NumRunQueuePriorities / 64> runQueueMask;
       be2_virt_ptr<OSThread> currentThread;
       std::chrono::time_point<std::chrono::high_resolution_clock> lastSwitchTime;
       std::chrono::time_point<std::chrono::high_resolution_clock> pauseTime;
@@ -41,13 +57,81 @@ struct StaticSchedulerData
 static virt_ptr<StaticSchedulerData>
 sSchedulerData = nullptr;
 
+//! Walk and validate every active thread on each reschedule
+static bool
+sValidateThreads = false;
+
+static std::chrono::steady_clock::time_point
+sSchedulerLockAcquireTime;
+
+static std::atomic<uint64_t>
+sSchedulerLockAcquisitions { 0 };
+
+static std::atomic<uint64_t>
+sSchedulerLockContentions { 0 };
+
+static std::atomic<uint64_t>
+sSchedulerLockWaitTimeNs { 0 };
+
+static std::atomic<uint64_t>
+sSchedulerLockHoldTimeNs { 0 };
+
+static std::atomic<uint64_t>
+sSchedulerLockMaxHoldTimeNs { 0 };
+
+static std::atomic<uint64_t>
+sContextSwitches { 0 };
+
 namespace internal
 {
 
 using ActiveQueue = Queue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::activeLink>;
-using CoreRunQueue0 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink0, ThreadIsLess>;
-using CoreRunQueue1 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink1, ThreadIsLess>;
-using CoreRunQueue2 = SortedQueue<OSThreadQueue, OSThreadLink, OSThread, &OSThread::coreRunQueueLink2, ThreadIsLess>;
+
+template<uint32_t CoreId,
+         be2_struct<OSThreadLink> OSThread::*LinkField,
+         be2_virt_ptr<OSThreadQueue> OSThread::*QueueField>
+struct CoreRunQueue
+{
+   using PriorityQueue = Queue<OSThreadQueue, OSThreadLink, OSThread, LinkField>;
+
+   static void
+   insert(virt_ptr<OSThread> thread)
+   {
+      auto &perCoreData = sSchedulerData->perCoreData[CoreId];
+      auto priority = static_cast<uint32_t>(thread->priority);
+      decaf_check(priority < NumRunQueuePriorities);
+      decaf_check(!(thread.get()->*QueueField));
+
+      auto queue = virt_addrof(perCoreData.runQueue[priority]);
+      PriorityQueue::append(queue, thread);
+      thread.get()->*QueueField = queue;
+      perCoreData.runQueueMask[priority / 64] |= (1ull << 63) >> (priority % 64);
+   }
+
+   static void
+   erase(virt_ptr<OSThread> thread)
+   {
+      auto queue = virt_ptr<OSThreadQueue> { thread.get()->*QueueField };
+      if (!queue) {
+         return;
+      }
+
+      PriorityQueue::erase(queue, thread);
+      thread.get()->*QueueField = nullptr;
+
+      if (!queue->head) {
+         auto &perCoreData = sSchedulerData->perCoreData[CoreId];
+         auto priority = static_cast<uint32_t>(
+            (virt_cast<virt_addr>(queue) - virt_cast<virt_addr>(virt_addrof(perCoreData.runQueue))) /
+            sizeof(OSThreadQueue));
+         perCoreData.runQueueMask[priority / 64] &= ~((1ull << 63) >> (priority % 64));
+      }
+   }
+};
+
+using CoreRunQueue0 = CoreRunQueue<0, &OSThread::coreRunQueueLink0, &OSThread::coreRunQueue0>;
+using CoreRunQueue1 = CoreRunQueue<1, &OSThread::coreRunQueueLink1, &OSThread::coreRunQueue1>;
+using CoreRunQueue2 = CoreRunQueue<2, &OSThread::coreRunQueueLink2, &OSThread::coreRunQueue2>;
 
 virt_ptr<OSThread>
 getCoreRunningThread(uint32_t coreId)
@@ -106,7 +190,24 @@ getCurrentThread()
 void
 lockScheduler()
 {
-   internal::acquireIdLockWithCoreId(sSchedulerData->schedulerLock);
+   auto &lock = sSchedulerData->schedulerLock;
+
+   if (UNLIKELY(internal::isLockHeldBySomeone(lock))) {
+      auto waitStart = std::chrono::steady_clock::now();
+      internal::acquireIdLockWithCoreId(lock);
+      sSchedulerLockAcquireTime = std::chrono::steady_clock::now();
+
+      auto waitTime = sSchedulerLockAcquireTime - waitStart;
+      sSchedulerLockContentions.fetch_add(1, std::memory_order_relaxed);
+      sSchedulerLockWaitTimeNs.fetch_add(
+         std::chrono::duration_cast<std::chrono::nanoseconds>(waitTime).count(),
+         std::memory_order_relaxed);
+   } else {
+      internal::acquireIdLockWithCoreId(lock);
+      sSchedulerLockAcquireTime = std::chrono::steady_clock::now();
+   }
+
+   sSchedulerLockAcquisitions.fetch_add(1, std::memory_order_relaxed);
 }
 
 bool
@@ -118,9 +219,32 @@ isSchedulerLocked()
 void
 unlockScheduler()
 {
+   // We still hold the lock, so nobody else can be touching the acquire time
+   auto holdTime = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - sSchedulerLockAcquireTime).count());
+   sSchedulerLockHoldTimeNs.fetch_add(holdTime, std::memory_order_relaxed);
+
+   if (holdTime > sSchedulerLockMaxHoldTimeNs.load(std::memory_order_relaxed)) {
+      sSchedulerLockMaxHoldTimeNs.store(holdTime, std::memory_order_relaxed);
+   }
+
    internal::releaseIdLockWithCoreId(sSchedulerData->schedulerLock);
 }
 
+SchedulerStats
+getSchedulerStats()
+{
+   auto stats = SchedulerStats { };
+   stats.lockAcquisitions = sSchedulerLockAcquisitions.load(std::memory_order_relaxed);
+   stats.lockContentions = sSchedulerLockContentions.load(std::memory_order_relaxed);
+   stats.lockWaitTimeNs = sSchedulerLockWaitTimeNs.load(std::memory_order_relaxed);
+   stats.lockHoldTimeNs = sSchedulerLockHoldTimeNs.load(std::memory_order_relaxed);
+   stats.lockMaxHoldTimeNs = sSchedulerLockMaxHoldTimeNs.load(std::memory_order_relaxed);
+   stats.contextSwitches = sContextSwitches.load(std::memory_order_relaxed);
+   return stats;
+}
+
 bool
 isSchedulerEnabled()
 {
@@ -148,7 +272,10 @@ markThreadActiveNoLock(virt_ptr<OSThread> thread)
    auto activeThreadQueue = virt_addrof(sSchedulerData->activeThreadQueue);
    decaf_check(!ActiveQueue::contains(activeThreadQueue, thread));
    ActiveQueue::append(activeThreadQueue, thread);
-   checkActiveThreadsNoLock();
+
+   if (sValidateThreads) {
+      checkActiveThreadsNoLock();
+   }
 }
 
 void
@@ -157,7 +284,10 @@ markThreadInactiveNoLock(virt_ptr<OSThread> thread)
    auto activeThreadQueue = virt_addrof(sSchedulerData->activeThreadQueue);
    decaf_check(ActiveQueue::contains(activeThreadQueue, thread));
    ActiveQueue::erase(activeThreadQueue, thread);
-   checkActiveThreadsNoLock();
+
+   if (sValidateThreads) {
+      checkActiveThreadsNoLock();
+   }
 }
 
 bool
@@ -180,24 +310,24 @@ queueThreadNoLock(virt_ptr<OSThread> thread)
 
    // Schedule this thread on any cores which can run it!
    if (thread->attr & OSThreadAttributes::AffinityCPU0) {
-      CoreRunQueue0::insert(virt_addrof(sSchedulerData->perCoreData[0].runQueue), thread);
+      CoreRunQueue0::insert(thread);
    }
 
    if (thread->attr & OSThreadAttributes::AffinityCPU1) {
-      CoreRunQueue1::insert(virt_addrof(sSchedulerData->perCoreData[1].runQueue), thread);
+      CoreRunQueue1::insert(thread);
    }
 
    if (thread->attr & OSThreadAttributes::AffinityCPU2) {
-      CoreRunQueue2::insert(virt_addrof(sSchedulerData->perCoreData[2].runQueue), thread);
+      CoreRunQueue2::insert(thread);
    }
 }
 
 static void
 unqueueThreadNoLock(virt_ptr<OSThread> thread)
 {
-   CoreRunQueue0::erase(virt_addrof(sSchedulerData->perCoreData[0].runQueue), thread);
-   CoreRunQueue1::erase(virt_addrof(sSchedulerData->perCoreData[1].runQueue), thread);
-   CoreRunQueue2::erase(virt_addrof(sSchedulerData->perCoreData[2].runQueue), thread);
+   CoreRunQueue0::erase(thread);
+   CoreRunQueue1::erase(thread);
+   CoreRunQueue2::erase(thread);
 }
 
 void
@@ -218,7 +348,16 @@ static virt_ptr<OSThread>
 peekNextThreadNoLock(uint32_t core)
 {
    decaf_check(isSchedulerLocked());
-   auto thread = sSchedulerData->perCoreData[core].runQueue.head;
+   auto &perCoreData = sSchedulerData->perCoreData[core];
+   auto thread = virt_ptr<OSThread> { nullptr };
+
+   for (auto i = 0u; i < perCoreData.runQueueMask.size(); ++i) {
+      if (perCoreData.runQueueMask[i]) {
+         auto priority = i * 64 + clz64(perCoreData.runQueueMask[i]);
+         thread = perCoreData.runQueue[priority].head;
+         break;
+      }
+   }
 
    if (thread) {
       decaf_check(thread->state == OSThreadState::Ready);
@@ -256,7 +395,10 @@ checkRunningThreadNoLock(bool yielding)
    decaf_check(isSchedulerLocked());
    auto coreId = cpu::this_core::id();
    auto &perCoreData = sSchedulerData->perCoreData[coreId];
-   checkActiveThreadsNoLock();
+
+   if (sValidateThreads) {
+      checkActiveThreadsNoLock();
+   }
 
    if (!perCoreData.schedulerEnabled) {
       return;
@@ -338,6 +480,7 @@ checkRunningThreadNoLock(bool yielding)
    // Switch thread
    perCoreData.currentThread = nextThread;
    perCoreData.lastSwitchTime = switchTime;
+   sContextSwitches.fetch_add(1, std::memory_order_relaxed);
 
    // Make sure interrupts are enabled
    auto prevState = coreinit::OSEnableInterrupts();
@@ -348,7 +491,10 @@ checkRunningThreadNoLock(bool yielding)
 
    // Restore interrupts to whatever state they were in
    coreinit::OSRestoreInterrupts(prevState);
-   checkActiveThreadsNoLock();
+
+   if (sValidateThreads) {
+      checkActiveThreadsNoLock();
+   }
 }
 
 void
@@ -634,6 +780,16 @@ promoteThreadPriorityNoLock(virt_ptr<OSThread> thread,
 void
 initialiseScheduler()
 {
+   static std::once_flag sRegisteredConfigChangeListener;
+   std::call_once(sRegisteredConfigChangeListener,
+      []() {
+         decaf::registerConfigChangeListener(
+            [](const decaf::Settings &settings) {
+               sValidateThreads = settings.debugger.validate_threads;
+            });
+      });
+   sValidateThreads = decaf::config()->debugger.validate_threads;
+
    OSInitThreadQueue(virt_addrof(sSchedulerData->activeThreadQueue));
 
    for (auto i = 0u; i < sSchedulerData->perCoreData.size(); ++i) {
@@ -641,7 +797,11 @@ initialiseScheduler()
       perCoreData.schedulerEnabled = true;
       perCoreData.currentThread = nullptr;
 
-      OSInitThreadQueue(virt_addrof(perCoreData.runQueue));
+      for (auto &runQueue : perCoreData.runQueue) {
+         OSInitThreadQueue(virt_addrof(runQueue));
+      }
+
+      perCoreData.runQueueMask.fill(0);
 
       perCoreData.lastSwitchTime = std::chrono::high_resolution_clock::now();
       perCoreData.pauseTime = std::chrono::time_point<std::chrono::high_resolution_clock>::max();
@@ -12,6 +12,27 @@ struct OSThreadSimpleQueue;
 namespace internal
 {
 
+struct SchedulerStats
+{
+   //! Number of times the scheduler lock was acquired.
+   uint64_t lockAcquisitions;
+
+   //! Number of acquisitions which found the lock already held.
+   uint64_t lockContentions;
+
+   //! Total time spent waiting for a contended lock.
+   uint64_t lockWaitTimeNs;
+
+   //! Total time the lock was held for.
+   uint64_t lockHoldTimeNs;
+
+   //! Longest time the lock was held for in one go.
+   uint64_t lockMaxHoldTimeNs;
+
+   //! Number of thread switches performed by the scheduler.
+   uint64_t contextSwitches;
+};
+
 virt_ptr<OSThread>
 getCoreRunningThread(uint32_t coreId);
 
@@ -36,6 +57,9 @@ isSchedulerLocked();
 void
 unlockScheduler();
 
+SchedulerStats
+getSchedulerStats();
+
 bool
 isSchedulerEnabled();
 
@@ -2,6 +2,7 @@
 #include "gx2_display.h"
 #include "gx2_event.h"
 #include "gx2_internal_pm4cap.h"
+#include "gx2_internal_pm4cap_writer.h"
 #include "gx2_cbpool.h"
 
 #include "cafe/libraries/coreinit/coreinit_memory.h"
@@ -12,8 +13,8 @@
 #include <common/log.h>
 #include <common/platform_dir.h>
 #include <common/murmur3.h>
+#include <algorithm>
 #include <fmt/core.h>
-#include <fstream>
 #include <gsl/gsl-lite.hpp>
 #include <libcpu/cpu_formatters.h>
 #include <libgpu/gpu7_tiling.h>
@@ -22,12 +23,13 @@
 #include <libgpu/latte/latte_pm4.h>
 #include <libgpu/latte/latte_pm4_commands.h>
 #include <libgpu/latte/latte_pm4_reader.h>
+#include <map>
 #include <mutex>
 #include <vector>
 
-using decaf::pm4::CaptureMagic;
-using decaf::pm4::CapturePacket;
 using decaf::pm4::CaptureMemoryLoad;
+using decaf::pm4::CaptureMemoryReference;
+using decaf::pm4::CapturePacket;
 using decaf::pm4::CaptureSetBuffer;
 using namespace latte;
 using namespace latte::pm4;
@@ -51,6 +53,15 @@ class Recorder
       uint64_t hash[2];
    };
 
+   //! The most recent memory loaded at an address, used to write keyframes.
+   struct LoadedMemory
+   {
+      CaptureMemoryLoad::MemoryType type;
+      uint32_t size;
+      uint64_t hash[2];
+      uint64_t sequence;
+   };
+
 public:
    Recorder()
    {
@@ -62,17 +73,14 @@ public:
    {
       decaf_check(mState == CaptureState::Disabled);
       std::unique_lock<std::mutex> lock { mMutex };
-      mOut.open(path, std::fstream::binary);
 
-      if (!mOut.is_open()) {
+      if (!mWriter.open(path)) {
          return false;
       }
 
-      // Write magic header
-      mOut.write(CaptureMagic.data(), CaptureMagic.size());
-
       // Set intial state
       mRecordedMemory.clear();
+      mLoadedMemory.clear();
       mState = CaptureState::WaitStartNextFrame;
 
       return true;
@@ -109,6 +117,8 @@ public:
       } else if (mState == CaptureState::WaitEndNextFrame) {
          stop();
          mCaptureNumFrames = 0;
+      } else if (mState == CaptureState::Enabled) {
+         writeKeyframe(static_cast<uint32_t>(mCapturedFrames));
       }
 
       ++mCapturedFrames;
@@ -132,8 +142,7 @@ public:
       CapturePacket packet;
       packet.type = CapturePacket::CommandBuffer;
       packet.size = numWords * 4;
-      writePacket(packet);
-      writeData(buffer.get(), packet.size);
+      writePacket(packet, buffer.get());
    }
 
    void
@@ -161,26 +170,50 @@ private:
    {
       decaf_check(mState == CaptureState::Disabled || mState == CaptureState::WaitStartNextFrame);
       mState = CaptureState::Enabled;
-      writeRegisterSnapshot();
-      writeDisplayInfo();
+      writeKeyframe(0);
    }
 
    void
    stop()
    {
       decaf_check(mState == CaptureState::Enabled || mState == CaptureState::WaitEndNextFrame);
-      mOut.close();
+      mWriter.close();
       mState = CaptureState::Disabled;
    }
 
+   void
+   writeKeyframe(uint32_t frame)
+   {
+      mWriter.beginKeyframe(frame, mPacketTimestamp);
+      writeRegisterSnapshot();
+      writeDisplayInfo();
+
+      // Reload all memory in the order it was originally loaded, so where
+      // loads overlap the most recent one wins
+      auto loads = std::vector<std::pair<phys_addr, const LoadedMemory *>> { };
+      for (auto &[address, load] : mLoadedMemory) {
+         loads.emplace_back(address, &load);
+      }
+
+      std::sort(loads.begin(), loads.end(),
+                [](const auto &lhs, const auto &rhs) {
+                   return lhs.second->sequence < rhs.second->sequence;
+                });
+
+      for (auto &[address, load] : loads) {
+         writeMemoryReference(load->type, address, load->size, load->hash);
+      }
+
+      mWriter.endKeyframe();
+   }
+
    void
    writeRegisterSnapshot()
    {
       CapturePacket packet;
       packet.type = CapturePacket::RegisterSnapshot;
       packet.size = static_cast<uint32_t>(mRegisters.size() * sizeof(uint32_t));
-      writePacket(packet);
-      writeData(mRegisters.data(), packet.size);
+      writePacket(packet, mRegisters.data());
    }
 
    void
@@ -188,11 +221,6 @@ private:
    {
       auto tvScanBuffer = getTvScanBuffer();
       if (tvScanBuffer->image) {
-         CapturePacket packet;
-         packet.type = CapturePacket::SetBuffer;
-         packet.size = sizeof(CaptureSetBuffer);
-         writePacket(packet);
-
          CaptureSetBuffer setBuffer;
          setBuffer.type = CaptureSetBuffer::TvBuffer;
          setBuffer.address = OSEffectiveToPhysical(virt_cast<virt_addr>(tvScanBuffer->image));
@@ -202,16 +230,15 @@ private:
          setBuffer.bufferingMode = GX2BufferingMode::Double;
          setBuffer.width = tvScanBuffer->width;
          setBuffer.height = tvScanBuffer->height;
-         writeData(&setBuffer, packet.size);
-      }
 
-      auto drcScanBuffer = getDrcScanBuffer();
-      if (drcScanBuffer->image) {
          CapturePacket packet;
          packet.type = CapturePacket::SetBuffer;
          packet.size = sizeof(CaptureSetBuffer);
-         writePacket(packet);
+         writePacket(packet, &setBuffer);
+      }
 
+      auto drcScanBuffer = getDrcScanBuffer();
+      if (drcScanBuffer->image) {
          CaptureSetBuffer setBuffer;
          setBuffer.type = CaptureSetBuffer::DrcBuffer;
          setBuffer.address = OSEffectiveToPhysical(virt_cast<virt_addr>(drcScanBuffer->image));
@@ -221,38 +248,58 @@ private:
          setBuffer.bufferingMode = GX2BufferingMode::Double;
          setBuffer.width = drcScanBuffer->width;
          setBuffer.height = drcScanBuffer->height;
-         writeData(&setBuffer, packet.size);
+
+         CapturePacket packet;
+         packet.type = CapturePacket::SetBuffer;
+         packet.size = sizeof(CaptureSetBuffer);
+         writePacket(packet, &setBuffer);
       }
    }
 
    void
-   writePacket(CapturePacket &packet)
+   writePacket(CapturePacket &packet,
+               const void *data)
    {
       packet.timestamp = mPacketTimestamp++;
-      mOut.write(reinterpret_cast<const char *>(&packet), sizeof(CapturePacket));
+      mWriter.writePacket(packet, data);
    }
 
    void
-   writeData(void *data, uint32_t size)
+   writeMemoryReference(CaptureMemoryLoad::MemoryType type,
+                        phys_addr address,
+                        uint32_t size,
+                        const uint64_t hash[2])
    {
-      mOut.write(reinterpret_cast<const char *>(data), size);
+      CaptureMemoryReference reference;
+      reference.type = type;
+      reference.address = address;
+      reference.size = size;
+      reference.hash[0] = hash[0];
+      reference.hash[1] = hash[1];
+
+      CapturePacket packet;
+      packet.type = CapturePacket::MemoryReference;
+      packet.size = sizeof(CaptureMemoryReference);
+      writePacket(packet, &reference);
    }
 
    void
    writeMemoryLoad(CaptureMemoryLoad::MemoryType type,
                    phys_addr address,
-                   uint32_t size)
+                   uint32_t size,
+                   const uint64_t hash[2])
    {
-      CaptureMemoryLoad load;
-      load.type = type;
-      load.address = address;
-
-      CapturePacket packet;
-      packet.type = CapturePacket::MemoryLoad;
-      packet.size = size + sizeof(CaptureMemoryLoad);
-      writePacket(packet);
-      writeData(&load, sizeof(CaptureMemoryLoad));
-      writeData(phys_cast<void *>(address).get(), size);
+      // The memory itself is only stored if we have not seen its contents
+      // before, at any address
+      mWriter.writeMemoryBlock(hash, phys_cast<void *>(address).get(), size);
+      writeMemoryReference(type, address, size, hash);
+
+      auto &loaded = mLoadedMemory[address];
+      loaded.type = type;
+      loaded.size = size;
+      loaded.hash[0] = hash[0];
+      loaded.hash[1] = hash[1];
+      loaded.sequence = mNextLoadSequence++;
    }
 
    void
@@ -837,7 +884,7 @@ private:
    {
       auto trackStart = addr;
       auto trackEnd = trackStart + size;
-      auto addNewEntry = true;
+      RecordedMemory *tracked = nullptr;
       uint64_t hash[2] = { 0, 0 };
       auto useHash = HashAllMemory || (HashShadowState && type == CaptureMemoryLoad::ShadowState);
 
@@ -845,49 +892,53 @@ private:
          return false;
       }
 
-      if (useHash) {
-         MurmurHash3_x64_128(phys_cast<void *>(addr).get(), size, 0, hash);
-      }
-
       for (auto &mem : mRecordedMemory) {
          if (trackStart < mem.start || trackStart > mem.end) {
             // Not in this block!
             continue;
          }
 
-         if (trackEnd <= mem.end) {
-            // Current memory is completely contained within an already tracked block
-            if (useHash) {
-               // If hash is enabled, then we do not write if hash matches
-               if (hash[0] == mem.hash[0] && hash[1] == mem.hash[1]) {
-                  return false;
-               }
-            } else if (type != CaptureMemoryLoad::CpuFlush) {
-               // If hash is disabled, and this is NOT a flush, then do not write memory
-               return false;
-            }
-         }
-
-         mem.end = trackEnd;
-         mem.hash[0] = hash[0];
-         mem.hash[1] = hash[1];
-         addNewEntry = false;
+         tracked = &mem;
          break;
       }
 
-      if (addNewEntry) {
+      auto contained = tracked && trackEnd <= tracked->end;
+      if (contained && !useHash && type != CaptureMemoryLoad::CpuFlush) {
+         // If hash is disabled, and this is NOT a flush, then do not write
+         // memory which is completely contained within an already tracked block
+         return false;
+      }
+
+      // Written memory is addressed by the hash of its contents, so from here
+      // on we always need it
+      MurmurHash3_x64_128(phys_cast<void *>(addr).get(), size, 0, hash);
+
+      if (contained && useHash) {
+         // If hash is enabled, then we do not write if hash matches
+         if (hash[0] == tracked->hash[0] && hash[1] == tracked->hash[1]) {
+            return false;
+         }
+      }
+
+      if (tracked) {
+         tracked->end = trackEnd;
+         tracked->hash[0] = hash[0];
+         tracked->hash[1] = hash[1];
+      } else {
          mRecordedMemory.emplace_back(RecordedMemory { trackStart, trackEnd, hash[0], hash[1] });
       }
 
-      writeMemoryLoad(type, addr, size);
+      writeMemoryLoad(type, addr, size, hash);
       return true;
    }
 
 private:
    CaptureState mState = CaptureState::Disabled;
    std::mutex mMutex;
-   std::ofstream mOut;
+   CaptureWriter mWriter;
    std::vector<RecordedMemory> mRecordedMemory;
+   std::map<phys_addr, LoadedMemory> mLoadedMemory;
+   uint64_t mNextLoadSequence = 0ull;
    std::array<uint32_t, 0x10000> mRegisters;
    size_t mCapturedFrames = 0;
    size_t mCaptureNumFrames = 0;
@@ -0,0 +1,289 @@
+#include "gx2_internal_pm4cap_writer.h"
+
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <common/platform_thread.h>
+#include <cstring>
+#include <zlib.h>
+
+using decaf::pm4::CaptureBlockIndex;
+using decaf::pm4::CaptureChunk;
+using decaf::pm4::CaptureFileHeader;
+using decaf::pm4::CaptureFileTrailer;
+using decaf::pm4::CaptureFrameIndex;
+using decaf::pm4::CaptureIndexHeader;
+using decaf::pm4::CaptureMemoryBlock;
+using decaf::pm4::CapturePacket;
+
+namespace cafe::gx2::internal
+{
+
+template<typename Type>
+static void
+appendData(std::vector<uint8_t> &buffer,
+           const Type *data,
+           size_t size = sizeof(Type))
+{
+   if (!size) {
+      return;
+   }
+
+   auto offset = buffer.size();
+   buffer.resize(offset + size);
+   std::memcpy(buffer.data() + offset, data, size);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+   close();
+}
+
+bool
+CaptureWriter::open(const std::string &path)
+{
+   decaf_check(!mThread.joinable());
+   mOut.open(path, std::fstream::binary);
+
+   if (!mOut.is_open()) {
+      return false;
+   }
+
+   auto header = CaptureFileHeader { };
+   header.magic = decaf::pm4::ChunkedCaptureMagic;
+   header.version = decaf::pm4::ChunkedCaptureVersion;
+   mOut.write(reinterpret_cast<const char *>(&header), sizeof(header));
+   mOutPosition = sizeof(header);
+
+   mPackets = PendingChunk { CaptureChunk::Packets };
+   mBlocks = PendingChunk { CaptureChunk::MemoryBlocks };
+   mWrittenBlocks.clear();
+   mFrameIndex.clear();
+   mBlockIndex.clear();
+   mClosing = false;
+
+   mThread = std::thread { [this]() { writerThread(); } };
+   platform::setThreadName(&mThread, "PM4 Capture Writer");
+   return true;
+}
+
+void
+CaptureWriter::close()
+{
+   if (!mThread.joinable()) {
+      return;
+   }
+
+   submitPackets();
+
+   {
+      std::unique_lock<std::mutex> lock { mQueueMutex };
+      mClosing = true;
+   }
+
+   mQueueCondition.notify_all();
+   mThread.join();
+   mOut.close();
+   mWrittenBlocks.clear();
+}
+
+void
+CaptureWriter::beginKeyframe(uint32_t frame,
+                             uint64_t timestamp)
+{
+   submitPackets();
+   mPackets.type = CaptureChunk::Keyframe;
+   mPackets.frame = frame;
+   mPackets.timestamp = timestamp;
+}
+
+void
+CaptureWriter::endKeyframe()
+{
+   decaf_check(mPackets.type == CaptureChunk::Keyframe);
+   submitPackets();
+}
+
+void
+CaptureWriter::writePacket(const CapturePacket &packet,
+                           const void *data)
+{
+   appendData(mPackets.data, &packet);
+   appendData(mPackets.data, reinterpret_cast<const uint8_t *>(data), packet.size);
+
+   // Keyframes must stay in a single chunk
+   if (mPackets.type == CaptureChunk::Packets &&
+       mPackets.data.size() >= MaxPacketChunkSize) {
+      submitPackets();
+   }
+}
+
+void
+CaptureWriter::writeMemoryBlock(const uint64_t hash[2],
+                                const void *data,
+                                uint32_t size)
+{
+   if (!mWrittenBlocks.insert(BlockKey { { hash[0], hash[1] }, size }).second) {
+      return;
+   }
+
+   if (!mBlocks.data.empty() &&
+       mBlocks.data.size() + sizeof(CaptureMemoryBlock) + size > MaxBlockChunkSize) {
+      submitBlocks();
+   }
+
+   auto header = CaptureMemoryBlock { };
+   header.hash[0] = hash[0];
+   header.hash[1] = hash[1];
+   header.size = size;
+   appendData(mBlocks.data, &header);
+
+   auto index = CaptureBlockIndex { };
+   index.hash[0] = hash[0];
+   index.hash[1] = hash[1];
+   index.size = size;
+   index.chunkOffset = 0;
+   index.dataOffset = static_cast<uint32_t>(mBlocks.data.size());
+   mBlocks.blocks.push_back(index);
+
+   appendData(mBlocks.data, reinterpret_cast<const uint8_t *>(data), size);
+}
+
+void
+CaptureWriter::submitPackets()
+{
+   // Blocks go first so a reader streaming the file has always seen the
+   // blocks a packet refers to
+   submitBlocks();
+
+   if (mPackets.type == CaptureChunk::Keyframe || !mPackets.data.empty()) {
+      submit(std::move(mPackets));
+   }
+
+   mPackets = PendingChunk { CaptureChunk::Packets };
+}
+
+void
+CaptureWriter::submitBlocks()
+{
+   if (!mBlocks.data.empty()) {
+      submit(std::move(mBlocks));
+   }
+
+   mBlocks = PendingChunk { CaptureChunk::MemoryBlocks };
+}
+
+void
+CaptureWriter::submit(PendingChunk &&chunk)
+{
+   std::unique_lock<std::mutex> lock { mQueueMutex };
+
+   mQueueCondition.wait(lock, [this]() {
+      return mQueue.empty() || mQueuedBytes < MaxQueuedBytes;
+   });
+
+   mQueuedBytes += chunk.data.size();
+   mQueue.emplace_back(std::move(chunk));
+   mQueueCondition.notify_all();
+}
+
+void
+CaptureWriter::writerThread()
+{
+   while (true) {
+      auto chunk = PendingChunk { };
+
+      {
+         std::unique_lock<std::mutex> lock { mQueueMutex };
+         mQueueCondition.wait(lock, [this]() {
+            return mClosing || !mQueue.empty();
+         });
+
+         if (mQueue.empty()) {
+            break;
+         }
+
+         chunk = std::move(mQueue.front());
+         mQueue.pop_front();
+      }
+
+      writeChunk(chunk);
+
+      {
+         std::unique_lock<std::mutex> lock { mQueueMutex };
+         mQueuedBytes -= chunk.data.size();
+      }
+
+      mQueueCondition.notify_all();
+   }
+
+   writeIndex();
+}
+
+void
+CaptureWriter::writeChunk(PendingChunk &chunk)
+{
+   auto header = CaptureChunk { };
+   header.type = chunk.type;
+   header.compression = CaptureChunk::None;
+   header.uncompressedSize = static_cast<uint32_t>(chunk.data.size());
+   header.compressedSize = header.uncompressedSize;
+   header.frame = chunk.frame;
+
+   auto data = chunk.data.data();
+
+   if (!chunk.data.empty()) {
+      auto compressedSize = compressBound(static_cast<uLong>(chunk.data.size()));
+      mCompressBuffer.resize(compressedSize);
+
+      auto result = compress2(mCompressBuffer.data(), &compressedSize,
+                              chunk.data.data(),
+                              static_cast<uLong>(chunk.data.size()),
+                              Z_BEST_SPEED);
+
+      if (result == Z_OK && compressedSize < chunk.data.size()) {
+         header.compression = CaptureChunk::Zlib;
+         header.compressedSize = static_cast<uint32_t>(compressedSize);
+         data = mCompressBuffer.data();
+      } else if (result != Z_OK) {
+         gLog->warn("pm4 capture failed to compress chunk, zlib error {}", result);
+      }
+   }
+
+   auto chunkOffset = mOutPosition;
+   if (chunk.type == CaptureChunk::Keyframe) {
+      mFrameIndex.push_back(CaptureFrameIndex { chunkOffset, chunk.timestamp });
+   }
+
+   for (auto &block : chunk.blocks) {
+      block.chunkOffset = chunkOffset;
+      mBlockIndex.push_back(block);
+   }
+
+   mOut.write(reinterpret_cast<const char *>(&header), sizeof(header));
+   mOut.write(reinterpret_cast<const char *>(data), header.compressedSize);
+   mOutPosition += sizeof(header) + header.compressedSize;
+}
+
+void
+CaptureWriter::writeIndex()
+{
+   auto index = PendingChunk { CaptureChunk::Index };
+   auto header = CaptureIndexHeader { };
+   header.numFrames = static_cast<uint32_t>(mFrameIndex.size());
+   header.numBlocks = static_cast<uint32_t>(mBlockIndex.size());
+   appendData(index.data, &header);
+   appendData(index.data, mFrameIndex.data(),
+              mFrameIndex.size() * sizeof(CaptureFrameIndex));
+   appendData(index.data, mBlockIndex.data(),
+              mBlockIndex.size() * sizeof(CaptureBlockIndex));
+
+   auto trailer = CaptureFileTrailer { };
+   trailer.indexOffset = mOutPosition;
+   trailer.magic = decaf::pm4::ChunkedCaptureMagic;
+
+   writeChunk(index);
+   mOut.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+   mOutPosition += sizeof(trailer);
+}
+
+} // namespace cafe::gx2::internal
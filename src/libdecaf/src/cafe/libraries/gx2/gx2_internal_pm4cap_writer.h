@@ -0,0 +1,141 @@
+#pragma once
+#include "decaf_pm4replay.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace cafe::gx2::internal
+{
+
+/**
+ * Writes a chunked pm4 capture, see decaf_pm4replay.h for the format.
+ *
+ * Data is buffered into chunks on the calling thread, chunks are then
+ * compressed and written to disk on a background thread so capturing does
+ * not stall the GX2 flush path.
+ */
+class CaptureWriter
+{
+   //! Packet chunks are submitted once they reach this size.
+   static constexpr size_t MaxPacketChunkSize = 1 * 1024 * 1024;
+
+   //! Memory block chunks are submitted once they reach this size.
+   static constexpr size_t MaxBlockChunkSize = 4 * 1024 * 1024;
+
+   //! Maximum amount of uncompressed data queued for the writer thread
+   //! before submitting a chunk waits for it to catch up.
+   static constexpr size_t MaxQueuedBytes = 256 * 1024 * 1024;
+
+   struct BlockKey
+   {
+      uint64_t hash[2];
+      uint32_t size;
+
+      bool operator ==(const BlockKey &other) const
+      {
+         return hash[0] == other.hash[0] &&
+                hash[1] == other.hash[1] &&
+                size == other.size;
+      }
+   };
+
+   struct BlockKeyHash
+   {
+      size_t operator()(const BlockKey &key) const
+      {
+         return static_cast<size_t>(key.hash[0] ^ key.hash[1]);
+      }
+   };
+
+   struct PendingChunk
+   {
+      decaf::pm4::CaptureChunk::Type type;
+      uint32_t frame;
+      uint64_t timestamp;
+      std::vector<uint8_t> data;
+
+      //! Location of each block within a MemoryBlocks chunk.
+      std::vector<decaf::pm4::CaptureBlockIndex> blocks;
+   };
+
+public:
+   ~CaptureWriter();
+
+   bool
+   open(const std::string &path);
+
+   void
+   close();
+
+   /**
+    * Start a new frame, everything written until endKeyframe goes into the
+    * frame's keyframe chunk.
+    */
+   void
+   beginKeyframe(uint32_t frame,
+                 uint64_t timestamp);
+
+   void
+   endKeyframe();
+
+   void
+   writePacket(const decaf::pm4::CapturePacket &packet,
+               const void *data);
+
+   /**
+    * Store a block of memory unless a block with the same contents has
+    * already been stored.
+    */
+   void
+   writeMemoryBlock(const uint64_t hash[2],
+                    const void *data,
+                    uint32_t size);
+
+private:
+   void
+   submitPackets();
+
+   void
+   submitBlocks();
+
+   void
+   submit(PendingChunk &&chunk);
+
+   void
+   writerThread();
+
+   void
+   writeChunk(PendingChunk &chunk);
+
+   void
+   writeIndex();
+
+private:
+   std::ofstream mOut;
+   uint64_t mOutPosition = 0;
+
+   PendingChunk mPackets;
+   PendingChunk mBlocks;
+   std::unordered_set<BlockKey, BlockKeyHash> mWrittenBlocks;
+
+   std::thread mThread;
+   std::mutex mQueueMutex;
+   std::condition_variable mQueueCondition;
+   std::deque<PendingChunk> mQueue;
+   size_t mQueuedBytes = 0;
+   bool mClosing = false;
+
+   // Only accessed by the writer thread
+   std::vector<decaf::pm4::CaptureFrameIndex> mFrameIndex;
+   std::vector<decaf::pm4::CaptureBlockIndex> mBlockIndex;
+   std::vector<uint8_t> mCompressBuffer;
+};
+
+} // namespace cafe::gx2::internal
@@ -2,14 +2,20 @@
 #include "sndcore2_config.h"
 #include "sndcore2_constants.h"
 #include "sndcore2_device.h"
+#include "sndcore2_mix.h"
 #include "sndcore2_voice.h"
+#include "decaf_config.h"
+#include "decaf_configstorage.h"
 #include "decaf_sound.h"
 
 #include "cafe/cafe_ppc_interface_invoke_guest.h"
 
 #include <array>
 #include <common/fixed.h>
+#include <common/workerpool.h>
 #include <libcpu/mmu.h>
+#include <memory>
+#include <mutex>
 
 namespace cafe::sndcore2
 {
@@ -17,6 +23,17 @@ namespace cafe::sndcore2
 constexpr auto NumOutputSamples = 48000 * 3 / 1000;
 constexpr auto DefaultVolume = ufixed_1_15_t { 1.0 };
 
+// Voice decoding is only split across the worker pool when there are at
+// least this many voices per thread, below that it is not worth the
+// synchronisation.
+constexpr auto MinVoicesPerDecodeThread = 8u;
+
+// Largest number of source samples we will decode up front for a voice in
+// one frame, voices with a higher SRC ratio use the reference decoder.
+constexpr auto MaxBlockSourceSamples = 1024u;
+
+static_assert(sizeof(Pcm16Sample) == sizeof(int16_t));
+
 struct AuxData
 {
    AXAuxCallback callback;
@@ -58,6 +75,22 @@ sDeviceData = nullptr;
 namespace internal
 {
 
+static AudioFrameTimings
+sAudioFrameTimings;
+
+//! Time spent in guest callbacks during the current frame's mix.
+static std::chrono::nanoseconds
+sFrameCallbackTime;
+
+static std::atomic<unsigned int>
+sNumDecodeThreads { 0 };
+
+static std::unique_ptr<WorkerPool>
+sDecodeWorkerPool;
+
+static unsigned int
+sDecodeWorkerPoolThreads = 0;
+
 static DeviceData *
 getDevice(AXDeviceType type,
           uint32_t deviceId)
@@ -116,9 +149,17 @@ struct AudioDecoder
    }
 
    AudioDecoder& advance()
+   {
+      return advance(read());
+   }
+
+   /**
+    * Advance to the next sample, where sample is the result of read() at the
+    * current position.
+    */
+   AudioDecoder& advance(Pcm16Sample sample)
    {
       // Update prev sample
-      auto sample = read();
       adpcm.prevSample[1] = adpcm.prevSample[0];
       adpcm.prevSample[0] = fixed_to_data(sample);
 
@@ -164,6 +205,30 @@ struct AudioDecoder
       return isEof;
    }
 
+   /**
+    * Decode up to count samples starting at the current position, leaving
+    * the decoder positioned at the last decoded sample.
+    *
+    * Returns the number of samples decoded, which is less than count if we
+    * reached the end of a non-looping voice, in which case the decoder is
+    * left in the end of file state.
+    */
+   uint32_t decodeBlock(Pcm16Sample *out,
+                        uint32_t count)
+   {
+      auto numDecoded = 0u;
+
+      while (numDecoded < count && !isEof) {
+         out[numDecoded] = read();
+
+         if (++numDecoded < count) {
+            advance(out[numDecoded - 1]);
+         }
+      }
+
+      return numDecoded;
+   }
+
    Pcm16Sample read()
    {
       decaf_check(!isEof);
@@ -214,10 +279,14 @@ struct AudioDecoder
    }
 };
 
+/**
+ * Resample one frame of a voice, decoding the current and next source sample
+ * again for every output sample.
+ */
 void
-sampleVoice(virt_ptr<AXVoice> voice,
-            Pcm16Sample *samples,
-            int numSamples)
+sampleVoiceReference(virt_ptr<AXVoice> voice,
+                     Pcm16Sample *samples,
+                     int numSamples)
 {
    static const auto FpOne = ufixed_16_16_t(1);
    static const auto FpZero = ufixed_16_16_t(0);
@@ -295,6 +364,115 @@ sampleVoice(virt_ptr<AXVoice> voice,
    extras->src.currentOffsetFrac = ufixed_0_16_t { offsetFrac };
 }
 
+/**
+ * Equivalent to sampleVoiceReference, but decodes all of the source samples
+ * needed for this frame in one go rather than re-decoding the current and
+ * next sample for every output sample.
+ */
+void
+sampleVoice(virt_ptr<AXVoice> voice,
+            Pcm16Sample *samples,
+            int numSamples)
+{
+   static const auto FpOne = ufixed_16_16_t(1);
+   static const auto FpZero = ufixed_16_16_t(0);
+
+   auto extras = getVoiceExtras(voice->index);
+   auto offsetFrac = ufixed_16_16_t(extras->src.currentOffsetFrac.value());
+   auto ratio = extras->src.ratio.value();
+
+   // The number of times the source position advances this frame
+   auto numAdvances =
+      (static_cast<uint64_t>(fixed_to_data(offsetFrac)) +
+       static_cast<uint64_t>(fixed_to_data(ratio)) * numSamples) >> 16;
+
+   if (getMixerKernel() == MixerKernel::Reference ||
+       numAdvances + 2 > MaxBlockSourceSamples) {
+      return sampleVoiceReference(voice, samples, numSamples);
+   }
+
+   memset(samples, 0, numSamples * sizeof(Pcm16Sample));
+
+   // Decode the source samples up front, plus one more for interpolation
+   Pcm16Sample source[MaxBlockSourceSamples];
+   AudioDecoder decoder;
+   decoder.fromVoice(extras);
+
+   auto numSource = decoder.decodeBlock(source, static_cast<uint32_t>(numAdvances + 1));
+
+   if (!decoder.eof()) {
+      AudioDecoder nextDecoder(decoder);
+      nextDecoder.advance(source[numSource - 1]);
+
+      if (!nextDecoder.eof()) {
+         source[numSource++] = nextDecoder.read();
+      }
+   }
+
+   int16_t lastSample[4] = {
+      extras->src.lastSample[0],
+      extras->src.lastSample[1],
+      extras->src.lastSample[2],
+      extras->src.lastSample[3],
+   };
+
+   auto position = 0u;
+
+   for (auto i = 0; i < numSamples; ++i) {
+      Pcm16Sample sample;
+      if (offsetFrac == FpZero) {
+         sample = source[position];
+         samples[i] = sample;
+      } else {
+         if (position + 1 < numSource) {
+            sample = source[position + 1];
+         } else {
+            sample = 0;
+         }
+
+         auto thisSampleMul = FpOne - offsetFrac;
+         auto lastSampleMul = offsetFrac;
+         samples[i] = sample * thisSampleMul + fixed_from_data<Pcm16Sample>(lastSample[0]) * lastSampleMul;
+      }
+
+      offsetFrac += ratio;
+
+      while (offsetFrac >= FpOne) {
+         offsetFrac -= FpOne;
+         position++;
+
+         lastSample[3] = lastSample[2];
+         lastSample[2] = lastSample[1];
+         lastSample[1] = lastSample[0];
+         lastSample[0] = fixed_to_data(sample);
+
+         if (position >= numSource) {
+            break;
+         }
+
+         if (offsetFrac >= FpOne) {
+            sample = source[position];
+         }
+      }
+
+      if (position >= numSource) {
+         break;
+      }
+   }
+
+   for (auto i = 0; i < 4; ++i) {
+      extras->src.lastSample[i] = lastSample[i];
+   }
+
+   if (decoder.eof()) {
+      voice->state = AXVoiceState::Stopped;
+   }
+
+   decoder.toVoice(extras);
+
+   extras->src.currentOffsetFrac = ufixed_0_16_t { offsetFrac };
+}
+
 void applyADSR(virt_ptr<AXVoice> voice,
                Pcm16Sample *samples,
                int numSamples)
@@ -308,22 +486,78 @@ void applyADSR(virt_ptr<AXVoice> voice,
    extras->ve.volume += extras->ve.delta.value() * numSamples;
 }
 
+static void
+decodeVoice(virt_ptr<AXVoice> voice,
+            int numSamples)
+{
+   auto extras = getVoiceExtras(voice->index);
+
+   if (voice->state == AXVoiceState::Stopped) {
+      extras->numSamples = 0;
+      return;
+   }
+
+   extras->numSamples = numSamples;
+   sampleVoice(voice, extras->samples, numSamples);
+   applyADSR(voice, extras->samples, numSamples);
+}
+
+/**
+ * Returns the worker pool used for decoding voices, or nullptr when voices
+ * should only be decoded on the audio thread.
+ *
+ * This is only called from the audio thread so needs no locking, the pool
+ * is recreated if the number of decode threads has changed.
+ */
+static WorkerPool *
+getDecodeWorkerPool()
+{
+   auto numThreads = sNumDecodeThreads.load();
+   if (!numThreads) {
+      numThreads = static_cast<unsigned int>(
+         std::min<size_t>(WorkerPool::getDefaultNumThreads() + 1, 4));
+   }
+
+   if (numThreads != sDecodeWorkerPoolThreads) {
+      sDecodeWorkerPool.reset();
+      sDecodeWorkerPoolThreads = numThreads;
+
+      if (numThreads > 1) {
+         sDecodeWorkerPool = std::make_unique<WorkerPool>(numThreads - 1, "Audio Decode");
+      }
+   }
+
+   return sDecodeWorkerPool.get();
+}
+
 void
 decodeVoiceSamples(int numSamples)
 {
    const auto voices = getAcquiredVoices();
+   auto pool = getDecodeWorkerPool();
+   auto numChunks = size_t { 1 };
 
-   for (auto voice : voices) {
-      auto extras = getVoiceExtras(voice->index);
+   if (pool) {
+      numChunks = std::min(pool->getNumThreads() + 1,
+                           voices.size() / MinVoicesPerDecodeThread);
+   }
 
-      if (voice->state == AXVoiceState::Stopped) {
-         extras->numSamples = 0;
-         continue;
+   if (numChunks <= 1) {
+      for (auto voice : voices) {
+         decodeVoice(voice, numSamples);
       }
-
-      extras->numSamples = numSamples;
-      sampleVoice(voice, extras->samples, numSamples);
-      applyADSR(voice, extras->samples, numSamples);
+   } else {
+      // Each voice only touches its own state, so the result is the same
+      // regardless of which thread decodes it.
+      pool->parallelFor(numChunks,
+         [&](size_t chunk) {
+            auto begin = voices.size() * chunk / numChunks;
+            auto end = voices.size() * (chunk + 1) / numChunks;
+
+            for (auto i = begin; i < end; ++i) {
+               decodeVoice(voices[i], numSamples);
+            }
+         });
    }
 
    // TODO: Apply Volume Evelope (ADSR)
@@ -339,6 +573,7 @@ static void
 invokeAuxCallback(AuxData &aux, uint32_t numChannels, uint32_t numSamples, Pcm16Sample samples[6][144])
 {
    if (aux.callback) {
+      auto start = std::chrono::high_resolution_clock::now();
       auto auxCbData = virt_addrof(sDeviceData->auxCallbackData);
       auxCbData->samples = numSamples;
       auxCbData->channels = numChannels;
@@ -363,6 +598,8 @@ invokeAuxCallback(AuxData &aux, uint32_t numChannels, uint32_t numSamples, Pcm16
                static_cast<int16_t>(sDeviceData->samples[ch][i]));
          }
       }
+
+      sFrameCallbackTime += std::chrono::high_resolution_clock::now() - start;
    }
 }
 
@@ -374,6 +611,7 @@ invokeFinalMixCallback(DeviceTypeData &device,
                        Pcm16Sample samples[4][6][144])
 {
    if (device.finalMixCallback) {
+      auto start = std::chrono::high_resolution_clock::now();
       auto mixCbData = virt_addrof(sDeviceData->finalMixCallbackData);
       mixCbData->channels = numChannels;
       mixCbData->samples = numSamples;
@@ -408,6 +646,8 @@ invokeFinalMixCallback(DeviceTypeData &device,
             }
          }
       }
+
+      sFrameCallbackTime += std::chrono::high_resolution_clock::now() - start;
    }
 }
 
@@ -477,27 +717,60 @@ getDeviceNumChannels(AXDeviceType type)
    return channels[type];
 }
 
+static constexpr auto AXMaxDevices = 4;
+static constexpr auto AXMaxBuses = 4;
+static constexpr auto AXMaxChannels = 6;
+
+using BusSamples = Pcm16Sample[AXMaxBuses][AXMaxDevices][AXMaxChannels][NumOutputSamples];
+
 static void
-mixDevice(AXDeviceType type, uint16_t numSamples)
+mixVoicesReference(AXDeviceType type,
+                   uint16_t numDevices,
+                   uint16_t numBus,
+                   uint16_t numChannels,
+                   uint16_t numSamples,
+                   BusSamples &busSamples)
 {
-   static const auto AXMaxDevices = 4;
-   static const auto AXMaxBuses = 4;
-   static const auto AXMaxChannels = 6;
+   const auto voices = getAcquiredVoices();
 
-   auto devices = getDeviceGroup(type);
-   auto numDevices = getDeviceNumDevices(type);
-   auto numBus = getDeviceNumBuses(type);
-   auto numChannels = getDeviceNumChannels(type);
+   for (auto voice : voices) {
+      auto extras = getVoiceExtras(voice->index);
 
-   decaf_check(numDevices <= AXMaxDevices);
-   decaf_check(numBus <= AXMaxBuses);
-   decaf_check(numChannels <= AXMaxChannels);
-   decaf_check(numSamples == 96 || numSamples == 144);
+      if (!extras->numSamples) {
+         continue;
+      }
+
+      decaf_check(extras->numSamples == numSamples);
 
-   Pcm16Sample busSamples[AXMaxBuses][AXMaxDevices][AXMaxChannels][NumOutputSamples];
+      for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
+         for (auto bus = 0u; bus < numBus; ++bus) {
+            for (auto channel = 0u; channel < numChannels; ++channel) {
+               auto &volume = getVoiceMixVolume(extras, type, deviceId, channel, bus);
+               mixSamplesReference(busSamples[bus][deviceId][channel],
+                                   extras->samples, volume.volume, numSamples);
+               volume.volume += volume.delta;
+            }
+         }
+      }
+   }
+}
+
+/**
+ * Mix all voices into a 32 bit accumulator per bus channel, so that we
+ * only have to clamp back down to 16 bit once all voices are mixed.
+ */
+static void
+mixVoicesVector(AXDeviceType type,
+                uint16_t numDevices,
+                uint16_t numBus,
+                uint16_t numChannels,
+                uint16_t numSamples,
+                BusSamples &busSamples)
+{
+   alignas(16) static int32_t accumulator[AXMaxBuses][AXMaxDevices][AXMaxChannels][NumOutputSamples];
    const auto voices = getAcquiredVoices();
 
-   memset(busSamples, 0, sizeof(Pcm16Sample) * AXMaxBuses * AXMaxDevices * AXMaxChannels * NumOutputSamples);
+   memset(accumulator, 0, sizeof(accumulator));
 
    for (auto voice : voices) {
       auto extras = getVoiceExtras(voice->index);
@@ -507,23 +780,81 @@ mixDevice(AXDeviceType type, uint16_t numSamples)
       }
 
       decaf_check(extras->numSamples == numSamples);
+      auto samples = reinterpret_cast<const int16_t *>(extras->samples);
 
       for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
          for (auto bus = 0u; bus < numBus; ++bus) {
             for (auto channel = 0u; channel < numChannels; ++channel) {
                auto &volume = getVoiceMixVolume(extras, type, deviceId, channel, bus);
-               auto &out = busSamples[bus][deviceId][channel];
-
-               for (auto i = 0u; i < numSamples; ++i) {
-                  out[i] += extras->samples[i] * volume.volume;
-               }
-
+               accumulateSamples(accumulator[bus][deviceId][channel], samples,
+                                 fixed_to_data(volume.volume), numSamples);
                volume.volume += volume.delta;
             }
          }
       }
    }
 
+   for (auto bus = 0u; bus < numBus; ++bus) {
+      for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
+         for (auto channel = 0u; channel < numChannels; ++channel) {
+            packSamples(reinterpret_cast<int16_t *>(busSamples[bus][deviceId][channel]),
+                        accumulator[bus][deviceId][channel], numSamples);
+         }
+      }
+   }
+}
+
+static void
+mixAuxReturn(Pcm16Sample *out,
+             Pcm16Sample *samples,
+             ufixed_1_15_t returnVolume,
+             uint16_t numSamples)
+{
+   if (getMixerKernel() == MixerKernel::Reference) {
+      mixSamplesReference(out, samples, returnVolume, numSamples);
+   } else {
+      alignas(16) int32_t accumulator[NumOutputSamples];
+      unpackSamples(accumulator, reinterpret_cast<int16_t *>(out), numSamples);
+      accumulateSamples(accumulator, reinterpret_cast<int16_t *>(samples),
+                        fixed_to_data(returnVolume), numSamples);
+      packSamples(reinterpret_cast<int16_t *>(out), accumulator, numSamples);
+   }
+}
+
+static void
+applyDeviceVolume(Pcm16Sample *samples,
+                  ufixed_1_15_t volume,
+                  uint16_t numSamples)
+{
+   if (getMixerKernel() == MixerKernel::Reference) {
+      scaleSamplesReference(samples, volume, numSamples);
+   } else {
+      scaleSamples(reinterpret_cast<int16_t *>(samples), fixed_to_data(volume), numSamples);
+   }
+}
+
+static void
+mixDevice(AXDeviceType type, uint16_t numSamples)
+{
+   auto devices = getDeviceGroup(type);
+   auto numDevices = getDeviceNumDevices(type);
+   auto numBus = getDeviceNumBuses(type);
+   auto numChannels = getDeviceNumChannels(type);
+
+   decaf_check(numDevices <= AXMaxDevices);
+   decaf_check(numBus <= AXMaxBuses);
+   decaf_check(numChannels <= AXMaxChannels);
+   decaf_check(numSamples == 96 || numSamples == 144);
+
+   BusSamples busSamples;
+   memset(busSamples, 0, sizeof(busSamples));
+
+   if (getMixerKernel() == MixerKernel::Reference) {
+      mixVoicesReference(type, numDevices, numBus, numChannels, numSamples, busSamples);
+   } else {
+      mixVoicesVector(type, numDevices, numBus, numChannels, numSamples, busSamples);
+   }
+
    for (auto deviceId = 0u; deviceId < numDevices; ++deviceId) {
       auto &device = devices->devices[deviceId];
 
@@ -543,9 +874,8 @@ mixDevice(AXDeviceType type, uint16_t numSamples)
          auto subBus = busSamples[bus];
 
          for (auto channel = 0u; channel < numChannels; ++channel) {
-            for (auto i = 0u; i < numSamples; ++i) {
-               mainBus[deviceId][channel][i] += subBus[deviceId][channel][i] * returnVolume;
-            }
+            mixAuxReturn(mainBus[deviceId][channel], subBus[deviceId][channel],
+                         returnVolume, numSamples);
          }
       }
    }
@@ -555,9 +885,7 @@ mixDevice(AXDeviceType type, uint16_t numSamples)
       auto &device = devices->devices[deviceId];
 
       for (auto channel = 0u; channel < numChannels; ++channel) {
-         for (auto i = 0u; i < numSamples; ++i) {
-            mainBus[deviceId][channel][i] = mainBus[deviceId][channel][i] * device.volume;
-         }
+         applyDeviceVolume(mainBus[deviceId][channel], device.volume, numSamples);
       }
    }
 
@@ -623,12 +951,20 @@ mixOutput(int32_t* buffer,
           uint16_t numChannels)
 {
    // Decode audio samples from the source voices
+   auto decodeStart = std::chrono::high_resolution_clock::now();
    decodeVoiceSamples(numSamples);
 
    // Mix all the devices
+   auto mixStart = std::chrono::high_resolution_clock::now();
+   sFrameCallbackTime = std::chrono::nanoseconds { 0 };
    mixDevice(AXDeviceType::TV, numSamples);
    mixDevice(AXDeviceType::DRC, numSamples);
    mixDevice(AXDeviceType::RMT, numSamples);
+   auto mixEnd = std::chrono::high_resolution_clock::now();
+
+   sAudioFrameTimings.decode.record(mixStart - decodeStart);
+   sAudioFrameTimings.mix.record(mixEnd - mixStart - sFrameCallbackTime);
+   sAudioFrameTimings.auxCallbacks.record(sFrameCallbackTime);
 
    // Send off the TV device 0 data to be played on host
    for (auto i = 0; i < NumOutputSamples; ++i) {
@@ -638,6 +974,33 @@ mixOutput(int32_t* buffer,
    }
 }
 
+void
+AudioTimingHistogram::record(std::chrono::nanoseconds duration)
+{
+   auto ns = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+   auto us = ns / 1000;
+   auto bucket = 0u;
+
+   while (us > 1 && bucket + 1 < NumAudioTimingBuckets) {
+      us >>= 1;
+      ++bucket;
+   }
+
+   buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+   count.fetch_add(1, std::memory_order_relaxed);
+   totalNs.fetch_add(ns, std::memory_order_relaxed);
+
+   if (ns > maxNs.load(std::memory_order_relaxed)) {
+      maxNs.store(ns, std::memory_order_relaxed);
+   }
+}
+
+const AudioFrameTimings &
+getAudioFrameTimings()
+{
+   return sAudioFrameTimings;
+}
+
 } // namespace internal
 
 AXResult
@@ -937,6 +1300,16 @@ namespace internal
 void
 initDevices()
 {
+   static std::once_flag sRegisteredConfigChangeListener;
+   std::call_once(sRegisteredConfigChangeListener,
+      []() {
+         decaf::registerConfigChangeListener(
+            [](const decaf::Settings &settings) {
+               sNumDecodeThreads.store(settings.sound.decode_threads);
+            });
+      });
+   sNumDecodeThreads.store(decaf::config()->sound.decode_threads);
+
    for (auto &device : sDeviceData->tvDevices.devices) {
       device.volume = DefaultVolume;
       for (auto &aux : device.aux) {
@@ -1,5 +1,9 @@
 #pragma once
 #include "sndcore2_enum.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <libcpu/be2_struct.h>
 
 namespace cafe::sndcore2
@@ -113,6 +117,38 @@ AXSetAuxReturnVolume(AXDeviceType type,
 namespace internal
 {
 
+static constexpr auto NumAudioTimingBuckets = 16u;
+
+/**
+ * Histogram of how long a stage of audio frame processing takes, bucket N
+ * counts frames which took [2^N, 2^(N+1)) microseconds, with bucket 0 also
+ * counting anything quicker and the last bucket anything slower.
+ */
+struct AudioTimingHistogram
+{
+   void record(std::chrono::nanoseconds duration);
+
+   std::array<std::atomic<uint64_t>, NumAudioTimingBuckets> buckets { };
+   std::atomic<uint64_t> count { 0 };
+   std::atomic<uint64_t> totalNs { 0 };
+   std::atomic<uint64_t> maxNs { 0 };
+};
+
+struct AudioFrameTimings
+{
+   //! Voice decode, sample rate conversion and ADSR.
+   AudioTimingHistogram decode;
+
+   //! Mixing voices into devices, excluding guest callbacks.
+   AudioTimingHistogram mix;
+
+   //! Guest aux and final mix callbacks.
+   AudioTimingHistogram auxCallbacks;
+};
+
+const AudioFrameTimings &
+getAudioFrameTimings();
+
 void
 mixOutput(int32_t* buffer,
           uint16_t numSamples,
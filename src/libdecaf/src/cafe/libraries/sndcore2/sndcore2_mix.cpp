@@ -0,0 +1,180 @@
+#include "sndcore2_mix.h"
+
+#include <algorithm>
+#include <common/platform_intrin.h>
+
+namespace cafe::sndcore2::internal
+{
+
+static MixerKernel
+sMixerKernel = MixerKernel::Vector;
+
+MixerKernel
+getMixerKernel()
+{
+   return sMixerKernel;
+}
+
+/**
+ * Select which implementation is used for voice decoding and mixing, mostly
+ * useful to compare the output and performance of the two.
+ */
+void
+setMixerKernel(MixerKernel kernel)
+{
+   sMixerKernel = kernel;
+}
+
+void
+mixSamplesReference(sfixed_1_0_15_t *out,
+                    const sfixed_1_0_15_t *samples,
+                    ufixed_1_15_t volume,
+                    uint32_t numSamples)
+{
+   for (auto i = 0u; i < numSamples; ++i) {
+      out[i] += samples[i] * volume;
+   }
+}
+
+void
+scaleSamplesReference(sfixed_1_0_15_t *samples,
+                      ufixed_1_15_t volume,
+                      uint32_t numSamples)
+{
+   for (auto i = 0u; i < numSamples; ++i) {
+      samples[i] = samples[i] * volume;
+   }
+}
+
+static inline int32_t
+multiplySample(int16_t sample,
+               uint16_t volume)
+{
+   // A 1.15 signed sample times a 1.15 unsigned volume always fits in 32 bits
+   auto product = static_cast<int32_t>(sample) * static_cast<int32_t>(volume);
+   return product / (1 << 15);
+}
+
+/**
+ * Multiply 8 samples by a 1.15 unsigned volume, returning the 1.15 results
+ * as two vectors of 4 x int32.
+ *
+ * SSE2 only has a signed 16 bit multiply high, for volumes >= 1.0 the
+ * volume is negative when treated as signed so we add back sample << 16.
+ */
+static inline void
+multiplySamples(__m128i samples,
+                __m128i volume,
+                bool volumeHighBit,
+                __m128i &lo,
+                __m128i &hi)
+{
+   auto productLo = _mm_mullo_epi16(samples, volume);
+   auto productHi = _mm_mulhi_epi16(samples, volume);
+
+   if (volumeHighBit) {
+      productHi = _mm_add_epi16(productHi, samples);
+   }
+
+   lo = _mm_unpacklo_epi16(productLo, productHi);
+   hi = _mm_unpackhi_epi16(productLo, productHi);
+
+   // Shift right by 15 rounding towards zero, matching the reference
+   auto bias = _mm_set1_epi32(0x7FFF);
+   lo = _mm_srai_epi32(_mm_add_epi32(lo, _mm_and_si128(_mm_srai_epi32(lo, 31), bias)), 15);
+   hi = _mm_srai_epi32(_mm_add_epi32(hi, _mm_and_si128(_mm_srai_epi32(hi, 31), bias)), 15);
+}
+
+void
+accumulateSamples(int32_t *accumulator,
+                  const int16_t *samples,
+                  uint16_t volume,
+                  uint32_t numSamples)
+{
+   if (volume == 0) {
+      return;
+   }
+
+   auto vecVolume = _mm_set1_epi16(static_cast<int16_t>(volume));
+   auto volumeHighBit = (volume & 0x8000) != 0;
+   auto i = 0u;
+
+   for (; i + 8 <= numSamples; i += 8) {
+      auto lo = __m128i { };
+      auto hi = __m128i { };
+      multiplySamples(_mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i)),
+                      vecVolume, volumeHighBit, lo, hi);
+
+      auto accLo = reinterpret_cast<__m128i *>(accumulator + i);
+      auto accHi = reinterpret_cast<__m128i *>(accumulator + i + 4);
+      _mm_storeu_si128(accLo, _mm_add_epi32(_mm_loadu_si128(accLo), lo));
+      _mm_storeu_si128(accHi, _mm_add_epi32(_mm_loadu_si128(accHi), hi));
+   }
+
+   for (; i < numSamples; ++i) {
+      accumulator[i] += multiplySample(samples[i], volume);
+   }
+}
+
+void
+scaleSamples(int16_t *samples,
+             uint16_t volume,
+             uint32_t numSamples)
+{
+   auto vecVolume = _mm_set1_epi16(static_cast<int16_t>(volume));
+   auto volumeHighBit = (volume & 0x8000) != 0;
+   auto i = 0u;
+
+   for (; i + 8 <= numSamples; i += 8) {
+      auto ptr = reinterpret_cast<__m128i *>(samples + i);
+      auto lo = __m128i { };
+      auto hi = __m128i { };
+      multiplySamples(_mm_loadu_si128(ptr), vecVolume, volumeHighBit, lo, hi);
+      _mm_storeu_si128(ptr, _mm_packs_epi32(lo, hi));
+   }
+
+   for (; i < numSamples; ++i) {
+      auto sample = multiplySample(samples[i], volume);
+      samples[i] = static_cast<int16_t>(std::clamp(sample, -32768, 32767));
+   }
+}
+
+void
+unpackSamples(int32_t *accumulator,
+              const int16_t *samples,
+              uint32_t numSamples)
+{
+   auto i = 0u;
+
+   for (; i + 8 <= numSamples; i += 8) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+      auto lo = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+      auto hi = _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(accumulator + i), lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(accumulator + i + 4), hi);
+   }
+
+   for (; i < numSamples; ++i) {
+      accumulator[i] = samples[i];
+   }
+}
+
+void
+packSamples(int16_t *samples,
+            const int32_t *accumulator,
+            uint32_t numSamples)
+{
+   auto i = 0u;
+
+   for (; i + 8 <= numSamples; i += 8) {
+      auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(accumulator + i));
+      auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(accumulator + i + 4));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(samples + i), _mm_packs_epi32(lo, hi));
+   }
+
+   for (; i < numSamples; ++i) {
+      samples[i] = static_cast<int16_t>(std::clamp(accumulator[i], -32768, 32767));
+   }
+}
+
+} // namespace cafe::sndcore2::internal
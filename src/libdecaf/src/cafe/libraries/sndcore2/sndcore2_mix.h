@@ -0,0 +1,67 @@
+#pragma once
+#include <common/fixed.h>
+#include <cstdint>
+
+namespace cafe::sndcore2::internal
+{
+
+enum class MixerKernel
+{
+   //! The original per-sample fixed point implementation.
+   Reference,
+
+   //! SIMD kernels with a 32 bit planar accumulator.
+   Vector,
+};
+
+MixerKernel
+getMixerKernel();
+
+void
+setMixerKernel(MixerKernel kernel);
+
+/*
+Reference kernels, these operate directly on the fixed point sample types
+and wrap on overflow exactly as the original mixer did.
+*/
+
+void
+mixSamplesReference(sfixed_1_0_15_t *out,
+                    const sfixed_1_0_15_t *samples,
+                    ufixed_1_15_t volume,
+                    uint32_t numSamples);
+
+void
+scaleSamplesReference(sfixed_1_0_15_t *samples,
+                      ufixed_1_15_t volume,
+                      uint32_t numSamples);
+
+/*
+Vector kernels, these operate on the raw 1.15 data of the samples and
+volumes.  Each product is truncated towards zero to 1.15 before it is
+accumulated so the results match the reference kernels as long as the
+reference did not overflow, in which case we saturate instead.
+*/
+
+void
+accumulateSamples(int32_t *accumulator,
+                  const int16_t *samples,
+                  uint16_t volume,
+                  uint32_t numSamples);
+
+void
+scaleSamples(int16_t *samples,
+             uint16_t volume,
+             uint32_t numSamples);
+
+void
+unpackSamples(int32_t *accumulator,
+              const int16_t *samples,
+              uint32_t numSamples);
+
+void
+packSamples(int16_t *samples,
+            const int32_t *accumulator,
+            uint32_t numSamples);
+
+} // namespace cafe::sndcore2::internal
@@ -438,6 +438,16 @@ getAcquiredVoices();
 virt_ptr<AXVoiceExtras>
 getVoiceExtras(int index);
 
+void
+sampleVoice(virt_ptr<AXVoice> voice,
+            Pcm16Sample *samples,
+            int numSamples);
+
+void
+sampleVoiceReference(virt_ptr<AXVoice> voice,
+                     Pcm16Sample *samples,
+                     int numSamples);
+
 } // namespace internal
 
 } // namespace cafe::sndcore2
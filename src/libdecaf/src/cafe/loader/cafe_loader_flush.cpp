@@ -1,12 +1,17 @@
 #include "cafe_loader_flush.h"
 #include "cafe_loader_iop.h"
 
+#include <libcpu/cpu_control.h>
+
 namespace cafe::loader::internal
 {
 
 void
 LiSafeFlushCode(virt_addr base, uint32_t size)
 {
+   // The code heap may be reused by a newly loaded module, make sure nothing
+   // runs what was previously decoded at these addresses.
+   cpu::invalidateInstructionCache(base.getAddress(), size);
 }
 
 void
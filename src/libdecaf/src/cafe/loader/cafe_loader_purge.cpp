@@ -4,6 +4,8 @@
 #include "cafe_loader_loaded_rpl.h"
 #include "cafe_loader_purge.h"
 
+#include <libcpu/cpu_control.h>
+
 namespace cafe::loader::internal
 {
 
@@ -18,6 +20,8 @@ LiPurgeOneUnlinkedModule(virt_ptr<LOADED_RPL> rpl)
 
    if (!(rpl->loadStateFlags & LoaderStateFlags_Unk0x20000000)) {
       if (rpl->textBuffer) {
+         cpu::removeJitCacheModule(
+            virt_cast<virt_addr>(rpl->textBuffer).getAddress());
          LiCacheLineCorrectFreeEx(globals->processCodeHeap,
                                   rpl->textBuffer,
                                   rpl->textBufferSize);
@@ -12,9 +12,12 @@
 #include "cafe/libraries/cafe_hle.h"
 
 #include <libcpu/be2_struct.h>
+#include <libcpu/cpu_config.h>
+#include <libcpu/cpu_control.h>
 #include <libcpu/cpu_formatters.h>
 #include <libcpu/espresso/espresso_instructionset.h>
 #include <libcpu/espresso/espresso_spr.h>
+#include <cstring>
 #include <zlib.h>
 
 namespace cafe::loader::internal
@@ -674,6 +677,46 @@ sExecReloc(virt_ptr<LOADED_RPL> rpl,
    return 0;
 }
 
+/**
+ * Notify the JIT of the read only sections in the RPX.
+ *
+ * This must happen before the RPX's text is registered with the JIT's
+ * persistent code cache, which keys the module on these ranges.
+ */
+static void
+sAddJitReadOnlySections(virt_ptr<LOADED_RPL> rpl)
+{
+   auto shStrSection = virt_ptr<char> { nullptr };
+   if (auto shstrndx = rpl->elfHeader.shstrndx) {
+      shStrSection = virt_cast<char *>(rpl->sectionAddressBuffer[shstrndx]);
+   }
+
+   for (auto i = 0u; i < rpl->elfHeader.shnum; ++i) {
+      auto sectionHeader = getSectionHeader(rpl, i);
+      auto sectionAddress = rpl->sectionAddressBuffer[i];
+      if (!sectionAddress || sectionHeader->type != rpl::SHT_PROGBITS) {
+         continue;
+      }
+
+      if (shStrSection && sectionHeader->name) {
+         auto name = shStrSection + sectionHeader->name;
+         if (strcmp(name.get(), ".rodata") == 0) {
+            cpu::addJitReadOnlyRange(sectionAddress.getAddress(),
+                                     sectionHeader->size);
+            continue;
+         }
+      }
+
+      if (!(sectionHeader->flags & rpl::SHF_WRITE)) {
+         // TODO: Fix me
+         // When we have a small section, e.g. .syscall section with
+         // sectionHeader->size == 8, we seem to break binrec
+         //cpu::addJitReadOnlyRange(sectionAddress.getAddress(),
+         //                         sectionHeader->size);
+      }
+   }
+}
+
 int32_t
 LiFixupRelocOneRPL(virt_ptr<LOADED_RPL> rpl,
                    virt_ptr<LiImportTracking> imports,
@@ -724,6 +767,10 @@ LiFixupRelocOneRPL(virt_ptr<LOADED_RPL> rpl,
       }
    }
 
+   if (isRpx && cpu::config()->jit.rodataReadOnly) {
+      sAddJitReadOnlySections(rpl);
+   }
+
    // Flush the code cache
    if (textAddress) {
       if (textMax - textAddress > rpl->textBufferSize) {
@@ -733,6 +780,12 @@ LiFixupRelocOneRPL(virt_ptr<LOADED_RPL> rpl,
       }
 
       LiSafeFlushCode(textAddress, rpl->textBufferSize);
+
+      // The text is now final, let the JIT load any cached code for it
+      cpu::addJitCacheModule(
+         std::string { rpl->moduleNameBuffer.get(), rpl->moduleNameLen },
+         textAddress.getAddress(),
+         rpl->textBufferSize);
    }
 
    // Relocate entry point
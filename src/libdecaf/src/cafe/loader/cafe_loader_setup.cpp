@@ -9,10 +9,14 @@
 #include "cafe_loader_query.h"
 #include "cafe_loader_log.h"
 #include "cafe_loader_minfileinfo.h"
+#include "cafe_loader_zlib.h"
 #include "cafe/cafe_stackobject.h"
+#include "decaf_config.h"
 
 #include <array>
+#include <chrono>
 #include <common/align.h>
+#include <deque>
 #include <libcpu/cpu_formatters.h>
 #include <zlib.h>
 
@@ -194,17 +198,41 @@ sLiRefillBounceBufferForReading(virt_ptr<LOADED_RPL> rpl,
    return result;
 }
 
-int32_t
-ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
-                          uint32_t sectionIndex,
-                          std::string_view boundsName,
-                          uint32_t fileOffset,
-                          uint32_t deflatedSize,
-                          virt_ptr<void> inflatedBuffer,
-                          uint32_t *inflatedSize)
+struct LiInflateStats
+{
+   uint32_t numSections = 0;
+   uint32_t numCacheHits = 0;
+   uint64_t deflatedBytes = 0;
+   uint64_t inflatedBytes = 0;
+
+   //! Time spent waiting for the worker pool to finish inflating.
+   std::chrono::nanoseconds duration { 0 };
+};
+
+//! Deflated sections of the RPL being set up which are being inflated on the
+//! worker pool, a deque so queued sections never move in memory.
+static std::deque<LiSectionInflate>
+sPendingInflates;
+
+static std::chrono::nanoseconds
+sTotalSetupTime { 0 };
+
+static uint32_t
+sNumModulesSetup = 0;
+
+/**
+ * Copy the deflated data of a section out of the bounce buffers and queue it
+ * to be inflated on the host worker pool whilst the rest of the RPL is read.
+ */
+static int32_t
+sLiQueueSectionInflate(virt_ptr<LOADED_RPL> rpl,
+                       uint32_t sectionIndex,
+                       const char *boundsName,
+                       uint32_t fileOffset,
+                       uint32_t deflatedSize,
+                       virt_ptr<void> inflatedBuffer,
+                       uint32_t inflatedSize)
 {
-   auto inflatedBytesMax = *inflatedSize;
-   auto deflatedBytesRemaining = deflatedSize;
    auto bounceBuffer = virt_ptr<void> { nullptr };
    auto bounceBufferSize = uint32_t { 0 };
 
@@ -218,89 +246,147 @@ ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> rpl,
       return error;
    }
 
-   auto stream = z_stream { };
-   std::memset(&stream, 0, sizeof(stream));
-
-   auto zlibError = inflateInit(&stream);
-   if (zlibError != Z_OK) {
-      switch (zlibError) {
-      case Z_STREAM_ERROR:
-         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
-         return Error::ZlibStreamError;
-      case Z_MEM_ERROR:
-         LiSetFatalError(0x187298u, rpl->fileType, 0, "ZLIB_UncompressFromStream", 319);
-         return Error::ZlibMemError;
-      case Z_VERSION_ERROR:
-         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
-         return Error::ZlibVersionError;
-      default:
-         Loader_ReportError("***Unknown ZLIB error {} (0x{}).", zlibError, zlibError);
-         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 332);
-         return Error::ZlibUnknownError;
-      }
-   }
-
-   constexpr auto InflateChunkSize = 0x3000u;
-   rpl->lastSectionCrc = 0u;
-
-   stream.next_out = reinterpret_cast<Bytef *>(inflatedBuffer.get());
+   auto &section = sPendingInflates.emplace_back();
+   section.sectionIndex = sectionIndex;
+   section.boundsName = boundsName;
+   section.dst = reinterpret_cast<uint8_t *>(inflatedBuffer.get());
+   section.expectedSize = inflatedSize;
+   section.deflated.resize(deflatedSize);
 
+   auto bytesRead = 0u;
    while (true) {
       // TODO: Loader_UpdateHeartBeat();
       LiCheckAndHandleInterrupts();
-      stream.avail_in = bounceBufferSize;
-      stream.next_in = reinterpret_cast<Bytef *>(bounceBuffer.get());
+      std::memcpy(section.deflated.data() + bytesRead,
+                  bounceBuffer.get(),
+                  bounceBufferSize);
+      bytesRead += bounceBufferSize;
 
-      while (stream.avail_in) {
-         LiCheckAndHandleInterrupts();
-         stream.avail_out = std::min<uInt>(InflateChunkSize, inflatedBytesMax - stream.total_out);
-
-         zlibError = inflate(&stream, 0);
-         if (zlibError != Z_OK && zlibError != Z_STREAM_END) {
-            switch (zlibError) {
-            case Z_STREAM_ERROR:
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 405);
-               return -470086;
-            case Z_MEM_ERROR:
-               LiSetFatalError(0x187298u, rpl->fileType, 0, "ZLIB_UncompressFromStream", 415);
-               error = -470084;
-               break;
-            case Z_DATA_ERROR:
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 419);
-               error = -470087;
-               break;
-            default:
-               Loader_ReportError("***Unknown ZLIB error {} (0x{}).", zlibError, zlibError);
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 424);
-               error = -470100;
-            }
-
-            inflateEnd(&stream);
-            return error;
-         }
-
-         decaf_check(stream.total_out <= inflatedBytesMax);
-      }
-
-      deflatedBytesRemaining -= bounceBufferSize;
-      if (!deflatedBytesRemaining) {
+      if (bytesRead >= deflatedSize) {
          break;
       }
 
-      error = sLiRefillBounceBufferForReading(rpl, &bounceBufferSize, deflatedBytesRemaining, &bounceBuffer);
+      error = sLiRefillBounceBufferForReading(rpl, &bounceBufferSize, deflatedSize - bytesRead, &bounceBuffer);
       if (error) {
+         sPendingInflates.pop_back();
          LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 520);
-         inflateEnd(&stream);
-         *inflatedSize = stream.total_out;
          return -470087;
       }
    }
 
-   inflateEnd(&stream);
-   *inflatedSize = stream.total_out;
+   auto config = decaf::config();
+   LiQueueSectionInflate(section,
+                         config->system.rpl_section_cache ?
+                            config->system.rpl_section_cache_path : std::string { });
    return 0;
 }
 
+/**
+ * Wait for all the queued sections to be inflated, returning the error of
+ * the first one which failed.
+ */
+static int32_t
+sLiInflatePendingSections(virt_ptr<LOADED_RPL> rpl,
+                          LiInflateStats &stats)
+{
+   if (sPendingInflates.empty()) {
+      return 0;
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   LiWaitSectionInflates();
+   stats.duration += std::chrono::steady_clock::now() - start;
+
+   auto result = int32_t { 0 };
+   for (auto &section : sPendingInflates) {
+      stats.numSections++;
+      stats.numCacheHits += section.cacheHit ? 1 : 0;
+      stats.deflatedBytes += section.deflated.size();
+      stats.inflatedBytes += section.inflatedSize;
+
+      if (result ||
+          (section.zlibError == Z_STREAM_END &&
+           section.inflatedSize == section.expectedSize)) {
+         continue;
+      }
+
+      switch (section.zlibError) {
+      case Z_STREAM_END:
+      case Z_BUF_ERROR:
+         Loader_ReportError(
+            "***{} {} {} Decompression ({}->{}) failure. Anticipated uncompressed size would be {}; got {}",
+            rpl->moduleNameBuffer,
+            section.boundsName,
+            section.sectionIndex,
+            section.deflated.size(),
+            section.expectedSize,
+            section.expectedSize,
+            section.inflatedSize);
+         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "sLiSetupOneAllocSection", 1604);
+         result = -470090;
+         continue;
+      case Z_STREAM_ERROR:
+         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 405);
+         result = -470086;
+         break;
+      case Z_MEM_ERROR:
+         LiSetFatalError(0x187298u, rpl->fileType, 0, "ZLIB_UncompressFromStream", 415);
+         result = -470084;
+         break;
+      case Z_DATA_ERROR:
+         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 419);
+         result = -470087;
+         break;
+      default:
+         Loader_ReportError("***Unknown ZLIB error {} (0x{}).", section.zlibError, section.zlibError);
+         LiSetFatalError(0x18729Bu, rpl->fileType, 1, "ZLIB_UncompressFromStream", 424);
+         result = -470100;
+      }
+
+      Loader_ReportError(
+         "***{} {} {} Decompression ({}->{}) failure.",
+         rpl->moduleNameBuffer,
+         section.boundsName,
+         section.sectionIndex,
+         section.deflated.size(),
+         section.expectedSize);
+   }
+
+   sPendingInflates.clear();
+   return result;
+}
+
+/**
+ * Log how long setting up rpl took, readDuration is the time spent reading
+ * its allocated sections not including any wait for them to be inflated.
+ */
+static void
+sLiReportSetupTime(virt_ptr<LOADED_RPL> rpl,
+                   std::chrono::steady_clock::time_point start,
+                   std::chrono::steady_clock::duration readDuration,
+                   const LiInflateStats &stats)
+{
+   using milliseconds = std::chrono::duration<double, std::milli>;
+   auto duration = std::chrono::steady_clock::now() - start;
+   sTotalSetupTime += duration;
+   sNumModulesSetup++;
+
+   gLog->info("Loader set up {} in {:.2f} ms: read {:.2f} ms, inflate wait {:.2f} ms, "
+              "other {:.2f} ms ({} sections, {} -> {} bytes, {} from cache); "
+              "{} modules in {:.2f} ms so far",
+              rpl->moduleNameBuffer,
+              milliseconds { duration }.count(),
+              milliseconds { readDuration }.count(),
+              milliseconds { stats.duration }.count(),
+              milliseconds { duration - readDuration - stats.duration }.count(),
+              stats.numSections,
+              stats.deflatedBytes,
+              stats.inflatedBytes,
+              stats.numCacheHits,
+              sNumModulesSetup,
+              milliseconds { sTotalSetupTime }.count());
+}
+
 static int32_t
 LiSetupOneAllocSection(kernel::UniqueProcessId upid,
                        virt_ptr<LOADED_RPL> rpl,
@@ -377,14 +463,13 @@ LiSetupOneAllocSection(kernel::UniqueProcessId upid,
             *reinterpret_cast<be2_val<uint32_t> *>(
                inflatedExpectedSizeBuffer.data());
          if (inflatedExpectedSize) {
-            auto inflatedBytes = static_cast<uint32_t>(inflatedExpectedSize);
-            error = ZLIB_UncompressFromStream(rpl,
-                                              sectionIndex,
-                                              bounds->name,
-                                              sectionHeader->offset + 4,
-                                              sectionHeader->size - 4,
-                                              virt_cast<void *>(sectionAddress),
-                                              &inflatedBytes);
+            error = sLiQueueSectionInflate(rpl,
+                                           sectionIndex,
+                                           bounds->name,
+                                           sectionHeader->offset + 4,
+                                           sectionHeader->size - 4,
+                                           virt_cast<void *>(sectionAddress),
+                                           inflatedExpectedSize);
             if (error) {
                Loader_ReportError(
                   "***{} {} {} Decompression ({}->{}) failure.",
@@ -396,21 +481,8 @@ LiSetupOneAllocSection(kernel::UniqueProcessId upid,
                return error;
             }
 
-            if (inflatedBytes != inflatedExpectedSize) {
-               Loader_ReportError(
-                  "***{} {} {} Decompression ({}->{}) failure. Anticipated uncompressed size would be {}; got {}",
-                  rpl->moduleNameBuffer,
-                  bounds->name,
-                  sectionIndex,
-                  sectionHeader->size - 4,
-                  inflatedExpectedSize,
-                  inflatedExpectedSize,
-                  inflatedBytes);
-               LiSetFatalError(0x18729Bu, rpl->fileType, 1, "sLiSetupOneAllocSection", 1604);
-               return -470090;
-            }
-
-            sectionHeader->size = inflatedBytes;
+            // The inflated size is checked by sLiInflatePendingSections
+            sectionHeader->size = inflatedExpectedSize;
          }
       } else {
          auto bytesRead = 0u;
@@ -461,6 +533,10 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
               virt_ptr<TinyHeap> dataHeapTracking)
 {
    int32_t result = 0;
+   auto setupStart = std::chrono::steady_clock::now();
+   auto readStart = setupStart;
+   auto readDuration = std::chrono::steady_clock::duration { 0 };
+   auto inflateStats = LiInflateStats { };
 
    // Calculate segment bounds
    RplSegmentBounds bounds;
@@ -542,6 +618,8 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
       goto error;
    }
 
+   readStart = std::chrono::steady_clock::now();
+
    if (rpl->dataBuffer) {
       for (auto i = 1u; i < rpl->elfHeader.shnum; ++i) {
          auto sectionHeader = virt_cast<rpl::SectionHeader *>(shBase + i * rpl->elfHeader.shentsize);
@@ -592,6 +670,12 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
                }
 
                if (sectionHeader->type == rpl::SHT_RPL_EXPORTS) {
+                  // The export count is read straight away
+                  result = sLiInflatePendingSections(rpl, inflateStats);
+                  if (result) {
+                     goto error;
+                  }
+
                   if (sectionHeader->flags & rpl::SHF_EXECINSTR) {
                      rpl->numFuncExports = *virt_cast<uint32_t *>(rpl->sectionAddressBuffer[i]);
                      rpl->funcExports = virt_cast<void *>(rpl->sectionAddressBuffer[i] + 8);
@@ -638,6 +722,15 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
       }
    }
 
+   // Reading the exports waits for them to be inflated, which is already
+   // counted in inflateStats
+   readDuration = std::chrono::steady_clock::now() - readStart - inflateStats.duration;
+
+   result = sLiInflatePendingSections(rpl, inflateStats);
+   if (result) {
+      goto error;
+   }
+
    if (bounds.temp.min != bounds.temp.max) {
       auto compressedRelocationsBuffer = virt_ptr<void> { nullptr };
       auto compressedRelocationsBufferSize = uint32_t { 0 };
@@ -752,9 +845,14 @@ LiSetupOneRPL(kernel::UniqueProcessId upid,
       goto error;
    }
 
+   sLiReportSetupTime(rpl, setupStart, readDuration, inflateStats);
    return 0;
 
 error:
+   // Workers may still be writing into the sections and their buffers
+   LiWaitSectionInflates();
+   sPendingInflates.clear();
+
    if (rpl->compressedRelocationsBuffer) {
       LiCacheLineCorrectFreeEx(codeHeapTracking,
                                  rpl->compressedRelocationsBuffer,
@@ -1,10 +1,54 @@
 #include "cafe_loader_iop.h"
 #include "cafe_loader_zlib.h"
+
+#include <common/log.h>
+#include <common/workerpool.h>
+#include <common/xxhash.h>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <zlib.h>
 
 namespace cafe::loader::internal
 {
 
+static std::mutex
+sInflatePoolMutex;
+
+static std::unique_ptr<WorkerPool>
+sInflatePool;
+
+static std::mutex
+sQueuedInflateMutex;
+
+static std::condition_variable
+sQueuedInflateCondition;
+
+//! Number of sections queued by LiQueueSectionInflate still being inflated
+static size_t
+sNumQueuedInflates = 0;
+
+//! The last section cache directory which was created successfully
+static std::string
+sCreatedCachePath;
+
+static WorkerPool &
+getInflatePool()
+{
+   std::unique_lock<std::mutex> lock { sInflatePoolMutex };
+
+   if (!sInflatePool) {
+      sInflatePool = std::make_unique<WorkerPool>(WorkerPool::getDefaultNumThreads(),
+                                                  "Loader Inflate");
+   }
+
+   return *sInflatePool;
+}
+
 uint32_t
 LiCalcCRC32(uint32_t crc,
             virt_ptr<const void> data,
@@ -20,4 +64,168 @@ LiCalcCRC32(uint32_t crc,
    return crc;
 }
 
+static void
+inflateSection(LiSectionInflate &section)
+{
+   auto stream = z_stream { };
+   std::memset(&stream, 0, sizeof(stream));
+
+   section.zlibError = inflateInit(&stream);
+   if (section.zlibError != Z_OK) {
+      return;
+   }
+
+   // The whole destination is available so the section is inflated in one
+   // call rather than in small chunks
+   stream.next_in = section.deflated.data();
+   stream.avail_in = static_cast<uInt>(section.deflated.size());
+   stream.next_out = section.dst;
+   stream.avail_out = section.expectedSize;
+
+   section.zlibError = inflate(&stream, Z_FINISH);
+   section.inflatedSize = static_cast<uint32_t>(stream.total_out);
+   inflateEnd(&stream);
+}
+
+static std::string
+getCacheEntryPath(const std::string &cachePath,
+                  const LiSectionInflate &section)
+{
+   auto key = XXH64(section.deflated.data(), section.deflated.size(),
+                    section.expectedSize);
+   return (std::filesystem::path { cachePath } /
+           fmt::format("{:016x}.bin", key)).string();
+}
+
+static bool
+readCacheEntry(const std::string &path,
+               LiSectionInflate &section)
+{
+   auto file = std::ifstream { path, std::ifstream::in | std::ifstream::binary };
+   if (!file.is_open()) {
+      return false;
+   }
+
+   file.seekg(0, std::ifstream::end);
+   if (file.tellg() != static_cast<std::streamoff>(section.expectedSize)) {
+      return false;
+   }
+
+   file.seekg(0, std::ifstream::beg);
+   file.read(reinterpret_cast<char *>(section.dst), section.expectedSize);
+   return !!file;
+}
+
+static void
+writeCacheEntry(const std::string &path,
+                const LiSectionInflate &section)
+{
+   // Write to a temporary file first so an interrupted write can never leave
+   // a truncated entry behind.
+   auto tmpPath = path + ".tmp";
+   {
+      auto file = std::ofstream { tmpPath, std::ofstream::out | std::ofstream::binary };
+      if (!file.is_open()) {
+         return;
+      }
+
+      file.write(reinterpret_cast<const char *>(section.dst), section.inflatedSize);
+      if (!file) {
+         return;
+      }
+   }
+
+   auto error = std::error_code { };
+   std::filesystem::rename(tmpPath, path, error);
+}
+
+static bool
+createCacheDirectory(const std::string &cachePath)
+{
+   if (cachePath == sCreatedCachePath) {
+      return true;
+   }
+
+   auto error = std::error_code { };
+   std::filesystem::create_directories(cachePath, error);
+   if (error) {
+      gLog->warn("Could not create RPL section cache directory {}: {}",
+                 cachePath, error.message());
+      return false;
+   }
+
+   sCreatedCachePath = cachePath;
+   return true;
+}
+
+static void
+inflateOrReadCachedSection(LiSectionInflate &section,
+                           const std::string &cachePath)
+{
+   auto entryPath = std::string { };
+
+   if (!cachePath.empty()) {
+      entryPath = getCacheEntryPath(cachePath, section);
+      if (readCacheEntry(entryPath, section)) {
+         section.zlibError = Z_STREAM_END;
+         section.inflatedSize = section.expectedSize;
+         section.cacheHit = true;
+         return;
+      }
+   }
+
+   inflateSection(section);
+
+   if (!cachePath.empty() &&
+       section.zlibError == Z_STREAM_END &&
+       section.inflatedSize == section.expectedSize) {
+      writeCacheEntry(entryPath, section);
+   }
+}
+
+void
+LiQueueSectionInflate(LiSectionInflate &section,
+                      const std::string &cachePath)
+{
+   auto sectionCachePath = std::string { };
+   if (!cachePath.empty() && createCacheDirectory(cachePath)) {
+      sectionCachePath = cachePath;
+   }
+
+   {
+      std::unique_lock<std::mutex> lock { sQueuedInflateMutex };
+      sNumQueuedInflates++;
+   }
+
+   getInflatePool().post(
+      [&section, sectionCachePath]() {
+         inflateOrReadCachedSection(section, sectionCachePath);
+
+         std::unique_lock<std::mutex> lock { sQueuedInflateMutex };
+         if (--sNumQueuedInflates == 0) {
+            sQueuedInflateCondition.notify_all();
+         }
+      });
+}
+
+void
+LiWaitSectionInflates()
+{
+   std::unique_lock<std::mutex> lock { sQueuedInflateMutex };
+   sQueuedInflateCondition.wait(lock, []() {
+      return sNumQueuedInflates == 0;
+   });
+}
+
+void
+LiInflateSections(std::vector<LiSectionInflate> &sections,
+                  const std::string &cachePath)
+{
+   for (auto &section : sections) {
+      LiQueueSectionInflate(section, cachePath);
+   }
+
+   LiWaitSectionInflates();
+}
+
 } // namespace cafe::loader::internal
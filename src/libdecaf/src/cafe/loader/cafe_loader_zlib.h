@@ -1,6 +1,8 @@
 #pragma once
 #include <libcpu/be2_struct.h>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace cafe::loader
 {
@@ -10,19 +12,62 @@ struct LOADED_RPL;
 namespace internal
 {
 
+/**
+ * A deflated section which has been read from the file and is waiting to be
+ * inflated on the host by LiQueueSectionInflate or LiInflateSections.
+ */
+struct LiSectionInflate
+{
+   uint32_t sectionIndex = 0;
+   const char *boundsName = nullptr;
+
+   //! Deflated data, without the leading inflated size.
+   std::vector<uint8_t> deflated;
+
+   //! Where the section is inflated to.
+   uint8_t *dst = nullptr;
+
+   //! Inflated size from the section data.
+   uint32_t expectedSize = 0;
+
+   //! Result of inflate, Z_STREAM_END on success.
+   int zlibError = 0;
+
+   //! Number of bytes written to dst.
+   uint32_t inflatedSize = 0;
+
+   //! Whether the section was read from the section cache.
+   bool cacheHit = false;
+};
+
 uint32_t
 LiCalcCRC32(uint32_t crc,
             virt_ptr<const void> data,
             uint32_t size);
 
-int32_t
-ZLIB_UncompressFromStream(virt_ptr<LOADED_RPL> basics,
-                          uint32_t sectionIndex,
-                          std::string_view boundsName,
-                          uint32_t fileOffset,
-                          uint32_t deflatedSize,
-                          virt_ptr<void> dst,
-                          uint32_t *inflatedSize);
+/**
+ * Start inflating a section on the host worker pool and return straight
+ * away, section must stay alive until LiWaitSectionInflates returns. When
+ * cachePath is not empty the inflated section is read from or stored to the
+ * section cache in that directory.
+ */
+void
+LiQueueSectionInflate(LiSectionInflate &section,
+                      const std::string &cachePath);
+
+/**
+ * Wait for every section queued by LiQueueSectionInflate to be inflated.
+ */
+void
+LiWaitSectionInflates();
+
+/**
+ * Inflate sections in parallel on the host, returning once all of them are
+ * done.
+ */
+void
+LiInflateSections(std::vector<LiSectionInflate> &sections,
+                  const std::string &cachePath);
 
 } // namespace internal
 
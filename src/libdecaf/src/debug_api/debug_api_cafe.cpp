@@ -6,10 +6,12 @@
 #include "cafe/libraries/coreinit/coreinit_enum_string.h"
 #include "cafe/libraries/coreinit/coreinit_scheduler.h"
 #include "cafe/libraries/coreinit/coreinit_thread.h"
+#include "cafe/libraries/sndcore2/sndcore2_device.h"
 #include "cafe/libraries/sndcore2/sndcore2_enum.h"
 #include "cafe/libraries/sndcore2/sndcore2_voice.h"
 #include "cafe/loader/cafe_loader_entry.h"
 #include "cafe/kernel/cafe_kernel_loader.h"
+#include "cafe/kernel/cafe_kernel_lock.h"
 
 #include "debugger/debugger.h"
 
@@ -222,4 +224,62 @@ sampleCafeVoices(std::vector<CafeVoice> &voiceInfos)
    return true;
 }
 
+bool
+sampleCafeSchedulerStats(CafeSchedulerStats &stats)
+{
+   auto schedulerStats = cafe::coreinit::internal::getSchedulerStats();
+   stats.lockAcquisitions = schedulerStats.lockAcquisitions;
+   stats.lockContentions = schedulerStats.lockContentions;
+   stats.lockWaitTimeNs = schedulerStats.lockWaitTimeNs;
+   stats.lockHoldTimeNs = schedulerStats.lockHoldTimeNs;
+   stats.lockMaxHoldTimeNs = schedulerStats.lockMaxHoldTimeNs;
+   stats.contextSwitches = schedulerStats.contextSwitches;
+   return true;
+}
+
+bool
+sampleCafeKernelLockStats(std::vector<CafeKernelLockStats> &stats)
+{
+   stats.clear();
+
+   for (auto site = cafe::kernel::internal::getFirstSpinLockSite(); site; site = site->next) {
+      auto &info = stats.emplace_back();
+      info.name = site->name;
+      info.acquisitions = site->acquisitions.load(std::memory_order_relaxed);
+      info.contentions = site->contentions.load(std::memory_order_relaxed);
+      info.spins = site->spins.load(std::memory_order_relaxed);
+      info.parks = site->parks.load(std::memory_order_relaxed);
+      info.holdTimeNs = site->holdTimeNs.load(std::memory_order_relaxed);
+      info.maxHoldTimeNs = site->maxHoldTimeNs.load(std::memory_order_relaxed);
+   }
+
+   return true;
+}
+
+static void
+copyAudioTimingHistogram(CafeAudioTimingHistogram &dst,
+                         const cafe::sndcore2::internal::AudioTimingHistogram &src)
+{
+   static_assert(std::tuple_size<decltype(dst.buckets)>::value ==
+                 cafe::sndcore2::internal::NumAudioTimingBuckets);
+
+   for (auto i = 0u; i < dst.buckets.size(); ++i) {
+      dst.buckets[i] = src.buckets[i].load(std::memory_order_relaxed);
+   }
+
+   dst.count = src.count.load(std::memory_order_relaxed);
+   dst.totalNs = src.totalNs.load(std::memory_order_relaxed);
+   dst.maxNs = src.maxNs.load(std::memory_order_relaxed);
+}
+
+bool
+sampleCafeAudioTimings(CafeAudioTimings &timings)
+{
+   auto &frameTimings = cafe::sndcore2::internal::getAudioFrameTimings();
+   copyAudioTimingHistogram(timings.decode, frameTimings.decode);
+   copyAudioTimingHistogram(timings.mix, frameTimings.mix);
+   copyAudioTimingHistogram(timings.auxCallbacks, frameTimings.auxCallbacks);
+   return true;
+}
+
 } // namespace decaf::debug
@@ -0,0 +1,31 @@
+#include "decaf_debug_api.h"
+
+#include "ios/ios_worker_thread.h"
+
+namespace decaf::debug
+{
+
+bool
+sampleIosWorkerQueueStats(std::vector<IosWorkerQueueStats> &stats)
+{
+   auto queues = std::vector<ios::internal::WorkerQueueStats> { };
+   ios::internal::sampleWorkerQueueStats(queues);
+   stats.clear();
+
+   for (auto &queue : queues) {
+      auto &info = stats.emplace_back();
+      info.key = queue.key;
+      info.submitted = queue.submitted;
+      info.completed = queue.completed;
+      info.depth = queue.depth;
+      info.maxDepth = queue.maxDepth;
+      info.totalWaitNs = queue.totalWaitNs;
+      info.maxWaitNs = queue.maxWaitNs;
+      info.totalRunNs = queue.totalRunNs;
+      info.maxRunNs = queue.maxRunNs;
+   }
+
+   return true;
+}
+
+} // namespace decaf::debug
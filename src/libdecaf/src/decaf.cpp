@@ -7,6 +7,7 @@
 
 #include "cafe/kernel/cafe_kernel.h"
 #include "cafe/kernel/cafe_kernel_process.h"
+#include "cafe/libraries/cafe_hle_trace.h"
 #include "cafe/libraries/coreinit/coreinit_scheduler.h"
 #include "cafe/libraries/coreinit/coreinit_thread.h"
 #include "cafe/libraries/swkbd/swkbd_keyboard.h"
@@ -129,14 +130,14 @@ initialise(const std::string &gamePath)
    filesystem->makeFolder(user, "/vol/temp");
 
    if (!volPath.empty()) {
-      filesystem->mountDevice(user, "/vol/code", std::make_shared<vfs::HostDevice>(volPath / "code"));
-      filesystem->mountDevice(user, "/vol/content", std::make_shared<vfs::HostDevice>(volPath / "content"));
-      filesystem->mountDevice(user, "/vol/meta", std::make_shared<vfs::HostDevice>(volPath / "meta"));
+      filesystem->mountDevice(user, "/vol/code", std::make_shared<vfs::HostDevice>(volPath / "code", true));
+      filesystem->mountDevice(user, "/vol/content", std::make_shared<vfs::HostDevice>(volPath / "content", true));
+      filesystem->mountDevice(user, "/vol/meta", std::make_shared<vfs::HostDevice>(volPath / "meta", true));
    } else if (!rpxPath.empty()) {
-      filesystem->mountDevice(user, "/vol/code", std::make_shared<vfs::HostDevice>(rpxPath.parent_path()));
+      filesystem->mountDevice(user, "/vol/code", std::make_shared<vfs::HostDevice>(rpxPath.parent_path(), true));
 
       if (!decaf::config()->system.content_path.empty()) {
-         filesystem->mountDevice(user, "/vol/content", std::make_shared<vfs::HostDevice>(decaf::config()->system.content_path));
+         filesystem->mountDevice(user, "/vol/content", std::make_shared<vfs::HostDevice>(decaf::config()->system.content_path, true));
       }
 
       cafe::kernel::setExecutableFilename(rpxPath.filename().string());
@@ -234,6 +235,9 @@ shutdown()
    ios::join();
    cafe::kernel::join();
 
+   // Flush any remaining HLE trace records
+   cafe::hle::stopBinaryTrace();
+
    // Stop graphics driver
    auto graphicsDriver = getGraphicsDriver();
 
@@ -1,4 +1,5 @@
 #include "ios_fs_fsa_device.h"
+#include "ios_fs_host_io.h"
 #include "ios_fs_log.h"
 
 #include "ios/ios.h"
@@ -18,7 +19,7 @@ FSADevice::FSADevice() :
 }
 
 FSAStatus
-FSADevice::translateError(vfs::Error error) const
+FSADevice::translateError(vfs::Error error)
 {
    switch (error) {
    case vfs::Error::Success:
@@ -664,6 +665,79 @@ FSADevice::readFile(vfs::User user,
 }
 
 
+/**
+ * Read from a file without blocking the caller, callback is called with the
+ * same result readFile would return.
+ *
+ * Reads which can be done with FileHandle::readAt are passed to the host IO
+ * threads, so multiple reads can be in flight at once. The file position is
+ * advanced before the read is queued so that following reads are queued at
+ * the correct position.
+ *
+ * Reads which would hit the end of file are done synchronously with
+ * readFile, so that the handle's end of file state is set as before.
+ */
+void
+FSADevice::readFileAsync(vfs::User user,
+                         phys_ptr<FSARequestReadFile> request,
+                         phys_ptr<uint8_t> buffer,
+                         uint32_t bufferLen,
+                         ReadFileCallback callback)
+{
+   auto handle = static_cast<Handle *>(nullptr);
+   auto status = mapFileHandle(request->handle, handle);
+   if (status < 0) {
+      return callback(readFile(user, request, buffer, bufferLen));
+   }
+
+   auto file = handle->file;
+   auto size = static_cast<int64_t>(request->size);
+   auto count = static_cast<int64_t>(request->count);
+   auto position = vfs::Result<int64_t> { int64_t { 0 } };
+
+   if (request->readFlags & FSAReadFlag::ReadWithPos) {
+      position = static_cast<int64_t>(request->pos);
+   } else {
+      position = file->tell();
+   }
+
+   auto fileSize = file->size();
+   if (!position || !fileSize || size <= 0 || count <= 0 ||
+       *position + size * count > *fileSize) {
+      return callback(readFile(user, request, buffer, bufferLen));
+   }
+
+   // Check the handle supports concurrent reads with an empty read
+   if (file->readAt(nullptr, 0, 0, *position).error() != vfs::Error::Success) {
+      return callback(readFile(user, request, buffer, bufferLen));
+   }
+
+   auto error = file->seek(vfs::FileHandle::SeekStart, *position + size * count);
+   if (error != vfs::Error::Success) {
+      return callback(readFile(user, request, buffer, bufferLen));
+   }
+
+   auto fileHandle = static_cast<int32_t>(request->handle);
+   submitHostRead(std::move(file), buffer.get(), size, count, *position,
+      [fileHandle, size, count, pos = *position,
+       callback = std::move(callback)](vfs::Result<int64_t> result)
+      {
+         if (!result) {
+            fsLog->debug("FSADevice::readFile[{}] size: {} count: {} pos: {} "
+                         "failed with error {}",
+                         fileHandle, size, count, pos, result.error());
+            return callback(translateError(result.error()));
+         }
+
+         auto bytesRead = (*result) * size;
+         fsLog->trace("FSADevice::readFile[{}] size: {} count: {} pos: {} "
+                      "read bytes: {}",
+                      fileHandle, size, count, pos, bytesRead);
+         callback(static_cast<FSAStatus>(bytesRead));
+      });
+}
+
+
 FSAStatus
 FSADevice::remove(vfs::User user,
                   phys_ptr<FSARequestRemove> request)
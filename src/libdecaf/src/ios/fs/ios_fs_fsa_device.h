@@ -9,6 +9,7 @@
 #include "vfs/vfs_permissions.h"
 
 #include <common/structsize.h>
+#include <functional>
 #include <vector>
 #include <libcpu/be2_struct.h>
 #include <memory>
@@ -50,11 +51,13 @@ class FSADevice
       }
 
       Type type;
-      std::unique_ptr<vfs::FileHandle> file;
+      std::shared_ptr<vfs::FileHandle> file;
       vfs::DirectoryIterator directory;
    };
 
 public:
+   using ReadFileCallback = std::function<void(FSAStatus)>;
+
    FSADevice();
 
    FSAStatus appendFile(vfs::User user, phys_ptr<FSARequestAppendFile> request);
@@ -76,6 +79,7 @@ public:
    FSAStatus openFile(vfs::User user, phys_ptr<FSARequestOpenFile> request, phys_ptr<FSAResponseOpenFile> response);
    FSAStatus readDir(vfs::User user, phys_ptr<FSARequestReadDir> request, phys_ptr<FSAResponseReadDir> response);
    FSAStatus readFile(vfs::User user, phys_ptr<FSARequestReadFile> request, phys_ptr<uint8_t> buffer, uint32_t bufferLen);
+   void readFileAsync(vfs::User user, phys_ptr<FSARequestReadFile> request, phys_ptr<uint8_t> buffer, uint32_t bufferLen, ReadFileCallback callback);
    FSAStatus remove(vfs::User user, phys_ptr<FSARequestRemove> request);
    FSAStatus rename(vfs::User user, phys_ptr<FSARequestRename> request);
    FSAStatus rewindDir(vfs::User user, phys_ptr<FSARequestRewindDir> request);
@@ -87,8 +91,8 @@ public:
    FSAStatus writeFile(vfs::User user, phys_ptr<FSARequestWriteFile> request, phys_ptr<const uint8_t> buffer, uint32_t bufferLen);
 
 private:
-   FSAStatus
-   translateError(vfs::Error error) const;
+   static FSAStatus
+   translateError(vfs::Error error);
 
    vfs::Path
    translatePath(phys_ptr<const char> path) const;
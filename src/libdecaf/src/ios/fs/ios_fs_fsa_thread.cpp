@@ -14,6 +14,10 @@
 #include "ios/ios_stackobject.h"
 #include "ios/ios_worker_thread.h"
 
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
 using namespace ios::kernel;
 using ios::internal::submitWorkerTask;
 
@@ -57,6 +61,53 @@ getDevice(FSADeviceHandle handle,
    return FSAStatus::OK;
 }
 
+enum class FilesystemAccess
+{
+   Shared,
+   Exclusive,
+};
+
+/*
+FSA requests run on the IOS worker threads keyed by their FSA client handle,
+so requests from one client run in order while different clients run in
+parallel.  The vfs device tree is not safe to modify concurrently, so any
+request which might modify it takes the filesystem lock exclusively.
+*/
+static std::shared_mutex
+sFilesystemMutex;
+
+template<typename Function>
+static void
+submitFsaTask(phys_ptr<ResourceRequest> resourceRequest,
+              FilesystemAccess access,
+              Function function)
+{
+   submitWorkerTask(
+      static_cast<ios::internal::WorkerQueueKey>(resourceRequest->requestData.handle),
+      [=]() {
+         if (access == FilesystemAccess::Exclusive) {
+            auto lock = std::unique_lock { sFilesystemMutex };
+            function();
+         } else {
+            auto lock = std::shared_lock { sFilesystemMutex };
+            function();
+         }
+      });
+}
+
+static FilesystemAccess
+getOpenFileAccess(phys_ptr<const FSARequestOpenFile> request)
+{
+   // Opening with write access may create a file
+   auto mode = phys_ptr<const char> { phys_addrof(request->mode) }.get();
+   auto modeEnd = std::find(mode, mode + FSAModeLength, '\0');
+   if (std::find_first_of(mode, modeEnd, "wa+", "wa+" + 3) != modeEnd) {
+      return FilesystemAccess::Exclusive;
+   }
+
+   return FilesystemAccess::Shared;
+}
+
 static FSAStatus
 fsaDeviceOpen(phys_ptr<RequestOrigin> origin,
               FSADeviceHandle *outHandle,
@@ -127,63 +178,63 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
 
    switch (command) {
    case FSACommand::AppendFile:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->appendFile(user, phys_addrof(request->appendFile)));
          });
       break;
    case FSACommand::ChangeDir:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->changeDir(user, phys_addrof(request->changeDir)));
          });
       break;
    case FSACommand::ChangeMode:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->changeMode(user, phys_addrof(request->changeMode)));
          });
       break;
    case FSACommand::CloseDir:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->closeDir(user, phys_addrof(request->closeDir)));
          });
       break;
    case FSACommand::CloseFile:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->closeFile(user, phys_addrof(request->closeFile)));
          });
       break;
    case FSACommand::FlushFile:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->flushFile(user, phys_addrof(request->flushFile)));
          });
       break;
    case FSACommand::FlushQuota:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->flushQuota(user, phys_addrof(request->flushQuota)));
          });
       break;
    case FSACommand::GetCwd:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->getCwd(user, phys_addrof(response->getCwd)));
          });
       break;
    case FSACommand::GetInfoByQuery:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->getInfoByQuery(user,
@@ -192,7 +243,7 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::GetPosFile:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->getPosFile(user,
@@ -201,28 +252,28 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::IsEof:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->isEof(user, phys_addrof(request->isEof)));
          });
       break;
    case FSACommand::MakeDir:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->makeDir(user, phys_addrof(request->makeDir)));
          });
       break;
    case FSACommand::MakeQuota:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->makeQuota(user, phys_addrof(request->makeQuota)));
          });
       break;
    case FSACommand::OpenDir:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->openDir(user,
@@ -231,7 +282,9 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::OpenFile:
-      submitWorkerTask([=]() {
+   {
+      auto access = getOpenFileAccess(phys_addrof(request->openFile));
+      submitFsaTask(resourceRequest, access, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->openFile(user,
@@ -239,8 +292,9 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
                                 phys_addrof(response->openFile)));
          });
       break;
+   }
    case FSACommand::ReadDir:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->readDir(user,
@@ -249,35 +303,35 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::Remove:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->remove(user, phys_addrof(request->remove)));
          });
       break;
    case FSACommand::Rename:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->rename(user, phys_addrof(request->rename)));
          });
       break;
    case FSACommand::RewindDir:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->rewindDir(user, phys_addrof(request->rewindDir)));
          });
       break;
    case FSACommand::SetPosFile:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->setPosFile(user, phys_addrof(request->setPosFile)));
          });
       break;
    case FSACommand::StatFile:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Shared, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->statFile(user,
@@ -286,21 +340,21 @@ fsaDeviceIoctl(phys_ptr<ResourceRequest> resourceRequest,
          });
       break;
    case FSACommand::TruncateFile:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->truncateFile(user, phys_addrof(request->truncateFile)));
          });
       break;
    case FSACommand::Unmount:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->unmount(user, phys_addrof(request->unmount)));
          });
       break;
    case FSACommand::UnmountWithProcess:
-      submitWorkerTask([=]() {
+      submitFsaTask(resourceRequest, FilesystemAccess::Exclusive, [=]() {
             fsaAsyncTaskComplete(
                resourceRequest,
                device->unmountWithProcess(user,
@@ -340,21 +394,24 @@ fsaDeviceIoctlv(phys_ptr<ResourceRequest> resourceRequest,
    switch (command) {
    case FSACommand::ReadFile:
    {
-      submitWorkerTask(
+      submitFsaTask(
+         resourceRequest, FilesystemAccess::Shared,
          [=]() {
             auto buffer = phys_cast<uint8_t *>(vecs[1].paddr);
             auto length = vecs[1].len;
 
-            fsaAsyncTaskComplete(
-               resourceRequest,
-               device->readFile(user, phys_addrof(request->readFile),
-                                buffer, length));
+            device->readFileAsync(
+               user, phys_addrof(request->readFile), buffer, length,
+               [resourceRequest](FSAStatus status) {
+                  fsaAsyncTaskComplete(resourceRequest, status);
+               });
          });
       break;
    }
    case FSACommand::WriteFile:
    {
-      submitWorkerTask(
+      submitFsaTask(
+         resourceRequest, FilesystemAccess::Exclusive,
          [=]()
          {
             auto buffer = phys_cast<uint8_t *>(vecs[1].paddr);
@@ -369,7 +426,8 @@ fsaDeviceIoctlv(phys_ptr<ResourceRequest> resourceRequest,
    }
    case FSACommand::Mount:
    {
-      submitWorkerTask(
+      submitFsaTask(
+         resourceRequest, FilesystemAccess::Exclusive,
          [=]()
          {
             fsaAsyncTaskComplete(
@@ -380,7 +438,8 @@ fsaDeviceIoctlv(phys_ptr<ResourceRequest> resourceRequest,
    }
    case FSACommand::MountWithProcess:
    {
-      submitWorkerTask(
+      submitFsaTask(
+         resourceRequest, FilesystemAccess::Exclusive,
          [=]()
          {
             fsaAsyncTaskComplete(
@@ -0,0 +1,137 @@
+#include "ios_fs_host_io.h"
+
+#include <common/platform_thread.h>
+#include <condition_variable>
+#include <fmt/format.h>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace ios::fs::internal
+{
+
+/*
+Reads from host files are performed on a small pool of threads using
+FileHandle::readAt, so a large streaming read does not hold up every other
+FSA request queued behind it on the IOS worker thread.  The number of
+threads is the number of reads we can have in flight at once.
+*/
+static constexpr auto NumHostIoThreads = 4;
+
+struct HostReadRequest
+{
+   std::shared_ptr<vfs::FileHandle> file;
+   void *buffer;
+   int64_t size;
+   int64_t count;
+   int64_t position;
+   HostReadCallback callback;
+};
+
+static std::vector<std::thread>
+sHostIoThreads;
+
+static bool
+sHostIoThreadsRunning = false;
+
+static std::mutex
+sHostIoMutex;
+
+static std::condition_variable
+sHostIoConditionVariable;
+
+static std::queue<HostReadRequest>
+sHostIoRequests;
+
+static void
+hostIoThread()
+{
+   auto lock = std::unique_lock { sHostIoMutex };
+
+   while (true) {
+      sHostIoConditionVariable.wait(lock, [] {
+         return !sHostIoThreadsRunning || !sHostIoRequests.empty();
+      });
+
+      if (!sHostIoThreadsRunning) {
+         break;
+      }
+
+      auto request = std::move(sHostIoRequests.front());
+      sHostIoRequests.pop();
+      lock.unlock();
+
+      request.callback(request.file->readAt(request.buffer,
+                                            request.size,
+                                            request.count,
+                                            request.position));
+
+      // Release our reference to the file outside of the lock, this may be
+      // the last reference if the file was closed while we were reading.
+      request = { };
+      lock.lock();
+   }
+}
+
+void
+startHostIoThreads()
+{
+   auto lock = std::unique_lock { sHostIoMutex };
+   if (sHostIoThreadsRunning) {
+      return;
+   }
+
+   sHostIoThreadsRunning = true;
+
+   for (auto i = 0; i < NumHostIoThreads; ++i) {
+      sHostIoThreads.emplace_back(hostIoThread);
+      platform::setThreadName(&sHostIoThreads.back(),
+                              fmt::format("IOS Host IO {}", i));
+   }
+}
+
+void
+stopHostIoThreads()
+{
+   {
+      auto lock = std::unique_lock { sHostIoMutex };
+      if (!sHostIoThreadsRunning) {
+         return;
+      }
+
+      sHostIoThreadsRunning = false;
+      sHostIoRequests = { };
+   }
+
+   sHostIoConditionVariable.notify_all();
+
+   for (auto &thread : sHostIoThreads) {
+      thread.join();
+   }
+
+   sHostIoThreads.clear();
+}
+
+/**
+ * Queue a read at an absolute position in file, callback is called from a
+ * host IO thread with the result of FileHandle::readAt.
+ */
+void
+submitHostRead(std::shared_ptr<vfs::FileHandle> file,
+               void *buffer,
+               int64_t size,
+               int64_t count,
+               int64_t position,
+               HostReadCallback callback)
+{
+   {
+      auto lock = std::unique_lock { sHostIoMutex };
+      sHostIoRequests.push({ std::move(file), buffer, size, count, position,
+                             std::move(callback) });
+   }
+
+   sHostIoConditionVariable.notify_one();
+}
+
+} // namespace ios::fs::internal
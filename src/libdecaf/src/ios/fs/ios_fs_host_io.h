@@ -0,0 +1,26 @@
+#pragma once
+#include "vfs/vfs_filehandle.h"
+
+#include <functional>
+#include <memory>
+
+namespace ios::fs::internal
+{
+
+using HostReadCallback = std::function<void(vfs::Result<int64_t>)>;
+
+void
+startHostIoThreads();
+
+void
+stopHostIoThreads();
+
+void
+submitHostRead(std::shared_ptr<vfs::FileHandle> file,
+               void *buffer,
+               int64_t size,
+               int64_t count,
+               int64_t position,
+               HostReadCallback callback);
+
+} // namespace ios::fs::internal
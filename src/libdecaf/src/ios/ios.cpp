@@ -2,6 +2,7 @@
 #include "ios_alarm_thread.h"
 #include "ios_network_thread.h"
 #include "ios_worker_thread.h"
+#include "ios/fs/ios_fs_host_io.h"
 #include "ios/kernel/ios_kernel.h"
 #include "vfs/vfs_virtual_device.h"
 
@@ -18,6 +19,7 @@ start()
    internal::startAlarmThread();
    internal::startNetworkTaskThread();
    internal::startWorkerThread();
+   fs::internal::startHostIoThreads();
    kernel::start();
 }
 
@@ -26,6 +28,7 @@ join()
 {
    kernel::join();
    internal::stopWorkerThread();
+   fs::internal::stopHostIoThreads();
    internal::stopNetworkTaskThread();
    internal::stopAlarmThread();
 }
@@ -35,6 +38,7 @@ stop()
 {
    kernel::stop();
    internal::stopWorkerThread();
+   fs::internal::stopHostIoThreads();
    internal::stopNetworkTaskThread();
    internal::stopAlarmThread();
 }
@@ -1,51 +1,219 @@
 #include "ios_worker_thread.h"
+#include "decaf_config.h"
 
+#include <algorithm>
 #include <atomic>
+#include <common/atomicqueue.h>
+#include <common/decaf_assert.h>
+#include <common/platform_thread.h>
 #include <condition_variable>
-#include <functional>
+#include <fmt/format.h>
 #include <mutex>
-#include <queue>
 #include <thread>
+#include <vector>
 
 namespace ios::internal
 {
 
-using WorkerTask = std::function<void()>;
+/*
+Tasks are hashed by their key onto a fixed number of worker queues. A queue
+is only ever run by one worker thread at a time, which keeps tasks with the
+same key in order, while tasks on other queues run in parallel on the
+remaining workers.
 
-static std::thread
-sWorkerThread;
+Submitting a task pushes it onto its queue, the first task to make a queue
+non-empty also pushes the queue onto the ready queue. A worker which pops a
+queue from the ready queue owns it until the queue is drained, or until it
+has run MaxTasksPerTurn tasks at which point the queue goes to the back of
+the ready queue so one busy key can not starve the others.
+
+Statistics are kept per key rather than per queue, as unrelated devices can
+share a queue. A key claims a stats slot the first time it is submitted and
+keeps it, once all slots are taken further keys are not tracked.
+*/
+static constexpr auto NumWorkerQueues = 64u;
+static constexpr auto MaxQueuedTasks = 256u;
+static constexpr auto MaxTasksPerTurn = 16;
+static constexpr auto MaxWorkerThreads = 4u;
+static constexpr auto MaxStatsKeys = 256u;
+
+struct WorkerKeyStats
+{
+   //! The key this slot belongs to plus one, zero while the slot is unused.
+   std::atomic<uint64_t> slotKey { 0 };
+
+   std::atomic<uint64_t> submitted { 0 };
+   std::atomic<uint64_t> completed { 0 };
+   std::atomic<uint64_t> maxDepth { 0 };
+   std::atomic<uint64_t> totalWaitNs { 0 };
+   std::atomic<uint64_t> maxWaitNs { 0 };
+   std::atomic<uint64_t> totalRunNs { 0 };
+   std::atomic<uint64_t> maxRunNs { 0 };
+};
+
+struct QueuedTask
+{
+   WorkerTask task;
+   std::chrono::steady_clock::time_point submitTime;
+   WorkerKeyStats *stats = nullptr;
+};
+
+struct WorkerQueue
+{
+   BoundedAtomicQueue<QueuedTask, MaxQueuedTasks> tasks;
+
+   //! Number of tasks submitted but not yet completed, the queue is in the
+   //! ready queue or owned by a worker while this is non-zero.
+   std::atomic<uint32_t> pending { 0 };
+};
+
+static WorkerQueue
+sWorkerQueues[NumWorkerQueues];
+
+static WorkerKeyStats
+sWorkerKeyStats[MaxStatsKeys];
+
+static BoundedAtomicQueue<WorkerQueue *, NumWorkerQueues>
+sReadyQueues;
+
+static std::vector<std::thread>
+sWorkerThreads;
 
 static std::atomic<bool>
 sWorkerThreadRunning { false };
 
+static std::atomic<uint32_t>
+sNumReadyQueues { 0 };
+
+static std::atomic<uint32_t>
+sNumSleepingWorkers { 0 };
+
 static std::condition_variable
 sWorkerThreadConditionVariable;
 
 static std::mutex
 sWorkerThreadMutex;
 
-static std::queue<WorkerTask>
-sWorkerThreadTasks;
+static void
+updateMaximum(std::atomic<uint64_t> &maximum,
+              uint64_t value)
+{
+   auto current = maximum.load(std::memory_order_relaxed);
+   while (value > current &&
+          !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+   }
+}
+
+/**
+ * Find the stats slot for key, claiming a free one if this is the first time
+ * the key has been seen. Returns nullptr if every slot is taken.
+ */
+static WorkerKeyStats *
+getKeyStats(WorkerQueueKey key)
+{
+   auto slotKey = static_cast<uint64_t>(key) + 1;
+
+   for (auto i = 0u; i < MaxStatsKeys; ++i) {
+      auto &stats = sWorkerKeyStats[(key + i) % MaxStatsKeys];
+      auto current = stats.slotKey.load(std::memory_order_acquire);
+
+      if (current == 0 &&
+          stats.slotKey.compare_exchange_strong(current, slotKey,
+                                                std::memory_order_acq_rel)) {
+         return &stats;
+      }
+
+      if (current == slotKey) {
+         return &stats;
+      }
+   }
+
+   return nullptr;
+}
+
+static void
+scheduleQueue(WorkerQueue *queue)
+{
+   auto pushed = sReadyQueues.push(queue);
+   decaf_check(pushed);
+   sNumReadyQueues.fetch_add(1);
+
+   if (sNumSleepingWorkers.load() != 0) {
+      auto lock = std::unique_lock { sWorkerThreadMutex };
+      sWorkerThreadConditionVariable.notify_one();
+   }
+}
+
+static void
+runQueue(WorkerQueue *queue)
+{
+   auto task = QueuedTask { };
+
+   for (auto i = 0; i < MaxTasksPerTurn; ++i) {
+      // pending is only incremented after the push completes, but a push
+      // for an earlier slot may still be in progress so we might have to
+      // wait for it to be published.
+      while (!queue->tasks.pop(task)) {
+         std::this_thread::yield();
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      task.task();
+      auto end = std::chrono::steady_clock::now();
+      task.task.reset();
+
+      if (auto stats = task.stats) {
+         auto waitNs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(start - task.submitTime).count());
+         auto runNs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+         stats->totalWaitNs.fetch_add(waitNs, std::memory_order_relaxed);
+         stats->totalRunNs.fetch_add(runNs, std::memory_order_relaxed);
+         updateMaximum(stats->maxWaitNs, waitNs);
+         updateMaximum(stats->maxRunNs, runNs);
+         stats->completed.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      if (queue->pending.fetch_sub(1) == 1) {
+         // Queue is drained, the next submit will schedule it again
+         return;
+      }
+   }
+
+   scheduleQueue(queue);
+}
 
 static void
 iosWorkerThread()
 {
    while (sWorkerThreadRunning) {
-      auto lock = std::unique_lock { sWorkerThreadMutex };
+      auto queue = static_cast<WorkerQueue *>(nullptr);
 
-      if (sWorkerThreadTasks.empty()) {
-         sWorkerThreadConditionVariable.wait(lock);
-         if (!sWorkerThreadRunning) {
-            break;
-         }
+      if (sReadyQueues.pop(queue)) {
+         sNumReadyQueues.fetch_sub(1);
+         runQueue(queue);
+         continue;
       }
 
-      auto task = std::move(sWorkerThreadTasks.front());
-      sWorkerThreadTasks.pop();
-      lock.unlock();
+      auto lock = std::unique_lock { sWorkerThreadMutex };
+      sNumSleepingWorkers.fetch_add(1);
+      sWorkerThreadConditionVariable.wait(lock, [] {
+         return !sWorkerThreadRunning || sNumReadyQueues.load() != 0;
+      });
+      sNumSleepingWorkers.fetch_sub(1);
+   }
+}
 
-      task();
+static unsigned int
+getNumWorkerThreads()
+{
+   auto numThreads = decaf::config()->system.ios_worker_threads;
+   if (numThreads == 0) {
+      numThreads = std::clamp(std::thread::hardware_concurrency() / 2,
+                              2u, MaxWorkerThreads);
    }
+
+   return numThreads;
 }
 
 void
@@ -53,7 +221,13 @@ startWorkerThread()
 {
    if (!sWorkerThreadRunning) {
       sWorkerThreadRunning = true;
-      sWorkerThread = std::thread { iosWorkerThread };
+
+      auto numThreads = getNumWorkerThreads();
+      for (auto i = 0u; i < numThreads; ++i) {
+         sWorkerThreads.emplace_back(iosWorkerThread);
+         platform::setThreadName(&sWorkerThreads.back(),
+                                 fmt::format("IOS Worker {}", i));
+      }
    }
 }
 
@@ -61,19 +235,95 @@ void
 stopWorkerThread()
 {
    if (sWorkerThreadRunning) {
-      sWorkerThreadRunning = false;
+      {
+         auto lock = std::unique_lock { sWorkerThreadMutex };
+         sWorkerThreadRunning = false;
+      }
+
       sWorkerThreadConditionVariable.notify_all();
-      sWorkerThread.join();
-      sWorkerThreadTasks = {};
+
+      for (auto &thread : sWorkerThreads) {
+         thread.join();
+      }
+
+      sWorkerThreads.clear();
+
+      // Discard any tasks which did not get to run
+      auto queue = static_cast<WorkerQueue *>(nullptr);
+      while (sReadyQueues.pop(queue)) {
+      }
+
+      for (auto &workerQueue : sWorkerQueues) {
+         auto task = QueuedTask { };
+         while (workerQueue.tasks.pop(task)) {
+            // Count it as completed so the key's depth goes back to zero
+            if (task.stats) {
+               task.stats->completed.fetch_add(1, std::memory_order_relaxed);
+            }
+         }
+
+         workerQueue.pending = 0;
+      }
+
+      sNumReadyQueues = 0;
    }
 }
 
 void
-submitWorkerTask(WorkerTask task)
+submitWorkerTask(WorkerQueueKey key,
+                 WorkerTask task)
 {
-   auto lock = std::unique_lock { sWorkerThreadMutex };
-   sWorkerThreadTasks.push(std::move(task));
-   sWorkerThreadConditionVariable.notify_all();
+   auto queue = &sWorkerQueues[key % NumWorkerQueues];
+   auto stats = getKeyStats(key);
+   auto queuedTask = QueuedTask { std::move(task), std::chrono::steady_clock::now(), stats };
+
+   if (stats) {
+      // Tasks submitted by other threads may complete before we read
+      // completed, so it can be ahead of our view of submitted
+      auto submitted = stats->submitted.fetch_add(1, std::memory_order_relaxed) + 1;
+      auto completed = stats->completed.load(std::memory_order_relaxed);
+      if (submitted > completed) {
+         updateMaximum(stats->maxDepth, submitted - completed);
+      }
+   }
+
+   while (!queue->tasks.push(std::move(queuedTask))) {
+      // Queue is full, wait for the workers to catch up
+      std::this_thread::yield();
+   }
+
+   if (queue->pending.fetch_add(1) == 0) {
+      scheduleQueue(queue);
+   }
+}
+
+void
+sampleWorkerQueueStats(std::vector<WorkerQueueStats> &stats)
+{
+   stats.clear();
+
+   for (auto &keyStats : sWorkerKeyStats) {
+      auto slotKey = keyStats.slotKey.load(std::memory_order_acquire);
+      if (slotKey == 0) {
+         continue;
+      }
+
+      auto &stat = stats.emplace_back();
+      stat.key = static_cast<WorkerQueueKey>(slotKey - 1);
+      stat.submitted = keyStats.submitted.load(std::memory_order_relaxed);
+      stat.completed = keyStats.completed.load(std::memory_order_relaxed);
+      stat.depth = stat.submitted - std::min(stat.submitted, stat.completed);
+      stat.maxDepth = keyStats.maxDepth.load(std::memory_order_relaxed);
+      stat.totalWaitNs = keyStats.totalWaitNs.load(std::memory_order_relaxed);
+      stat.maxWaitNs = keyStats.maxWaitNs.load(std::memory_order_relaxed);
+      stat.totalRunNs = keyStats.totalRunNs.load(std::memory_order_relaxed);
+      stat.maxRunNs = keyStats.maxRunNs.load(std::memory_order_relaxed);
+   }
+
+   std::sort(stats.begin(), stats.end(),
+             [](const WorkerQueueStats &lhs, const WorkerQueueStats &rhs) {
+                return lhs.key < rhs.key;
+             });
 }
 
 } // namespace ios::internal
@@ -1,9 +1,135 @@
-#include <functional>
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace ios::internal
 {
 
-using WorkerTask = std::function<void()>;
+/**
+ * A move-only void() callable stored inline, so submitting a task to the
+ * worker threads never allocates.
+ */
+class WorkerTask
+{
+public:
+   static constexpr auto InlineSize = std::size_t { 96 };
+
+   WorkerTask() = default;
+
+   template<typename Callable,
+            typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, WorkerTask>>>
+   WorkerTask(Callable &&callable)
+   {
+      using Type = std::decay_t<Callable>;
+      static_assert(sizeof(Type) <= InlineSize,
+                    "Callable is too large for WorkerTask inline storage");
+      static_assert(alignof(Type) <= alignof(std::max_align_t),
+                    "Callable is over aligned for WorkerTask inline storage");
+
+      new (mStorage) Type { std::forward<Callable>(callable) };
+      mOperations = &sOperations<Type>;
+   }
+
+   WorkerTask(WorkerTask &&other) noexcept
+   {
+      *this = std::move(other);
+   }
+
+   WorkerTask &operator =(WorkerTask &&other) noexcept
+   {
+      if (this != &other) {
+         reset();
+
+         if (other.mOperations) {
+            other.mOperations->move(mStorage, other.mStorage);
+            mOperations = other.mOperations;
+            other.reset();
+         }
+      }
+
+      return *this;
+   }
+
+   WorkerTask(const WorkerTask &) = delete;
+   WorkerTask &operator =(const WorkerTask &) = delete;
+
+   ~WorkerTask()
+   {
+      reset();
+   }
+
+   explicit operator bool() const
+   {
+      return mOperations != nullptr;
+   }
+
+   void operator()()
+   {
+      mOperations->invoke(mStorage);
+   }
+
+   void reset()
+   {
+      if (mOperations) {
+         mOperations->destroy(mStorage);
+         mOperations = nullptr;
+      }
+   }
+
+private:
+   struct Operations
+   {
+      void (*invoke)(void *storage);
+      void (*move)(void *dst, void *src);
+      void (*destroy)(void *storage);
+   };
+
+   template<typename Type>
+   static constexpr Operations sOperations = {
+      [](void *storage) {
+         (*std::launder(reinterpret_cast<Type *>(storage)))();
+      },
+      [](void *dst, void *src) {
+         new (dst) Type { std::move(*std::launder(reinterpret_cast<Type *>(src))) };
+      },
+      [](void *storage) {
+         std::launder(reinterpret_cast<Type *>(storage))->~Type();
+      },
+   };
+
+   const Operations *mOperations = nullptr;
+   alignas(std::max_align_t) unsigned char mStorage[InlineSize];
+};
+
+//! Tasks submitted with the same key run in submission order, tasks with
+//! different keys may run in parallel.
+using WorkerQueueKey = uint32_t;
+
+struct WorkerQueueStats
+{
+   //! The key these statistics are for.
+   WorkerQueueKey key = 0;
+
+   uint64_t submitted = 0;
+   uint64_t completed = 0;
+
+   //! Number of tasks currently queued or running.
+   uint64_t depth = 0;
+   uint64_t maxDepth = 0;
+
+   //! Time from submission until the task started running.
+   uint64_t totalWaitNs = 0;
+   uint64_t maxWaitNs = 0;
+
+   //! Time spent running tasks.
+   uint64_t totalRunNs = 0;
+   uint64_t maxRunNs = 0;
+};
 
 void
 startWorkerThread();
@@ -12,6 +138,11 @@ void
 stopWorkerThread();
 
 void
-submitWorkerTask(WorkerTask task);
+submitWorkerTask(WorkerQueueKey key,
+                 WorkerTask task);
+
+//! Returns the statistics of every key which has been submitted, sorted by key.
+void
+sampleWorkerQueueStats(std::vector<WorkerQueueStats> &stats);
 
 } // namespace ios::internal
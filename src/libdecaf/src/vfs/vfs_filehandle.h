@@ -36,6 +36,18 @@ public:
    virtual Result<int64_t> truncate() = 0;
    virtual Result<int64_t> read(void *buffer, int64_t size, int64_t count) = 0;
    virtual Result<int64_t> write(const void *buffer, int64_t size, int64_t count) = 0;
+
+   /**
+    * Read at an absolute position without using or changing the current
+    * file position.
+    *
+    * Unlike the other functions this may be called from multiple threads at
+    * once, handles which can not support that return OperationNotSupported.
+    */
+   virtual Result<int64_t> readAt(void *buffer, int64_t size, int64_t count, int64_t position)
+   {
+      return { Error::OperationNotSupported };
+   }
 };
 
 } // namespace vfs
@@ -1,20 +1,24 @@
 #include "vfs_host_device.h"
 #include "vfs_host_directoryiterator.h"
 #include "vfs_host_filehandle.h"
+#include "vfs_host_mappedfilehandle.h"
 #include "vfs_link_device.h"
 #include "vfs_virtual_device.h"
 
 #include <algorithm>
 #include <common/platform.h>
+#include <common/platform_memory.h>
 #include <system_error>
 #include <vector>
 
 namespace vfs
 {
 
-HostDevice::HostDevice(std::filesystem::path path) :
+HostDevice::HostDevice(std::filesystem::path path,
+                       bool mapReadOnlyFiles) :
    Device(Device::Host),
    mHostPath(std::move(path)),
+   mMapReadOnlyFiles(mapReadOnlyFiles),
    mVirtualDevice(std::make_shared<VirtualDevice>())
 {
 }
@@ -180,6 +184,39 @@ translateOpenMode(FileHandle::Mode mode)
    return result;
 }
 
+static std::unique_ptr<FileHandle>
+openMappedFile(const std::filesystem::path &hostPath,
+               FileHandle::Mode mode)
+{
+   // Empty files can not be mapped, leave them to fopen
+   auto ec = std::error_code { };
+   if (!std::filesystem::is_regular_file(hostPath, ec) ||
+       std::filesystem::file_size(hostPath, ec) == 0 || ec) {
+      return nullptr;
+   }
+
+   auto size = size_t { 0 };
+   auto handle = platform::openMemoryMappedFile(hostPath.string(),
+                                                platform::ProtectFlags::ReadOnly,
+                                                &size);
+   if (handle == platform::InvalidMapFileHandle) {
+      return nullptr;
+   }
+
+   auto view = platform::mapViewOfFile(handle,
+                                       platform::ProtectFlags::ReadOnly,
+                                       0, size);
+   if (!view) {
+      platform::closeMemoryMappedFile(handle);
+      return nullptr;
+   }
+
+   return std::make_unique<HostMappedFileHandle>(handle,
+                                                 static_cast<uint8_t *>(view),
+                                                 static_cast<int64_t>(size),
+                                                 mode);
+}
+
 Result<std::unique_ptr<FileHandle>>
 HostDevice::openFile(const User &user,
                      const Path &path,
@@ -204,6 +241,13 @@ HostDevice::openFile(const User &user,
       }
    }
 
+   if (mMapReadOnlyFiles &&
+       !(mode & (FileHandle::Write | FileHandle::Append | FileHandle::Update))) {
+      if (auto handle = openMappedFile(makeHostPath(path), mode)) {
+         return { std::move(handle) };
+      }
+   }
+
    auto hostMode = translateOpenMode(mode);
 #ifdef PLATFORM_WINDOWS
    auto handle = static_cast<FILE *>(nullptr);
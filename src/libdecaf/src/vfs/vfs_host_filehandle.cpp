@@ -1,10 +1,12 @@
 #include "vfs_host_filehandle.h"
 
 #include <common/platform.h>
+#include <system_error>
 
 #ifdef PLATFORM_WINDOWS
 #include <io.h>
 #elif defined(PLATFORM_POSIX)
+#include <cerrno>
 #include <unistd.h>
 #include <sys/types.h>
 #endif
@@ -12,6 +14,31 @@
 namespace vfs
 {
 
+#ifdef PLATFORM_POSIX
+static Error
+translateErrno(int error)
+{
+   auto ec = std::error_code { error, std::generic_category() };
+
+   if (ec == std::errc::bad_file_descriptor) {
+      return Error::NotOpen;
+   } else if (ec == std::errc::is_a_directory) {
+      return Error::NotFile;
+   } else if (ec == std::errc::invalid_argument ||
+              ec == std::errc::value_too_large) {
+      return Error::InvalidSeekPosition;
+   } else if (ec == std::errc::invalid_seek ||
+              ec == std::errc::no_such_device_or_address) {
+      return Error::OperationNotSupported;
+   } else if (ec == std::errc::permission_denied ||
+              ec == std::errc::operation_not_permitted) {
+      return Error::Permission;
+   }
+
+   return Error::GenericError;
+}
+#endif
+
 HostFileHandle::HostFileHandle(FILE *handle, Mode mode) :
    mHandle(handle),
    mMode(mode)
@@ -196,4 +223,52 @@ HostFileHandle::write(const void *buffer, int64_t size, int64_t count)
    return { static_cast<int64_t>(fwrite(buffer, size, count, mHandle)) };
 }
 
+Result<int64_t>
+HostFileHandle::readAt(void *buffer, int64_t size, int64_t count, int64_t position)
+{
+   if (!mHandle) {
+      return { Error::NotOpen };
+   }
+
+   // Concurrent reads could race with writes through this handle
+   if (mMode & (Write | Append | Update)) {
+      return { Error::OperationNotSupported };
+   }
+
+   if (size <= 0 || count <= 0) {
+      return { int64_t { 0 } };
+   }
+
+#if defined(PLATFORM_POSIX)
+   auto bytes = size * count;
+   auto bytesRead = int64_t { 0 };
+   auto dst = reinterpret_cast<uint8_t *>(buffer);
+
+   while (bytesRead < bytes) {
+      auto result = pread(fileno(mHandle), dst + bytesRead,
+                          static_cast<size_t>(bytes - bytesRead),
+                          static_cast<off_t>(position + bytesRead));
+      if (result < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+
+         return { translateErrno(errno) };
+      }
+
+      if (result == 0) {
+         break;
+      }
+
+      bytesRead += result;
+   }
+
+   return { bytesRead / size };
+#else
+   // ReadFile with an offset moves the file pointer on Windows, so it is not
+   // safe to use alongside the FILE * in other threads.
+   return { Error::OperationNotSupported };
+#endif
+}
+
 } // namespace vfs
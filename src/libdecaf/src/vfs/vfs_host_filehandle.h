@@ -21,6 +21,7 @@ public:
    Result<int64_t> truncate() override;
    Result<int64_t> read(void *buffer, int64_t size, int64_t count) override;
    Result<int64_t> write(const void *buffer, int64_t size, int64_t count) override;
+   Result<int64_t> readAt(void *buffer, int64_t size, int64_t count, int64_t position) override;
 
 private:
    FILE *mHandle;
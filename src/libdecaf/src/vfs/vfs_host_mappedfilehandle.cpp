@@ -0,0 +1,260 @@
+#include "vfs_host_mappedfilehandle.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vfs
+{
+
+//! Number of consecutive sequential reads before we start reading ahead.
+static constexpr auto SequentialReadThreshold = 2;
+
+//! Number of consecutive non-sequential reads before we disable readahead.
+static constexpr auto RandomReadThreshold = 4;
+
+//! Reads at least this large are prefetched as a whole before copying.
+static constexpr auto MinPrefetchReadSize = int64_t { 64 * 1024 };
+
+static constexpr auto MinReadaheadSize = int64_t { 256 * 1024 };
+static constexpr auto MaxReadaheadSize = int64_t { 8 * 1024 * 1024 };
+
+HostMappedFileHandle::HostMappedFileHandle(platform::MapFileHandle handle,
+                                           uint8_t *view,
+                                           int64_t size,
+                                           Mode mode) :
+   mHandle(handle),
+   mView(view),
+   mSize(size),
+   mPosition(0),
+   mEof(false),
+   mMode(mode),
+   mLastReadEnd(-1),
+   mPrefetchEnd(0),
+   mSequentialReads(0),
+   mRandomReads(0),
+   mAccessPattern(platform::AccessPattern::Normal)
+{
+}
+
+HostMappedFileHandle::~HostMappedFileHandle()
+{
+   close();
+}
+
+Error
+HostMappedFileHandle::close()
+{
+   if (mView) {
+      platform::unmapViewOfFile(mView, static_cast<size_t>(mSize));
+      mView = nullptr;
+   }
+
+   if (mHandle != platform::InvalidMapFileHandle) {
+      platform::closeMemoryMappedFile(mHandle);
+      mHandle = platform::InvalidMapFileHandle;
+   }
+
+   return Error::Success;
+}
+
+Result<bool>
+HostMappedFileHandle::eof()
+{
+   if (!mView) {
+      return { Error::NotOpen };
+   }
+
+   return { mEof };
+}
+
+Error
+HostMappedFileHandle::flush()
+{
+   if (!mView) {
+      return Error::NotOpen;
+   }
+
+   return Error::Success;
+}
+
+Error
+HostMappedFileHandle::seek(SeekDirection direction,
+                           int64_t offset)
+{
+   if (!mView) {
+      return Error::NotOpen;
+   }
+
+   auto position = mPosition;
+   switch (direction) {
+   case SeekCurrent:
+      position += offset;
+      break;
+   case SeekEnd:
+      position = mSize + offset;
+      break;
+   case SeekStart:
+      position = offset;
+      break;
+   default:
+      return Error::InvalidSeekDirection;
+   }
+
+   if (position < 0) {
+      return Error::InvalidSeekPosition;
+   }
+
+   // Like fseek, a successful seek clears the end of file indicator
+   mPosition = position;
+   mEof = false;
+   return Error::Success;
+}
+
+Result<int64_t>
+HostMappedFileHandle::size()
+{
+   if (!mView) {
+      return { Error::NotOpen };
+   }
+
+   return { mSize };
+}
+
+Result<int64_t>
+HostMappedFileHandle::tell()
+{
+   if (!mView) {
+      return { Error::NotOpen };
+   }
+
+   return { mPosition };
+}
+
+Result<int64_t>
+HostMappedFileHandle::truncate()
+{
+   if (!mView) {
+      return { Error::NotOpen };
+   }
+
+   return { Error::ReadOnly };
+}
+
+Result<int64_t>
+HostMappedFileHandle::read(void *buffer,
+                           int64_t size,
+                           int64_t count)
+{
+   if (!mView) {
+      return { Error::NotOpen };
+   }
+
+   if (size <= 0 || count <= 0) {
+      return { int64_t { 0 } };
+   }
+
+   // Match fread: the position moves past any partial element read and a
+   // short read sets the end of file indicator.
+   auto bytes = size * count;
+   auto bytesRead = copyAt(buffer, bytes, mPosition);
+   mPosition += bytesRead;
+
+   if (bytesRead < bytes) {
+      mEof = true;
+   }
+
+   return { bytesRead / size };
+}
+
+Result<int64_t>
+HostMappedFileHandle::write(const void *buffer,
+                            int64_t size,
+                            int64_t count)
+{
+   if (!mView) {
+      return { Error::NotOpen };
+   }
+
+   return { Error::ReadOnly };
+}
+
+Result<int64_t>
+HostMappedFileHandle::readAt(void *buffer,
+                             int64_t size,
+                             int64_t count,
+                             int64_t position)
+{
+   if (!mView) {
+      return { Error::NotOpen };
+   }
+
+   if (size <= 0 || count <= 0 || position < 0) {
+      return { int64_t { 0 } };
+   }
+
+   return { copyAt(buffer, size * count, position) / size };
+}
+
+int64_t
+HostMappedFileHandle::copyAt(void *buffer,
+                             int64_t bytes,
+                             int64_t position)
+{
+   if (position >= mSize) {
+      return 0;
+   }
+
+   bytes = std::min(bytes, mSize - position);
+   adviseRead(position, bytes);
+   std::memcpy(buffer, mView + position, static_cast<size_t>(bytes));
+   return bytes;
+}
+
+void
+HostMappedFileHandle::adviseRead(int64_t position,
+                                 int64_t bytes)
+{
+   auto end = position + bytes;
+   auto pattern = mAccessPattern.load(std::memory_order_relaxed);
+
+   if (mLastReadEnd.exchange(end, std::memory_order_relaxed) == position) {
+      mRandomReads.store(0, std::memory_order_relaxed);
+
+      if (mSequentialReads.fetch_add(1, std::memory_order_relaxed) + 1 >= SequentialReadThreshold) {
+         pattern = platform::AccessPattern::Sequential;
+      }
+   } else {
+      mSequentialReads.store(0, std::memory_order_relaxed);
+      mPrefetchEnd.store(0, std::memory_order_relaxed);
+
+      if (mRandomReads.fetch_add(1, std::memory_order_relaxed) + 1 >= RandomReadThreshold) {
+         pattern = platform::AccessPattern::Random;
+      }
+   }
+
+   if (mAccessPattern.exchange(pattern, std::memory_order_relaxed) != pattern) {
+      platform::adviseMemoryAccess(mView, static_cast<size_t>(mSize), pattern);
+   }
+
+   // Fault in large reads with one request rather than a page at a time
+   if (bytes >= MinPrefetchReadSize &&
+       end > mPrefetchEnd.load(std::memory_order_relaxed)) {
+      platform::prefetchMemory(mView + position, static_cast<size_t>(bytes));
+   }
+
+   // Stay ahead of sequential streams, the window grows with the read size
+   if (pattern == platform::AccessPattern::Sequential) {
+      auto window = std::clamp(bytes * 4, MinReadaheadSize, MaxReadaheadSize);
+      auto prefetchStart = std::max(end, mPrefetchEnd.load(std::memory_order_relaxed));
+      auto prefetchEnd = std::min(end + window, mSize);
+
+      // Only issue a new hint once we have consumed half of the last window
+      if (prefetchEnd > prefetchStart && prefetchStart - end < window / 2) {
+         platform::prefetchMemory(mView + prefetchStart,
+                                  static_cast<size_t>(prefetchEnd - prefetchStart));
+         mPrefetchEnd.store(prefetchEnd, std::memory_order_relaxed);
+      }
+   }
+}
+
+} // namespace vfs
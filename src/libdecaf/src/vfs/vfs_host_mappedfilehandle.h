@@ -0,0 +1,59 @@
+#pragma once
+#include "vfs_filehandle.h"
+
+#include <atomic>
+#include <common/platform_memory.h>
+#include <cstdint>
+
+namespace vfs
+{
+
+/**
+ * A read-only host file which is mapped into memory, reads are a single
+ * memcpy out of the page cache.
+ *
+ * Readahead hints are given to the host based on the access pattern seen so
+ * far, as the kernel's own fault-around readahead is much smaller than the
+ * streaming reads titles typically do.
+ */
+class HostMappedFileHandle : public FileHandle
+{
+public:
+   HostMappedFileHandle(platform::MapFileHandle handle,
+                        uint8_t *view,
+                        int64_t size,
+                        Mode mode);
+   ~HostMappedFileHandle() override;
+
+   Error close() override;
+   Result<bool> eof() override;
+   Error flush() override;
+   Error seek(SeekDirection direction, int64_t offset) override;
+   Result<int64_t> size() override;
+   Result<int64_t> tell() override;
+   Result<int64_t> truncate() override;
+   Result<int64_t> read(void *buffer, int64_t size, int64_t count) override;
+   Result<int64_t> write(const void *buffer, int64_t size, int64_t count) override;
+   Result<int64_t> readAt(void *buffer, int64_t size, int64_t count, int64_t position) override;
+
+private:
+   int64_t copyAt(void *buffer, int64_t bytes, int64_t position);
+   void adviseRead(int64_t position, int64_t bytes);
+
+private:
+   platform::MapFileHandle mHandle;
+   uint8_t *mView;
+   int64_t mSize;
+   int64_t mPosition;
+   bool mEof;
+   Mode mMode;
+
+   //! Access pattern tracking, readAt may be called from multiple threads.
+   std::atomic<int64_t> mLastReadEnd;
+   std::atomic<int64_t> mPrefetchEnd;
+   std::atomic<int> mSequentialReads;
+   std::atomic<int> mRandomReads;
+   std::atomic<platform::AccessPattern> mAccessPattern;
+};
+
+} // namespace vfs
@@ -4,6 +4,25 @@
 namespace gpu7::tiling::cpu
 {
 
+enum class KernelIsa
+{
+   Scalar,
+   SSE2,
+   AVX2,
+};
+
+KernelIsa
+getKernelIsa();
+
+bool
+setKernelIsa(KernelIsa isa);
+
+uint32_t
+getNumThreads();
+
+void
+setNumThreads(uint32_t numThreads);
+
 void
 untile(const RetileInfo& desc,
        uint8_t* untiled,
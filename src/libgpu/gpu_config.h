@@ -2,6 +2,7 @@
 #include <array>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace gpu
@@ -50,10 +51,23 @@ struct DisplaySettings
    ViewMode viewMode = ViewMode::Split;
 };
 
+struct ShaderCacheSettings
+{
+   //! Store translated shaders on disk so they can be reused across runs
+   bool enabled = true;
+
+   //! Directory the shader cache is stored in
+   std::string path = "shader_cache";
+
+   //! Read every cache entry at startup instead of on first use
+   bool preload = false;
+};
+
 struct Settings
 {
    DebugSettings debug;
    DisplaySettings display;
+   ShaderCacheSettings shaderCache;
 };
 
 std::shared_ptr<const Settings> config();
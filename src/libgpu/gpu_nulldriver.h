@@ -0,0 +1,30 @@
+#pragma once
+#include "gpu_graphicsdriver.h"
+
+#include <cstdint>
+
+namespace gpu
+{
+
+struct NullDriverDebugInfo : GraphicsDriverDebugInfo
+{
+   NullDriverDebugInfo()
+   {
+      type = GraphicsDriverType::Null;
+   }
+
+   uint64_t numSwaps = 0;
+   uint64_t numDraws = 0;
+   uint64_t numIndices = 0;
+
+   //! Registers written by type 0 and SET_* packets.
+   uint64_t numRegisterWrites = 0;
+
+   //! LOAD_* packets, each loads a whole range of registers from memory.
+   uint64_t numRegisterLoads = 0;
+
+   uint64_t numMemWrites = 0;
+   uint64_t numEopEvents = 0;
+};
+
+} // namespace gpu
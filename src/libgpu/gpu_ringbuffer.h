@@ -7,9 +7,43 @@ namespace gpu::ringbuffer
 
 using Buffer = gsl::span<uint32_t>;
 
+//! Number of descriptors which can be queued before the writer stalls.
+static constexpr uint32_t Capacity = 1024;
+
+//! Submissions up to this many words are copied into the descriptor itself,
+//! larger ones into a buffer owned by the descriptor.
+static constexpr uint32_t InlineWords = 28;
+
+struct Stats
+{
+   //! Number of buffers written to the ring.
+   uint64_t writes;
+
+   //! Number of times a writer had to wait for the ring to drain.
+   uint64_t stalls;
+
+   //! Number of times the reader had to be woken up by a writer.
+   uint64_t wakeups;
+
+   //! Number of descriptors currently queued.
+   uint32_t occupancy;
+
+   //! Highest number of descriptors ever queued at once.
+   uint32_t maxOccupancy;
+};
+
 void
 write(const Buffer &buffer);
 
+/**
+ * Queue a host owned buffer without copying it.
+ *
+ * The caller must keep the buffer alive and unmodified until the GPU has
+ * retired it.
+ */
+void
+writeNoCopy(const Buffer &buffer);
+
 Buffer
 read();
 
@@ -19,4 +53,7 @@ wait();
 void
 wake();
 
+Stats
+getStats();
+
 } // namespace gpu::ringbuffer
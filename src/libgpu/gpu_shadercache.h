@@ -0,0 +1,57 @@
+#pragma once
+#ifdef DECAF_VULKAN
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace gpu::shadercache
+{
+
+struct PrewarmStats
+{
+   //! Number of draws processed.
+   uint64_t draws = 0;
+
+   //! Number of shaders which were translated and added to the cache.
+   uint64_t translated = 0;
+
+   //! Number of shaders which were already in the cache.
+   uint64_t cached = 0;
+};
+
+/**
+ * Fills a shader cache from a stream of PM4 command buffers without needing
+ * a Vulkan device.
+ *
+ * Draws are not executed, only the shader descriptions for the current
+ * register state are built and translated, so the shader binaries referenced
+ * by the command buffers must already be loaded into guest memory.
+ */
+class Prewarmer
+{
+   class Impl;
+
+public:
+   Prewarmer(const std::string &cachePath);
+   ~Prewarmer();
+
+   //! Replaces the register state, values are in host byte order.
+   void
+   loadRegisters(const uint32_t *values,
+                 uint32_t count);
+
+   //! Processes a big endian PM4 command buffer.
+   void
+   runCommandBuffer(uint32_t *words,
+                    uint32_t numWords);
+
+   PrewarmStats
+   getStats() const;
+
+private:
+   std::unique_ptr<Impl> mImpl;
+};
+
+} // namespace gpu::shadercache
+
+#endif // ifdef DECAF_VULKAN
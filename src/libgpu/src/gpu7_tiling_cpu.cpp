@@ -2,12 +2,160 @@
 
 #include <common/align.h>
 #include <common/decaf_assert.h>
+#include <common/platform_compiler.h>
+#include <common/platform_intrin.h>
 
+#include <algorithm>
+#include <common/workerpool.h>
 #include <cstring>
+#include <memory>
+#include <mutex>
 
 namespace gpu7::tiling::cpu
 {
 
+static KernelIsa
+getSupportedKernelIsa()
+{
+   if (platform::cpuHasAvx2()) {
+      return KernelIsa::AVX2;
+   }
+
+   // SSE2 is always available on x86-64
+   return KernelIsa::SSE2;
+}
+
+static KernelIsa
+sSupportedKernelIsa = getSupportedKernelIsa();
+
+static KernelIsa
+sKernelIsa = sSupportedKernelIsa;
+
+// Surfaces are split into chunks of at least this many bytes when retiling
+// on the worker pool, anything smaller is not worth the synchronisation.
+static constexpr uint32_t
+MinParallelChunkBytes = 64 * 1024;
+
+static std::mutex
+sWorkerPoolMutex;
+
+static std::shared_ptr<WorkerPool>
+sWorkerPool;
+
+static uint32_t
+sNumThreads = 0;
+
+/**
+ * Returns the worker pool to retile with, or nullptr when retiling should
+ * happen only on the calling thread.
+ */
+static std::shared_ptr<WorkerPool>
+getWorkerPool()
+{
+   std::unique_lock<std::mutex> lock { sWorkerPoolMutex };
+
+   if (!sWorkerPool) {
+      auto numWorkers = sNumThreads ?
+         static_cast<size_t>(sNumThreads - 1) :
+         WorkerPool::getDefaultNumThreads();
+
+      if (numWorkers == 0) {
+         return nullptr;
+      }
+
+      sWorkerPool = std::make_shared<WorkerPool>(numWorkers, "Retile Worker");
+   }
+
+   return sWorkerPool;
+}
+
+/*
+The SIMD kernels below all work on pairs of rows.  Swapping the 128 bit
+lanes or 64 bit halves of two registers is its own inverse, so the same
+kernel is used for both tiling and untiling with source and destination
+swapped.
+*/
+
+// Interleave the 128 bit lanes of two 256 bit rows:
+//   dst0 = { src0[0], src1[0] }, dst1 = { src0[1], src1[1] }
+PLATFORM_TARGET_AVX2 static inline void
+swapLanes128Avx2(const uint8_t *src0,
+                 const uint8_t *src1,
+                 uint8_t *dst0,
+                 uint8_t *dst1)
+{
+   auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src0));
+   auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src1));
+   _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst0), _mm256_permute2x128_si256(a, b, 0x20));
+   _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst1), _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+// Interleave the 64 bit halves of two 128 bit rows:
+//   dst0 = { src0[0], src1[0] }, dst1 = { src0[1], src1[1] }
+static inline void
+swapHalves64Sse2(const uint8_t *src0,
+                 const uint8_t *src1,
+                 uint8_t *dst0,
+                 uint8_t *dst1)
+{
+   auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0));
+   auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst0), _mm_unpacklo_epi64(a, b));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst1), _mm_unpackhi_epi64(a, b));
+}
+
+// Interleave the 32 bit elements of two 128 bit rows:
+//   dst0 = { src0[0], src1[0], src0[1], src1[1] }
+//   dst1 = { src0[2], src1[2], src0[3], src1[3] }
+static inline void
+interleave32Sse2(const uint8_t *src0,
+                 const uint8_t *src1,
+                 uint8_t *dst0,
+                 uint8_t *dst1)
+{
+   auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0));
+   auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst0), _mm_unpacklo_epi32(a, b));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst1), _mm_unpackhi_epi32(a, b));
+}
+
+// Inverse of interleave32Sse2
+static inline void
+deinterleave32Sse2(const uint8_t *src0,
+                   const uint8_t *src1,
+                   uint8_t *dst0,
+                   uint8_t *dst1)
+{
+   auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src0));
+   auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1));
+   auto lo = _mm_unpacklo_epi32(a, b);
+   auto hi = _mm_unpackhi_epi32(a, b);
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst0), _mm_unpacklo_epi32(lo, hi));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst1), _mm_unpackhi_epi32(lo, hi));
+}
+
+// Combine two 64 bit rows into one 128 bit row
+static inline void
+packRows64Sse2(const uint8_t *src0,
+               const uint8_t *src1,
+               uint8_t *dst)
+{
+   auto a = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src0));
+   auto b = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src1));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi64(a, b));
+}
+
+// Split one 128 bit row into two 64 bit rows
+static inline void
+unpackRows64Sse2(const uint8_t *src,
+                 uint8_t *dst0,
+                 uint8_t *dst1)
+{
+   auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+   _mm_storel_epi64(reinterpret_cast<__m128i *>(dst0), a);
+   _mm_storel_epi64(reinterpret_cast<__m128i *>(dst1), _mm_unpackhi_epi64(a, a));
+}
+
 template<
    bool IsUntiling,
    uint32_t MicroTileThickness,
@@ -16,7 +164,8 @@ template<
    bool IsMacro3X,
    bool IsBankSwapped,
    uint32_t BitsPerElement,
-   bool IsDepth
+   bool IsDepth,
+   KernelIsa Isa
 >
 struct RetileCore
 {
@@ -36,6 +185,59 @@ struct RetileCore
       }
    }
 
+   // Moves a pair of 256 bit untiled rows to or from a pair of 256 bit tiled
+   // rows, with the tiled rows holding interleaved 128 bit lanes.
+   static inline void
+   swapLanes128(uint8_t *untiledRow1,
+                uint8_t *untiledRow2,
+                uint8_t *tiledRow1,
+                uint8_t *tiledRow2)
+   {
+      if (IsUntiling) {
+         swapLanes128Avx2(tiledRow1, tiledRow2, untiledRow1, untiledRow2);
+      } else {
+         swapLanes128Avx2(untiledRow1, untiledRow2, tiledRow1, tiledRow2);
+      }
+   }
+
+   static inline void
+   swapHalves64(uint8_t *untiledRow1,
+                uint8_t *untiledRow2,
+                uint8_t *tiledRow1,
+                uint8_t *tiledRow2)
+   {
+      if (IsUntiling) {
+         swapHalves64Sse2(tiledRow1, tiledRow2, untiledRow1, untiledRow2);
+      } else {
+         swapHalves64Sse2(untiledRow1, untiledRow2, tiledRow1, tiledRow2);
+      }
+   }
+
+   static inline void
+   interleave32(uint8_t *untiledRow1,
+                uint8_t *untiledRow2,
+                uint8_t *tiledRow1,
+                uint8_t *tiledRow2)
+   {
+      if (IsUntiling) {
+         deinterleave32Sse2(tiledRow1, tiledRow2, untiledRow1, untiledRow2);
+      } else {
+         interleave32Sse2(untiledRow1, untiledRow2, tiledRow1, tiledRow2);
+      }
+   }
+
+   static inline void
+   packRows64(uint8_t *untiledRow1,
+              uint8_t *untiledRow2,
+              uint8_t *tiled)
+   {
+      if (IsUntiling) {
+         unpackRows64Sse2(tiled, untiledRow1, untiledRow2);
+      } else {
+         packRows64Sse2(untiledRow1, untiledRow2, tiled);
+      }
+   }
+
    static inline void
    retileMicro8(uint8_t *tiled,
                 uint8_t *untiled,
@@ -55,10 +257,15 @@ struct RetileCore
          auto tiledRow2 = tiled + 2 * tiledStride;
          auto tiledRow3 = tiled + 3 * tiledStride;
 
-         copyElems<8>(untiledRow0, tiledRow0, rowElems);
-         copyElems<8>(untiledRow1, tiledRow2, rowElems);
-         copyElems<8>(untiledRow2, tiledRow1, rowElems);
-         copyElems<8>(untiledRow3, tiledRow3, rowElems);
+         if constexpr (Isa != KernelIsa::Scalar) {
+            packRows64(untiledRow0, untiledRow2, tiledRow0);
+            packRows64(untiledRow1, untiledRow3, tiledRow2);
+         } else {
+            copyElems<8>(untiledRow0, tiledRow0, rowElems);
+            copyElems<8>(untiledRow1, tiledRow2, rowElems);
+            copyElems<8>(untiledRow2, tiledRow1, rowElems);
+            copyElems<8>(untiledRow3, tiledRow3, rowElems);
+         }
 
          untiled += 4 * untiledStride;
          tiled += 4 * tiledStride;
@@ -96,11 +303,15 @@ struct RetileCore
          auto tiledRow1 = tiled + 0 * tiledStride;
          auto tiledRow2 = tiled + 1 * tiledStride;
 
-         copyElems<16>(untiledRow1 + 0, tiledRow1 + 0, groupElems);
-         copyElems<16>(untiledRow1 + 16, tiledRow2 + 0, groupElems);
+         if constexpr (Isa == KernelIsa::AVX2) {
+            swapLanes128(untiledRow1, untiledRow2, tiledRow1, tiledRow2);
+         } else {
+            copyElems<16>(untiledRow1 + 0, tiledRow1 + 0, groupElems);
+            copyElems<16>(untiledRow1 + 16, tiledRow2 + 0, groupElems);
 
-         copyElems<16>(untiledRow2 + 0, tiledRow1 + 16, groupElems);
-         copyElems<16>(untiledRow2 + 16, tiledRow2 + 16, groupElems);
+            copyElems<16>(untiledRow2 + 0, tiledRow1 + 16, groupElems);
+            copyElems<16>(untiledRow2 + 16, tiledRow2 + 16, groupElems);
+         }
 
          tiled += tiledStride * 2;
          untiled += untiledStride * 2;
@@ -130,17 +341,22 @@ struct RetileCore
          auto tiledRow1 = tiled + 0 * tiledStride;
          auto tiledRow2 = tiled + 1 * tiledStride;
 
-         copyElems<16>(untiledRow1 + 0, tiledRow1 + 0, groupElems);
-         copyElems<16>(untiledRow2 + 0, tiledRow1 + 16, groupElems);
+         if constexpr (Isa == KernelIsa::AVX2) {
+            swapLanes128(untiledRow1 + 0, untiledRow2 + 0, tiledRow1 + 0, tiledRow1 + 32);
+            swapLanes128(untiledRow1 + 32, untiledRow2 + 32, tiledRow2 + 0, tiledRow2 + 32);
+         } else {
+            copyElems<16>(untiledRow1 + 0, tiledRow1 + 0, groupElems);
+            copyElems<16>(untiledRow2 + 0, tiledRow1 + 16, groupElems);
 
-         copyElems<16>(untiledRow1 + 16, tiledRow1 + 32, groupElems);
-         copyElems<16>(untiledRow2 + 16, tiledRow1 + 48, groupElems);
+            copyElems<16>(untiledRow1 + 16, tiledRow1 + 32, groupElems);
+            copyElems<16>(untiledRow2 + 16, tiledRow1 + 48, groupElems);
 
-         copyElems<16>(untiledRow1 + 32, tiledRow2 + 0, groupElems);
-         copyElems<16>(untiledRow2 + 32, tiledRow2 + 16, groupElems);
+            copyElems<16>(untiledRow1 + 32, tiledRow2 + 0, groupElems);
+            copyElems<16>(untiledRow2 + 32, tiledRow2 + 16, groupElems);
 
-         copyElems<16>(untiledRow1 + 48, tiledRow2 + 32, groupElems);
-         copyElems<16>(untiledRow2 + 48, tiledRow2 + 48, groupElems);
+            copyElems<16>(untiledRow1 + 48, tiledRow2 + 32, groupElems);
+            copyElems<16>(untiledRow2 + 48, tiledRow2 + 48, groupElems);
+         }
 
          tiled += tiledStride * 2;
          untiled += untiledStride * 2;
@@ -163,25 +379,32 @@ struct RetileCore
          auto tiledRow1 = tiled + 0 * tiledStride;
          auto tiledRow2 = tiled + 1 * tiledStride;
 
-         copyElems<16>(untiledRow1 + 0 * groupBytes, tiledRow1 + 0 * groupBytes, groupElems);
-         copyElems<16>(untiledRow1 + 1 * groupBytes, tiledRow1 + 2 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 0 * groupBytes, tiledRow1 + 1 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 1 * groupBytes, tiledRow1 + 3 * groupBytes, groupElems);
-
-         copyElems<16>(untiledRow1 + 2 * groupBytes, tiledRow1 + 4 * groupBytes, groupElems);
-         copyElems<16>(untiledRow1 + 3 * groupBytes, tiledRow1 + 6 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 2 * groupBytes, tiledRow1 + 5 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 3 * groupBytes, tiledRow1 + 7 * groupBytes, groupElems);
-
-         copyElems<16>(untiledRow1 + 4 * groupBytes, tiledRow2 + 0 * groupBytes, groupElems);
-         copyElems<16>(untiledRow1 + 5 * groupBytes, tiledRow2 + 2 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 4 * groupBytes, tiledRow2 + 1 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 5 * groupBytes, tiledRow2 + 3 * groupBytes, groupElems);
-
-         copyElems<16>(untiledRow1 + 6 * groupBytes, tiledRow2 + 4 * groupBytes, groupElems);
-         copyElems<16>(untiledRow1 + 7 * groupBytes, tiledRow2 + 6 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 6 * groupBytes, tiledRow2 + 5 * groupBytes, groupElems);
-         copyElems<16>(untiledRow2 + 7 * groupBytes, tiledRow2 + 7 * groupBytes, groupElems);
+         if constexpr (Isa == KernelIsa::AVX2) {
+            swapLanes128(untiledRow1 + 0 * groupBytes, untiledRow2 + 0 * groupBytes, tiledRow1 + 0 * groupBytes, tiledRow1 + 2 * groupBytes);
+            swapLanes128(untiledRow1 + 2 * groupBytes, untiledRow2 + 2 * groupBytes, tiledRow1 + 4 * groupBytes, tiledRow1 + 6 * groupBytes);
+            swapLanes128(untiledRow1 + 4 * groupBytes, untiledRow2 + 4 * groupBytes, tiledRow2 + 0 * groupBytes, tiledRow2 + 2 * groupBytes);
+            swapLanes128(untiledRow1 + 6 * groupBytes, untiledRow2 + 6 * groupBytes, tiledRow2 + 4 * groupBytes, tiledRow2 + 6 * groupBytes);
+         } else {
+            copyElems<16>(untiledRow1 + 0 * groupBytes, tiledRow1 + 0 * groupBytes, groupElems);
+            copyElems<16>(untiledRow1 + 1 * groupBytes, tiledRow1 + 2 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 0 * groupBytes, tiledRow1 + 1 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 1 * groupBytes, tiledRow1 + 3 * groupBytes, groupElems);
+
+            copyElems<16>(untiledRow1 + 2 * groupBytes, tiledRow1 + 4 * groupBytes, groupElems);
+            copyElems<16>(untiledRow1 + 3 * groupBytes, tiledRow1 + 6 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 2 * groupBytes, tiledRow1 + 5 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 3 * groupBytes, tiledRow1 + 7 * groupBytes, groupElems);
+
+            copyElems<16>(untiledRow1 + 4 * groupBytes, tiledRow2 + 0 * groupBytes, groupElems);
+            copyElems<16>(untiledRow1 + 5 * groupBytes, tiledRow2 + 2 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 4 * groupBytes, tiledRow2 + 1 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 5 * groupBytes, tiledRow2 + 3 * groupBytes, groupElems);
+
+            copyElems<16>(untiledRow1 + 6 * groupBytes, tiledRow2 + 4 * groupBytes, groupElems);
+            copyElems<16>(untiledRow1 + 7 * groupBytes, tiledRow2 + 6 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 6 * groupBytes, tiledRow2 + 5 * groupBytes, groupElems);
+            copyElems<16>(untiledRow2 + 7 * groupBytes, tiledRow2 + 7 * groupBytes, groupElems);
+         }
 
          if (IsMacroTiling) {
             tiled += 0x100 << (NumBankBits + NumPipeBits);
@@ -212,6 +435,36 @@ struct RetileCore
                     uint8_t *untiled,
                     uint32_t untiledStride)
    {
+      if constexpr (Isa != KernelIsa::Scalar && (BitsPerElement == 16 || BitsPerElement == 32)) {
+         static constexpr auto tiledStride = MicroTileWidth * BytesPerElement;
+
+         for (int y = 0; y < MicroTileHeight; y += 4) {
+            auto untiledRow0 = untiled + (y + 0) * untiledStride;
+            auto untiledRow1 = untiled + (y + 1) * untiledStride;
+            auto untiledRow2 = untiled + (y + 2) * untiledStride;
+            auto untiledRow3 = untiled + (y + 3) * untiledStride;
+
+            auto tiledRow0 = tiled + (y + 0) * tiledStride;
+            auto tiledRow1 = tiled + (y + 1) * tiledStride;
+            auto tiledRow2 = tiled + (y + 2) * tiledStride;
+            auto tiledRow3 = tiled + (y + 3) * tiledStride;
+
+            if constexpr (BitsPerElement == 16) {
+               // Each 2 element group is 32 bits, an untiled row is 4 groups
+               interleave32(untiledRow0, untiledRow1, tiledRow0, tiledRow2);
+               interleave32(untiledRow2, untiledRow3, tiledRow1, tiledRow3);
+            } else {
+               // Each 2 element group is 64 bits, an untiled row is 4 groups
+               swapHalves64(untiledRow0 + 0, untiledRow1 + 0, tiledRow0 + 0, tiledRow0 + 16);
+               swapHalves64(untiledRow2 + 0, untiledRow3 + 0, tiledRow1 + 0, tiledRow1 + 16);
+               swapHalves64(untiledRow0 + 16, untiledRow1 + 16, tiledRow2 + 0, tiledRow2 + 16);
+               swapHalves64(untiledRow2 + 16, untiledRow3 + 16, tiledRow3 + 0, tiledRow3 + 16);
+            }
+         }
+
+         return;
+      }
+
       for (int y = 0; y < MicroTileHeight; y += 4) {
          copyDepthXYGroup(tiled, untiled, untiledStride, 0, y + 0, 0, y + 0);
          copyDepthXYGroup(tiled, untiled, untiledStride, 1, y + 0, 0, y + 1);
@@ -460,7 +713,36 @@ struct RetileCore
    }
 };
 
+template<typename Retiler>
+static inline void
+retileTiles(const typename Retiler::Params& params,
+            uint32_t firstTile,
+            uint32_t lastTile,
+            uint8_t *untiled,
+            uint8_t *tiled)
+{
+   for (auto tileIndex = firstTile; tileIndex < lastTile; ++tileIndex) {
+      Retiler::retile(params, tileIndex, untiled, tiled);
+   }
+}
+
+// Identical to retileTiles, but compiled with AVX2 enabled so the AVX2
+// kernels can be inlined into the tile loop.
+template<typename Retiler>
+PLATFORM_TARGET_AVX2 FLATTEN static inline void
+retileTilesAvx2(const typename Retiler::Params& params,
+                uint32_t firstTile,
+                uint32_t lastTile,
+                uint8_t *untiled,
+                uint8_t *tiled)
+{
+   for (auto tileIndex = firstTile; tileIndex < lastTile; ++tileIndex) {
+      Retiler::retile(params, tileIndex, untiled, tiled);
+   }
+}
+
 template<bool IsUntiling,
+   KernelIsa Isa,
    TileMode RetileMode,
    uint32_t BitsPerElement,
    bool IsDepth>
@@ -479,7 +761,8 @@ retileTiledSurface3(const RetileInfo& info,
       getTileModeIs3X(RetileMode),
       getTileModeIsBankSwapped(RetileMode),
       BitsPerElement,
-      IsDepth>;
+      IsDepth,
+      Isa>;
 
    typename Retiler::Params params;
    params.firstSliceIndex = firstSlice;
@@ -493,13 +776,38 @@ retileTiledSurface3(const RetileInfo& info,
    params.pipeSwizzle = info.pipeSwizzle;
    params.bankSwapWidth = info.bankSwapWidth;
 
-   uint32_t numTiles = numSlices * info.numTilesPerSlice;
-   for (auto tileIndex = 0u; tileIndex < numTiles; ++tileIndex) {
-      Retiler::retile(params, tileIndex, untiled, tiled);
+   auto retileRange =
+      [&](uint32_t firstTile, uint32_t lastTile)
+      {
+         if constexpr (Isa == KernelIsa::AVX2) {
+            retileTilesAvx2<Retiler>(params, firstTile, lastTile, untiled, tiled);
+         } else {
+            retileTiles<Retiler>(params, firstTile, lastTile, untiled, tiled);
+         }
+      };
+
+   // Every tile is written independently of the others, so we can split the
+   // surface up along slice and macro tile row boundaries.
+   const uint32_t numTiles = numSlices * info.numTilesPerSlice;
+   const uint32_t tilesPerRow = info.numTilesPerRow * getMacroTileHeight(RetileMode);
+   const uint32_t bytesPerRow = tilesPerRow * params.thinMicroTileBytes;
+   const uint32_t rowsPerChunk = std::max(1u, MinParallelChunkBytes / std::max(1u, bytesPerRow));
+   const uint32_t tilesPerChunk = rowsPerChunk * tilesPerRow;
+   const uint32_t numChunks = (numTiles + tilesPerChunk - 1) / tilesPerChunk;
+
+   auto pool = numChunks > 1 ? getWorkerPool() : nullptr;
+   if (!pool) {
+      retileRange(0, numTiles);
+      return;
    }
+
+   pool->parallelFor(numChunks, [&](size_t chunk) {
+      auto firstTile = static_cast<uint32_t>(chunk) * tilesPerChunk;
+      retileRange(firstTile, std::min(firstTile + tilesPerChunk, numTiles));
+   });
 }
 
-template<bool IsUntiling, TileMode RetileMode>
+template<bool IsUntiling, KernelIsa Isa, TileMode RetileMode>
 static inline void
 retileTiledSurface2(const RetileInfo& info,
                     uint8_t *untiled,
@@ -509,32 +817,32 @@ retileTiledSurface2(const RetileInfo& info,
 {
    if (!info.isDepth) {
       if (info.bitsPerElement == 8) {
-         retileTiledSurface3<IsUntiling, RetileMode, 8, false>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 8, false>(info, untiled, tiled, firstSlice, numSlices);
       } else if (info.bitsPerElement == 16) {
-         retileTiledSurface3<IsUntiling, RetileMode, 16, false>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 16, false>(info, untiled, tiled, firstSlice, numSlices);
       } else if (info.bitsPerElement == 32) {
-         retileTiledSurface3<IsUntiling, RetileMode, 32, false>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 32, false>(info, untiled, tiled, firstSlice, numSlices);
       } else if (info.bitsPerElement == 64) {
-         retileTiledSurface3<IsUntiling, RetileMode, 64, false>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 64, false>(info, untiled, tiled, firstSlice, numSlices);
       } else if (info.bitsPerElement == 128) {
-         retileTiledSurface3<IsUntiling, RetileMode, 128, false>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 128, false>(info, untiled, tiled, firstSlice, numSlices);
       } else {
          decaf_abort("Invalid color surface bpp");
       }
    } else {
       if (info.bitsPerElement == 16) {
-         retileTiledSurface3<IsUntiling, RetileMode, 16, true>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 16, true>(info, untiled, tiled, firstSlice, numSlices);
       } else if (info.bitsPerElement == 32) {
-         retileTiledSurface3<IsUntiling, RetileMode, 32, true>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 32, true>(info, untiled, tiled, firstSlice, numSlices);
       } else if (info.bitsPerElement == 64) {
-         retileTiledSurface3<IsUntiling, RetileMode, 64, true>(info, untiled, tiled, firstSlice, numSlices);
+         retileTiledSurface3<IsUntiling, Isa, RetileMode, 64, true>(info, untiled, tiled, firstSlice, numSlices);
       } else {
          decaf_abort("Invalid depth surface bpp");
       }
    }
 }
 
-template<bool IsUntiling>
+template<bool IsUntiling, KernelIsa Isa>
 static inline void
 retileTiledSurface(const RetileInfo& info,
                    uint8_t *untiled,
@@ -544,46 +852,46 @@ retileTiledSurface(const RetileInfo& info,
 {
    switch (info.tileMode) {
    case TileMode::Micro1DTiledThin1:
-      retileTiledSurface2<IsUntiling, TileMode::Micro1DTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Micro1DTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Micro1DTiledThick:
-      retileTiledSurface2<IsUntiling, TileMode::Micro1DTiledThick>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Micro1DTiledThick>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2DTiledThin1:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2DTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2DTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2DTiledThin2:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2DTiledThin2>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2DTiledThin2>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2DTiledThin4:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2DTiledThin4>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2DTiledThin4>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2DTiledThick:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2DTiledThick>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2DTiledThick>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2BTiledThin1:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2BTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2BTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2BTiledThin2:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2BTiledThin2>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2BTiledThin2>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2BTiledThin4:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2BTiledThin4>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2BTiledThin4>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro2BTiledThick:
-      retileTiledSurface2<IsUntiling, TileMode::Macro2BTiledThick>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro2BTiledThick>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro3DTiledThin1:
-      retileTiledSurface2<IsUntiling, TileMode::Macro3DTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro3DTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro3DTiledThick:
-      retileTiledSurface2<IsUntiling, TileMode::Macro3DTiledThick>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro3DTiledThick>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro3BTiledThin1:
-      retileTiledSurface2<IsUntiling, TileMode::Macro3BTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro3BTiledThin1>(info, untiled, tiled, firstSlice, numSlices);
       break;
    case TileMode::Macro3BTiledThick:
-      retileTiledSurface2<IsUntiling, TileMode::Macro3BTiledThick>(info, untiled, tiled, firstSlice, numSlices);
+      retileTiledSurface2<IsUntiling, Isa, TileMode::Macro3BTiledThick>(info, untiled, tiled, firstSlice, numSlices);
       break;
    default:
       decaf_abort("Unexpected tiled tile mode");
@@ -629,7 +937,66 @@ retile(const RetileInfo& info,
       return retileLinearSurface<IsUntiling>(info, untiled, tiled, firstSlice, numSlices);
    }
 
-   retileTiledSurface<IsUntiling>(info, untiled, tiled, firstSlice, numSlices);
+   switch (sKernelIsa) {
+   case KernelIsa::AVX2:
+      retileTiledSurface<IsUntiling, KernelIsa::AVX2>(info, untiled, tiled, firstSlice, numSlices);
+      break;
+   case KernelIsa::SSE2:
+      retileTiledSurface<IsUntiling, KernelIsa::SSE2>(info, untiled, tiled, firstSlice, numSlices);
+      break;
+   default:
+      retileTiledSurface<IsUntiling, KernelIsa::Scalar>(info, untiled, tiled, firstSlice, numSlices);
+   }
+}
+
+KernelIsa
+getKernelIsa()
+{
+   return sKernelIsa;
+}
+
+/**
+ * Select which SIMD kernels are used for retiling, mostly useful to compare
+ * their performance and results.
+ *
+ * Returns false if the host CPU does not support the given ISA.
+ */
+bool
+setKernelIsa(KernelIsa isa)
+{
+   if (static_cast<int>(isa) > static_cast<int>(sSupportedKernelIsa)) {
+      return false;
+   }
+
+   sKernelIsa = isa;
+   return true;
+}
+
+uint32_t
+getNumThreads()
+{
+   std::unique_lock<std::mutex> lock { sWorkerPoolMutex };
+
+   if (sNumThreads) {
+      return sNumThreads;
+   }
+
+   return static_cast<uint32_t>(WorkerPool::getDefaultNumThreads() + 1);
+}
+
+/**
+ * Set how many threads, including the calling thread, are used for retiling.
+ *
+ * A value of 0 uses one thread per host core and 1 disables the worker pool.
+ */
+void
+setNumThreads(uint32_t numThreads)
+{
+   std::unique_lock<std::mutex> lock { sWorkerPoolMutex };
+   sNumThreads = numThreads;
+
+   // Any retile still using the old pool keeps it alive until it finishes
+   sWorkerPool.reset();
 }
 
 void
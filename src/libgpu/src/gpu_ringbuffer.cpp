@@ -1,63 +1,258 @@
 #include "gpu_ringbuffer.h"
 
+#include <atomic>
 #include <condition_variable>
+#include <cstring>
 #include <mutex>
 #include <vector>
 
+/*
+The ring buffer is a fixed size single producer, single consumer queue of
+buffer descriptors.  Submissions are copied as the caller is free to reuse
+its buffer as soon as write() returns: small ones, which are typically built
+on the stack of the submitting thread, into the descriptor itself and larger
+ones into a buffer owned by the descriptor.  That buffer keeps its capacity
+between uses so the ring stops allocating once it has warmed up.  Host code
+which manages the lifetime of its buffers can use writeNoCopy() instead.
+
+Writers are serialised with sWriteMutex, which in practice is uncontended as
+the GX2 submission path is the only writer.  The reader never takes a lock
+unless it has run out of work and has to go to sleep.
+
+A descriptor returned by read() stays valid until the next call to read().
+
+Sleeping works like a futex: the sleeping side publishes that it is
+sleeping and then re-checks the ring before waiting, the waking side only
+touches the mutex and condition variable when it sees someone is sleeping.
+This means a busy GPU thread costs the writer no more than a couple of
+atomic operations per submission.
+*/
+
 namespace gpu::ringbuffer
 {
 
-static std::vector<uint32_t>
-mWriteVector;
+// Number of times the reader polls the ring before going to sleep.
+static constexpr int SpinCount = 1000;
+
+struct alignas(64) Descriptor
+{
+   uint32_t *data;
+   uint32_t numWords;
+   uint32_t words[InlineWords];
+   std::vector<uint32_t> copy;
+};
+
+static Descriptor
+sDescriptors[Capacity];
+
+// Written by the producer, read by the consumer
+alignas(64) static std::atomic<uint32_t>
+sWritePosition { 0 };
+
+// Written by the consumer, read by the producer
+alignas(64) static std::atomic<uint32_t>
+sReadPosition { 0 };
 
-static std::vector<uint32_t>
-mReadVector;
+// Consumer private state
+alignas(64) static bool
+sReadPending = false;
 
 static std::mutex
-sMutex;
+sWriteMutex;
+
+static std::mutex
+sSleepMutex;
 
 static std::condition_variable
-sConditionVariable;
+sReaderCondition;
 
-static bool
-sPendingWake = false;
+static std::condition_variable
+sWriterCondition;
+
+static std::atomic<bool>
+sReaderSleeping { false };
+
+static std::atomic<bool>
+sWriterSleeping { false };
+
+static std::atomic<bool>
+sPendingWake { false };
+
+static std::atomic<uint64_t>
+sNumWrites { 0 };
+
+static std::atomic<uint64_t>
+sNumStalls { 0 };
+
+static std::atomic<uint64_t>
+sNumWakeups { 0 };
+
+static std::atomic<uint32_t>
+sMaxOccupancy { 0 };
+
+static void
+wakeReader()
+{
+   if (sReaderSleeping.load()) {
+      {
+         std::unique_lock<std::mutex> lock { sSleepMutex };
+      }
+
+      sReaderCondition.notify_one();
+      sNumWakeups.fetch_add(1, std::memory_order_relaxed);
+   }
+}
+
+static void
+wakeWriter()
+{
+   if (sWriterSleeping.load()) {
+      {
+         std::unique_lock<std::mutex> lock { sSleepMutex };
+      }
+
+      sWriterCondition.notify_one();
+   }
+}
+
+static void
+writeDescriptor(const Buffer &items,
+                bool copy)
+{
+
+   std::unique_lock<std::mutex> lock { sWriteMutex };
+   auto writePosition = sWritePosition.load(std::memory_order_relaxed);
+
+   // Wait for the reader to make space if the ring is full
+   if (writePosition - sReadPosition.load(std::memory_order_acquire) >= Capacity) {
+      sNumStalls.fetch_add(1, std::memory_order_relaxed);
+
+      std::unique_lock<std::mutex> sleepLock { sSleepMutex };
+      sWriterSleeping.store(true);
+      sWriterCondition.wait(sleepLock, [&]() {
+         return writePosition - sReadPosition.load() < Capacity;
+      });
+      sWriterSleeping.store(false);
+   }
+
+   auto &descriptor = sDescriptors[writePosition % Capacity];
+   auto numWords = static_cast<uint32_t>(items.size());
+
+   if (!copy) {
+      descriptor.data = items.data();
+   } else if (numWords <= InlineWords) {
+      std::memcpy(descriptor.words, items.data(), numWords * sizeof(uint32_t));
+      descriptor.data = descriptor.words;
+   } else {
+      descriptor.copy.assign(items.begin(), items.end());
+      descriptor.data = descriptor.copy.data();
+   }
+
+   descriptor.numWords = numWords;
+   sWritePosition.store(writePosition + 1);
+   sNumWrites.fetch_add(1, std::memory_order_relaxed);
+
+   auto occupancy = writePosition + 1 - sReadPosition.load(std::memory_order_relaxed);
+   auto maxOccupancy = sMaxOccupancy.load(std::memory_order_relaxed);
+   while (occupancy > maxOccupancy &&
+          !sMaxOccupancy.compare_exchange_weak(maxOccupancy, occupancy,
+                                               std::memory_order_relaxed)) {
+   }
+
+   wakeReader();
+}
 
 void
 write(const Buffer &items)
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   mWriteVector.insert(mWriteVector.end(), items.begin(), items.end());
-   sConditionVariable.notify_all();
+   if (!items.empty()) {
+      writeDescriptor(items, true);
+   }
+}
+
+void
+writeNoCopy(const Buffer &items)
+{
+   if (!items.empty()) {
+      writeDescriptor(items, false);
+   }
 }
 
 Buffer
 read()
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   mReadVector.clear();
-   mReadVector.swap(mWriteVector);
-   return mReadVector;
+   auto readPosition = sReadPosition.load(std::memory_order_relaxed);
+
+   // Release the descriptor returned by the previous read
+   if (sReadPending) {
+      readPosition++;
+      sReadPosition.store(readPosition);
+      sReadPending = false;
+      wakeWriter();
+   }
+
+   if (readPosition == sWritePosition.load(std::memory_order_acquire)) {
+      return { };
+   }
+
+   auto &descriptor = sDescriptors[readPosition % Capacity];
+   sReadPending = true;
+   return { descriptor.data, descriptor.numWords };
+}
+
+static bool
+hasPendingWork()
+{
+   // Descriptors still to be read, not counting the one currently held
+   auto readPosition = sReadPosition.load(std::memory_order_relaxed);
+   if (sReadPending) {
+      readPosition++;
+   }
+
+   return readPosition != sWritePosition.load();
 }
 
 bool
 wait()
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   if (mWriteVector.empty() && !sPendingWake) {
-      sConditionVariable.wait(lock);
-   }
+   for (auto i = 0; i < SpinCount; ++i) {
+      if (hasPendingWork()) {
+         return true;
+      }
 
-   sPendingWake = false;
+      if (sPendingWake.exchange(false)) {
+         return hasPendingWork();
+      }
+   }
 
-   return !mWriteVector.empty();
+   std::unique_lock<std::mutex> lock { sSleepMutex };
+   sReaderSleeping.store(true);
+   sReaderCondition.wait(lock, []() {
+      return hasPendingWork() || sPendingWake.load();
+   });
+   sReaderSleeping.store(false);
+   sPendingWake.store(false);
+   return hasPendingWork();
 }
 
 void
 wake()
 {
-   std::unique_lock<std::mutex> lock { sMutex };
-   sPendingWake = true;
-   sConditionVariable.notify_all();
+   sPendingWake.store(true);
+   wakeReader();
+}
+
+Stats
+getStats()
+{
+   auto stats = Stats { };
+   stats.writes = sNumWrites.load(std::memory_order_relaxed);
+   stats.stalls = sNumStalls.load(std::memory_order_relaxed);
+   stats.wakeups = sNumWakeups.load(std::memory_order_relaxed);
+   stats.occupancy = sWritePosition.load(std::memory_order_relaxed) -
+                     sReadPosition.load(std::memory_order_relaxed);
+   stats.maxOccupancy = sMaxOccupancy.load(std::memory_order_relaxed);
+   return stats;
 }
 
 } // namespace gpu::ringbuffer
@@ -1,8 +1,13 @@
 #include "null_driver.h"
+#include "gpu_clock.h"
 #include "gpu_event.h"
+#include "gpu_ih.h"
+#include "gpu_memory.h"
 #include "gpu_ringbuffer.h"
+#include "latte/latte_endian.h"
 
 #include <common/decaf_assert.h>
+#include <thread>
 
 namespace null
 {
@@ -28,17 +33,35 @@ Driver::run()
    mRunning = true;
 
    while (mRunning) {
-      if (gpu::ringbuffer::wait()) {
-         auto items = gpu::ringbuffer::read();
-         // TODO: We need to actually process pm4 to do EVENT_WRITE_EOP for retired timestamps
+      gpu::ringbuffer::wait();
+
+      for (auto buffer = gpu::ringbuffer::read(); !buffer.empty();
+           buffer = gpu::ringbuffer::read()) {
+         runCommandBuffer(buffer);
       }
    }
+
+   updateDebugInfo();
 }
 
 void
 Driver::runUntilFlip()
 {
-   decaf_abort("NullDriver::runUntilFlip unimplemented");
+   auto startingSwap = mStats.numSwaps;
+   mRunning = true;
+
+   while (mRunning) {
+      gpu::ringbuffer::wait();
+
+      for (auto buffer = gpu::ringbuffer::read(); !buffer.empty();
+           buffer = gpu::ringbuffer::read()) {
+         runCommandBuffer(buffer);
+
+         if (mStats.numSwaps > startingSwap) {
+            return;
+         }
+      }
+   }
 }
 
 void
@@ -57,7 +80,7 @@ Driver::type()
 gpu::GraphicsDriverDebugInfo *
 Driver::getDebugInfo()
 {
-   return nullptr;
+   return &mDebugInfo;
 }
 
 void
@@ -72,4 +95,282 @@ Driver::notifyGpuFlush(phys_addr address,
 {
 }
 
+void
+Driver::updateDebugInfo()
+{
+   auto averageFrameTime = mAverageFrameTime.count();
+   mStats.averageFrameTimeMS = averageFrameTime;
+
+   if (averageFrameTime > 0.0) {
+      mStats.averageFps = 1000.0 / averageFrameTime;
+   } else {
+      mStats.averageFps = 0.0;
+   }
+
+   mDebugInfo = mStats;
+}
+
+void
+Driver::handlePacketType0(HeaderType0 header,
+                          const gsl::span<uint32_t> &data)
+{
+   mStats.numRegisterWrites += data.size();
+   Pm4Processor::handlePacketType0(header, data);
+}
+
+void
+Driver::handlePacketType3(HeaderType3 header,
+                          const gsl::span<uint32_t> &data)
+{
+   switch (header.opcode()) {
+   case IT_OPCODE::SET_ALU_CONST:
+   case IT_OPCODE::SET_CONFIG_REG:
+   case IT_OPCODE::SET_CONTEXT_REG:
+   case IT_OPCODE::SET_CTL_CONST:
+   case IT_OPCODE::SET_LOOP_CONST:
+   case IT_OPCODE::SET_SAMPLER:
+   case IT_OPCODE::SET_RESOURCE:
+      // The first dword is the register offset
+      mStats.numRegisterWrites += data.empty() ? 0 : data.size() - 1;
+      break;
+   case IT_OPCODE::LOAD_CONFIG_REG:
+   case IT_OPCODE::LOAD_CONTEXT_REG:
+   case IT_OPCODE::LOAD_ALU_CONST:
+   case IT_OPCODE::LOAD_BOOL_CONST:
+   case IT_OPCODE::LOAD_LOOP_CONST:
+   case IT_OPCODE::LOAD_RESOURCE:
+   case IT_OPCODE::LOAD_SAMPLER:
+   case IT_OPCODE::LOAD_CTL_CONST:
+      mStats.numRegisterLoads++;
+      break;
+   default:
+      break;
+   }
+
+   Pm4Processor::handlePacketType3(header, data);
+}
+
+void
+Driver::decafSetBuffer(const DecafSetBuffer &data)
+{
+}
+
+void
+Driver::decafCopyColorToScan(const DecafCopyColorToScan &data)
+{
+}
+
+void
+Driver::decafSwapBuffers(const DecafSwapBuffers &data)
+{
+   static const auto weight = 0.9;
+
+   // Nothing is in flight, so the flip happens immediately
+   gpu::onFlip();
+
+   auto now = std::chrono::steady_clock::now();
+
+   if (mLastSwap.time_since_epoch().count()) {
+      mAverageFrameTime = weight * mAverageFrameTime + (1.0 - weight) * (now - mLastSwap);
+   }
+
+   mLastSwap = now;
+   mStats.numSwaps++;
+   updateDebugInfo();
+}
+
+void
+Driver::decafClearColor(const DecafClearColor &data)
+{
+}
+
+void
+Driver::decafClearDepthStencil(const DecafClearDepthStencil &data)
+{
+}
+
+void
+Driver::decafOSScreenFlip(const DecafOSScreenFlip &data)
+{
+}
+
+void
+Driver::decafCopySurface(const DecafCopySurface &data)
+{
+}
+
+void
+Driver::decafExpandColorBuffer(const DecafExpandColorBuffer &data)
+{
+}
+
+void
+Driver::drawIndexAuto(const DrawIndexAuto &data)
+{
+   mStats.numDraws++;
+   mStats.numIndices += data.count;
+}
+
+void
+Driver::drawIndex2(const DrawIndex2 &data)
+{
+   mStats.numDraws++;
+   mStats.numIndices += data.count;
+}
+
+void
+Driver::drawIndexImmd(const DrawIndexImmd &data)
+{
+   mStats.numDraws++;
+   mStats.numIndices += data.count;
+}
+
+void
+Driver::waitMem(const WaitMem &data)
+{
+   auto addr = phys_addr { data.addrLo.ADDR_LO() << 2 };
+   auto ptr = gpu::internal::translateAddress(addr);
+
+   while (true) {
+      auto value = *reinterpret_cast<volatile uint32_t *>(ptr);
+      value = static_cast<uint32_t>(
+         latte::applyEndianSwap(value, data.addrLo.ENDIAN_SWAP()));
+      value &= data.mask;
+
+      bool result;
+      switch (data.memSpaceFunction.FUNCTION()) {
+      case WRM_FUNCTION::FUNCTION_ALWAYS:
+         result = true;
+         break;
+      case WRM_FUNCTION::FUNCTION_LESS_THAN:
+         result = value < data.reference;
+         break;
+      case WRM_FUNCTION::FUNCTION_LESS_THAN_EQUAL:
+         result = value <= data.reference;
+         break;
+      case WRM_FUNCTION::FUNCTION_EQUAL:
+         result = value == data.reference;
+         break;
+      case WRM_FUNCTION::FUNCTION_NOT_EQUAL:
+         result = value != data.reference;
+         break;
+      case WRM_FUNCTION::FUNCTION_GREATER_THAN_EQUAL:
+         result = value >= data.reference;
+         break;
+      case WRM_FUNCTION::FUNCTION_GREATER_THAN:
+         result = value > data.reference;
+         break;
+      default:
+         result = true;
+      }
+
+      if (result || !mRunning) {
+         break;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+}
+
+void
+Driver::memWrite(const MemWrite &data)
+{
+   auto addr = phys_addr { data.addrLo.ADDR_LO() << 2 };
+   auto ptr = gpu::internal::translateAddress(addr);
+   auto value = uint64_t { 0 };
+
+   if (data.addrHi.CNTR_SEL() == MW_WRITE_CLOCK) {
+      value = gpu::clock::now();
+   } else if (data.addrHi.DATA32()) {
+      value = static_cast<uint64_t>(data.dataLo);
+   } else {
+      value = static_cast<uint64_t>(data.dataLo) |
+              (static_cast<uint64_t>(data.dataHi) << 32);
+   }
+
+   value = latte::applyEndianSwap(value, data.addrLo.ENDIAN_SWAP());
+
+   if (data.addrHi.DATA32()) {
+      *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
+   } else {
+      *reinterpret_cast<uint64_t *>(ptr) = value;
+   }
+
+   mStats.numMemWrites++;
+}
+
+void
+Driver::eventWrite(const EventWrite &data)
+{
+}
+
+void
+Driver::eventWriteEOP(const EventWriteEOP &data)
+{
+   if (data.addrHi.DATA_SEL() != EWP_DATA_DISCARD) {
+      auto addr = phys_addr { data.addrLo.ADDR_LO() << 2 };
+      auto ptr = gpu::internal::translateAddress(addr);
+      decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+
+      auto value = uint64_t { 0u };
+      switch (data.addrHi.DATA_SEL()) {
+      case EWP_DATA_32:
+         value = data.dataLo;
+         break;
+      case EWP_DATA_64:
+         value = static_cast<uint64_t>(data.dataLo) |
+                 (static_cast<uint64_t>(data.dataHi) << 32);
+         break;
+      case EWP_DATA_CLOCK:
+         value = gpu::clock::now();
+         break;
+      }
+
+      value = latte::applyEndianSwap(value, data.addrLo.ENDIAN_SWAP());
+
+      switch (data.addrHi.DATA_SEL()) {
+      case EWP_DATA_32:
+         *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
+         break;
+      case EWP_DATA_64:
+      case EWP_DATA_CLOCK:
+         *reinterpret_cast<uint64_t *>(ptr) = value;
+         break;
+      }
+   }
+
+   if (data.addrHi.INT_SEL() != EWP_INT_NONE) {
+      auto interrupt = gpu::ih::Entry { };
+      interrupt.word0 = latte::CP_INT_SRC_ID::CP_EOP_EVENT;
+      gpu::ih::write(interrupt);
+   }
+
+   mStats.numEopEvents++;
+}
+
+void
+Driver::pfpSyncMe(const PfpSyncMe &data)
+{
+}
+
+void
+Driver::setPredication(const SetPredication &data)
+{
+}
+
+void
+Driver::streamOutBaseUpdate(const StreamOutBaseUpdate &data)
+{
+}
+
+void
+Driver::streamOutBufferUpdate(const StreamOutBufferUpdate &data)
+{
+}
+
+void
+Driver::surfaceSync(const SurfaceSync &data)
+{
+}
+
 } // namespace null
@@ -1,10 +1,22 @@
 #pragma once
 #include "gpu_graphicsdriver.h"
+#include "gpu_nulldriver.h"
+#include "pm4_processor.h"
+
+#include <atomic>
+#include <chrono>
 
 namespace null
 {
 
-class Driver : public gpu::GraphicsDriver
+/**
+ * A graphics driver which runs the pm4 stream without rendering anything.
+ *
+ * Register and shadow state is tracked by Pm4Processor, memory writes and
+ * end of pipe events retire as soon as they are processed, so the CPU side
+ * sees timestamps advance exactly as it would with a real GPU.
+ */
+class Driver : public gpu::GraphicsDriver, public Pm4Processor
 {
 public:
    virtual ~Driver() = default;
@@ -23,8 +35,45 @@ public:
    virtual void notifyCpuFlush(phys_addr address, uint32_t size) override;
    virtual void notifyGpuFlush(phys_addr address, uint32_t size) override;
 
+protected:
+   virtual void handlePacketType0(HeaderType0 header, const gsl::span<uint32_t> &data) override;
+   virtual void handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &data) override;
+
+   virtual void decafSetBuffer(const DecafSetBuffer &data) override;
+   virtual void decafCopyColorToScan(const DecafCopyColorToScan &data) override;
+   virtual void decafSwapBuffers(const DecafSwapBuffers &data) override;
+   virtual void decafClearColor(const DecafClearColor &data) override;
+   virtual void decafClearDepthStencil(const DecafClearDepthStencil &data) override;
+   virtual void decafOSScreenFlip(const DecafOSScreenFlip &data) override;
+   virtual void decafCopySurface(const DecafCopySurface &data) override;
+   virtual void decafExpandColorBuffer(const DecafExpandColorBuffer &data) override;
+   virtual void drawIndexAuto(const DrawIndexAuto &data) override;
+   virtual void drawIndex2(const DrawIndex2 &data) override;
+   virtual void drawIndexImmd(const DrawIndexImmd &data) override;
+   virtual void waitMem(const WaitMem &data) override;
+   virtual void memWrite(const MemWrite &data) override;
+   virtual void eventWrite(const EventWrite &data) override;
+   virtual void eventWriteEOP(const EventWriteEOP &data) override;
+   virtual void pfpSyncMe(const PfpSyncMe &data) override;
+   virtual void setPredication(const SetPredication &data) override;
+   virtual void streamOutBaseUpdate(const StreamOutBaseUpdate &data) override;
+   virtual void streamOutBufferUpdate(const StreamOutBufferUpdate &data) override;
+   virtual void surfaceSync(const SurfaceSync &data) override;
+
 private:
-   bool mRunning = false;
+   void updateDebugInfo();
+
+private:
+   std::atomic<bool> mRunning { false };
+
+   //! Counters are only touched by the GPU thread, mDebugInfo is a copy of
+   //! them which is updated every flip.
+   gpu::NullDriverDebugInfo mStats;
+   gpu::NullDriverDebugInfo mDebugInfo;
+
+   using duration_ms = std::chrono::duration<double, std::chrono::milliseconds::period>;
+   std::chrono::time_point<std::chrono::steady_clock> mLastSwap;
+   duration_ms mAverageFrameTime { 0.0 };
 };
 
 } // namespace null
@@ -39,8 +39,8 @@ protected:
    virtual void streamOutBufferUpdate(const StreamOutBufferUpdate &data) = 0;
    virtual void surfaceSync(const SurfaceSync &data) = 0;
 
-   void handlePacketType0(HeaderType0 header, const gsl::span<uint32_t> &data);
-   void handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &data);
+   virtual void handlePacketType0(HeaderType0 header, const gsl::span<uint32_t> &data);
+   virtual void handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &data);
    void nopPacket(const Nop &data);
    void indirectBufferCall(const IndirectBufferCall &data);
    void indirectBufferCallPriv(const IndirectBufferCallPriv &data);
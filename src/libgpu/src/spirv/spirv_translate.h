@@ -15,6 +15,11 @@
 namespace spirv
 {
 
+//! Version of the translator output, this must be bumped whenever a change
+//! affects the generated SPIR-V or the ShaderMeta structures so that any
+//! persistent shader caches are invalidated.
+static constexpr uint32_t TranslatorVersion = 1;
+
 enum class ShaderType : uint32_t
 {
    Unknown,
@@ -95,11 +95,18 @@ Driver::initialise(vk::Instance instance,
    mBaseDescriptorSetLayout = basePl->descriptorLayout;
    mPipelineLayout = basePl->pipelineLayout;
 
-   // Set up the pipeline cache
+   // Set up the shader cache
+   if (gpuConfig->shaderCache.enabled) {
+      mShaderCache.initialise(gpuConfig->shaderCache.path,
+                              gpuConfig->shaderCache.preload);
+   }
+
+   // Set up the pipeline cache, seeded from the previous run if we have one
+   auto pipelineCacheData = mShaderCache.loadPipelineCache();
    auto pipelineCacheCreateInfo = vk::PipelineCacheCreateInfo { };
    pipelineCacheCreateInfo.flags = vk::PipelineCacheCreateFlags { };
-   pipelineCacheCreateInfo.pInitialData = nullptr;
-   pipelineCacheCreateInfo.initialDataSize = 0;
+   pipelineCacheCreateInfo.pInitialData = pipelineCacheData.data();
+   pipelineCacheCreateInfo.initialDataSize = pipelineCacheData.size();
    mPipelineCache = mDevice.createPipelineCache(pipelineCacheCreateInfo);
 
    initialiseBlankSampler();
@@ -115,6 +122,8 @@ Driver::destroy()
    mFenceSignal.notify_all();
    mFenceThread.join();
 
+   mShaderCache.storePipelineCache(mDevice.getPipelineCacheData(mPipelineCache));
+
    destroyDisplayPipeline();
 }
 
@@ -361,15 +370,15 @@ void
 Driver::run()
 {
    while (mRunState == RunState::Running) {
-      // Grab the next buffer
+      // Wait for something to do
       gpu::ringbuffer::wait();
-      auto buffer = gpu::ringbuffer::read();
 
       // Check for any fences completing
       checkSyncFences();
 
-      // Process the buffer if there is anything new
-      if (!buffer.empty()) {
+      // Process every buffer which has been queued so far
+      for (auto buffer = gpu::ringbuffer::read(); !buffer.empty();
+           buffer = gpu::ringbuffer::read()) {
          executeBuffer(buffer);
       }
    }
@@ -389,14 +398,14 @@ Driver::runUntilFlip()
       // Check for any fences completing
       checkSyncFences();
 
-      // Process the buffer if there is anything new
-      auto buffer = gpu::ringbuffer::read();
-      if (!buffer.empty()) {
+      // Process queued buffers until we reach a flip
+      for (auto buffer = gpu::ringbuffer::read(); !buffer.empty();
+           buffer = gpu::ringbuffer::read()) {
          executeBuffer(buffer);
-      }
 
-      if (mLastSwap > startingSwap) {
-         break;
+         if (mLastSwap > startingSwap) {
+            return;
+         }
       }
    }
 }
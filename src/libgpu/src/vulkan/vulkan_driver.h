@@ -13,6 +13,7 @@
 #include "vk_mem_alloc_decaf.h"
 #include "vulkan_descs.h"
 #include "vulkan_memtracker.h"
+#include "vulkan_shadercache.h"
 
 #include <atomic>
 #include <common/vulkan_hpp.h>
@@ -227,6 +228,19 @@ struct RectStubShaderObject
    vk::ShaderModule module;
 };
 
+// Shader descriptions only depend on register state and the shader binaries
+// in memory, so they can also be built outside of the driver.
+using ShaderRegisters = std::array<uint32_t, 0x10000>;
+
+spirv::VertexShaderDesc
+buildVertexShaderDesc(const ShaderRegisters &registers);
+
+spirv::GeometryShaderDesc
+buildGeometryShaderDesc(const ShaderRegisters &registers);
+
+spirv::PixelShaderDesc
+buildPixelShaderDesc(const ShaderRegisters &registers);
+
 enum class StagingBufferType : uint32_t
 {
    CpuToGpu = 0,
@@ -739,6 +753,7 @@ private:
    uint64_t *mLastOccQueryAddr = nullptr;
    vk::QueryPool mLastOccQuery;
    vk::PipelineCache mPipelineCache;
+   ShaderCache mShaderCache;
 
    SyncWaiter *mActiveSyncWaiter = nullptr;
    vk::CommandBuffer mActiveCommandBuffer;
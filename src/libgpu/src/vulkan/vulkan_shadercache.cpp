@@ -0,0 +1,474 @@
+#ifdef DECAF_VULKAN
+#include "vulkan_shadercache.h"
+
+#include <common/log.h>
+#include <common/xxhash.h>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <type_traits>
+
+namespace vulkan
+{
+
+static constexpr uint32_t EntryMagic = 0x56505344; // "DSPV"
+static constexpr auto EntryExtension = ".bin";
+static constexpr auto PipelineCacheFileName = "pipelines.vkcache";
+
+struct EntryHeader
+{
+   uint32_t magic;
+   uint32_t translatorVersion;
+   spirv::ShaderType type;
+   uint32_t numWords;
+};
+
+class EntryWriter
+{
+public:
+   template<typename Type>
+   void
+   write(const Type &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value);
+      auto bytes = reinterpret_cast<const uint8_t *>(&value);
+      mData.insert(mData.end(), bytes, bytes + sizeof(Type));
+   }
+
+   void
+   writeWords(const std::vector<unsigned int> &words)
+   {
+      auto bytes = reinterpret_cast<const uint8_t *>(words.data());
+      mData.insert(mData.end(), bytes, bytes + words.size() * sizeof(unsigned int));
+   }
+
+   std::vector<uint8_t> &
+   data()
+   {
+      return mData;
+   }
+
+private:
+   std::vector<uint8_t> mData;
+};
+
+class EntryReader
+{
+public:
+   EntryReader(const std::vector<uint8_t> &data) :
+      mData(data)
+   {
+   }
+
+   template<typename Type>
+   bool
+   read(Type &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value);
+      if (mPosition + sizeof(Type) > mData.size()) {
+         return false;
+      }
+
+      std::memcpy(&value, mData.data() + mPosition, sizeof(Type));
+      mPosition += sizeof(Type);
+      return true;
+   }
+
+   bool
+   readWords(std::vector<unsigned int> &words,
+             uint32_t numWords)
+   {
+      auto size = static_cast<size_t>(numWords) * sizeof(unsigned int);
+      if (mPosition + size != mData.size()) {
+         return false;
+      }
+
+      words.resize(numWords);
+      std::memcpy(words.data(), mData.data() + mPosition, size);
+      mPosition += size;
+      return true;
+   }
+
+private:
+   const std::vector<uint8_t> &mData;
+   size_t mPosition = 0;
+};
+
+static void
+writeMeta(EntryWriter &writer,
+          const spirv::VertexShaderMeta &meta)
+{
+   writer.write(static_cast<const spirv::ShaderMeta &>(meta));
+   writer.write(meta.numExports);
+   writer.write(meta.streamOutUsed);
+   writer.write(meta.attribBuffers);
+   writer.write(static_cast<uint32_t>(meta.attribElems.size()));
+
+   for (auto &elem : meta.attribElems) {
+      writer.write(elem);
+   }
+}
+
+static void
+writeMeta(EntryWriter &writer,
+          const spirv::GeometryShaderMeta &meta)
+{
+   writer.write(static_cast<const spirv::ShaderMeta &>(meta));
+   writer.write(meta.streamOutUsed);
+}
+
+static void
+writeMeta(EntryWriter &writer,
+          const spirv::PixelShaderMeta &meta)
+{
+   writer.write(static_cast<const spirv::ShaderMeta &>(meta));
+   writer.write(meta.pixelOutUsed);
+}
+
+static bool
+readMeta(EntryReader &reader,
+         spirv::VertexShaderMeta &meta)
+{
+   auto numAttribElems = uint32_t { 0 };
+   if (!reader.read(static_cast<spirv::ShaderMeta &>(meta)) ||
+       !reader.read(meta.numExports) ||
+       !reader.read(meta.streamOutUsed) ||
+       !reader.read(meta.attribBuffers) ||
+       !reader.read(numAttribElems)) {
+      return false;
+   }
+
+   meta.attribElems.resize(numAttribElems);
+   for (auto &elem : meta.attribElems) {
+      if (!reader.read(elem)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static bool
+readMeta(EntryReader &reader,
+         spirv::GeometryShaderMeta &meta)
+{
+   return reader.read(static_cast<spirv::ShaderMeta &>(meta)) &&
+          reader.read(meta.streamOutUsed);
+}
+
+static bool
+readMeta(EntryReader &reader,
+         spirv::PixelShaderMeta &meta)
+{
+   return reader.read(static_cast<spirv::ShaderMeta &>(meta)) &&
+          reader.read(meta.pixelOutUsed);
+}
+
+/*
+The descriptions reference the guest shader binaries by address, which is
+what the driver hashes for its in-memory lookups.  For the persistent key we
+hash the binary contents instead, so the key does not depend on where the
+title happened to load its shaders.
+*/
+static uint64_t
+getCacheKey(const spirv::VertexShaderDesc &desc)
+{
+   auto keyDesc = desc;
+   keyDesc.binary = { };
+   keyDesc.fsBinary = { };
+
+   auto key = XXH64(&keyDesc, sizeof(keyDesc), spirv::TranslatorVersion);
+   key = XXH64(desc.binary.data(), desc.binary.size(), key);
+   return XXH64(desc.fsBinary.data(), desc.fsBinary.size(), key);
+}
+
+static uint64_t
+getCacheKey(const spirv::GeometryShaderDesc &desc)
+{
+   auto keyDesc = desc;
+   keyDesc.binary = { };
+   keyDesc.dcBinary = { };
+
+   auto key = XXH64(&keyDesc, sizeof(keyDesc), spirv::TranslatorVersion);
+   key = XXH64(desc.binary.data(), desc.binary.size(), key);
+   return XXH64(desc.dcBinary.data(), desc.dcBinary.size(), key);
+}
+
+static uint64_t
+getCacheKey(const spirv::PixelShaderDesc &desc)
+{
+   auto keyDesc = desc;
+   keyDesc.binary = { };
+
+   auto key = XXH64(&keyDesc, sizeof(keyDesc), spirv::TranslatorVersion);
+   return XXH64(desc.binary.data(), desc.binary.size(), key);
+}
+
+static bool
+readFile(const std::string &path,
+         std::vector<uint8_t> &data)
+{
+   auto file = std::ifstream { path, std::ifstream::in | std::ifstream::binary };
+   if (!file.is_open()) {
+      return false;
+   }
+
+   file.seekg(0, std::ifstream::end);
+   data.resize(static_cast<size_t>(file.tellg()));
+   file.seekg(0, std::ifstream::beg);
+   file.read(reinterpret_cast<char *>(data.data()), data.size());
+   return !!file;
+}
+
+static bool
+writeFile(const std::string &path,
+          const std::vector<uint8_t> &data)
+{
+   // Write to a temporary file first so an interrupted write can never leave
+   // a truncated entry behind.
+   auto tmpPath = path + ".tmp";
+   {
+      auto file = std::ofstream { tmpPath, std::ofstream::out | std::ofstream::binary };
+      if (!file.is_open()) {
+         return false;
+      }
+
+      file.write(reinterpret_cast<const char *>(data.data()), data.size());
+      if (!file) {
+         return false;
+      }
+   }
+
+   auto error = std::error_code { };
+   std::filesystem::rename(tmpPath, path, error);
+   return !error;
+}
+
+template<typename ShaderType>
+static std::vector<uint8_t>
+serialiseShader(spirv::ShaderType type,
+                const ShaderType &shader)
+{
+   auto writer = EntryWriter { };
+   auto header = EntryHeader { };
+   header.magic = EntryMagic;
+   header.translatorVersion = spirv::TranslatorVersion;
+   header.type = type;
+   header.numWords = static_cast<uint32_t>(shader.binary.size());
+   writer.write(header);
+   writeMeta(writer, shader.meta);
+   writer.writeWords(shader.binary);
+   return std::move(writer.data());
+}
+
+template<typename ShaderType>
+static bool
+deserialiseShader(spirv::ShaderType type,
+                  const std::vector<uint8_t> &data,
+                  ShaderType &shader)
+{
+   auto reader = EntryReader { data };
+   auto header = EntryHeader { };
+   if (!reader.read(header) ||
+       header.magic != EntryMagic ||
+       header.translatorVersion != spirv::TranslatorVersion ||
+       header.type != type) {
+      return false;
+   }
+
+   return readMeta(reader, shader.meta) &&
+          reader.readWords(shader.binary, header.numWords);
+}
+
+bool
+ShaderCache::initialise(const std::string &path,
+                        bool preload)
+{
+   auto error = std::error_code { };
+   std::filesystem::create_directories(path, error);
+   if (error) {
+      gLog->warn("Could not create shader cache directory {}: {}",
+                 path, error.message());
+      return false;
+   }
+
+   mPath = path;
+   mPreloaded.clear();
+
+   if (preload) {
+      auto bytes = size_t { 0 };
+      for (auto &entry : std::filesystem::directory_iterator { path, error }) {
+         if (!entry.is_regular_file() ||
+             entry.path().extension() != EntryExtension) {
+            continue;
+         }
+
+         auto data = std::vector<uint8_t> { };
+         if (readFile(entry.path().string(), data)) {
+            bytes += data.size();
+            mPreloaded.emplace(entry.path().string(), std::move(data));
+         }
+      }
+
+      gLog->info("Preloaded {} shaders ({} KiB) from shader cache {}",
+                 mPreloaded.size(), bytes / 1024, path);
+   }
+
+   return true;
+}
+
+std::string
+ShaderCache::getEntryPath(spirv::ShaderType type,
+                          uint64_t key)
+{
+   auto prefix = "ps";
+   if (type == spirv::ShaderType::Vertex) {
+      prefix = "vs";
+   } else if (type == spirv::ShaderType::Geometry) {
+      prefix = "gs";
+   }
+
+   return (std::filesystem::path { mPath } /
+           fmt::format("{}_{:016x}{}", prefix, key, EntryExtension)).string();
+}
+
+bool
+ShaderCache::readEntry(spirv::ShaderType type,
+                       uint64_t key,
+                       std::vector<uint8_t> &data)
+{
+   if (!enabled()) {
+      return false;
+   }
+
+   auto path = getEntryPath(type, key);
+   auto itr = mPreloaded.find(path);
+   if (itr != mPreloaded.end()) {
+      data = std::move(itr->second);
+      mPreloaded.erase(itr);
+      return true;
+   }
+
+   return readFile(path, data);
+}
+
+void
+ShaderCache::writeEntry(spirv::ShaderType type,
+                        uint64_t key,
+                        std::vector<uint8_t> &&data)
+{
+   if (!enabled()) {
+      return;
+   }
+
+   auto path = getEntryPath(type, key);
+   if (!writeFile(path, data)) {
+      gLog->warn("Failed to write shader cache entry {}", path);
+   }
+}
+
+bool
+ShaderCache::load(const spirv::VertexShaderDesc &desc,
+                  spirv::VertexShader &shader)
+{
+   auto data = std::vector<uint8_t> { };
+   return readEntry(spirv::ShaderType::Vertex, getCacheKey(desc), data) &&
+          deserialiseShader(spirv::ShaderType::Vertex, data, shader);
+}
+
+bool
+ShaderCache::load(const spirv::GeometryShaderDesc &desc,
+                  spirv::GeometryShader &shader)
+{
+   auto data = std::vector<uint8_t> { };
+   return readEntry(spirv::ShaderType::Geometry, getCacheKey(desc), data) &&
+          deserialiseShader(spirv::ShaderType::Geometry, data, shader);
+}
+
+bool
+ShaderCache::load(const spirv::PixelShaderDesc &desc,
+                  spirv::PixelShader &shader)
+{
+   auto data = std::vector<uint8_t> { };
+   return readEntry(spirv::ShaderType::Pixel, getCacheKey(desc), data) &&
+          deserialiseShader(spirv::ShaderType::Pixel, data, shader);
+}
+
+void
+ShaderCache::store(const spirv::VertexShaderDesc &desc,
+                   const spirv::VertexShader &shader)
+{
+   writeEntry(spirv::ShaderType::Vertex, getCacheKey(desc),
+              serialiseShader(spirv::ShaderType::Vertex, shader));
+}
+
+void
+ShaderCache::store(const spirv::GeometryShaderDesc &desc,
+                   const spirv::GeometryShader &shader)
+{
+   writeEntry(spirv::ShaderType::Geometry, getCacheKey(desc),
+              serialiseShader(spirv::ShaderType::Geometry, shader));
+}
+
+void
+ShaderCache::store(const spirv::PixelShaderDesc &desc,
+                   const spirv::PixelShader &shader)
+{
+   writeEntry(spirv::ShaderType::Pixel, getCacheKey(desc),
+              serialiseShader(spirv::ShaderType::Pixel, shader));
+}
+
+bool
+ShaderCache::contains(const spirv::VertexShaderDesc &desc)
+{
+   auto shader = spirv::VertexShader { };
+   return load(desc, shader);
+}
+
+bool
+ShaderCache::contains(const spirv::GeometryShaderDesc &desc)
+{
+   auto shader = spirv::GeometryShader { };
+   return load(desc, shader);
+}
+
+bool
+ShaderCache::contains(const spirv::PixelShaderDesc &desc)
+{
+   auto shader = spirv::PixelShader { };
+   return load(desc, shader);
+}
+
+/**
+ * Vulkan validates the pipeline cache header itself and ignores data from a
+ * different driver or device, so we can pass whatever is on disk straight
+ * through.
+ */
+std::vector<uint8_t>
+ShaderCache::loadPipelineCache()
+{
+   auto data = std::vector<uint8_t> { };
+   if (enabled()) {
+      readFile((std::filesystem::path { mPath } / PipelineCacheFileName).string(), data);
+   }
+
+   return data;
+}
+
+void
+ShaderCache::storePipelineCache(const std::vector<uint8_t> &data)
+{
+   if (!enabled() || data.empty()) {
+      return;
+   }
+
+   auto path = (std::filesystem::path { mPath } / PipelineCacheFileName).string();
+   if (!writeFile(path, data)) {
+      gLog->warn("Failed to write pipeline cache {}", path);
+   }
+}
+
+} // namespace vulkan
+
+#endif // ifdef DECAF_VULKAN
@@ -0,0 +1,98 @@
+#pragma once
+#ifdef DECAF_VULKAN
+#include "spirv/spirv_translate.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vulkan
+{
+
+/**
+ * Persistent on-disk cache of translated shaders.
+ *
+ * Entries are keyed by the shader description with the guest shader binary
+ * contents hashed in place of their addresses, so a key stays valid across
+ * runs even if a title loads its shaders somewhere else.  Every entry also
+ * records spirv::TranslatorVersion so entries from an older translator are
+ * ignored and replaced.
+ */
+class ShaderCache
+{
+public:
+   bool
+   initialise(const std::string &path,
+              bool preload);
+
+   bool
+   enabled() const
+   {
+      return !mPath.empty();
+   }
+
+   bool
+   load(const spirv::VertexShaderDesc &desc,
+        spirv::VertexShader &shader);
+
+   bool
+   load(const spirv::GeometryShaderDesc &desc,
+        spirv::GeometryShader &shader);
+
+   bool
+   load(const spirv::PixelShaderDesc &desc,
+        spirv::PixelShader &shader);
+
+   void
+   store(const spirv::VertexShaderDesc &desc,
+         const spirv::VertexShader &shader);
+
+   void
+   store(const spirv::GeometryShaderDesc &desc,
+         const spirv::GeometryShader &shader);
+
+   void
+   store(const spirv::PixelShaderDesc &desc,
+         const spirv::PixelShader &shader);
+
+   bool
+   contains(const spirv::VertexShaderDesc &desc);
+
+   bool
+   contains(const spirv::GeometryShaderDesc &desc);
+
+   bool
+   contains(const spirv::PixelShaderDesc &desc);
+
+   std::vector<uint8_t>
+   loadPipelineCache();
+
+   void
+   storePipelineCache(const std::vector<uint8_t> &data);
+
+private:
+   std::string
+   getEntryPath(spirv::ShaderType type,
+                uint64_t key);
+
+   bool
+   readEntry(spirv::ShaderType type,
+             uint64_t key,
+             std::vector<uint8_t> &data);
+
+   void
+   writeEntry(spirv::ShaderType type,
+              uint64_t key,
+              std::vector<uint8_t> &&data);
+
+private:
+   std::string mPath;
+
+   //! Entries read from disk by preload, removed as they are used.
+   std::unordered_map<std::string, std::vector<uint8_t>> mPreloaded;
+};
+
+} // namespace vulkan
+
+#endif // ifdef DECAF_VULKAN
@@ -0,0 +1,147 @@
+#ifdef DECAF_VULKAN
+#include "gpu_shadercache.h"
+#include "pm4_processor.h"
+#include "vulkan_driver.h"
+#include "vulkan_shadercache.h"
+
+#include <algorithm>
+#include <common/log.h>
+#include <cstring>
+#include <unordered_set>
+
+namespace gpu::shadercache
+{
+
+class Prewarmer::Impl : public Pm4Processor
+{
+public:
+   Impl(const std::string &cachePath)
+   {
+      mCache.initialise(cachePath, false);
+   }
+
+   void
+   loadRegisters(const uint32_t *values,
+                 uint32_t count)
+   {
+      count = std::min<uint32_t>(count, static_cast<uint32_t>(mRegisters.size()));
+      std::memcpy(mRegisters.data(), values, count * sizeof(uint32_t));
+   }
+
+   void
+   runCommandBuffer(uint32_t *words,
+                    uint32_t numWords)
+   {
+      Pm4Processor::runCommandBuffer({ words, numWords });
+   }
+
+   PrewarmStats
+   getStats() const
+   {
+      return mStats;
+   }
+
+private:
+   template<typename DescType, typename ShaderType>
+   void
+   prewarmShader(const DescType &desc)
+   {
+      // Shader stage is disabled
+      if (desc.type == spirv::ShaderType::Unknown) {
+         return;
+      }
+
+      // Only look at each unique shader once per run
+      if (!mSeen.insert(desc.hash().value()).second) {
+         return;
+      }
+
+      if (mCache.contains(desc)) {
+         mStats.cached++;
+         return;
+      }
+
+      auto shader = ShaderType { };
+      if (!spirv::translate(desc, &shader)) {
+         gLog->warn("Failed to translate shader at 0x{:08X}",
+                    reinterpret_cast<uintptr_t>(desc.binary.data()));
+         return;
+      }
+
+      mCache.store(desc, shader);
+      mStats.translated++;
+   }
+
+   void
+   prewarmDraw()
+   {
+      mStats.draws++;
+      prewarmShader<spirv::VertexShaderDesc, spirv::VertexShader>(
+         vulkan::buildVertexShaderDesc(mRegisters));
+      prewarmShader<spirv::GeometryShaderDesc, spirv::GeometryShader>(
+         vulkan::buildGeometryShaderDesc(mRegisters));
+      prewarmShader<spirv::PixelShaderDesc, spirv::PixelShader>(
+         vulkan::buildPixelShaderDesc(mRegisters));
+   }
+
+   void drawIndexAuto(const DrawIndexAuto &data) override { prewarmDraw(); }
+   void drawIndex2(const DrawIndex2 &data) override { prewarmDraw(); }
+   void drawIndexImmd(const DrawIndexImmd &data) override { prewarmDraw(); }
+
+   // Nothing else affects which shaders are used
+   void decafSetBuffer(const DecafSetBuffer &data) override { }
+   void decafCopyColorToScan(const DecafCopyColorToScan &data) override { }
+   void decafSwapBuffers(const DecafSwapBuffers &data) override { }
+   void decafClearColor(const DecafClearColor &data) override { }
+   void decafClearDepthStencil(const DecafClearDepthStencil &data) override { }
+   void decafOSScreenFlip(const DecafOSScreenFlip &data) override { }
+   void decafCopySurface(const DecafCopySurface &data) override { }
+   void decafExpandColorBuffer(const DecafExpandColorBuffer &data) override { }
+   void waitMem(const WaitMem &data) override { }
+   void memWrite(const MemWrite &data) override { }
+   void eventWrite(const EventWrite &data) override { }
+   void eventWriteEOP(const EventWriteEOP &data) override { }
+   void pfpSyncMe(const PfpSyncMe &data) override { }
+   void setPredication(const SetPredication &data) override { }
+   void streamOutBaseUpdate(const StreamOutBaseUpdate &data) override { }
+   void streamOutBufferUpdate(const StreamOutBufferUpdate &data) override { }
+   void surfaceSync(const SurfaceSync &data) override { }
+
+private:
+   vulkan::ShaderCache mCache;
+   std::unordered_set<uint64_t> mSeen;
+   PrewarmStats mStats;
+};
+
+Prewarmer::Prewarmer(const std::string &cachePath) :
+   mImpl(std::make_unique<Impl>(cachePath))
+{
+}
+
+Prewarmer::~Prewarmer()
+{
+}
+
+void
+Prewarmer::loadRegisters(const uint32_t *values,
+                         uint32_t count)
+{
+   mImpl->loadRegisters(values, count);
+}
+
+void
+Prewarmer::runCommandBuffer(uint32_t *words,
+                            uint32_t numWords)
+{
+   mImpl->runCommandBuffer(words, numWords);
+}
+
+PrewarmStats
+Prewarmer::getStats() const
+{
+   return mImpl->getStats();
+}
+
+} // namespace gpu::shadercache
+
+#endif // ifdef DECAF_VULKAN
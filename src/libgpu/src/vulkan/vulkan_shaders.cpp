@@ -33,35 +33,44 @@ spirvPixelTypeFromLatte(latte::CB_NUMBER_TYPE format)
    }
 }
 
+template<typename Type>
+static inline Type
+getRegister(const ShaderRegisters &registers,
+            uint32_t id)
+{
+   static_assert(sizeof(Type) == 4, "Register storage must be a uint32_t");
+   return *reinterpret_cast<const Type *>(&registers[id / 4]);
+}
+
 spirv::VertexShaderDesc
-Driver::getVertexShaderDesc()
+buildVertexShaderDesc(const ShaderRegisters &registers)
 {
    gsl::span<uint8_t> fsShaderBinary;
    gsl::span<uint8_t> vsShaderBinary;
 
-   auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(latte::Register::SQ_PGM_START_FS);
-   auto pgm_offset_fs = getRegister<latte::SQ_PGM_CF_OFFSET_FS>(latte::Register::SQ_PGM_CF_OFFSET_FS);
-   auto pgm_size_fs = getRegister<latte::SQ_PGM_SIZE_FS>(latte::Register::SQ_PGM_SIZE_FS);
+   auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(registers, latte::Register::SQ_PGM_START_FS);
+   auto pgm_offset_fs = getRegister<latte::SQ_PGM_CF_OFFSET_FS>(registers, latte::Register::SQ_PGM_CF_OFFSET_FS);
+   auto pgm_size_fs = getRegister<latte::SQ_PGM_SIZE_FS>(registers, latte::Register::SQ_PGM_SIZE_FS);
    fsShaderBinary = gsl::make_span(
       phys_cast<uint8_t*>(phys_addr(pgm_start_fs.PGM_START() << 8)).getRawPointer(),
       pgm_size_fs.PGM_SIZE() << 3);
    decaf_check(pgm_offset_fs.PGM_OFFSET() == 0);
 
-   auto vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(latte::Register::VGT_GS_MODE);
+   auto vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(registers, latte::Register::VGT_GS_MODE);
    if (vgt_gs_mode.MODE() == latte::VGT_GS_ENABLE_MODE::OFF) {
       // When GS is disabled, vertex shader comes from vertex shader register
-      auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(latte::Register::SQ_PGM_START_VS);
-      auto pgm_offset_vs = getRegister<latte::SQ_PGM_CF_OFFSET_VS>(latte::Register::SQ_PGM_CF_OFFSET_VS);
-      auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(latte::Register::SQ_PGM_SIZE_VS);
+      auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(registers, latte::Register::SQ_PGM_START_VS);
+      auto pgm_offset_vs = getRegister<latte::SQ_PGM_CF_OFFSET_VS>(registers, latte::Register::SQ_PGM_CF_OFFSET_VS);
+      auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(registers, latte::Register::SQ_PGM_SIZE_VS);
       vsShaderBinary = gsl::make_span(
          phys_cast<uint8_t*>(phys_addr(pgm_start_vs.PGM_START() << 8)).getRawPointer(),
          pgm_size_vs.PGM_SIZE() << 3);
       decaf_check(pgm_offset_vs.PGM_OFFSET() == 0);
    } else {
       // When GS is enabled, vertex shader comes from export shader register
-      auto pgm_start_es = getRegister<latte::SQ_PGM_START_ES>(latte::Register::SQ_PGM_START_ES);
-      auto pgm_offset_es = getRegister<latte::SQ_PGM_CF_OFFSET_ES>(latte::Register::SQ_PGM_CF_OFFSET_ES);
-      auto pgm_size_es = getRegister<latte::SQ_PGM_SIZE_ES>(latte::Register::SQ_PGM_SIZE_ES);
+      auto pgm_start_es = getRegister<latte::SQ_PGM_START_ES>(registers, latte::Register::SQ_PGM_START_ES);
+      auto pgm_offset_es = getRegister<latte::SQ_PGM_CF_OFFSET_ES>(registers, latte::Register::SQ_PGM_CF_OFFSET_ES);
+      auto pgm_size_es = getRegister<latte::SQ_PGM_SIZE_ES>(registers, latte::Register::SQ_PGM_SIZE_ES);
 
       vsShaderBinary = gsl::make_span(
          phys_cast<uint8_t*>(phys_addr(pgm_start_es.PGM_START() << 8)).getRawPointer(),
@@ -74,56 +83,54 @@ Driver::getVertexShaderDesc()
    shaderDesc.binary = vsShaderBinary;
    shaderDesc.fsBinary = fsShaderBinary;
 
-   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
    shaderDesc.aluInstPreferVector = sq_config.ALU_INST_PREFER_VECTOR();
 
    for (auto i = 0; i < latte::MaxTextures; ++i) {
       auto resourceOffset = (latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + i) * 7;
-      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
-      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(registers, latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
       shaderDesc.texDims[i] = sq_tex_resource_word0.DIM();
       shaderDesc.texFormat[i] = spirvTextureTypeFromLatte(sq_tex_resource_word4.NUM_FORMAT_ALL());
    }
 
-   shaderDesc.regs.sq_pgm_resources_vs = getRegister<latte::SQ_PGM_RESOURCES_VS>(latte::Register::SQ_PGM_RESOURCES_VS);
-   shaderDesc.regs.pa_cl_vs_out_cntl = getRegister<latte::PA_CL_VS_OUT_CNTL>(latte::Register::PA_CL_VS_OUT_CNTL);
+   shaderDesc.regs.sq_pgm_resources_vs = getRegister<latte::SQ_PGM_RESOURCES_VS>(registers, latte::Register::SQ_PGM_RESOURCES_VS);
+   shaderDesc.regs.pa_cl_vs_out_cntl = getRegister<latte::PA_CL_VS_OUT_CNTL>(registers, latte::Register::PA_CL_VS_OUT_CNTL);
 
    for (auto i = 0u; i < 32; ++i) {
-      shaderDesc.regs.sq_vtx_semantics[i] = getRegister<latte::SQ_VTX_SEMANTIC_N>(latte::Register::SQ_VTX_SEMANTIC_0 + i * 4);
+      shaderDesc.regs.sq_vtx_semantics[i] = getRegister<latte::SQ_VTX_SEMANTIC_N>(registers, latte::Register::SQ_VTX_SEMANTIC_0 + i * 4);
    }
 
    for (auto i = 0; i < latte::MaxStreamOutBuffers; ++i) {
       // Note that these registers are not contiguous!
-      shaderDesc.streamOutStride[i] = getRegister<uint32_t>(latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + i * 16) << 2;
+      shaderDesc.streamOutStride[i] = getRegister<uint32_t>(registers, latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + i * 16) << 2;
    }
 
    return shaderDesc;
 }
 
 spirv::GeometryShaderDesc
-Driver::getGeometryShaderDesc()
+buildGeometryShaderDesc(const ShaderRegisters &registers)
 {
    // Do not generate geometry shaders if they are disabled
-   auto vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(latte::Register::VGT_GS_MODE);
+   auto vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(registers, latte::Register::VGT_GS_MODE);
    if (vgt_gs_mode.MODE() == latte::VGT_GS_ENABLE_MODE::OFF) {
       return spirv::GeometryShaderDesc();
    }
 
-   decaf_check(mCurrentDraw->vertexShader);
-
    // Geometry shader comes from geometry shader register
-   auto pgm_start_gs = getRegister<latte::SQ_PGM_START_VS>(latte::Register::SQ_PGM_START_GS);
-   auto pgm_offset_gs = getRegister<latte::SQ_PGM_CF_OFFSET_GS>(latte::Register::SQ_PGM_CF_OFFSET_GS);
-   auto pgm_size_gs = getRegister<latte::SQ_PGM_SIZE_GS>(latte::Register::SQ_PGM_SIZE_GS);
+   auto pgm_start_gs = getRegister<latte::SQ_PGM_START_VS>(registers, latte::Register::SQ_PGM_START_GS);
+   auto pgm_offset_gs = getRegister<latte::SQ_PGM_CF_OFFSET_GS>(registers, latte::Register::SQ_PGM_CF_OFFSET_GS);
+   auto pgm_size_gs = getRegister<latte::SQ_PGM_SIZE_GS>(registers, latte::Register::SQ_PGM_SIZE_GS);
    auto gsShaderBinary = gsl::make_span(
       phys_cast<uint8_t*>(phys_addr(pgm_start_gs.PGM_START() << 8)).getRawPointer(),
       pgm_size_gs.PGM_SIZE() << 3);
    decaf_check(pgm_offset_gs.PGM_OFFSET() == 0);
 
    // Data cache shader comes from vertex shader register
-   auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(latte::Register::SQ_PGM_START_VS);
-   auto pgm_offset_vs = getRegister<latte::SQ_PGM_CF_OFFSET_VS>(latte::Register::SQ_PGM_CF_OFFSET_VS);
-   auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(latte::Register::SQ_PGM_SIZE_VS);
+   auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(registers, latte::Register::SQ_PGM_START_VS);
+   auto pgm_offset_vs = getRegister<latte::SQ_PGM_CF_OFFSET_VS>(registers, latte::Register::SQ_PGM_CF_OFFSET_VS);
+   auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(registers, latte::Register::SQ_PGM_SIZE_VS);
    auto dcShaderBinary = gsl::make_span(
       phys_cast<uint8_t*>(phys_addr(pgm_start_vs.PGM_START() << 8)).getRawPointer(),
       pgm_size_vs.PGM_SIZE() << 3);
@@ -140,45 +147,43 @@ Driver::getGeometryShaderDesc()
    shaderDesc.binary = gsShaderBinary;
    shaderDesc.dcBinary = dcShaderBinary;
 
-   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
    shaderDesc.aluInstPreferVector = sq_config.ALU_INST_PREFER_VECTOR();
 
    for (auto i = 0; i < latte::MaxTextures; ++i) {
       auto resourceOffset = (latte::SQ_RES_OFFSET::GS_TEX_RESOURCE_0 + i) * 7;
-      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
-      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(registers, latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
       shaderDesc.texDims[i] = sq_tex_resource_word0.DIM();
       shaderDesc.texFormat[i] = spirvTextureTypeFromLatte(sq_tex_resource_word4.NUM_FORMAT_ALL());
    }
 
-   shaderDesc.regs.sq_gs_vert_itemsize = getRegister<latte::SQ_GS_VERT_ITEMSIZE>(latte::Register::SQ_GS_VERT_ITEMSIZE);
-   shaderDesc.regs.vgt_gs_out_prim_type = getRegister<latte::VGT_GS_OUT_PRIMITIVE_TYPE>(latte::Register::VGT_GS_OUT_PRIM_TYPE);
-   shaderDesc.regs.vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(latte::Register::VGT_GS_MODE);
-   shaderDesc.regs.sq_gsvs_ring_itemsize = getRegister<uint32_t>(latte::Register::SQ_GSVS_RING_ITEMSIZE);
-   shaderDesc.regs.pa_cl_vs_out_cntl = getRegister<latte::PA_CL_VS_OUT_CNTL>(latte::Register::PA_CL_VS_OUT_CNTL);
+   shaderDesc.regs.sq_gs_vert_itemsize = getRegister<latte::SQ_GS_VERT_ITEMSIZE>(registers, latte::Register::SQ_GS_VERT_ITEMSIZE);
+   shaderDesc.regs.vgt_gs_out_prim_type = getRegister<latte::VGT_GS_OUT_PRIMITIVE_TYPE>(registers, latte::Register::VGT_GS_OUT_PRIM_TYPE);
+   shaderDesc.regs.vgt_gs_mode = getRegister<latte::VGT_GS_MODE>(registers, latte::Register::VGT_GS_MODE);
+   shaderDesc.regs.sq_gsvs_ring_itemsize = getRegister<uint32_t>(registers, latte::Register::SQ_GSVS_RING_ITEMSIZE);
+   shaderDesc.regs.pa_cl_vs_out_cntl = getRegister<latte::PA_CL_VS_OUT_CNTL>(registers, latte::Register::PA_CL_VS_OUT_CNTL);
 
    for (auto i = 0; i < latte::MaxStreamOutBuffers; ++i) {
       // Note that these registers are not contiguous!
-      shaderDesc.streamOutStride[i] = getRegister<uint32_t>(latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + i * 16) << 2;
+      shaderDesc.streamOutStride[i] = getRegister<uint32_t>(registers, latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + i * 16) << 2;
    }
 
    return shaderDesc;
 }
 
 spirv::PixelShaderDesc
-Driver::getPixelShaderDesc()
+buildPixelShaderDesc(const ShaderRegisters &registers)
 {
    // Do not generate pixel shaders if rasterization is disabled
-   auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(latte::Register::PA_CL_CLIP_CNTL);
+   auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(registers, latte::Register::PA_CL_CLIP_CNTL);
    if (pa_cl_clip_cntl.RASTERISER_DISABLE()) {
       return spirv::PixelShaderDesc();
    }
 
-   decaf_check(mCurrentDraw->vertexShader);
-
-   auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(latte::Register::SQ_PGM_START_PS);
-   auto pgm_offset_ps = getRegister<latte::SQ_PGM_CF_OFFSET_PS>(latte::Register::SQ_PGM_CF_OFFSET_PS);
-   auto pgm_size_ps = getRegister<latte::SQ_PGM_SIZE_PS>(latte::Register::SQ_PGM_SIZE_PS);
+   auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(registers, latte::Register::SQ_PGM_START_PS);
+   auto pgm_offset_ps = getRegister<latte::SQ_PGM_CF_OFFSET_PS>(registers, latte::Register::SQ_PGM_CF_OFFSET_PS);
+   auto pgm_size_ps = getRegister<latte::SQ_PGM_SIZE_PS>(registers, latte::Register::SQ_PGM_SIZE_PS);
    auto psShaderBinary = gsl::make_span(
       phys_cast<uint8_t*>(phys_addr(pgm_start_ps.PGM_START() << 8)).getRawPointer(),
       pgm_size_ps.PGM_SIZE() << 3);
@@ -188,39 +193,67 @@ Driver::getPixelShaderDesc()
    shaderDesc.type = spirv::ShaderType::Pixel;
    shaderDesc.binary = psShaderBinary;
 
-   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
+   auto sq_config = getRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
    shaderDesc.aluInstPreferVector = sq_config.ALU_INST_PREFER_VECTOR();
 
    for (auto i = 0; i < latte::MaxRenderTargets; ++i) {
-      auto cb_color_info = getRegister<latte::CB_COLORN_INFO>(latte::Register::CB_COLOR0_INFO + i * 4);
+      auto cb_color_info = getRegister<latte::CB_COLORN_INFO>(registers, latte::Register::CB_COLOR0_INFO + i * 4);
       shaderDesc.pixelOutType[i] = spirvPixelTypeFromLatte(cb_color_info.NUMBER_TYPE());
    }
 
    for (auto i = 0; i < latte::MaxTextures; ++i) {
       auto resourceOffset = (latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0 + i) * 7;
-      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
-      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(registers, latte::Register::SQ_RESOURCE_WORD4_0 + 4 * resourceOffset);
       shaderDesc.texDims[i] = sq_tex_resource_word0.DIM();
       shaderDesc.texFormat[i] = spirvTextureTypeFromLatte(sq_tex_resource_word4.NUM_FORMAT_ALL());
    }
 
-   shaderDesc.regs.sq_pgm_resources_ps = getRegister<latte::SQ_PGM_RESOURCES_PS>(latte::Register::SQ_PGM_RESOURCES_PS);
-   shaderDesc.regs.sq_pgm_exports_ps = getRegister<latte::SQ_PGM_EXPORTS_PS>(latte::Register::SQ_PGM_EXPORTS_PS);
+   shaderDesc.regs.sq_pgm_resources_ps = getRegister<latte::SQ_PGM_RESOURCES_PS>(registers, latte::Register::SQ_PGM_RESOURCES_PS);
+   shaderDesc.regs.sq_pgm_exports_ps = getRegister<latte::SQ_PGM_EXPORTS_PS>(registers, latte::Register::SQ_PGM_EXPORTS_PS);
 
-   shaderDesc.regs.spi_ps_in_control_0 = getRegister<latte::SPI_PS_IN_CONTROL_0>(latte::Register::SPI_PS_IN_CONTROL_0);
-   shaderDesc.regs.spi_ps_in_control_1 = getRegister<latte::SPI_PS_IN_CONTROL_1>(latte::Register::SPI_PS_IN_CONTROL_1);
-   shaderDesc.regs.spi_vs_out_config = getRegister<latte::SPI_VS_OUT_CONFIG>(latte::Register::SPI_VS_OUT_CONFIG);
+   shaderDesc.regs.spi_ps_in_control_0 = getRegister<latte::SPI_PS_IN_CONTROL_0>(registers, latte::Register::SPI_PS_IN_CONTROL_0);
+   shaderDesc.regs.spi_ps_in_control_1 = getRegister<latte::SPI_PS_IN_CONTROL_1>(registers, latte::Register::SPI_PS_IN_CONTROL_1);
+   shaderDesc.regs.spi_vs_out_config = getRegister<latte::SPI_VS_OUT_CONFIG>(registers, latte::Register::SPI_VS_OUT_CONFIG);
 
-   shaderDesc.regs.cb_shader_control = getRegister<latte::CB_SHADER_CONTROL>(latte::Register::CB_SHADER_CONTROL);
-   shaderDesc.regs.cb_shader_mask = getRegister<latte::CB_SHADER_MASK>(latte::Register::CB_SHADER_MASK);
-   shaderDesc.regs.db_shader_control = getRegister<latte::DB_SHADER_CONTROL>(latte::Register::DB_SHADER_CONTROL);
+   shaderDesc.regs.cb_shader_control = getRegister<latte::CB_SHADER_CONTROL>(registers, latte::Register::CB_SHADER_CONTROL);
+   shaderDesc.regs.cb_shader_mask = getRegister<latte::CB_SHADER_MASK>(registers, latte::Register::CB_SHADER_MASK);
+   shaderDesc.regs.db_shader_control = getRegister<latte::DB_SHADER_CONTROL>(registers, latte::Register::DB_SHADER_CONTROL);
 
    for (auto i = 0; i < 32; ++i) {
-      shaderDesc.regs.spi_ps_input_cntls[i] = getRegister<latte::SPI_PS_INPUT_CNTL_N>(latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
+      shaderDesc.regs.spi_ps_input_cntls[i] = getRegister<latte::SPI_PS_INPUT_CNTL_N>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
    }
 
    for (auto i = 0; i < 10; ++i) {
-      shaderDesc.regs.spi_vs_out_ids[i] = getRegister<latte::SPI_VS_OUT_ID_N>(latte::Register::SPI_VS_OUT_ID_0 + i * 4);
+      shaderDesc.regs.spi_vs_out_ids[i] = getRegister<latte::SPI_VS_OUT_ID_N>(registers, latte::Register::SPI_VS_OUT_ID_0 + i * 4);
+   }
+
+   return shaderDesc;
+}
+
+spirv::VertexShaderDesc
+Driver::getVertexShaderDesc()
+{
+   return buildVertexShaderDesc(mRegisters);
+}
+
+spirv::GeometryShaderDesc
+Driver::getGeometryShaderDesc()
+{
+   auto shaderDesc = buildGeometryShaderDesc(mRegisters);
+   if (shaderDesc.type != spirv::ShaderType::Unknown) {
+      decaf_check(mCurrentDraw->vertexShader);
+   }
+
+   return shaderDesc;
+}
+
+spirv::PixelShaderDesc
+Driver::getPixelShaderDesc()
+{
+   auto shaderDesc = buildPixelShaderDesc(mRegisters);
+   if (shaderDesc.type != spirv::ShaderType::Unknown) {
+      decaf_check(mCurrentDraw->vertexShader);
    }
 
    return shaderDesc;
@@ -476,8 +509,12 @@ Driver::checkCurrentVertexShader()
       dumpRawShader(&*currentDesc, mDumpShaderBinariesOnly);
    }
 
-   if (!spirv::translate(*currentDesc, &foundShader->shader)) {
-      decaf_abort("Failed to translate vertex shader");
+   if (!mShaderCache.load(*currentDesc, foundShader->shader)) {
+      if (!spirv::translate(*currentDesc, &foundShader->shader)) {
+         decaf_abort("Failed to translate vertex shader");
+      }
+
+      mShaderCache.store(*currentDesc, foundShader->shader);
    }
 
    if (mDumpShaders) {
@@ -532,8 +569,12 @@ Driver::checkCurrentGeometryShader()
       dumpRawShader(&*currentDesc, mDumpShaderBinariesOnly);
    }
 
-   if (!spirv::translate(*currentDesc, &foundShader->shader)) {
-      decaf_abort("Failed to translate geometry shader");
+   if (!mShaderCache.load(*currentDesc, foundShader->shader)) {
+      if (!spirv::translate(*currentDesc, &foundShader->shader)) {
+         decaf_abort("Failed to translate geometry shader");
+      }
+
+      mShaderCache.store(*currentDesc, foundShader->shader);
    }
 
    if (mDumpShaders) {
@@ -587,8 +628,12 @@ Driver::checkCurrentPixelShader()
       dumpRawShader(&*currentDesc, mDumpShaderBinariesOnly);
    }
 
-   if (!spirv::translate(*currentDesc, &foundShader->shader)) {
-      decaf_abort("Failed to translate pixel shader");
+   if (!mShaderCache.load(*currentDesc, foundShader->shader)) {
+      if (!spirv::translate(*currentDesc, &foundShader->shader)) {
+         decaf_abort("Failed to translate pixel shader");
+      }
+
+      mShaderCache.store(*currentDesc, foundShader->shader);
    }
 
    if (mDumpShaders) {
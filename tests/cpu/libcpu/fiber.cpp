@@ -0,0 +1,121 @@
+#include <catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <common/platform_fiber.h>
+#include <cstring>
+#include <fmt/format.h>
+
+struct PingPongState
+{
+   platform::Fiber *main = nullptr;
+   platform::Fiber *ping = nullptr;
+   platform::Fiber *pong = nullptr;
+   uint64_t remaining = 0;
+   uint64_t switches = 0;
+};
+
+static void
+pingEntry(void *param)
+{
+   auto state = reinterpret_cast<PingPongState *>(param);
+
+   while (state->remaining) {
+      state->remaining--;
+      state->switches++;
+      platform::swapToFiber(state->ping, state->pong);
+   }
+
+   platform::swapToFiber(state->ping, state->main);
+}
+
+static void
+pongEntry(void *param)
+{
+   auto state = reinterpret_cast<PingPongState *>(param);
+
+   while (true) {
+      state->switches++;
+      platform::swapToFiber(state->pong, state->ping);
+   }
+}
+
+static uint64_t
+runPingPong(uint64_t count)
+{
+   auto state = PingPongState { };
+   state.remaining = count;
+   state.main = platform::getThreadFiber();
+   state.ping = platform::createFiber(pingEntry, &state);
+   state.pong = platform::createFiber(pongEntry, &state);
+
+   platform::swapToFiber(state.main, state.ping);
+
+   platform::destroyFiber(state.pong);
+   platform::destroyFiber(state.ping);
+   platform::destroyFiber(state.main);
+   return state.switches;
+}
+
+TEST_CASE("fiber ping pong")
+{
+   REQUIRE(runPingPong(1000) == 2000);
+
+   // Run again so we exercise reused stacks
+   REQUIRE(runPingPong(1000) == 2000);
+}
+
+struct StackState
+{
+   platform::Fiber *main = nullptr;
+   platform::Fiber *fiber = nullptr;
+   double result = 0.0;
+};
+
+static double
+useStack(int depth)
+{
+   // Use a reasonable amount of stack and floating point state, so we
+   // notice if the fiber stack is too small or misaligned.
+   alignas(32) double values[256];
+   for (auto i = 0; i < 256; ++i) {
+      values[i] = std::sqrt(static_cast<double>(i + depth));
+   }
+
+   auto sum = 0.0;
+   for (auto value : values) {
+      sum += value;
+   }
+
+   return depth ? sum + useStack(depth - 1) : sum;
+}
+
+TEST_CASE("fiber stack usage")
+{
+   auto state = StackState { };
+   state.main = platform::getThreadFiber();
+   state.fiber = platform::createFiber(
+      [](void *param) {
+         auto state = reinterpret_cast<StackState *>(param);
+         state->result = useStack(64);
+         platform::swapToFiber(state->fiber, state->main);
+      }, &state);
+
+   platform::swapToFiber(state.main, state.fiber);
+   REQUIRE(state.result == useStack(64));
+
+   platform::destroyFiber(state.fiber);
+   platform::destroyFiber(state.main);
+}
+
+TEST_CASE("fiber switch performance", "[!benchmark]")
+{
+   constexpr auto NumSwitches = 10000000ull;
+   auto start = std::chrono::high_resolution_clock::now();
+   auto switches = runPingPong(NumSwitches / 2);
+   auto duration = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(
+      std::chrono::high_resolution_clock::now() - start);
+
+   REQUIRE(switches == NumSwitches);
+   WARN(fmt::format("{:.1f} ns per switch", duration.count() / switches));
+}
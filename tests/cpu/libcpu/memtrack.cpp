@@ -0,0 +1,186 @@
+#include <catch.hpp>
+
+#include <array>
+#include <common/datahash.h>
+#include <common/platform_memory.h>
+#include <cstring>
+#include <libcpu/cpu_config.h>
+#include <libcpu/memtrack.h>
+#include <libcpu/mmu.h>
+
+static constexpr auto TrackedVirtualAddress = cpu::VirtualAddress { 0x10000000 };
+static constexpr auto TrackedPhysicalAddress = cpu::PhysicalAddress { 0x10000000 };
+static constexpr auto TrackedSize = uint32_t { 16 * 1024 * 1024 };
+
+/**
+ * Memory tracking can only be initialised once per process, so each backend
+ * has its own test tag which CMake runs in a separate process.
+ */
+static uint8_t *
+getTrackedMemory(cpu::MemorySettings::WriteTrackBackend backend)
+{
+   static bool initialised = false;
+   static auto initialisedBackend = cpu::MemorySettings::PageGuard;
+
+   if (!initialised) {
+      auto settings = cpu::Settings { };
+      settings.memory.writeTrackEnabled = true;
+      settings.memory.writeTrackBackend = backend;
+      cpu::setConfig(settings);
+
+      REQUIRE(cpu::initialiseMemory());
+      REQUIRE(cpu::allocateVirtualAddress(TrackedVirtualAddress, TrackedSize));
+      REQUIRE(cpu::mapMemory(TrackedVirtualAddress, TrackedPhysicalAddress,
+                             TrackedSize, cpu::MapPermission::ReadWrite));
+      initialisedBackend = backend;
+      initialised = true;
+   }
+
+   REQUIRE(initialisedBackend == backend);
+   return reinterpret_cast<uint8_t *>(cpu::getBaseVirtualAddress() +
+                                      TrackedVirtualAddress.getAddress());
+}
+
+static void
+checkDetectsWrites(uint8_t *memory)
+{
+   auto offset = uint32_t { 0x123000 };
+   auto size = uint32_t { 0x10000 };
+
+   auto state = cpu::getMemoryState(TrackedPhysicalAddress + offset, size);
+   REQUIRE(cpu::getMemoryState(TrackedPhysicalAddress + offset, size) == state);
+
+   // A write inside the range must change the state
+   memory[offset + 0x4321] = 0xAB;
+   auto newState = cpu::getMemoryState(TrackedPhysicalAddress + offset, size);
+   REQUIRE(newState != state);
+   REQUIRE(cpu::getMemoryState(TrackedPhysicalAddress + offset, size) == newState);
+
+   // A write outside the range must not change the state
+   memory[offset + size + 0x1000] = 0xCD;
+   REQUIRE(cpu::getMemoryState(TrackedPhysicalAddress + offset, size) == newState);
+}
+
+static void
+checkDirtyPages(uint8_t *memory)
+{
+   static constexpr auto NumPages = 8u;
+   auto pageSize = static_cast<uint32_t>(platform::getSystemPageSize());
+   auto offset = uint32_t { 0x400000 };
+
+   auto getPageState = [&](uint32_t page) {
+      return cpu::getMemoryState(TrackedPhysicalAddress + offset + page * pageSize,
+                                 pageSize);
+   };
+
+   auto states = std::array<cpu::MemtrackState, NumPages> { };
+   for (auto i = 0u; i < NumPages; ++i) {
+      states[i] = getPageState(i);
+   }
+
+   auto rangeState = cpu::getMemoryState(TrackedPhysicalAddress + offset,
+                                         NumPages * pageSize);
+
+   // Only the written pages are dirty
+   memory[offset + 3 * pageSize] = 0x12;
+   memory[offset + 5 * pageSize + pageSize - 1] = 0x34;
+
+   for (auto i = 0u; i < NumPages; ++i) {
+      auto state = getPageState(i);
+      if (i == 3 || i == 5) {
+         REQUIRE(state != states[i]);
+      } else {
+         REQUIRE(state == states[i]);
+      }
+
+      states[i] = state;
+   }
+
+   auto newRangeState = cpu::getMemoryState(TrackedPhysicalAddress + offset,
+                                            NumPages * pageSize);
+   REQUIRE(newRangeState != rangeState);
+   REQUIRE(cpu::getMemoryState(TrackedPhysicalAddress + offset,
+                               NumPages * pageSize) == newRangeState);
+
+   // Pages are tracked again after being queried, so a second write to the
+   // same page is seen as well
+   memory[offset + 3 * pageSize + 1] = 0x56;
+
+   for (auto i = 0u; i < NumPages; ++i) {
+      if (i == 3) {
+         REQUIRE(getPageState(i) != states[i]);
+      } else {
+         REQUIRE(getPageState(i) == states[i]);
+      }
+   }
+}
+
+TEST_CASE("memtrack page guard detects writes", "[memtrack][page_guard]")
+{
+   checkDetectsWrites(getTrackedMemory(cpu::MemorySettings::PageGuard));
+   REQUIRE(cpu::getMemtrackBackend() == cpu::MemorySettings::PageGuard);
+}
+
+TEST_CASE("memtrack page guard dirty pages", "[memtrack][page_guard]")
+{
+   checkDirtyPages(getTrackedMemory(cpu::MemorySettings::PageGuard));
+}
+
+TEST_CASE("memtrack page scan detects writes", "[.][memtrack][page_scan]")
+{
+   auto memory = getTrackedMemory(cpu::MemorySettings::PageScan);
+   if (cpu::getMemtrackBackend() != cpu::MemorySettings::PageScan) {
+      WARN("Page scan write tracking is not supported by this host, skipping");
+      return;
+   }
+
+   checkDetectsWrites(memory);
+}
+
+TEST_CASE("memtrack page scan dirty pages", "[.][memtrack][page_scan]")
+{
+   auto memory = getTrackedMemory(cpu::MemorySettings::PageScan);
+   if (cpu::getMemtrackBackend() != cpu::MemorySettings::PageScan) {
+      WARN("Page scan write tracking is not supported by this host, skipping");
+      return;
+   }
+
+   checkDirtyPages(memory);
+}
+
+TEST_CASE("memtrack performance", "[!benchmark][memtrack][page_scan]")
+{
+   auto memory = getTrackedMemory(cpu::MemorySettings::PageScan);
+   auto physicalMemory = reinterpret_cast<uint8_t *>(cpu::getBasePhysicalAddress() +
+                                                     TrackedPhysicalAddress.getAddress());
+
+   // Simulate a title streaming vertex data, touching one in every 16 pages
+   auto writePages = [&]()
+   {
+      for (auto offset = 0u; offset < TrackedSize; offset += 16 * 4096) {
+         memory[offset] += 1;
+      }
+   };
+
+   BENCHMARK("hash, unmodified")
+   {
+      return DataHash {}.write(physicalMemory, TrackedSize).value();
+   };
+
+   BENCHMARK("hash, modified")
+   {
+      writePages();
+      return DataHash {}.write(physicalMemory, TrackedSize).value();
+   };
+
+   BENCHMARK("tracked, unmodified")
+   {
+      return cpu::getMemoryState(TrackedPhysicalAddress, TrackedSize).state;
+   };
+
+   BENCHMARK("tracked, modified")
+   {
+      writePages();
+      return cpu::getMemoryState(TrackedPhysicalAddress, TrackedSize).state;
+   };
+}
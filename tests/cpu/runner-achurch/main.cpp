@@ -1,5 +1,7 @@
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <libcpu/cpu.h>
 #include <libcpu/cpu_config.h>
@@ -8,9 +10,18 @@
 #include <memory>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_sinks.h>
+#include <string>
 
-int
-runTests()
+static constexpr auto BaseCodeAddress = 0x01000000u;
+static constexpr auto BaseDataAddress = 0x03000000u;
+static constexpr auto DataSize = 0x02000000u;
+
+//! Number of benchmark iterations, 0 to run the tests normally.
+static uint32_t
+sBenchmarkIterations = 0;
+
+static bool
+loadTests()
 {
    // Built From http://achurch.org/cpu-tests/ppc750cl.s
    // powerpc-eabi-as ppc750cl.S -o ppc750cl.o --defsym TEST_SC=0 --defsym HAVE_UGQR=1 --defsym TEST_TRAP=0
@@ -19,7 +30,7 @@ runTests()
 
    if (!file.is_open()) {
       gLog->error("Could not open data/achurch.bin");
-      return -1;
+      return false;
    }
 
    // Calculate the total size of the file
@@ -28,35 +39,50 @@ runTests()
    file.seekg(0, std::ios::beg);
 
    // Allocate code memory
-   auto baseCodeAddress = cpu::VirtualAddress { 0x01000000u };
+   auto baseCodeAddress = cpu::VirtualAddress { BaseCodeAddress };
    auto baseCodePhysicalAddress = cpu::PhysicalAddress { 0x50000000u };
    auto codeSize = align_up(static_cast<uint32_t>(file_size), cpu::PageSize);
    cpu::allocateVirtualAddress(baseCodeAddress, codeSize);
    cpu::mapMemory(baseCodeAddress, baseCodePhysicalAddress, codeSize, cpu::MapPermission::ReadWrite);
 
    // Allocate data memory
-   auto baseDataAddress = cpu::VirtualAddress { 0x03000000u };
+   auto baseDataAddress = cpu::VirtualAddress { BaseDataAddress };
    auto baseDataPhysicalAddress = cpu::PhysicalAddress { 0x52000000u };
-   auto dataSize = 0x02000000u;
-   cpu::allocateVirtualAddress(baseDataAddress, dataSize);
-   cpu::mapMemory(baseDataAddress, baseDataPhysicalAddress, dataSize, cpu::MapPermission::ReadWrite);
+   cpu::allocateVirtualAddress(baseDataAddress, DataSize);
+   cpu::mapMemory(baseDataAddress, baseDataPhysicalAddress, DataSize, cpu::MapPermission::ReadWrite);
 
    // Read the file directly into PPC memory
    file.read(mem::translate<char>(baseCodeAddress.getAddress()), file_size);
+   return true;
+}
 
+static uint32_t
+executeTests()
+{
    auto core = cpu::this_core::state();
-   auto scratchMemAddr = baseDataAddress.getAddress() + (dataSize / 2);
-   auto failResultsAddr = baseDataAddress.getAddress();
+   auto scratchMemAddr = BaseDataAddress + (DataSize / 2);
+   auto failResultsAddr = BaseDataAddress;
    std::memset(mem::translate<void>(scratchMemAddr), 0, 32 * 1024u);
 
-   core->nia = baseCodeAddress.getAddress();
+   core->nia = BaseCodeAddress;
    core->gpr[3] = 0;
    core->gpr[4] = scratchMemAddr;
    core->gpr[5] = failResultsAddr;
    core->fpr[1].paired0 = 1.0;
    cpu::this_core::executeSub();
 
-   auto failedTests = core->gpr[3];
+   return core->gpr[3];
+}
+
+int
+runTests()
+{
+   if (!loadTests()) {
+      return -1;
+   }
+
+   auto failResultsAddr = BaseDataAddress;
+   auto failedTests = executeTests();
 
    if (failedTests) {
       for (uint32_t i = 0; i < failedTests; ++i) {
@@ -82,6 +108,49 @@ runTests()
    return 0;
 }
 
+/**
+ * Run the tests repeatedly on the interpreter and report how many guest
+ * instructions it runs per second. The first iteration also includes the
+ * cost of decoding every instruction into the interpreter's cache.
+ */
+int
+runBenchmark()
+{
+   if (!loadTests()) {
+      return -1;
+   }
+
+   auto totalInstructions = uint64_t { 0 };
+   auto totalSeconds = 0.0;
+
+   for (auto i = 0u; i < sBenchmarkIterations; ++i) {
+      auto startInstructions = cpu::getInterpreterInstructionCount();
+      auto start = std::chrono::steady_clock::now();
+      auto failedTests = executeTests();
+      auto end = std::chrono::steady_clock::now();
+
+      if (failedTests) {
+         gLog->error("Failed {} tests during benchmark.", failedTests);
+         return static_cast<int>(failedTests);
+      }
+
+      auto instructions = cpu::getInterpreterInstructionCount() - startInstructions;
+      auto seconds = std::chrono::duration<double> { end - start }.count();
+      gLog->info("Iteration {}: {} instructions in {:.3f} ms, {:.2f} MIPS",
+                 i, instructions, seconds * 1000.0,
+                 instructions / seconds / 1000000.0);
+
+      if (i > 0 || sBenchmarkIterations == 1) {
+         totalInstructions += instructions;
+         totalSeconds += seconds;
+      }
+   }
+
+   gLog->info("Interpreter average {:.2f} MIPS excluding the first iteration",
+              totalInstructions / totalSeconds / 1000000.0);
+   return 0;
+}
+
 int main(int argc, char *argv[])
 {
    int runResult;
@@ -91,6 +160,21 @@ int main(int argc, char *argv[])
 
    auto cpuConfig = cpu::Settings { };
    cpuConfig.jit.enabled = true;
+
+   for (auto i = 1; i < argc; ++i) {
+      auto arg = std::string { argv[i] };
+
+      if (arg == "--interpreter") {
+         cpuConfig.jit.enabled = false;
+      } else if (arg == "--benchmark" && i + 1 < argc) {
+         sBenchmarkIterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+         cpuConfig.jit.enabled = false;
+      } else {
+         gLog->error("Usage: {} [--interpreter] [--benchmark <iterations>]", argv[0]);
+         return -1;
+      }
+   }
+
    cpu::setConfig(cpuConfig);
    cpu::initialise();
 
@@ -99,7 +183,11 @@ int main(int argc, char *argv[])
       [&runResult](cpu::Core *core) {
          if (cpu::this_core::id() == 1) {
             // Run the tests on only a single core.
-            runResult = runTests();
+            if (sBenchmarkIterations) {
+               runResult = runBenchmark();
+            } else {
+               runResult = runTests();
+            }
          }
       });
 
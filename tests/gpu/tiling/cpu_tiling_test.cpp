@@ -2,6 +2,7 @@
 #include "addrlib_helpers.h"
 #include "test_helpers.h"
 
+#include <chrono>
 #include <common/align.h>
 #include <libgpu/gpu7_tiling_cpu.h>
 
@@ -59,7 +60,34 @@ compareTilingToAddrLib(const gpu7::tiling::SurfaceDescription& desc,
    CHECK(compareImages(gpu7Tiled, alibTiled));
 }
 
-TEST_CASE("cpuTiling")
+static constexpr gpu7::tiling::cpu::KernelIsa
+sTestKernelIsas[] = {
+   gpu7::tiling::cpu::KernelIsa::Scalar,
+   gpu7::tiling::cpu::KernelIsa::SSE2,
+   gpu7::tiling::cpu::KernelIsa::AVX2,
+};
+
+// 0 selects the default of one thread per host core
+static constexpr uint32_t
+sTestNumThreads[] = { 1u, 2u, 4u, 0u };
+
+static const char *
+kernelIsaToString(gpu7::tiling::cpu::KernelIsa isa)
+{
+   switch (isa) {
+   case gpu7::tiling::cpu::KernelIsa::Scalar:
+      return "Scalar";
+   case gpu7::tiling::cpu::KernelIsa::SSE2:
+      return "SSE2";
+   case gpu7::tiling::cpu::KernelIsa::AVX2:
+      return "AVX2";
+   default:
+      return "Unknown";
+   }
+}
+
+static void
+testCpuTiling()
 {
    for (auto& layout : sTestLayout) {
       SECTION(fmt::format("{}x{}x{} s{}n{}",
@@ -100,6 +128,158 @@ TEST_CASE("cpuTiling")
    }
 }
 
+TEST_CASE("cpuTiling")
+{
+   auto defaultIsa = gpu7::tiling::cpu::getKernelIsa();
+
+   for (auto isa : sTestKernelIsas) {
+      if (!gpu7::tiling::cpu::setKernelIsa(isa)) {
+         WARN(fmt::format("Skipping unsupported ISA {}", kernelIsaToString(isa)));
+         continue;
+      }
+
+      SECTION(kernelIsaToString(isa))
+      {
+         testCpuTiling();
+      }
+   }
+
+   gpu7::tiling::cpu::setKernelIsa(defaultIsa);
+}
+
+static constexpr TestFormat
+sTestIsaFormats[] = {
+   { gpu7::tiling::DataFormat::FMT_8, 8u, false },
+   { gpu7::tiling::DataFormat::FMT_8_8, 16u, false },
+   { gpu7::tiling::DataFormat::FMT_8_8_8_8, 32u, false },
+   { gpu7::tiling::DataFormat::FMT_32_32, 64u, false },
+   { gpu7::tiling::DataFormat::FMT_32_32_32_32, 128u, false },
+   { gpu7::tiling::DataFormat::FMT_16, 16u, true },
+   { gpu7::tiling::DataFormat::FMT_32, 32u, true },
+   { gpu7::tiling::DataFormat::FMT_X24_8_32_FLOAT, 64u, true },
+};
+
+static std::vector<uint8_t>
+untileWithIsa(gpu7::tiling::cpu::KernelIsa isa,
+              const gpu7::tiling::SurfaceInfo &info,
+              std::vector<uint8_t> &input,
+              uint32_t firstSlice,
+              uint32_t numSlices)
+{
+   auto untiled = std::vector<uint8_t> { };
+   untiled.resize(info.surfSize);
+
+   auto retileInfo = gpu7::tiling::computeRetileInfo(info);
+   auto tiledFirstSliceIndex = align_down(firstSlice, retileInfo.microTileThickness);
+   auto tiledSliceOffset = tiledFirstSliceIndex * retileInfo.thinSliceBytes;
+   auto untiledSliceOffset = firstSlice * retileInfo.thinSliceBytes;
+
+   gpu7::tiling::cpu::setKernelIsa(isa);
+   gpu7::tiling::cpu::untile(retileInfo,
+                             untiled.data() + untiledSliceOffset,
+                             input.data() + tiledSliceOffset,
+                             firstSlice, numSlices);
+   return untiled;
+}
+
+// Depth formats are not part of the AddrLib comparison, so also compare the
+// SIMD kernels against the scalar kernels to cover the depth paths.
+TEST_CASE("cpuTilingIsa")
+{
+   auto defaultIsa = gpu7::tiling::cpu::getKernelIsa();
+   auto& layout = sPerfTestLayout;
+
+   for (auto& mode : sTestTilingMode) {
+      for (auto& format : sTestIsaFormats) {
+         auto surface = gpu7::tiling::SurfaceDescription { };
+         surface.tileMode = mode.tileMode;
+         surface.format = format.format;
+         surface.bpp = format.bpp;
+         surface.width = layout.width;
+         surface.height = layout.height;
+         surface.numSlices = layout.depth;
+         surface.numSamples = 1u;
+         surface.numLevels = 1u;
+         surface.bankSwizzle = 0u;
+         surface.pipeSwizzle = 0u;
+         surface.dim = gpu7::tiling::SurfaceDim::Texture2DArray;
+         surface.use = format.depth ?
+            gpu7::tiling::SurfaceUse::DepthBuffer :
+            gpu7::tiling::SurfaceUse::None;
+
+         auto info = gpu7::tiling::computeSurfaceInfo(surface, 0);
+         auto reference = untileWithIsa(gpu7::tiling::cpu::KernelIsa::Scalar, info, sRandomData,
+                                        layout.testFirstSlice, layout.testNumSlices);
+
+         for (auto isa : sTestKernelIsas) {
+            if (isa == gpu7::tiling::cpu::KernelIsa::Scalar ||
+                !gpu7::tiling::cpu::setKernelIsa(isa)) {
+               continue;
+            }
+
+            INFO(fmt::format("{} {}bpp{} {}", tileModeToString(mode.tileMode),
+                             format.bpp, format.depth ? " depth" : "",
+                             kernelIsaToString(isa)));
+            CHECK(compareImages(untileWithIsa(isa, info, sRandomData,
+                                              layout.testFirstSlice, layout.testNumSlices),
+                                reference));
+         }
+      }
+   }
+
+   gpu7::tiling::cpu::setKernelIsa(defaultIsa);
+}
+
+// Retiling is split across the worker pool by slice and macro tile row, the
+// result must be identical to retiling everything on the calling thread.
+TEST_CASE("cpuTilingThreads")
+{
+   auto defaultNumThreads = gpu7::tiling::cpu::getNumThreads();
+   auto isa = gpu7::tiling::cpu::getKernelIsa();
+   auto& layout = sPerfTestLayout;
+
+   for (auto& mode : sTestTilingMode) {
+      for (auto& format : sTestIsaFormats) {
+         auto surface = gpu7::tiling::SurfaceDescription { };
+         surface.tileMode = mode.tileMode;
+         surface.format = format.format;
+         surface.bpp = format.bpp;
+         surface.width = layout.width;
+         surface.height = layout.height;
+         surface.numSlices = layout.depth;
+         surface.numSamples = 1u;
+         surface.numLevels = 1u;
+         surface.bankSwizzle = 0u;
+         surface.pipeSwizzle = 0u;
+         surface.dim = gpu7::tiling::SurfaceDim::Texture2DArray;
+         surface.use = format.depth ?
+            gpu7::tiling::SurfaceUse::DepthBuffer :
+            gpu7::tiling::SurfaceUse::None;
+
+         auto info = gpu7::tiling::computeSurfaceInfo(surface, 0);
+         gpu7::tiling::cpu::setNumThreads(1);
+         auto reference = untileWithIsa(isa, info, sRandomData,
+                                        layout.testFirstSlice, layout.testNumSlices);
+
+         for (auto numThreads : sTestNumThreads) {
+            if (numThreads == 1) {
+               continue;
+            }
+
+            gpu7::tiling::cpu::setNumThreads(numThreads);
+            INFO(fmt::format("{} {}bpp{} {} threads", tileModeToString(mode.tileMode),
+                             format.bpp, format.depth ? " depth" : "",
+                             gpu7::tiling::cpu::getNumThreads()));
+            CHECK(compareImages(untileWithIsa(isa, info, sRandomData,
+                                              layout.testFirstSlice, layout.testNumSlices),
+                                reference));
+         }
+      }
+   }
+
+   gpu7::tiling::cpu::setNumThreads(defaultNumThreads);
+}
+
 struct ALibPendingCpuPerfEntry
 {
    gpu7::tiling::SurfaceDescription desc;
@@ -221,24 +401,61 @@ TEST_CASE("cpuTilingPerf", "[!benchmark]")
 
    static constexpr auto TestIterMulti = 10;
 
-   BENCHMARK(fmt::format("processing ({} retiles)", pendingTests.size() * TestIterMulti))
-   {
-      for (auto i = 0; i < TestIterMulti; ++i) {
-         for (auto& test : pendingTests) {
+   auto totalBytes = size_t { 0 };
+   for (auto& test : pendingTests) {
+      totalBytes += test.info.sliceSize * test.numSlices;
+   }
 
-            auto retileInfo = gpu7::tiling::computeRetileInfo(test.info);
+   auto runTests =
+      [&]()
+      {
+         for (auto i = 0; i < TestIterMulti; ++i) {
+            for (auto& test : pendingTests) {
+
+               auto retileInfo = gpu7::tiling::computeRetileInfo(test.info);
 
-            auto tiledFirstSliceIndex = align_down(test.firstSlice, retileInfo.microTileThickness);
-            auto tiledSliceOffset = tiledFirstSliceIndex * retileInfo.thinSliceBytes;
-            auto untiledSliceOffset = test.firstSlice * retileInfo.thinSliceBytes;
+               auto tiledFirstSliceIndex = align_down(test.firstSlice, retileInfo.microTileThickness);
+               auto tiledSliceOffset = tiledFirstSliceIndex * retileInfo.thinSliceBytes;
+               auto untiledSliceOffset = test.firstSlice * retileInfo.thinSliceBytes;
 
-            gpu7::tiling::cpu::untile(retileInfo,
-                                      untiled.data() + untiledSliceOffset,
-                                      tiledImage.data() + tiledSliceOffset,
-                                      test.firstSlice,
-                                      test.numSlices);
+               gpu7::tiling::cpu::untile(retileInfo,
+                                         untiled.data() + untiledSliceOffset,
+                                         tiledImage.data() + tiledSliceOffset,
+                                         test.firstSlice,
+                                         test.numSlices);
+            }
          }
+      };
+
+   auto defaultIsa = gpu7::tiling::cpu::getKernelIsa();
+   auto defaultNumThreads = gpu7::tiling::cpu::getNumThreads();
+
+   for (auto isa : sTestKernelIsas) {
+      if (!gpu7::tiling::cpu::setKernelIsa(isa)) {
+         continue;
       }
-   };
-}
 
+      for (auto numThreads : sTestNumThreads) {
+         gpu7::tiling::cpu::setNumThreads(numThreads);
+         auto config = fmt::format("{} {} threads", kernelIsaToString(isa),
+                                   gpu7::tiling::cpu::getNumThreads());
+
+         BENCHMARK(fmt::format("{} processing ({} retiles, {} MiB)",
+                               config,
+                               pendingTests.size() * TestIterMulti,
+                               (totalBytes * TestIterMulti) / (1024 * 1024)))
+         {
+            runTests();
+         };
+
+         auto start = std::chrono::steady_clock::now();
+         runTests();
+         auto elapsed = std::chrono::duration<double> { std::chrono::steady_clock::now() - start };
+         WARN(fmt::format("{}: {:.1f} MB/s", config,
+                          (totalBytes * TestIterMulti) / elapsed.count() / (1000 * 1000)));
+      }
+   }
+
+   gpu7::tiling::cpu::setNumThreads(defaultNumThreads);
+   gpu7::tiling::cpu::setKernelIsa(defaultIsa);
+}
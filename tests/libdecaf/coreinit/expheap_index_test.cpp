@@ -0,0 +1,761 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "cafe/libraries/coreinit/coreinit_internal_expheapindex.h"
+#include "cafe/libraries/coreinit/coreinit_memexpheap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <common/align.h>
+#include <cstring>
+#include <fmt/format.h>
+#include <libcpu/be2_struct.h>
+#include <libcpu/mmu.h>
+#include <random>
+#include <vector>
+
+using namespace cafe::coreinit;
+using cafe::coreinit::internal::ExpHeapFreeIndex;
+
+static constexpr auto HeapVirtualAddress = cpu::VirtualAddress { 0x10000000 };
+static constexpr auto HeapPhysicalAddress = cpu::PhysicalAddress { 0x10000000 };
+static constexpr auto HeapMemorySize = uint32_t { 256 * 1024 * 1024 };
+
+//! Heaps start on this alignment so the same offset in two heaps has the
+//! same alignment for any allocation.
+static constexpr auto HeapAlignment = uint32_t { 0x10000 };
+
+static constexpr auto FreeTag = uint16_t { 0x4654 };
+static constexpr auto UsedTag = uint16_t { 0x5544 };
+
+/**
+ * Get guest memory for a new heap. The heap's index is keyed by its address
+ * and these heaps are never destroyed, so every heap gets its own memory.
+ */
+static virt_addr
+allocateHeapMemory(uint32_t size)
+{
+   static auto initialised = false;
+   static auto next = uint32_t { 0 };
+
+   if (!initialised) {
+      REQUIRE(cpu::initialiseMemory());
+      REQUIRE(cpu::allocateVirtualAddress(HeapVirtualAddress, HeapMemorySize));
+      REQUIRE(cpu::mapMemory(HeapVirtualAddress, HeapPhysicalAddress,
+                             HeapMemorySize, cpu::MapPermission::ReadWrite));
+      initialised = true;
+   }
+
+   size = align_up(size, HeapAlignment);
+   REQUIRE(next + size <= HeapMemorySize);
+
+   auto address = virt_addr { HeapVirtualAddress.getAddress() + next };
+   next += size;
+   return address;
+}
+
+/**
+ * Set up a heap the same as MEMCreateExpHeapEx, without registering it with
+ * the arena lists which need the rest of coreinit.
+ */
+static virt_ptr<MEMExpHeap>
+createHeap(uint32_t size,
+           MEMExpHeapMode mode,
+           bool reuseAlignSpace)
+{
+   auto base = allocateHeapMemory(size);
+   auto heap = virt_cast<MEMExpHeap *>(base);
+   std::memset(heap.get(), 0, sizeof(MEMExpHeap));
+
+   heap->header.tag = MEMHeapTag::ExpandedHeap;
+   heap->header.dataStart = virt_cast<uint8_t *>(heap) + sizeof(MEMExpHeap);
+   heap->header.dataEnd = virt_cast<uint8_t *>(base + size);
+   heap->header.flags = MEMHeapFlags::None;
+
+   auto firstBlock = virt_cast<MEMExpHeapBlock *>(heap->header.dataStart);
+   firstBlock->attribs = MEMExpHeapBlockAttribs::get(0);
+   firstBlock->blockSize = static_cast<uint32_t>(size - sizeof(MEMExpHeap) - sizeof(MEMExpHeapBlock));
+   firstBlock->next = nullptr;
+   firstBlock->prev = nullptr;
+   firstBlock->tag = FreeTag;
+
+   heap->freeList.head = firstBlock;
+   heap->freeList.tail = firstBlock;
+   heap->usedList.head = nullptr;
+   heap->usedList.tail = nullptr;
+
+   heap->groupId = uint16_t { 0 };
+   heap->attribs = MEMExpHeapAttribs::get(0)
+      .allocMode(mode)
+      .reuseAlignSpace(reuseAlignSpace);
+   return heap;
+}
+
+/**
+ * The free list walking heap which MEMExpHeap used before it had an index,
+ * kept here to compare the real heap against.
+ */
+namespace reference
+{
+
+static virt_ptr<uint8_t>
+getBlockMemStart(virt_ptr<MEMExpHeapBlock> block)
+{
+   auto attribs = block->attribs.value();
+   return virt_cast<uint8_t *>(block) - attribs.alignment();
+}
+
+static virt_ptr<uint8_t>
+getBlockMemEnd(virt_ptr<MEMExpHeapBlock> block)
+{
+   return virt_cast<uint8_t *>(block) + sizeof(MEMExpHeapBlock) + block->blockSize;
+}
+
+static void
+insertBlock(virt_ptr<MEMExpHeapBlockList> list,
+            virt_ptr<MEMExpHeapBlock> prev,
+            virt_ptr<MEMExpHeapBlock> block)
+{
+   if (!prev) {
+      block->next = list->head;
+      block->prev = nullptr;
+
+      list->head = block;
+   } else {
+      block->next = prev->next;
+      block->prev = prev;
+
+      prev->next = block;
+   }
+
+   if (block->next) {
+      block->next->prev = block;
+   } else {
+      list->tail = block;
+   }
+}
+
+static void
+removeBlock(virt_ptr<MEMExpHeapBlockList> list,
+            virt_ptr<MEMExpHeapBlock> block)
+{
+   if (block->prev) {
+      block->prev->next = block->next;
+   } else {
+      list->head = block->next;
+   }
+
+   if (block->next) {
+      block->next->prev = block->prev;
+   } else {
+      list->tail = block->prev;
+   }
+
+   block->prev = nullptr;
+   block->next = nullptr;
+}
+
+static virt_ptr<MEMExpHeapBlock>
+createUsedBlockFromFreeBlock(virt_ptr<MEMExpHeap> heap,
+                             virt_ptr<MEMExpHeapBlock> freeBlock,
+                             uint32_t size,
+                             uint32_t alignment,
+                             MEMExpHeapDirection dir)
+{
+   auto expHeapAttribs = heap->attribs.value();
+   auto freeBlockPrev = freeBlock->prev;
+   auto freeMemStart = getBlockMemStart(freeBlock);
+   auto freeMemEnd = getBlockMemEnd(freeBlock);
+   removeBlock(virt_addrof(heap->freeList), freeBlock);
+
+   auto alignedDataStart = virt_ptr<uint8_t> { };
+   if (dir == MEMExpHeapDirection::FromStart) {
+      alignedDataStart = align_up(freeMemStart + sizeof(MEMExpHeapBlock), alignment);
+   } else {
+      alignedDataStart = align_down(freeMemEnd - size, alignment);
+   }
+
+   auto alignedBlock = virt_cast<MEMExpHeapBlock *>(alignedDataStart) - 1;
+   REQUIRE(alignedDataStart - sizeof(MEMExpHeapBlock) >= freeMemStart);
+   REQUIRE(alignedDataStart + size <= freeMemEnd);
+
+   auto topSpaceRemain = (alignedDataStart - freeMemStart) - sizeof(MEMExpHeapBlock);
+   auto bottomSpaceRemain = static_cast<uint32_t>((freeMemEnd - alignedDataStart) - size);
+
+   if (expHeapAttribs.reuseAlignSpace() || dir == MEMExpHeapDirection::FromEnd) {
+      if (topSpaceRemain > sizeof(MEMExpHeapBlock) + 4) {
+         freeBlock = virt_cast<MEMExpHeapBlock *>(freeMemStart);
+         freeBlock->attribs = MEMExpHeapBlockAttribs::get(0);
+         freeBlock->blockSize = static_cast<uint32_t>(topSpaceRemain - sizeof(MEMExpHeapBlock));
+         freeBlock->next = nullptr;
+         freeBlock->prev = nullptr;
+         freeBlock->tag = FreeTag;
+
+         insertBlock(virt_addrof(heap->freeList), freeBlockPrev, freeBlock);
+         topSpaceRemain = 0;
+      }
+   }
+
+   if (expHeapAttribs.reuseAlignSpace() || dir == MEMExpHeapDirection::FromStart) {
+      if (bottomSpaceRemain > sizeof(MEMExpHeapBlock) + 4) {
+         freeBlock = virt_cast<MEMExpHeapBlock *>(freeMemEnd - bottomSpaceRemain);
+         freeBlock->attribs = MEMExpHeapBlockAttribs::get(0);
+         freeBlock->blockSize = static_cast<uint32_t>(bottomSpaceRemain - sizeof(MEMExpHeapBlock));
+         freeBlock->next = nullptr;
+         freeBlock->prev = nullptr;
+         freeBlock->tag = FreeTag;
+
+         insertBlock(virt_addrof(heap->freeList), freeBlockPrev, freeBlock);
+         bottomSpaceRemain = 0;
+      }
+   }
+
+   alignedBlock->attribs = MEMExpHeapBlockAttribs::get(0)
+      .alignment(static_cast<uint32_t>(topSpaceRemain))
+      .allocDir(dir);
+   alignedBlock->blockSize = size + bottomSpaceRemain;
+   alignedBlock->prev = nullptr;
+   alignedBlock->next = nullptr;
+   alignedBlock->tag = UsedTag;
+
+   insertBlock(virt_addrof(heap->usedList), nullptr, alignedBlock);
+   return alignedBlock;
+}
+
+static void
+releaseMemory(virt_ptr<MEMExpHeap> heap,
+              virt_ptr<uint8_t> memStart,
+              virt_ptr<uint8_t> memEnd)
+{
+   virt_ptr<MEMExpHeapBlock> prevBlock = nullptr;
+   virt_ptr<MEMExpHeapBlock> nextBlock = heap->freeList.head;
+
+   for (auto block = heap->freeList.head; block; block = block->next) {
+      if (getBlockMemStart(block) < memStart) {
+         prevBlock = block;
+         nextBlock = block->next;
+      } else if (block >= prevBlock) {
+         break;
+      }
+   }
+
+   virt_ptr<MEMExpHeapBlock> freeBlock = nullptr;
+   if (prevBlock) {
+      if (memStart == getBlockMemEnd(prevBlock)) {
+         prevBlock->blockSize += static_cast<uint32_t>(memEnd - memStart);
+         freeBlock = prevBlock;
+      }
+   }
+
+   if (!freeBlock) {
+      freeBlock = virt_cast<MEMExpHeapBlock *>(memStart);
+      freeBlock->attribs = MEMExpHeapBlockAttribs::get(0);
+      freeBlock->blockSize = static_cast<uint32_t>((memEnd - memStart) - sizeof(MEMExpHeapBlock));
+      freeBlock->next = nullptr;
+      freeBlock->prev = nullptr;
+      freeBlock->tag = FreeTag;
+
+      insertBlock(virt_addrof(heap->freeList), prevBlock, freeBlock);
+   }
+
+   if (nextBlock) {
+      auto nextBlockStart = getBlockMemStart(nextBlock);
+
+      if (nextBlockStart == memEnd) {
+         auto nextBlockEnd = getBlockMemEnd(nextBlock);
+         freeBlock->blockSize += static_cast<uint32_t>(nextBlockEnd - nextBlockStart);
+         removeBlock(virt_addrof(heap->freeList), nextBlock);
+      }
+   }
+}
+
+static virt_ptr<void>
+allocFromExpHeap(virt_ptr<MEMExpHeap> heap,
+                 uint32_t size,
+                 int32_t alignment)
+{
+   auto mode = heap->attribs.value().allocMode();
+   auto dir = MEMExpHeapDirection::FromStart;
+
+   if (size == 0) {
+      size = 1;
+   }
+
+   size = align_up(size, 4);
+
+   if (alignment > 0) {
+      alignment = std::max(4, alignment);
+   } else {
+      alignment = std::max(4, -alignment);
+      dir = MEMExpHeapDirection::FromEnd;
+   }
+
+   auto foundBlock = virt_ptr<MEMExpHeapBlock> { nullptr };
+   auto bestAlignedSize = 0xFFFFFFFFu;
+
+   for (auto block = heap->freeList.head; block; block = block->next) {
+      auto alignedSize = ExpHeapFreeIndex::getAlignedSize(
+         static_cast<uint32_t>(virt_cast<virt_addr>(block)),
+         block->blockSize, alignment, dir);
+
+      if (alignedSize >= size) {
+         if (mode == MEMExpHeapMode::FirstFree) {
+            foundBlock = block;
+            break;
+         } else if (alignedSize < bestAlignedSize) {
+            foundBlock = block;
+            bestAlignedSize = alignedSize;
+         }
+      }
+   }
+
+   if (!foundBlock) {
+      return nullptr;
+   }
+
+   auto block = createUsedBlockFromFreeBlock(heap, foundBlock, size, alignment, dir);
+   return virt_cast<void *>(block + 1);
+}
+
+static void
+freeToExpHeap(virt_ptr<MEMExpHeap> heap,
+              virt_ptr<void> mem)
+{
+   auto block = virt_cast<MEMExpHeapBlock *>(mem) - 1;
+   auto memStart = getBlockMemStart(block);
+   auto memEnd = getBlockMemEnd(block);
+
+   removeBlock(virt_addrof(heap->usedList), block);
+   releaseMemory(heap, memStart, memEnd);
+}
+
+static uint32_t
+resizeForMBlockExpHeap(virt_ptr<MEMExpHeap> heap,
+                       virt_ptr<void> ptr,
+                       uint32_t size)
+{
+   auto block = virt_cast<MEMExpHeapBlock *>(ptr) - 1;
+   size = align_up(size, 4);
+
+   if (size < block->blockSize) {
+      auto releasedSpace = block->blockSize - size;
+
+      if (releasedSpace > sizeof(MEMExpHeapBlock) + 0x4) {
+         auto releasedMemEnd = getBlockMemEnd(block);
+         auto releasedMemStart = releasedMemEnd - releasedSpace;
+
+         block->blockSize -= releasedSpace;
+         releaseMemory(heap, releasedMemStart, releasedMemEnd);
+      }
+   } else if (size > block->blockSize) {
+      auto blockMemEnd = getBlockMemEnd(block);
+      auto freeBlock = virt_ptr<MEMExpHeapBlock> { nullptr };
+
+      for (auto i = heap->freeList.head; i; i = i->next) {
+         auto freeBlockMemStart = getBlockMemStart(i);
+
+         if (freeBlockMemStart == blockMemEnd) {
+            freeBlock = i;
+            break;
+         }
+
+         if (freeBlockMemStart > blockMemEnd) {
+            break;
+         }
+      }
+
+      if (!freeBlock) {
+         return 0;
+      }
+
+      auto freeBlockMemEnd = getBlockMemEnd(freeBlock);
+      auto freeMemSize = static_cast<uint32_t>(freeBlockMemEnd - getBlockMemStart(freeBlock));
+      removeBlock(virt_addrof(heap->freeList), freeBlock);
+
+      freeMemSize -= size - block->blockSize;
+      block->blockSize = size;
+
+      if (freeMemSize >= sizeof(MEMExpHeapBlock) + 0x4) {
+         releaseMemory(heap, freeBlockMemEnd - freeMemSize, freeBlockMemEnd);
+      } else {
+         block->blockSize += freeMemSize;
+      }
+   }
+
+   return block->blockSize;
+}
+
+static uint32_t
+adjustExpHeap(virt_ptr<MEMExpHeap> heap)
+{
+   auto lastFreeBlock = heap->freeList.tail;
+   if (!lastFreeBlock) {
+      return 0;
+   }
+
+   auto blockData = virt_cast<uint8_t *>(lastFreeBlock) + sizeof(MEMExpHeapBlock);
+   if (blockData + lastFreeBlock->blockSize != heap->header.dataEnd) {
+      return 0;
+   }
+
+   if (lastFreeBlock->prev) {
+      lastFreeBlock->prev->next = nullptr;
+   }
+
+   heap->header.dataEnd = getBlockMemStart(lastFreeBlock);
+   return static_cast<uint32_t>(virt_cast<uint8_t *>(heap->header.dataEnd) -
+                                virt_cast<uint8_t *>(heap));
+}
+
+static uint32_t
+getTotalFreeSize(virt_ptr<MEMExpHeap> heap)
+{
+   auto freeSize = 0u;
+   for (auto block = heap->freeList.head; block; block = block->next) {
+      freeSize += block->blockSize;
+   }
+
+   return freeSize;
+}
+
+} // namespace reference
+
+//! Offset of a pointer from the start of its heap, 0 for nullptr.
+template<typename PointerType>
+static uint32_t
+getOffset(virt_ptr<MEMExpHeap> heap,
+          const PointerType &ptr)
+{
+   auto address = virt_cast<virt_addr>(ptr);
+   if (!address) {
+      return 0;
+   }
+
+   return static_cast<uint32_t>(address - virt_cast<virt_addr>(heap));
+}
+
+/**
+ * Everything in a guest block list, as offsets from the heap so two heaps
+ * can be compared.
+ */
+static std::vector<uint32_t>
+dumpBlockList(virt_ptr<MEMExpHeap> heap,
+              virt_ptr<MEMExpHeapBlockList> list)
+{
+   auto dump = std::vector<uint32_t> { };
+   dump.push_back(getOffset(heap, list->head));
+   dump.push_back(getOffset(heap, list->tail));
+
+   for (auto block = list->head; block; block = block->next) {
+      dump.push_back(getOffset(heap, block));
+      dump.push_back(block->attribs.value().value);
+      dump.push_back(block->blockSize);
+      dump.push_back(getOffset(heap, block->prev));
+      dump.push_back(getOffset(heap, block->next));
+      dump.push_back(block->tag);
+   }
+
+   return dump;
+}
+
+static void
+compareHeaps(virt_ptr<MEMExpHeap> heap,
+             virt_ptr<MEMExpHeap> referenceHeap)
+{
+   REQUIRE(dumpBlockList(heap, virt_addrof(heap->freeList)) ==
+           dumpBlockList(referenceHeap, virt_addrof(referenceHeap->freeList)));
+   REQUIRE(dumpBlockList(heap, virt_addrof(heap->usedList)) ==
+           dumpBlockList(referenceHeap, virt_addrof(referenceHeap->usedList)));
+   REQUIRE(getOffset(heap, heap->header.dataEnd) ==
+           getOffset(referenceHeap, referenceHeap->header.dataEnd));
+   REQUIRE(MEMGetTotalFreeSizeForExpHeap(virt_cast<MEMHeapHeader *>(heap)) ==
+           reference::getTotalFreeSize(referenceHeap));
+}
+
+/**
+ * Run the same random allocations, frees and resizes on a real heap and on
+ * the reference heap, checking each result and both guest lists after
+ * every call.
+ */
+class HeapDifferential
+{
+public:
+   HeapDifferential(uint32_t seed,
+                    uint32_t size,
+                    MEMExpHeapMode mode,
+                    bool reuseAlignSpace) :
+      mRng(seed),
+      mHeap(createHeap(size, mode, reuseAlignSpace)),
+      mReferenceHeap(createHeap(size, mode, reuseAlignSpace))
+   {
+   }
+
+   void
+   alloc(uint32_t size,
+         int32_t alignment)
+   {
+      auto ptr = MEMAllocFromExpHeapEx(virt_cast<MEMHeapHeader *>(mHeap), size, alignment);
+      auto referencePtr = reference::allocFromExpHeap(mReferenceHeap, size, alignment);
+      REQUIRE(getOffset(mHeap, ptr) == getOffset(mReferenceHeap, referencePtr));
+
+      if (ptr) {
+         mAllocations.push_back(getOffset(mHeap, ptr));
+      }
+   }
+
+   void
+   free(size_t index)
+   {
+      auto offset = mAllocations[index];
+      mAllocations.erase(mAllocations.begin() + index);
+
+      MEMFreeToExpHeap(virt_cast<MEMHeapHeader *>(mHeap), getPointer(mHeap, offset));
+      reference::freeToExpHeap(mReferenceHeap, getPointer(mReferenceHeap, offset));
+   }
+
+   void
+   resize(size_t index,
+          uint32_t size)
+   {
+      auto offset = mAllocations[index];
+
+      // Growing into a free block which is too small corrupts both heaps,
+      // the resize only checks there is a free block after ours
+      auto block = virt_cast<MEMExpHeapBlock *>(getPointer(mReferenceHeap, offset)) - 1;
+      auto blockMemEnd = reference::getBlockMemEnd(block);
+
+      for (auto freeBlock = mReferenceHeap->freeList.head; freeBlock; freeBlock = freeBlock->next) {
+         if (reference::getBlockMemStart(freeBlock) == blockMemEnd) {
+            auto freeMemSize = static_cast<uint32_t>(reference::getBlockMemEnd(freeBlock) - blockMemEnd);
+            size = std::min(size, block->blockSize + freeMemSize);
+            break;
+         }
+      }
+
+      auto result = MEMResizeForMBlockExpHeap(virt_cast<MEMHeapHeader *>(mHeap),
+                                              getPointer(mHeap, offset), size);
+      auto referenceResult = reference::resizeForMBlockExpHeap(mReferenceHeap,
+                                                               getPointer(mReferenceHeap, offset),
+                                                               size);
+      REQUIRE(result == referenceResult);
+   }
+
+   void
+   adjust()
+   {
+      auto result = MEMAdjustExpHeap(virt_cast<MEMHeapHeader *>(mHeap));
+      REQUIRE(result == reference::adjustExpHeap(mReferenceHeap));
+   }
+
+   void
+   compare()
+   {
+      compareHeaps(mHeap, mReferenceHeap);
+   }
+
+   void
+   run(size_t numOperations)
+   {
+      static const int32_t alignments[] = { 4, 8, 16, 32, 64, 128, 256, 4096 };
+
+      for (auto i = 0u; i < numOperations; ++i) {
+         auto op = mRng() % 8;
+
+         if (mAllocations.empty() || op < 4) {
+            // Mostly small allocations, with the occasional large one which
+            // often does not fit
+            auto size = static_cast<uint32_t>((mRng() % 16) ? 1 + mRng() % 256 : 1 + mRng() % 0x100000);
+            auto alignment = alignments[mRng() % 8];
+
+            // The FromEnd fit check ignores the data start being aligned
+            // down, a size which is not a multiple of the alignment can
+            // fail a decaf_check in both heaps
+            if (mRng() % 4 == 0) {
+               size = align_up(size, static_cast<uint32_t>(alignment));
+               alignment = -alignment;
+            }
+
+            alloc(size, alignment);
+         } else if (op < 7) {
+            free(mRng() % mAllocations.size());
+         } else {
+            resize(mRng() % mAllocations.size(), 1 + mRng() % 512);
+         }
+
+         compare();
+      }
+   }
+
+   void
+   freeAll()
+   {
+      while (!mAllocations.empty()) {
+         free(mRng() % mAllocations.size());
+         compare();
+      }
+   }
+
+private:
+   static virt_ptr<void>
+   getPointer(virt_ptr<MEMExpHeap> heap,
+              uint32_t offset)
+   {
+      return virt_cast<void *>(virt_cast<virt_addr>(heap) + offset);
+   }
+
+private:
+   std::mt19937 mRng;
+   virt_ptr<MEMExpHeap> mHeap;
+   virt_ptr<MEMExpHeap> mReferenceHeap;
+   std::vector<uint32_t> mAllocations;
+};
+
+TEST_CASE("expheap matches free list walk")
+{
+   for (auto mode : { MEMExpHeapMode::FirstFree, MEMExpHeapMode::NearestSize }) {
+      for (auto reuseAlignSpace : { false, true }) {
+         DYNAMIC_SECTION("mode " << static_cast<int>(mode) <<
+                         " reuseAlignSpace " << reuseAlignSpace)
+         {
+            auto test = HeapDifferential { 0x4558504D, 0x400000, mode, reuseAlignSpace };
+            test.run(4000);
+            test.freeAll();
+            test.run(1000);
+         }
+      }
+   }
+}
+
+TEST_CASE("expheap matches free list walk after adjust")
+{
+   for (auto reuseAlignSpace : { false, true }) {
+      DYNAMIC_SECTION("reuseAlignSpace " << reuseAlignSpace)
+      {
+         auto test = HeapDifferential { 0x41444A53, 0x100000, MEMExpHeapMode::FirstFree,
+                                        reuseAlignSpace };
+         test.run(1000);
+         test.adjust();
+         test.compare();
+
+         // The adjusted heap's tail is left pointing at the removed block
+         test.run(500);
+         test.adjust();
+         test.compare();
+      }
+   }
+}
+
+TEST_CASE("expheap reuseAlignSpace keeps the guest free list order")
+{
+   auto test = HeapDifferential { 0, 0x100000, MEMExpHeapMode::FirstFree, true };
+
+   // Leaves free space both before and after the allocation, which go in
+   // the free list with the higher addressed block first
+   test.alloc(0x100, 0x1000);
+   test.compare();
+
+   // FirstFree takes the first block in the list, not the lowest address
+   test.alloc(0x10, 4);
+   test.alloc(0x10, -4);
+   test.alloc(0x10, 4);
+   test.compare();
+
+   test.resize(0, 0x200);
+   test.compare();
+   test.freeAll();
+}
+
+TEST_CASE("expheap index nearest size prefers lowest address on ties")
+{
+   auto index = ExpHeapFreeIndex { };
+   index.insertFree(0x3000, 0x100);
+   index.insertFree(0x1000, 0x100);
+   index.insertFree(0x2000, 0x80);
+
+   REQUIRE(index.findFree(0x80, 4, MEMExpHeapDirection::FromStart, MEMExpHeapMode::NearestSize) == 0x2000);
+   REQUIRE(index.findFree(0x84, 4, MEMExpHeapDirection::FromStart, MEMExpHeapMode::NearestSize) == 0x1000);
+   REQUIRE(index.findFree(0x84, 4, MEMExpHeapDirection::FromStart, MEMExpHeapMode::FirstFree) == 0x1000);
+   REQUIRE(index.findFree(0x200, 4, MEMExpHeapDirection::FromStart, MEMExpHeapMode::FirstFree) == 0);
+}
+
+TEST_CASE("expheap index counts unsorted free list links")
+{
+   auto index = ExpHeapFreeIndex { };
+   REQUIRE(index.isFreeListSorted());
+
+   index.insertFreeLink(0x1000, 0x2000);
+   REQUIRE(index.isFreeListSorted());
+
+   index.insertFreeLink(0x2000, 0x1800);
+   index.insertFreeLink(0x3000, 0x800);
+   REQUIRE(!index.isFreeListSorted());
+
+   index.removeFreeLink(0x2000, 0x1800);
+   REQUIRE(!index.isFreeListSorted());
+
+   index.removeFreeLink(0x3000, 0x800);
+   REQUIRE(index.isFreeListSorted());
+
+   // Links to the start or end of the list are never unsorted
+   index.insertFreeLink(0, 0x1000);
+   index.insertFreeLink(0x1000, 0);
+   REQUIRE(index.isFreeListSorted());
+}
+
+TEST_CASE("expheap allocation performance", "[!benchmark]")
+{
+   // Lots of small live allocations, as with titles which allocate many
+   // small objects every frame
+   constexpr auto NumIterations = 100000;
+   constexpr auto NumLive = 4000;
+
+   for (auto mode : { MEMExpHeapMode::FirstFree, MEMExpHeapMode::NearestSize }) {
+      auto rng = std::mt19937 { 0x53545245 };
+      auto heap = createHeap(0x1000000, mode, false);
+      auto referenceHeap = createHeap(0x1000000, mode, false);
+      auto allocations = std::vector<uint32_t> { };
+      auto time = std::chrono::nanoseconds { 0 };
+      auto referenceTime = std::chrono::nanoseconds { 0 };
+
+      for (auto i = 0; i < NumIterations; ++i) {
+         if (allocations.size() < NumLive || rng() % 2) {
+            auto size = 1 + rng() % 512;
+
+            auto start = std::chrono::steady_clock::now();
+            auto ptr = MEMAllocFromExpHeapEx(virt_cast<MEMHeapHeader *>(heap), size, 4);
+            auto middle = std::chrono::steady_clock::now();
+            auto referencePtr = reference::allocFromExpHeap(referenceHeap, size, 4);
+            auto end = std::chrono::steady_clock::now();
+
+            time += middle - start;
+            referenceTime += end - middle;
+            REQUIRE(getOffset(heap, ptr) == getOffset(referenceHeap, referencePtr));
+            allocations.push_back(getOffset(heap, ptr));
+         } else {
+            auto index = rng() % allocations.size();
+            auto offset = allocations[index];
+            allocations.erase(allocations.begin() + index);
+
+            auto start = std::chrono::steady_clock::now();
+            MEMFreeToExpHeap(virt_cast<MEMHeapHeader *>(heap),
+                             virt_cast<void *>(virt_cast<virt_addr>(heap) + offset));
+            auto middle = std::chrono::steady_clock::now();
+            reference::freeToExpHeap(referenceHeap,
+                                     virt_cast<void *>(virt_cast<virt_addr>(referenceHeap) + offset));
+            auto end = std::chrono::steady_clock::now();
+
+            time += middle - start;
+            referenceTime += end - middle;
+         }
+      }
+
+      compareHeaps(heap, referenceHeap);
+
+      using milliseconds = std::chrono::duration<double, std::milli>;
+      WARN(fmt::format("{}: free list walk {:.2f} ms, index {:.2f} ms for {} operations",
+                       mode == MEMExpHeapMode::FirstFree ? "FirstFree" : "NearestSize",
+                       milliseconds { referenceTime }.count(),
+                       milliseconds { time }.count(),
+                       NumIterations));
+   }
+}
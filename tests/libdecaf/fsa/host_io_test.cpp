@@ -0,0 +1,592 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "ios/ios.h"
+#include "ios/fs/ios_fs_fsa_device.h"
+#include "ios/fs/ios_fs_host_io.h"
+#include "vfs/vfs_host_device.h"
+#include "vfs/vfs_host_filehandle.h"
+#include "vfs/vfs_host_mappedfilehandle.h"
+#include "vfs/vfs_virtual_device.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <libcpu/be2_struct.h>
+#include <libcpu/mmu.h>
+#include <map>
+#include <mutex>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace ios::fs;
+using namespace ios::fs::internal;
+
+struct TemporaryFile
+{
+   TemporaryFile(const std::vector<uint8_t> &data)
+   {
+      static std::atomic<int> sCounter { 0 };
+      path = std::filesystem::temp_directory_path() /
+         fmt::format("decaf-test-fsa-{}.bin", sCounter++);
+
+      auto file = std::ofstream { path, std::ofstream::binary };
+      file.write(reinterpret_cast<const char *>(data.data()), data.size());
+   }
+
+   ~TemporaryFile()
+   {
+      auto error = std::error_code { };
+      std::filesystem::remove(path, error);
+   }
+
+   std::unique_ptr<vfs::HostFileHandle>
+   open(vfs::FileHandle::Mode mode = vfs::FileHandle::Read)
+   {
+      auto handle = fopen(path.string().c_str(),
+                          (mode & vfs::FileHandle::Write) ? "r+b" : "rb");
+      REQUIRE(handle);
+      return std::make_unique<vfs::HostFileHandle>(handle, mode);
+   }
+
+   std::unique_ptr<vfs::HostMappedFileHandle>
+   openMapped()
+   {
+      auto size = size_t { 0 };
+      auto handle = platform::openMemoryMappedFile(path.string(),
+                                                   platform::ProtectFlags::ReadOnly,
+                                                   &size);
+      REQUIRE(handle != platform::InvalidMapFileHandle);
+
+      auto view = platform::mapViewOfFile(handle, platform::ProtectFlags::ReadOnly, 0, size);
+      REQUIRE(view);
+      return std::make_unique<vfs::HostMappedFileHandle>(handle,
+                                                         static_cast<uint8_t *>(view),
+                                                         static_cast<int64_t>(size),
+                                                         vfs::FileHandle::Read);
+   }
+
+   std::filesystem::path path;
+};
+
+static std::vector<uint8_t>
+generateData(size_t size)
+{
+   auto rng = std::mt19937 { 0xF5A };
+   auto data = std::vector<uint8_t>(size);
+
+   for (auto &value : data) {
+      value = static_cast<uint8_t>(rng());
+   }
+
+   return data;
+}
+
+/**
+ * Waits for a fixed number of host IO completions.
+ */
+struct CompletionCounter
+{
+   void complete()
+   {
+      std::unique_lock<std::mutex> lock { mutex };
+      completed++;
+      cv.notify_all();
+   }
+
+   void wait(size_t count)
+   {
+      std::unique_lock<std::mutex> lock { mutex };
+      cv.wait(lock, [&]() { return completed >= count; });
+   }
+
+   std::mutex mutex;
+   std::condition_variable cv;
+   size_t completed = 0;
+};
+
+TEST_CASE("host file readAt")
+{
+   auto data = generateData(64 * 1024 + 123);
+   auto file = TemporaryFile { data };
+   auto handle = file.open();
+
+   // Read a range in the middle of the file
+   auto buffer = std::vector<uint8_t>(4096);
+   auto result = handle->readAt(buffer.data(), 16, 256, 1000);
+   REQUIRE(result);
+   REQUIRE(*result == 256);
+   REQUIRE(std::equal(buffer.begin(), buffer.end(), data.begin() + 1000));
+
+   // readAt must not move the file position
+   REQUIRE(*handle->tell() == 0);
+
+   // A read past the end only returns the complete elements
+   result = handle->readAt(buffer.data(), 100, 10, static_cast<int64_t>(data.size()) - 250);
+   REQUIRE(result);
+   REQUIRE(*result == 2);
+}
+
+TEST_CASE("host file readAt is not supported for writable handles")
+{
+   auto file = TemporaryFile { generateData(1024) };
+   auto handle = file.open(static_cast<vfs::FileHandle::Mode>(vfs::FileHandle::Read | vfs::FileHandle::Write));
+   auto buffer = std::vector<uint8_t>(16);
+   REQUIRE(handle->readAt(buffer.data(), 1, 16, 0).error() == vfs::Error::OperationNotSupported);
+}
+
+TEST_CASE("host io reads in flight")
+{
+   constexpr auto ChunkSize = 4096;
+   constexpr auto NumChunks = 256;
+   auto data = generateData(ChunkSize * NumChunks);
+   auto file = TemporaryFile { data };
+   auto handle = std::shared_ptr<vfs::FileHandle> { file.open() };
+   auto buffer = std::vector<uint8_t>(data.size());
+   auto counter = CompletionCounter { };
+   auto numFailed = std::atomic<int> { 0 };
+
+   startHostIoThreads();
+
+   // Submit in reverse order so completion order does not match file order
+   for (auto i = NumChunks - 1; i >= 0; --i) {
+      submitHostRead(handle, buffer.data() + i * ChunkSize, 1, ChunkSize,
+                     i * ChunkSize,
+                     [&](vfs::Result<int64_t> result) {
+                        if (!result || *result != ChunkSize) {
+                           numFailed++;
+                        }
+
+                        counter.complete();
+                     });
+   }
+
+   // Dropping our reference must not close the file under in flight reads
+   handle.reset();
+   counter.wait(NumChunks);
+   stopHostIoThreads();
+
+   REQUIRE(numFailed == 0);
+   REQUIRE(buffer == data);
+}
+
+TEST_CASE("host mapped file matches stdio")
+{
+   auto data = generateData(1024 * 1024 + 77);
+   auto file = TemporaryFile { data };
+   auto stdio = file.open();
+   auto mapped = file.openMapped();
+   auto rng = std::mt19937 { 0xF5A };
+   auto stdioBuffer = std::vector<uint8_t>(256 * 1024);
+   auto mappedBuffer = std::vector<uint8_t>(256 * 1024);
+
+   REQUIRE(*mapped->size() == *stdio->size());
+
+   // A mix of sequential and random reads, including ones past the end
+   for (auto i = 0; i < 256; ++i) {
+      if (rng() % 3 == 0) {
+         auto position = static_cast<int64_t>(rng() % (data.size() + 1024));
+         REQUIRE(stdio->seek(vfs::FileHandle::SeekStart, position) == vfs::Error::Success);
+         REQUIRE(mapped->seek(vfs::FileHandle::SeekStart, position) == vfs::Error::Success);
+      }
+
+      auto size = static_cast<int64_t>(1 + rng() % 16);
+      auto count = static_cast<int64_t>(rng() % (stdioBuffer.size() / size));
+      auto stdioResult = stdio->read(stdioBuffer.data(), size, count);
+      auto mappedResult = mapped->read(mappedBuffer.data(), size, count);
+
+      REQUIRE(stdioResult);
+      REQUIRE(mappedResult);
+      REQUIRE(*mappedResult == *stdioResult);
+      REQUIRE(std::equal(stdioBuffer.begin(), stdioBuffer.begin() + *stdioResult * size,
+                         mappedBuffer.begin()));
+      REQUIRE(*mapped->tell() == *stdio->tell());
+      REQUIRE(*mapped->eof() == *stdio->eof());
+   }
+}
+
+TEST_CASE("host mapped file is read only")
+{
+   auto file = TemporaryFile { generateData(1024) };
+   auto mapped = file.openMapped();
+   auto buffer = std::vector<uint8_t>(16);
+   REQUIRE(mapped->write(buffer.data(), 1, 16).error() == vfs::Error::ReadOnly);
+   REQUIRE(mapped->truncate().error() == vfs::Error::ReadOnly);
+   REQUIRE(mapped->seek(vfs::FileHandle::SeekStart, -1) == vfs::Error::InvalidSeekPosition);
+
+   mapped->close();
+   REQUIRE(mapped->read(buffer.data(), 1, 16).error() == vfs::Error::NotOpen);
+}
+
+//! Guest memory for the FSA requests, responses and read buffers.
+static constexpr auto FsaRequestAddress = phys_addr { 0x10000000 };
+static constexpr auto FsaResponseAddress = phys_addr { 0x10001000 };
+static constexpr auto FsaBufferAddress = phys_addr { 0x10010000 };
+
+/**
+ * Creates an FSADevice on a filesystem with the temporary directory mounted
+ * at /tmp, so a TemporaryFile can be opened through it.
+ */
+static std::unique_ptr<FSADevice>
+createFsaDevice()
+{
+   static auto memoryInitialised = cpu::initialiseMemory();
+   REQUIRE(memoryInitialised);
+
+   auto root = std::make_shared<vfs::VirtualDevice>("/");
+   auto host = std::make_shared<vfs::HostDevice>(std::filesystem::temp_directory_path());
+   REQUIRE(root->mountDevice(vfs::User { }, "/tmp", host) == vfs::Error::Success);
+   ios::setFileSystem(root);
+   return std::make_unique<FSADevice>();
+}
+
+static int32_t
+openFsaFile(FSADevice &device,
+            const TemporaryFile &file,
+            const char *mode)
+{
+   auto request = phys_cast<FSARequestOpenFile *>(FsaRequestAddress);
+   auto response = phys_cast<FSAResponseOpenFile *>(FsaResponseAddress);
+   std::memset(request.get(), 0, sizeof(FSARequestOpenFile));
+   request->path = "/tmp/" + file.path.filename().string();
+   request->mode = mode;
+
+   REQUIRE(device.openFile(vfs::User { }, request, response) == FSAStatus::OK);
+   return response->handle;
+}
+
+static uint32_t
+getFsaFilePosition(FSADevice &device,
+                   int32_t handle)
+{
+   auto request = phys_cast<FSARequestGetPosFile *>(FsaRequestAddress);
+   auto response = phys_cast<FSAResponseGetPosFile *>(FsaResponseAddress);
+   request->handle = handle;
+
+   REQUIRE(device.getPosFile(vfs::User { }, request, response) == FSAStatus::OK);
+   return response->pos;
+}
+
+/**
+ * Queue a read through FSADevice::readFileAsync, pos is only used when
+ * flags has ReadWithPos. The result is stored in status once complete.
+ */
+static void
+readFsaFileAsync(FSADevice &device,
+                 int32_t handle,
+                 phys_ptr<uint8_t> buffer,
+                 uint32_t size,
+                 uint32_t count,
+                 uint32_t pos,
+                 FSAReadFlag flags,
+                 CompletionCounter &counter,
+                 FSAStatus &status)
+{
+   auto request = phys_cast<FSARequestReadFile *>(FsaRequestAddress);
+   std::memset(request.get(), 0, sizeof(FSARequestReadFile));
+   request->size = size;
+   request->count = count;
+   request->pos = pos;
+   request->handle = handle;
+   request->readFlags = flags;
+
+   device.readFileAsync(vfs::User { }, request, buffer, size * count,
+                        [counter = &counter, status = &status](FSAStatus result) {
+                           *status = result;
+                           counter->complete();
+                        });
+}
+
+TEST_CASE("fsa readFileAsync advances the file position")
+{
+   constexpr auto ChunkSize = 4096u;
+   auto data = generateData(ChunkSize * 8);
+   auto file = TemporaryFile { data };
+   auto device = createFsaDevice();
+   auto handle = openFsaFile(*device, file, "r");
+   auto buffer = phys_cast<uint8_t *>(FsaBufferAddress);
+   auto counter = CompletionCounter { };
+   auto status = std::array<FSAStatus, 3> { };
+
+   startHostIoThreads();
+
+   // The position must move as soon as the read is queued, so the next
+   // read without a position starts after it
+   readFsaFileAsync(*device, handle, buffer, 1, ChunkSize, 0,
+                    FSAReadFlag::None, counter, status[0]);
+   REQUIRE(getFsaFilePosition(*device, handle) == ChunkSize);
+
+   readFsaFileAsync(*device, handle, buffer + ChunkSize, 1, ChunkSize, 0,
+                    FSAReadFlag::None, counter, status[1]);
+   REQUIRE(getFsaFilePosition(*device, handle) == ChunkSize * 2);
+
+   // A read with a position continues from the end of that read
+   readFsaFileAsync(*device, handle, buffer + ChunkSize * 2, 4, ChunkSize / 4, ChunkSize * 5,
+                    FSAReadFlag::ReadWithPos, counter, status[2]);
+   REQUIRE(getFsaFilePosition(*device, handle) == ChunkSize * 6);
+
+   counter.wait(3);
+   stopHostIoThreads();
+
+   for (auto &result : status) {
+      REQUIRE(result == static_cast<FSAStatus>(ChunkSize));
+   }
+
+   REQUIRE(std::equal(buffer.get(), buffer.get() + ChunkSize * 2, data.begin()));
+   REQUIRE(std::equal(buffer.get() + ChunkSize * 2, buffer.get() + ChunkSize * 3,
+                      data.begin() + ChunkSize * 5));
+}
+
+TEST_CASE("fsa readFileAsync short read at end of file")
+{
+   auto data = generateData(10000);
+   auto file = TemporaryFile { data };
+   auto device = createFsaDevice();
+   auto handle = openFsaFile(*device, file, "r");
+   auto buffer = phys_cast<uint8_t *>(FsaBufferAddress);
+   auto counter = CompletionCounter { };
+   auto status = FSAStatus { };
+
+   startHostIoThreads();
+
+   // Only the bytes up to the end of file are read
+   readFsaFileAsync(*device, handle, buffer, 1, 4096, 8192,
+                    FSAReadFlag::ReadWithPos, counter, status);
+   counter.wait(1);
+   REQUIRE(status == static_cast<FSAStatus>(10000 - 8192));
+   REQUIRE(std::equal(buffer.get(), buffer.get() + (10000 - 8192), data.begin() + 8192));
+   REQUIRE(getFsaFilePosition(*device, handle) == 10000);
+
+   auto isEofRequest = phys_cast<FSARequestIsEof *>(FsaRequestAddress);
+   isEofRequest->handle = handle;
+   REQUIRE(device->isEof(vfs::User { }, isEofRequest) == FSAStatus::EndOfFile);
+
+   // Only complete elements are counted
+   readFsaFileAsync(*device, handle, buffer, 100, 30, 7550,
+                    FSAReadFlag::ReadWithPos, counter, status);
+   counter.wait(2);
+   REQUIRE(status == static_cast<FSAStatus>(24 * 100));
+
+   stopHostIoThreads();
+}
+
+TEST_CASE("fsa readFileAsync falls back to readFile without readAt")
+{
+   auto data = generateData(16 * 1024);
+   auto file = TemporaryFile { data };
+   auto device = createFsaDevice();
+   auto buffer = phys_cast<uint8_t *>(FsaBufferAddress);
+   auto counter = CompletionCounter { };
+   auto status = FSAStatus { };
+
+   // Writable host file handles do not support readAt, so the read must be
+   // completed synchronously before readFileAsync returns
+   auto handle = openFsaFile(*device, file, "r+");
+   readFsaFileAsync(*device, handle, buffer, 1, 1000, 0,
+                    FSAReadFlag::None, counter, status);
+   REQUIRE(counter.completed == 1);
+   REQUIRE(status == static_cast<FSAStatus>(1000));
+   REQUIRE(std::equal(buffer.get(), buffer.get() + 1000, data.begin()));
+   REQUIRE(getFsaFilePosition(*device, handle) == 1000);
+
+   readFsaFileAsync(*device, handle, buffer, 1, 1000, 0,
+                    FSAReadFlag::None, counter, status);
+   REQUIRE(counter.completed == 2);
+   REQUIRE(status == static_cast<FSAStatus>(1000));
+   REQUIRE(std::equal(buffer.get(), buffer.get() + 1000, data.begin() + 1000));
+   REQUIRE(getFsaFilePosition(*device, handle) == 2000);
+}
+
+struct ReplayRead
+{
+   std::string path;
+   int64_t size;
+   int64_t count;
+   int64_t position;
+};
+
+/**
+ * Parse the FSADevice::openFile and FSADevice::readFile lines out of a
+ * decaf log, which needs to have been captured with log level trace.
+ */
+static std::vector<ReplayRead>
+parseFsaLog(const std::string &logPath)
+{
+   static const auto OpenFileRegex = std::regex {
+      R"(FSADevice::openFile\[(\d+)\] path: (\S+) mode: \S+ handle: \d+)" };
+   static const auto ReadFileRegex = std::regex {
+      R"(FSADevice::readFile\[(\d+)\] size: (\d+) count: (\d+)(?: withPos: (\d+))? read bytes: (\d+))" };
+
+   auto reads = std::vector<ReplayRead> { };
+   auto paths = std::map<int, std::string> { };
+   auto positions = std::map<int, int64_t> { };
+   auto file = std::ifstream { logPath };
+   auto line = std::string { };
+
+   while (std::getline(file, line)) {
+      auto match = std::smatch { };
+
+      if (std::regex_search(line, match, OpenFileRegex)) {
+         auto handle = std::stoi(match[1]);
+         paths[handle] = match[2];
+         positions[handle] = 0;
+      } else if (std::regex_search(line, match, ReadFileRegex)) {
+         auto handle = std::stoi(match[1]);
+         auto read = ReplayRead { };
+         read.path = paths[handle];
+         read.size = std::stoll(match[2]);
+         read.count = std::stoll(match[3]);
+         read.position = match[4].matched ? std::stoll(match[4]) : positions[handle];
+         positions[handle] = read.position + std::stoll(match[5]);
+
+         if (!read.path.empty()) {
+            reads.push_back(read);
+         }
+      }
+   }
+
+   return reads;
+}
+
+static std::vector<ReplayRead>
+generateReplayReads(const std::string &path,
+                    int64_t fileSize)
+{
+   // Mostly sequential streaming reads with some random access mixed in
+   auto rng = std::mt19937 { 0xF5A };
+   auto reads = std::vector<ReplayRead> { };
+   auto position = int64_t { 0 };
+
+   for (auto i = 0; i < 2048; ++i) {
+      auto read = ReplayRead { path, 1, 64 * 1024, position };
+
+      if (rng() % 4 == 0) {
+         read.position = (rng() % (fileSize / read.count)) * read.count;
+      }
+
+      position = (read.position + read.count) % (fileSize - read.count);
+      reads.push_back(read);
+   }
+
+   return reads;
+}
+
+/**
+ * Replays the reads from a title's FSA log against the host filesystem,
+ * set DECAF_FSA_REPLAY_LOG to the log file and DECAF_FSA_REPLAY_ROOT to a
+ * directory which the logged paths are relative to (e.g. containing a
+ * vol/content directory). Without those a synthetic workload is used.
+ */
+TEST_CASE("fsa read replay performance", "[!benchmark]")
+{
+   auto logPath = std::getenv("DECAF_FSA_REPLAY_LOG");
+   auto rootPath = std::getenv("DECAF_FSA_REPLAY_ROOT");
+   auto reads = std::vector<ReplayRead> { };
+   auto root = std::filesystem::path { };
+   auto synthetic = std::unique_ptr<TemporaryFile> { };
+
+   if (logPath && rootPath) {
+      reads = parseFsaLog(logPath);
+      root = rootPath;
+   } else {
+      synthetic = std::make_unique<TemporaryFile>(generateData(64 * 1024 * 1024));
+      reads = generateReplayReads(synthetic->path.filename().string(),
+                                  64 * 1024 * 1024);
+      root = synthetic->path.parent_path();
+   }
+
+   REQUIRE(!reads.empty());
+
+   // Open every file once up front, as the title would have
+   auto files = std::map<std::string, std::shared_ptr<vfs::HostFileHandle>> { };
+   auto maxReadSize = int64_t { 0 };
+   auto totalBytes = int64_t { 0 };
+
+   for (auto &read : reads) {
+      if (!files.count(read.path)) {
+         auto hostPath = root / std::filesystem::path { read.path }.relative_path();
+         auto handle = fopen(hostPath.string().c_str(), "rb");
+         if (!handle) {
+            FAIL(fmt::format("Could not open {}", hostPath.string()));
+         }
+
+         files[read.path] = std::make_shared<vfs::HostFileHandle>(handle, vfs::FileHandle::Read);
+      }
+
+      maxReadSize = std::max(maxReadSize, read.size * read.count);
+      totalBytes += read.size * read.count;
+   }
+
+   auto syncBuffer = std::vector<uint8_t>(maxReadSize);
+   auto start = std::chrono::high_resolution_clock::now();
+
+   for (auto &read : reads) {
+      auto &file = files[read.path];
+      file->seek(vfs::FileHandle::SeekStart, read.position);
+      file->read(syncBuffer.data(), read.size, read.count);
+   }
+
+   auto syncDuration = std::chrono::duration_cast<std::chrono::duration<double>>(
+      std::chrono::high_resolution_clock::now() - start);
+
+   auto mappedFiles = std::map<std::string, std::unique_ptr<vfs::HostMappedFileHandle>> { };
+   for (auto &[path, file] : files) {
+      auto hostPath = root / std::filesystem::path { path }.relative_path();
+      auto size = size_t { 0 };
+      auto handle = platform::openMemoryMappedFile(hostPath.string(),
+                                                   platform::ProtectFlags::ReadOnly,
+                                                   &size);
+      auto view = platform::mapViewOfFile(handle, platform::ProtectFlags::ReadOnly, 0, size);
+      mappedFiles[path] = std::make_unique<vfs::HostMappedFileHandle>(
+         handle, static_cast<uint8_t *>(view), static_cast<int64_t>(size),
+         vfs::FileHandle::Read);
+   }
+
+   start = std::chrono::high_resolution_clock::now();
+
+   for (auto &read : reads) {
+      auto &file = mappedFiles[read.path];
+      file->seek(vfs::FileHandle::SeekStart, read.position);
+      file->read(syncBuffer.data(), read.size, read.count);
+   }
+
+   auto mappedDuration = std::chrono::duration_cast<std::chrono::duration<double>>(
+      std::chrono::high_resolution_clock::now() - start);
+
+   // Each in flight read needs its own buffer, like guest reads would have
+   auto asyncBuffers = std::vector<std::vector<uint8_t>>(reads.size());
+   for (auto i = 0u; i < reads.size(); ++i) {
+      asyncBuffers[i].resize(reads[i].size * reads[i].count);
+   }
+
+   auto counter = CompletionCounter { };
+   startHostIoThreads();
+   start = std::chrono::high_resolution_clock::now();
+
+   for (auto i = 0u; i < reads.size(); ++i) {
+      auto &read = reads[i];
+      submitHostRead(files[read.path], asyncBuffers[i].data(),
+                     read.size, read.count, read.position,
+                     [&](vfs::Result<int64_t>) { counter.complete(); });
+   }
+
+   counter.wait(reads.size());
+   auto asyncDuration = std::chrono::duration_cast<std::chrono::duration<double>>(
+      std::chrono::high_resolution_clock::now() - start);
+   stopHostIoThreads();
+
+   auto megabytes = static_cast<double>(totalBytes) / (1024 * 1024);
+   WARN(fmt::format("{} reads, {:.1f} MB", reads.size(), megabytes));
+   WARN(fmt::format("seek + read: {:.1f} MB/s", megabytes / syncDuration.count()));
+   WARN(fmt::format("mapped seek + read: {:.1f} MB/s", megabytes / mappedDuration.count()));
+   WARN(fmt::format("host io readAt: {:.1f} MB/s", megabytes / asyncDuration.count()));
+}
@@ -0,0 +1,202 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "ios/ios_worker_thread.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fmt/format.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace ios::internal;
+
+/**
+ * Waits for a fixed number of tasks to complete.
+ */
+struct CompletionCounter
+{
+   void complete()
+   {
+      std::unique_lock<std::mutex> lock { mutex };
+      completed++;
+      cv.notify_all();
+   }
+
+   void wait(size_t count)
+   {
+      std::unique_lock<std::mutex> lock { mutex };
+      cv.wait(lock, [&]() { return completed >= count; });
+   }
+
+   std::mutex mutex;
+   std::condition_variable cv;
+   size_t completed = 0;
+};
+
+static const WorkerQueueStats &
+findKeyStats(const std::vector<WorkerQueueStats> &stats,
+             WorkerQueueKey key)
+{
+   auto itr = std::find_if(stats.begin(), stats.end(),
+                           [key](const WorkerQueueStats &stat) { return stat.key == key; });
+   REQUIRE(itr != stats.end());
+   return *itr;
+}
+
+TEST_CASE("worker task")
+{
+   auto value = std::make_shared<int>(0);
+   auto task = WorkerTask { [value]() { *value += 1; } };
+   REQUIRE(value.use_count() == 2);
+
+   // Moving must not copy the callable
+   auto moved = WorkerTask { std::move(task) };
+   REQUIRE(!task);
+   REQUIRE(moved);
+   REQUIRE(value.use_count() == 2);
+
+   moved();
+   REQUIRE(*value == 1);
+
+   moved.reset();
+   REQUIRE(value.use_count() == 1);
+}
+
+TEST_CASE("worker tasks with the same key run in order")
+{
+   constexpr auto NumKeys = 8u;
+   constexpr auto NumTasksPerKey = 1000u;
+   auto results = std::array<std::vector<uint32_t>, NumKeys> { };
+   auto counter = CompletionCounter { };
+
+   startWorkerThread();
+
+   for (auto i = 0u; i < NumTasksPerKey; ++i) {
+      for (auto key = 0u; key < NumKeys; ++key) {
+         submitWorkerTask(key, [&results, &counter, key, i]() {
+            results[key].push_back(i);
+            counter.complete();
+         });
+      }
+   }
+
+   counter.wait(NumKeys * NumTasksPerKey);
+   stopWorkerThread();
+
+   for (auto key = 0u; key < NumKeys; ++key) {
+      REQUIRE(results[key].size() == NumTasksPerKey);
+
+      for (auto i = 0u; i < NumTasksPerKey; ++i) {
+         REQUIRE(results[key][i] == i);
+      }
+   }
+}
+
+TEST_CASE("worker tasks with different keys run in parallel")
+{
+   // Key 0 blocks until a task on key 1 runs, which would deadlock if they
+   // were serialised onto one thread.
+   auto released = std::atomic<bool> { false };
+   auto counter = CompletionCounter { };
+
+   startWorkerThread();
+   submitWorkerTask(0, [&]() {
+      while (!released) {
+         std::this_thread::yield();
+      }
+
+      counter.complete();
+   });
+
+   submitWorkerTask(1, [&]() {
+      released = true;
+      counter.complete();
+   });
+
+   counter.wait(2);
+   stopWorkerThread();
+
+   auto stats = std::vector<WorkerQueueStats> { };
+   sampleWorkerQueueStats(stats);
+   REQUIRE(findKeyStats(stats, 0).depth == 0);
+   REQUIRE(findKeyStats(stats, 1).depth == 0);
+}
+
+TEST_CASE("worker queue stats are kept per key")
+{
+   // Both keys hash onto the same queue and the same first stats slot, but
+   // must still be counted separately
+   constexpr auto FirstKey = 1000u;
+   constexpr auto SecondKey = FirstKey + 64 * 4;
+   constexpr auto NumFirstTasks = 10u;
+   constexpr auto NumSecondTasks = 25u;
+   auto counter = CompletionCounter { };
+
+   startWorkerThread();
+
+   for (auto i = 0u; i < NumFirstTasks; ++i) {
+      submitWorkerTask(FirstKey, [&]() { counter.complete(); });
+   }
+
+   for (auto i = 0u; i < NumSecondTasks; ++i) {
+      submitWorkerTask(SecondKey, [&]() { counter.complete(); });
+   }
+
+   counter.wait(NumFirstTasks + NumSecondTasks);
+   stopWorkerThread();
+
+   auto stats = std::vector<WorkerQueueStats> { };
+   sampleWorkerQueueStats(stats);
+
+   auto &first = findKeyStats(stats, FirstKey);
+   REQUIRE(first.submitted == NumFirstTasks);
+   REQUIRE(first.completed == NumFirstTasks);
+   REQUIRE(first.depth == 0);
+
+   auto &second = findKeyStats(stats, SecondKey);
+   REQUIRE(second.submitted == NumSecondTasks);
+   REQUIRE(second.completed == NumSecondTasks);
+   REQUIRE(second.depth == 0);
+}
+
+TEST_CASE("worker queue performance", "[!benchmark]")
+{
+   // Many clients each submitting small tasks, like FSA stat / open calls
+   constexpr auto NumKeys = 16u;
+   constexpr auto NumTasks = 200000u;
+   auto counter = CompletionCounter { };
+   auto completed = std::atomic<uint32_t> { 0 };
+
+   startWorkerThread();
+   auto start = std::chrono::high_resolution_clock::now();
+
+   for (auto i = 0u; i < NumTasks; ++i) {
+      submitWorkerTask(i % NumKeys, [&]() {
+         if (completed.fetch_add(1) + 1 == NumTasks) {
+            counter.complete();
+         }
+      });
+   }
+
+   counter.wait(1);
+   auto duration = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(
+      std::chrono::high_resolution_clock::now() - start);
+   stopWorkerThread();
+
+   auto stats = std::vector<WorkerQueueStats> { };
+   sampleWorkerQueueStats(stats);
+
+   auto maxDepth = uint64_t { 0 };
+   for (auto &stat : stats) {
+      maxDepth = std::max(maxDepth, stat.maxDepth);
+   }
+
+   WARN(fmt::format("{:.1f} ns per task, max queue depth {}",
+                    duration.count() / NumTasks, maxDepth));
+}
@@ -0,0 +1,183 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "cafe/loader/cafe_loader_zlib.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fmt/format.h>
+#include <random>
+#include <vector>
+#include <zlib.h>
+
+using namespace cafe::loader::internal;
+
+/**
+ * Section sized data which compresses about as well as code does.
+ */
+static std::vector<uint8_t>
+makeSectionData(std::mt19937 &rng,
+                size_t size)
+{
+   auto data = std::vector<uint8_t>(size);
+   for (auto i = 0u; i < size; i += 4) {
+      auto word = (rng() % 4) ? 0x60000000u | (rng() % 64) : rng();
+      for (auto j = 0u; j < 4 && i + j < size; ++j) {
+         data[i + j] = static_cast<uint8_t>(word >> (24 - 8 * j));
+      }
+   }
+
+   return data;
+}
+
+static std::vector<uint8_t>
+deflateData(const std::vector<uint8_t> &data)
+{
+   auto size = compressBound(static_cast<uLong>(data.size()));
+   auto deflated = std::vector<uint8_t>(size);
+   REQUIRE(compress2(deflated.data(), &size, data.data(),
+                     static_cast<uLong>(data.size()), 6) == Z_OK);
+   deflated.resize(size);
+   return deflated;
+}
+
+struct TestSections
+{
+   TestSections(uint32_t seed,
+                size_t count,
+                size_t maxSize)
+   {
+      auto rng = std::mt19937 { seed };
+      for (auto i = 0u; i < count; ++i) {
+         expected.push_back(makeSectionData(rng, 1 + rng() % maxSize));
+      }
+
+      reset();
+   }
+
+   void
+   reset()
+   {
+      output.clear();
+      sections.clear();
+
+      for (auto &data : expected) {
+         output.emplace_back(data.size(), 0xCD);
+      }
+
+      for (auto i = 0u; i < expected.size(); ++i) {
+         auto &section = sections.emplace_back();
+         section.sectionIndex = i;
+         section.deflated = deflateData(expected[i]);
+         section.dst = output[i].data();
+         section.expectedSize = static_cast<uint32_t>(expected[i].size());
+      }
+   }
+
+   std::vector<std::vector<uint8_t>> expected;
+   std::vector<std::vector<uint8_t>> output;
+   std::vector<LiSectionInflate> sections;
+};
+
+TEST_CASE("loader inflates sections in parallel")
+{
+   auto test = TestSections { 0x52504C00, 64, 0x40000 };
+   LiInflateSections(test.sections, { });
+
+   for (auto i = 0u; i < test.sections.size(); ++i) {
+      REQUIRE(test.sections[i].zlibError == Z_STREAM_END);
+      REQUIRE(test.sections[i].inflatedSize == test.sections[i].expectedSize);
+      REQUIRE(!test.sections[i].cacheHit);
+      REQUIRE(test.output[i] == test.expected[i]);
+   }
+}
+
+TEST_CASE("loader reports corrupt sections")
+{
+   auto test = TestSections { 0x52504C01, 4, 0x1000 };
+   test.sections[1].deflated[0] ^= 0xFF;
+   test.sections[2].deflated.resize(test.sections[2].deflated.size() / 2);
+   test.sections[3].expectedSize /= 2;
+   LiInflateSections(test.sections, { });
+
+   REQUIRE(test.sections[0].zlibError == Z_STREAM_END);
+   REQUIRE(test.sections[1].zlibError == Z_DATA_ERROR);
+   REQUIRE(test.sections[2].zlibError == Z_BUF_ERROR);
+   REQUIRE(test.sections[3].zlibError == Z_BUF_ERROR);
+   REQUIRE(test.sections[3].inflatedSize == test.sections[3].expectedSize);
+}
+
+TEST_CASE("loader section cache")
+{
+   auto cachePath = std::filesystem::temp_directory_path() /
+      fmt::format("decaf-rpl-cache-test-{}",
+                  std::chrono::steady_clock::now().time_since_epoch().count());
+   auto test = TestSections { 0x52504C02, 8, 0x10000 };
+
+   LiInflateSections(test.sections, cachePath.string());
+   for (auto &section : test.sections) {
+      REQUIRE(!section.cacheHit);
+   }
+
+   test.reset();
+   LiInflateSections(test.sections, cachePath.string());
+   for (auto i = 0u; i < test.sections.size(); ++i) {
+      REQUIRE(test.sections[i].cacheHit);
+      REQUIRE(test.sections[i].zlibError == Z_STREAM_END);
+      REQUIRE(test.output[i] == test.expected[i]);
+   }
+
+   // A section with different data must not hit the cache
+   test.reset();
+   test.sections[0].deflated = deflateData(std::vector<uint8_t>(test.expected[0].size(), 0));
+   LiInflateSections(test.sections, cachePath.string());
+   REQUIRE(!test.sections[0].cacheHit);
+   REQUIRE(test.output[0] == std::vector<uint8_t>(test.expected[0].size(), 0));
+
+   auto error = std::error_code { };
+   std::filesystem::remove_all(cachePath, error);
+}
+
+TEST_CASE("loader inflate performance", "[!benchmark]")
+{
+   auto test = TestSections { 0x52504C03, 48, 0x100000 };
+   auto inflatedBytes = size_t { 0 };
+   for (auto &data : test.expected) {
+      inflatedBytes += data.size();
+   }
+
+   // Serial chunked inflate, the same as the loader did before
+   auto start = std::chrono::steady_clock::now();
+   for (auto i = 0u; i < test.sections.size(); ++i) {
+      auto &section = test.sections[i];
+      auto stream = z_stream { };
+      REQUIRE(inflateInit(&stream) == Z_OK);
+      stream.next_in = section.deflated.data();
+      stream.avail_in = static_cast<uInt>(section.deflated.size());
+      stream.next_out = section.dst;
+
+      while (stream.avail_in) {
+         stream.avail_out = std::min<uInt>(0x3000u, section.expectedSize - stream.total_out);
+         auto error = inflate(&stream, 0);
+         REQUIRE((error == Z_OK || error == Z_STREAM_END));
+      }
+
+      inflateEnd(&stream);
+   }
+   auto serial = std::chrono::steady_clock::now() - start;
+
+   test.reset();
+   start = std::chrono::steady_clock::now();
+   LiInflateSections(test.sections, { });
+   auto parallel = std::chrono::steady_clock::now() - start;
+
+   for (auto i = 0u; i < test.sections.size(); ++i) {
+      REQUIRE(test.output[i] == test.expected[i]);
+   }
+
+   using milliseconds = std::chrono::duration<double, std::milli>;
+   WARN(fmt::format("Inflated {} sections, {} bytes: serial {:.2f} ms, parallel {:.2f} ms",
+                    test.sections.size(), inflatedBytes,
+                    milliseconds { serial }.count(),
+                    milliseconds { parallel }.count()));
+}
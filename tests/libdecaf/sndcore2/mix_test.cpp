@@ -0,0 +1,218 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "cafe/libraries/sndcore2/sndcore2_mix.h"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+#include <random>
+#include <vector>
+
+using namespace cafe::sndcore2::internal;
+
+using Pcm16Sample = sfixed_1_0_15_t;
+
+static constexpr auto NumSamples = 144u;
+static constexpr auto NumVoices = 96u;
+
+struct MixTestVoice
+{
+   std::array<int16_t, NumSamples> samples;
+   uint16_t volume;
+};
+
+/**
+ * Generates voices whose mixed output will not overflow 16 bits, as that is
+ * where the reference (wrapping) and vector (saturating) kernels differ.
+ */
+static std::vector<MixTestVoice>
+generateVoices(std::mt19937 &rng,
+               uint32_t numVoices)
+{
+   auto maxSample = static_cast<int16_t>(32767 / (2 * numVoices));
+   auto sampleDist = std::uniform_int_distribution<int> { -maxSample, maxSample };
+   auto volumeDist = std::uniform_int_distribution<int> { 0, 0xFFFF };
+   auto voices = std::vector<MixTestVoice>(numVoices);
+
+   for (auto &voice : voices) {
+      for (auto &sample : voice.samples) {
+         sample = static_cast<int16_t>(sampleDist(rng));
+      }
+
+      voice.volume = static_cast<uint16_t>(volumeDist(rng));
+   }
+
+   return voices;
+}
+
+static std::array<int16_t, NumSamples>
+mixReference(const std::vector<MixTestVoice> &voices)
+{
+   Pcm16Sample out[NumSamples] = { };
+
+   for (auto &voice : voices) {
+      Pcm16Sample samples[NumSamples];
+      for (auto i = 0u; i < NumSamples; ++i) {
+         samples[i] = fixed_from_data<Pcm16Sample>(voice.samples[i]);
+      }
+
+      mixSamplesReference(out, samples,
+                          fixed_from_data<ufixed_1_15_t>(voice.volume),
+                          NumSamples);
+   }
+
+   auto result = std::array<int16_t, NumSamples> { };
+   for (auto i = 0u; i < NumSamples; ++i) {
+      result[i] = fixed_to_data(out[i]);
+   }
+
+   return result;
+}
+
+static std::array<int16_t, NumSamples>
+mixVector(const std::vector<MixTestVoice> &voices)
+{
+   int32_t accumulator[NumSamples] = { };
+
+   for (auto &voice : voices) {
+      accumulateSamples(accumulator, voice.samples.data(), voice.volume, NumSamples);
+   }
+
+   auto result = std::array<int16_t, NumSamples> { };
+   packSamples(result.data(), accumulator, NumSamples);
+   return result;
+}
+
+TEST_CASE("sndcore2 vector mix matches reference")
+{
+   auto rng = std::mt19937 { 0x5ADC0DE2 };
+
+   for (auto numVoices : { 1u, 2u, 17u, NumVoices }) {
+      auto voices = generateVoices(rng, numVoices);
+      INFO(fmt::format("{} voices", numVoices));
+      REQUIRE(mixVector(voices) == mixReference(voices));
+   }
+}
+
+TEST_CASE("sndcore2 vector mix matches reference at full scale")
+{
+   // Volumes below 1.0 can not overflow a single voice, above 1.0 we must
+   // halve the sample range to stay within 16 bits.
+   auto rng = std::mt19937 { 0x5ADC0DE2 };
+
+   for (auto volume : { 0x0000u, 0x0001u, 0x4000u, 0x7FFFu, 0x8000u, 0xC000u, 0xFFFFu }) {
+      auto maxSample = volume > 0x8000 ? 16383 : 32767;
+      auto sampleDist = std::uniform_int_distribution<int> { -maxSample - 1, maxSample };
+      auto voices = std::vector<MixTestVoice>(1);
+      voices[0].volume = static_cast<uint16_t>(volume);
+
+      for (auto &sample : voices[0].samples) {
+         sample = static_cast<int16_t>(sampleDist(rng));
+      }
+
+      // Make sure the extremes are covered
+      voices[0].samples[0] = static_cast<int16_t>(-maxSample - 1);
+      voices[0].samples[1] = static_cast<int16_t>(maxSample);
+      voices[0].samples[2] = -1;
+      voices[0].samples[3] = 1;
+
+      INFO(fmt::format("volume 0x{:04X}", volume));
+      REQUIRE(mixVector(voices) == mixReference(voices));
+   }
+}
+
+TEST_CASE("sndcore2 vector scale matches reference")
+{
+   auto rng = std::mt19937 { 0x5ADC0DE2 };
+   auto sampleDist = std::uniform_int_distribution<int> { -32768, 32767 };
+
+   for (auto volume : { 0x0000u, 0x0001u, 0x2000u, 0x7FFFu, 0x8000u }) {
+      int16_t vector[NumSamples];
+      Pcm16Sample reference[NumSamples];
+
+      for (auto i = 0u; i < NumSamples; ++i) {
+         vector[i] = static_cast<int16_t>(sampleDist(rng));
+         reference[i] = fixed_from_data<Pcm16Sample>(vector[i]);
+      }
+
+      scaleSamples(vector, static_cast<uint16_t>(volume), NumSamples);
+      scaleSamplesReference(reference, fixed_from_data<ufixed_1_15_t>(static_cast<uint16_t>(volume)), NumSamples);
+
+      INFO(fmt::format("volume 0x{:04X}", volume));
+      for (auto i = 0u; i < NumSamples; ++i) {
+         REQUIRE(vector[i] == fixed_to_data(reference[i]));
+      }
+   }
+}
+
+TEST_CASE("sndcore2 vector mix saturates")
+{
+   int32_t accumulator[NumSamples] = { };
+   int16_t samples[NumSamples];
+   int16_t result[NumSamples];
+
+   std::fill(std::begin(samples), std::end(samples), int16_t { 30000 });
+   accumulateSamples(accumulator, samples, 0x8000, NumSamples);
+   accumulateSamples(accumulator, samples, 0x8000, NumSamples);
+   packSamples(result, accumulator, NumSamples);
+
+   for (auto sample : result) {
+      REQUIRE(sample == 32767);
+   }
+}
+
+TEST_CASE("sndcore2 mix performance", "[!benchmark]")
+{
+   // 96 voices into 4 buses of 6 channel TV output
+   constexpr auto NumFrames = 1000;
+   constexpr auto NumOutputs = 4 * 6;
+   auto rng = std::mt19937 { 0x5ADC0DE2 };
+   auto voices = generateVoices(rng, NumVoices);
+
+   {
+      auto start = std::chrono::high_resolution_clock::now();
+      std::vector<Pcm16Sample> out(NumOutputs * NumSamples);
+      std::vector<Pcm16Sample> samples(NumSamples);
+
+      for (auto frame = 0; frame < NumFrames; ++frame) {
+         for (auto &voice : voices) {
+            std::memcpy(samples.data(), voice.samples.data(), sizeof(int16_t) * NumSamples);
+
+            for (auto output = 0; output < NumOutputs; ++output) {
+               mixSamplesReference(out.data() + output * NumSamples, samples.data(),
+                                   fixed_from_data<ufixed_1_15_t>(voice.volume),
+                                   NumSamples);
+            }
+         }
+      }
+
+      auto duration = std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+         std::chrono::high_resolution_clock::now() - start);
+      WARN(fmt::format("reference: {:.2f} us per frame", duration.count() / NumFrames));
+   }
+
+   {
+      auto start = std::chrono::high_resolution_clock::now();
+      std::vector<int32_t> accumulator(NumOutputs * NumSamples);
+      std::vector<int16_t> out(NumOutputs * NumSamples);
+
+      for (auto frame = 0; frame < NumFrames; ++frame) {
+         std::fill(accumulator.begin(), accumulator.end(), 0);
+
+         for (auto &voice : voices) {
+            for (auto output = 0; output < NumOutputs; ++output) {
+               accumulateSamples(accumulator.data() + output * NumSamples,
+                                 voice.samples.data(), voice.volume, NumSamples);
+            }
+         }
+
+         packSamples(out.data(), accumulator.data(), NumOutputs * NumSamples);
+      }
+
+      auto duration = std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+         std::chrono::high_resolution_clock::now() - start);
+      WARN(fmt::format("vector: {:.2f} us per frame", duration.count() / NumFrames));
+   }
+}
@@ -0,0 +1,397 @@
+#include <catch.hpp>
+
+#include "cafe/libraries/sndcore2/sndcore2.h"
+#include "cafe/libraries/sndcore2/sndcore2_device.h"
+#include "cafe/libraries/sndcore2/sndcore2_mix.h"
+#include "cafe/libraries/sndcore2/sndcore2_voice.h"
+
+#include <array>
+#include <cstring>
+#include <fmt/format.h>
+#include <libcpu/be2_struct.h>
+#include <libcpu/mmu.h>
+#include <random>
+#include <vector>
+
+using namespace cafe::sndcore2;
+using namespace cafe::sndcore2::internal;
+
+static constexpr auto TestVirtualAddress = cpu::VirtualAddress { 0x10000000 };
+static constexpr auto TestPhysicalAddress = cpu::PhysicalAddress { 0x10000000 };
+static constexpr auto TestMemorySize = uint32_t { 16 * 1024 * 1024 };
+
+//! Where sndcore2's static data is relocated to, as the loader would.
+static constexpr auto LibraryTextAddress = virt_addr { 0x10000000 };
+static constexpr auto LibraryDataAddress = virt_addr { 0x10100000 };
+
+//! Voice sample data, this is in memory page 0 so a voice's offsets are
+//! simply its sample addresses.
+static constexpr auto SampleDataAddress = virt_addr { 0x10800000 };
+static constexpr auto SampleDataSize = uint32_t { 0x10000 };
+
+static constexpr auto NumFrames = 8;
+
+static void
+initialiseSndcore2()
+{
+   static auto initialised = false;
+   static auto library = cafe::sndcore2::Library { };
+
+   if (!initialised) {
+      REQUIRE(cpu::initialiseMemory());
+      REQUIRE(cpu::allocateVirtualAddress(TestVirtualAddress, TestMemorySize));
+      REQUIRE(cpu::mapMemory(TestVirtualAddress, TestPhysicalAddress,
+                             TestMemorySize, cpu::MapPermission::ReadWrite));
+
+      library.generate();
+      library.relocate(LibraryTextAddress, LibraryDataAddress);
+      initVoices();
+      initDevices();
+      initialised = true;
+   }
+}
+
+struct TestVoice
+{
+   AXVoiceFormat format;
+   bool loop;
+
+   //! Source samples advanced per output sample, as 16.16 fixed point.
+   uint32_t ratio;
+
+   //! Starting position between source samples, as 0.16 fixed point.
+   uint16_t offsetFrac;
+
+   //! Length of the voice in source samples, for ADPCM this includes the
+   //! frame headers.
+   uint32_t length;
+};
+
+/**
+ * Fill a voice's sample data with random samples whose magnitude stays below
+ * maxSample, returning the offset of the first sample.
+ *
+ * ADPCM frames are 8 bytes, a predictor / scale header followed by 14 four
+ * bit samples. The coefficients and scales are chosen so the decoded samples
+ * also stay below maxSample.
+ */
+static uint32_t
+generateSampleData(std::mt19937 &rng,
+                   virt_addr address,
+                   const TestVoice &test,
+                   int16_t maxSample,
+                   virt_ptr<AXVoiceExtras> extras)
+{
+   auto bytes = virt_cast<uint8_t *>(address);
+
+   if (test.format == AXVoiceFormat::LPCM16) {
+      auto sampleDist = std::uniform_int_distribution<int> { -maxSample, maxSample };
+      auto samples = virt_cast<int16_t *>(address);
+      for (auto i = 0u; i < test.length; ++i) {
+         samples[i] = static_cast<int16_t>(sampleDist(rng));
+      }
+
+      return static_cast<uint32_t>(address) / 2;
+   }
+
+   if (test.format == AXVoiceFormat::LPCM8) {
+      auto maxByte = std::max(maxSample >> 8, 1);
+      auto sampleDist = std::uniform_int_distribution<int> { -maxByte, maxByte - 1 };
+      for (auto i = 0u; i < test.length; ++i) {
+         bytes[i] = static_cast<uint8_t>(sampleDist(rng));
+      }
+
+      return static_cast<uint32_t>(address);
+   }
+
+   // With |coeff1| + |coeff2| <= 1024 the previous samples contribute at
+   // most half of their magnitude, so |sample| <= 2 * 8 * scale.
+   auto maxScaleShift = 0;
+   while (maxScaleShift < 11 && (16 << (maxScaleShift + 1)) <= maxSample) {
+      ++maxScaleShift;
+   }
+
+   auto coeffDist = std::uniform_int_distribution<int> { -512, 512 };
+   auto coeffIndexDist = std::uniform_int_distribution<int> { 0, 7 };
+   auto scaleDist = std::uniform_int_distribution<int> { 0, maxScaleShift };
+   auto byteDist = std::uniform_int_distribution<int> { 0, 255 };
+   auto prevDist = std::uniform_int_distribution<int> { -maxSample / 2, maxSample / 2 };
+
+   for (auto i = 0u; i < 16; ++i) {
+      extras->adpcm.coefficients[i] = static_cast<int16_t>(coeffDist(rng));
+   }
+
+   auto numBytes = (test.length + 1) / 2;
+   for (auto i = 0u; i < numBytes; ++i) {
+      if (i % 8 == 0) {
+         bytes[i] = static_cast<uint8_t>((coeffIndexDist(rng) << 4) | scaleDist(rng));
+      } else {
+         bytes[i] = static_cast<uint8_t>(byteDist(rng));
+      }
+   }
+
+   extras->adpcm.predScale = bytes[0];
+   extras->adpcm.prevSample[0] = static_cast<int16_t>(prevDist(rng));
+   extras->adpcm.prevSample[1] = static_cast<int16_t>(prevDist(rng));
+   extras->adpcmLoop.prevSample[0] = static_cast<int16_t>(prevDist(rng));
+   extras->adpcmLoop.prevSample[1] = static_cast<int16_t>(prevDist(rng));
+   return static_cast<uint32_t>(address) * 2;
+}
+
+/**
+ * Set up an acquired voice to play the given test voice, the loop point is a
+ * third of the way in so looping voices also test the wrap around.
+ */
+static void
+setupVoice(std::mt19937 &rng,
+           virt_ptr<AXVoice> voice,
+           const TestVoice &test,
+           virt_addr address,
+           int16_t maxSample)
+{
+   auto extras = getVoiceExtras(voice->index);
+   auto start = generateSampleData(rng, address, test, maxSample, extras);
+
+   extras->type = AXVoiceType::Default;
+   extras->data.format = test.format;
+   extras->data.memPageNumber = uint16_t { 0 };
+   extras->data.loopFlag = test.loop ? AXVoiceLoop::Enabled : AXVoiceLoop::Disabled;
+   extras->data.endOffsetAbs = virt_addr { start + test.length - 1 };
+
+   if (test.format == AXVoiceFormat::ADPCM) {
+      // Skip the frame headers
+      auto loopFrame = (test.length / 16) / 3;
+      extras->data.currentOffsetAbs = virt_addr { start + 2 };
+      extras->data.loopOffsetAbs = virt_addr { start + loopFrame * 16 + 2 };
+      extras->adpcmLoop.predScale =
+         virt_cast<uint8_t *>(address)[loopFrame * 8];
+   } else {
+      extras->data.currentOffsetAbs = virt_addr { start };
+      extras->data.loopOffsetAbs = virt_addr { start + test.length / 3 };
+   }
+
+   extras->src.ratio = fixed_from_data<ufixed_16_16_t>(test.ratio);
+   extras->src.currentOffsetFrac = fixed_from_data<ufixed_0_16_t>(test.offsetFrac);
+   voice->state = AXVoiceState::Playing;
+}
+
+static std::vector<int16_t>
+toData(const Pcm16Sample *samples,
+       int numSamples)
+{
+   auto result = std::vector<int16_t>(numSamples);
+   for (auto i = 0; i < numSamples; ++i) {
+      result[i] = fixed_to_data(samples[i]);
+   }
+
+   return result;
+}
+
+static void
+requireSameVoiceState(virt_ptr<AXVoice> voice,
+                      virt_ptr<AXVoice> referenceVoice)
+{
+   auto extras = getVoiceExtras(voice->index);
+   auto referenceExtras = getVoiceExtras(referenceVoice->index);
+
+   REQUIRE(voice->state == referenceVoice->state);
+   REQUIRE(extras->data.currentOffsetAbs == referenceExtras->data.currentOffsetAbs);
+   REQUIRE(fixed_to_data(extras->src.currentOffsetFrac.value()) ==
+           fixed_to_data(referenceExtras->src.currentOffsetFrac.value()));
+   REQUIRE(extras->loopCount == referenceExtras->loopCount);
+   REQUIRE(extras->adpcm.predScale == referenceExtras->adpcm.predScale);
+
+   for (auto i = 0u; i < 2; ++i) {
+      REQUIRE(extras->adpcm.prevSample[i] == referenceExtras->adpcm.prevSample[i]);
+   }
+
+   for (auto i = 0u; i < 4; ++i) {
+      REQUIRE(extras->src.lastSample[i] == referenceExtras->src.lastSample[i]);
+   }
+}
+
+TEST_CASE("sndcore2 block decode matches reference")
+{
+   initialiseSndcore2();
+   setMixerKernel(MixerKernel::Vector);
+
+   auto rng = std::mt19937 { 0x5ADC0DE2 };
+   auto voice = AXAcquireVoice(0, nullptr, nullptr);
+   auto referenceVoice = AXAcquireVoice(0, nullptr, nullptr);
+   REQUIRE(voice);
+   REQUIRE(referenceVoice);
+
+   for (auto format : { AXVoiceFormat::ADPCM, AXVoiceFormat::LPCM8, AXVoiceFormat::LPCM16 }) {
+      for (auto loop : { true, false }) {
+         for (auto ratio : { 0x8000u, 0xCCCDu, 0x10000u, 0x18000u, 0x2A3D7u, 0x40000u }) {
+            for (auto offsetFrac : { 0x0000u, 0x4321u, 0xC000u }) {
+               for (auto numSamples : { 96, 144 }) {
+                  auto test = TestVoice { };
+                  test.format = format;
+                  test.loop = loop;
+                  test.ratio = ratio;
+                  test.offsetFrac = static_cast<uint16_t>(offsetFrac);
+
+                  // Short enough for every voice to either wrap or reach
+                  // its end within NumFrames, at the slowest ratio too
+                  test.length = loop ? 300u : 160u;
+
+                  INFO(fmt::format("format {}, loop {}, ratio 0x{:X}, offsetFrac 0x{:04X}, {} samples",
+                                   static_cast<int>(format), loop, ratio, offsetFrac, numSamples));
+
+                  // Both voices play the same sample data
+                  auto seed = rng();
+                  auto voiceRng = std::mt19937 { seed };
+                  auto referenceRng = std::mt19937 { seed };
+                  setupVoice(voiceRng, voice, test, SampleDataAddress, 32767);
+                  setupVoice(referenceRng, referenceVoice, test, SampleDataAddress, 32767);
+
+                  for (auto frame = 0; frame < NumFrames; ++frame) {
+                     INFO(fmt::format("frame {}", frame));
+                     Pcm16Sample samples[144];
+                     Pcm16Sample referenceSamples[144];
+                     sampleVoice(voice, samples, numSamples);
+                     sampleVoiceReference(referenceVoice, referenceSamples, numSamples);
+
+                     REQUIRE(toData(samples, numSamples) == toData(referenceSamples, numSamples));
+                     requireSameVoiceState(voice, referenceVoice);
+
+                     if (voice->state == AXVoiceState::Stopped) {
+                        REQUIRE(!loop);
+                        break;
+                     }
+                  }
+
+                  if (loop) {
+                     REQUIRE(getVoiceExtras(voice->index)->loopCount > 0);
+                  } else {
+                     REQUIRE(voice->state == AXVoiceState::Stopped);
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   AXFreeVoice(voice);
+   AXFreeVoice(referenceVoice);
+}
+
+struct VoiceState
+{
+   std::array<uint8_t, sizeof(AXVoice)> voice;
+   std::array<uint8_t, sizeof(AXVoiceExtras)> extras;
+};
+
+static std::vector<VoiceState>
+saveVoiceStates(const std::vector<virt_ptr<AXVoice>> &voices)
+{
+   auto states = std::vector<VoiceState>(voices.size());
+   for (auto i = 0u; i < voices.size(); ++i) {
+      std::memcpy(states[i].voice.data(), voices[i].get(), sizeof(AXVoice));
+      std::memcpy(states[i].extras.data(),
+                  getVoiceExtras(voices[i]->index).get(), sizeof(AXVoiceExtras));
+   }
+
+   return states;
+}
+
+static void
+restoreVoiceStates(const std::vector<virt_ptr<AXVoice>> &voices,
+                   const std::vector<VoiceState> &states)
+{
+   for (auto i = 0u; i < voices.size(); ++i) {
+      std::memcpy(voices[i].get(), states[i].voice.data(), sizeof(AXVoice));
+      std::memcpy(getVoiceExtras(voices[i]->index).get(),
+                  states[i].extras.data(), sizeof(AXVoiceExtras));
+   }
+}
+
+static std::vector<std::vector<int32_t>>
+mixFrames(MixerKernel kernel,
+          uint16_t numSamples)
+{
+   auto frames = std::vector<std::vector<int32_t>> { };
+   setMixerKernel(kernel);
+
+   for (auto frame = 0; frame < NumFrames; ++frame) {
+      auto &output = frames.emplace_back(144 * AXNumTvChannels);
+      mixOutput(output.data(), numSamples, AXNumTvChannels);
+   }
+
+   return frames;
+}
+
+TEST_CASE("sndcore2 mixOutput matches between mixer kernels")
+{
+   // 16 voices across 4 buses with volumes up to 1.0 can not overflow 16
+   // bits, which is where the reference and vector mix kernels differ.
+   constexpr auto NumVoices = 16u;
+   constexpr auto MaxSample = int16_t { 32767 / (NumVoices * AXNumTvBus * 2) };
+   initialiseSndcore2();
+
+   auto rng = std::mt19937 { 0x5ADC0DE2 };
+   auto formatDist = std::uniform_int_distribution<int> { 0, 2 };
+   auto ratioDist = std::uniform_int_distribution<uint32_t> { 0x4000, 0x30000 };
+   auto fracDist = std::uniform_int_distribution<uint32_t> { 0, 0xFFFF };
+   auto volumeDist = std::uniform_int_distribution<uint32_t> { 0, 0x7000 };
+   auto deltaDist = std::uniform_int_distribution<uint32_t> { 0, 0x100 };
+   auto voices = std::vector<virt_ptr<AXVoice>> { };
+
+   for (auto i = 0u; i < NumVoices; ++i) {
+      auto voice = AXAcquireVoice(0, nullptr, nullptr);
+      REQUIRE(voice);
+      voices.push_back(voice);
+
+      auto test = TestVoice { };
+      test.format = std::array { AXVoiceFormat::ADPCM,
+                                 AXVoiceFormat::LPCM8,
+                                 AXVoiceFormat::LPCM16 }[formatDist(rng)];
+      test.loop = (i % 4) != 0;
+      test.ratio = ratioDist(rng);
+      test.offsetFrac = static_cast<uint16_t>(fracDist(rng));
+      test.length = 300 + 40 * i;
+      setupVoice(rng, voice, test, SampleDataAddress + i * SampleDataSize, MaxSample);
+
+      auto extras = getVoiceExtras(voice->index);
+      extras->ve.volume = fixed_from_data<ufixed_0_16_t>(static_cast<uint16_t>(0x8000 + volumeDist(rng)));
+
+      for (auto channel = 0u; channel < AXNumTvChannels; ++channel) {
+         for (auto bus = 0u; bus < AXNumTvBus; ++bus) {
+            auto &volume = extras->tvVolume[0][channel][bus];
+            volume.volume = fixed_from_data<ufixed_1_15_t>(static_cast<uint16_t>(volumeDist(rng)));
+            volume.delta = fixed_from_data<ufixed_1_15_t>(static_cast<uint16_t>(deltaDist(rng)));
+         }
+      }
+   }
+
+   for (auto numSamples : { uint16_t { 96 }, uint16_t { 144 } }) {
+      INFO(fmt::format("{} samples", numSamples));
+      auto initialState = saveVoiceStates(voices);
+
+      auto referenceFrames = mixFrames(MixerKernel::Reference, numSamples);
+      auto referenceState = saveVoiceStates(voices);
+      restoreVoiceStates(voices, initialState);
+
+      auto vectorFrames = mixFrames(MixerKernel::Vector, numSamples);
+      auto vectorState = saveVoiceStates(voices);
+      restoreVoiceStates(voices, initialState);
+
+      for (auto frame = 0; frame < NumFrames; ++frame) {
+         INFO(fmt::format("frame {}", frame));
+         REQUIRE(vectorFrames[frame] == referenceFrames[frame]);
+      }
+
+      for (auto i = 0u; i < voices.size(); ++i) {
+         INFO(fmt::format("voice {}", i));
+         REQUIRE(vectorState[i].voice == referenceState[i].voice);
+         REQUIRE(vectorState[i].extras == referenceState[i].extras);
+      }
+   }
+
+   for (auto voice : voices) {
+      AXFreeVoice(voice);
+   }
+
+   setMixerKernel(MixerKernel::Vector);
+}
@@ -0,0 +1,436 @@
+#include <libdecaf/decaf_hletrace.h>
+
+#include <algorithm>
+#include <cstring>
+#include <excmd.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace decaf::hletrace;
+
+struct FunctionInfo
+{
+   TraceFunction function;
+   std::string name;
+   std::vector<TraceParam> params;
+};
+
+struct FunctionStats
+{
+   uint64_t numCalls = 0;
+   uint64_t numReturns = 0;
+   uint64_t totalTime = 0;
+   uint64_t maxTime = 0;
+};
+
+struct DecodeState
+{
+   bool summary = false;
+   uint64_t firstTimestamp = 0;
+   uint64_t numRecords = 0;
+   std::vector<FunctionInfo> functions;
+   std::vector<FunctionStats> stats;
+
+   //! Timestamp of calls which have not returned yet, keyed by the stack
+   //! pointer and function id of the call.
+   std::unordered_map<uint64_t, uint64_t> pendingCalls;
+};
+
+static const char *
+getFunctionName(DecodeState &state,
+                uint32_t id)
+{
+   if (id >= state.functions.size() || state.functions[id].name.empty()) {
+      return "<unknown>";
+   }
+
+   return state.functions[id].name.c_str();
+}
+
+//! Read a 32 bit argument register, r11 onwards are read from the stack.
+static bool
+readGpr(const TraceRecord &record,
+        unsigned regIndex,
+        uint32_t &value)
+{
+   if (regIndex >= 3 && regIndex <= 10) {
+      value = record.gpr[regIndex - 3];
+      return true;
+   }
+
+   if (regIndex >= 11 && regIndex - 11 < record.numStackArgs) {
+      value = record.stack[regIndex - 11];
+      return true;
+   }
+
+   return false;
+}
+
+static void
+formatValue(fmt::memory_buffer &message,
+            const TraceParam &param,
+            const TraceRecord &record,
+            bool &stringUsed)
+{
+   switch (param.type) {
+   case TraceRegisterType::Gpr32:
+   {
+      auto value = uint32_t { 0 };
+      if (!readGpr(record, param.index, value)) {
+         fmt::format_to(std::back_inserter(message), "?");
+      } else if ((param.flags & TraceParam::String) && value && !stringUsed) {
+         // Only the first string argument is recorded, truncated to fit
+         auto length = strnlen(record.string, TraceMaxStringLength);
+         fmt::format_to(std::back_inserter(message), "\"{}{}\"",
+                        std::string_view { record.string, length },
+                        length == TraceMaxStringLength - 1 ? "..." : "");
+         stringUsed = true;
+      } else if (param.flags & (TraceParam::Pointer | TraceParam::String)) {
+         fmt::format_to(std::back_inserter(message), "0x{:08X}", value);
+      } else if (param.flags & TraceParam::Signed) {
+         fmt::format_to(std::back_inserter(message), "{}", static_cast<int32_t>(value));
+      } else {
+         fmt::format_to(std::back_inserter(message), "{}", value);
+      }
+      break;
+   }
+   case TraceRegisterType::Gpr64:
+   {
+      auto hi = uint32_t { 0 };
+      auto lo = uint32_t { 0 };
+      if (!readGpr(record, param.index, hi) ||
+          !readGpr(record, param.index + 1, lo)) {
+         fmt::format_to(std::back_inserter(message), "?");
+         break;
+      }
+
+      auto value = (static_cast<uint64_t>(hi) << 32) | static_cast<uint64_t>(lo);
+      if (param.flags & TraceParam::Signed) {
+         fmt::format_to(std::back_inserter(message), "{}", static_cast<int64_t>(value));
+      } else {
+         fmt::format_to(std::back_inserter(message), "{}", value);
+      }
+      break;
+   }
+   case TraceRegisterType::Fpr:
+      if (param.index >= 1 && param.index <= TraceNumFprs) {
+         fmt::format_to(std::back_inserter(message), "{}", record.fpr[param.index - 1]);
+      } else {
+         fmt::format_to(std::back_inserter(message), "?");
+      }
+      break;
+   case TraceRegisterType::VarArgs:
+      fmt::format_to(std::back_inserter(message), "...");
+      break;
+   case TraceRegisterType::Void:
+      break;
+   }
+}
+
+static void
+printCall(DecodeState &state,
+          const TraceRecord &record)
+{
+   fmt::memory_buffer message;
+   fmt::format_to(std::back_inserter(message), "[{:>14.3f}] [{}] {}(",
+                  (record.timestamp - state.firstTimestamp) / 1000.0,
+                  static_cast<uint32_t>(record.core),
+                  getFunctionName(state, record.functionId));
+
+   if (record.functionId < state.functions.size()) {
+      auto &info = state.functions[record.functionId];
+      auto stringUsed = false;
+
+      if (info.function.isMemberFunction) {
+         fmt::format_to(std::back_inserter(message), "this = 0x{:08X}, ", record.gpr[0]);
+      }
+
+      for (auto i = 0u; i < info.params.size(); ++i) {
+         if (i > 0) {
+            fmt::format_to(std::back_inserter(message), ", ");
+         }
+
+         formatValue(message, info.params[i], record, stringUsed);
+      }
+   }
+
+   fmt::format_to(std::back_inserter(message), ") from 0x{:08X}\n",
+                  static_cast<uint32_t>(record.lr));
+   std::cout << std::string_view { message.data(), message.size() };
+}
+
+static void
+printReturn(DecodeState &state,
+            const TraceRecord &record,
+            int64_t duration)
+{
+   fmt::memory_buffer message;
+   fmt::format_to(std::back_inserter(message), "[{:>14.3f}] [{}] {} returned",
+                  (record.timestamp - state.firstTimestamp) / 1000.0,
+                  static_cast<uint32_t>(record.core),
+                  getFunctionName(state, record.functionId));
+
+   if (record.functionId < state.functions.size()) {
+      auto &returnValue = state.functions[record.functionId].function.returnValue;
+      auto stringUsed = true;
+
+      if (returnValue.type != TraceRegisterType::Void) {
+         fmt::format_to(std::back_inserter(message), " ");
+
+         // The return value lives in r3/r4 or f1, which are where a return
+         // record stores them.
+         formatValue(message, returnValue, record, stringUsed);
+      }
+   }
+
+   if (duration >= 0) {
+      fmt::format_to(std::back_inserter(message), " after {:.3f}us", duration / 1000.0);
+   }
+
+   fmt::format_to(std::back_inserter(message), "\n");
+   std::cout << std::string_view { message.data(), message.size() };
+}
+
+static void
+processRecord(DecodeState &state,
+              const TraceRecord &record)
+{
+   if (state.numRecords++ == 0) {
+      state.firstTimestamp = record.timestamp;
+   }
+
+   if (record.functionId >= state.stats.size()) {
+      state.stats.resize(record.functionId + 1);
+   }
+
+   auto &stats = state.stats[record.functionId];
+   auto key = (static_cast<uint64_t>(record.sp) << 32) | record.functionId;
+
+   if (record.type == TraceRecord::Call) {
+      stats.numCalls++;
+      state.pendingCalls[key] = record.timestamp;
+
+      if (!state.summary) {
+         printCall(state, record);
+      }
+   } else if (record.type == TraceRecord::Return) {
+      auto duration = int64_t { -1 };
+      auto itr = state.pendingCalls.find(key);
+
+      if (itr != state.pendingCalls.end()) {
+         duration = static_cast<int64_t>(record.timestamp - itr->second);
+         state.pendingCalls.erase(itr);
+
+         stats.numReturns++;
+         stats.totalTime += duration;
+         stats.maxTime = std::max<uint64_t>(stats.maxTime, duration);
+      }
+
+      if (!state.summary) {
+         printReturn(state, record, duration);
+      }
+   }
+}
+
+static bool
+readFunctions(DecodeState &state,
+              const TraceBlock &block,
+              const std::vector<char> &data)
+{
+   auto position = size_t { 0 };
+
+   for (auto i = 0u; i < block.numEntries; ++i) {
+      auto info = FunctionInfo { };
+      if (position + sizeof(TraceFunction) > data.size()) {
+         return false;
+      }
+
+      std::memcpy(&info.function, data.data() + position, sizeof(TraceFunction));
+      position += sizeof(TraceFunction);
+
+      auto paramsSize = info.function.numParams * sizeof(TraceParam);
+      if (position + info.function.nameLength + paramsSize > data.size()) {
+         return false;
+      }
+
+      info.name.assign(data.data() + position, info.function.nameLength);
+      position += info.function.nameLength;
+
+      info.params.resize(info.function.numParams);
+      std::memcpy(info.params.data(), data.data() + position, paramsSize);
+      position += paramsSize;
+
+      if (info.function.id >= state.functions.size()) {
+         state.functions.resize(info.function.id + 1);
+      }
+
+      state.functions[info.function.id] = std::move(info);
+   }
+
+   return true;
+}
+
+static bool
+readRecords(DecodeState &state,
+            const TraceBlock &block,
+            const std::vector<char> &data)
+{
+   if (block.numEntries * sizeof(TraceRecord) > data.size()) {
+      return false;
+   }
+
+   auto records = std::vector<TraceRecord> { };
+   records.resize(block.numEntries);
+   std::memcpy(records.data(), data.data(), records.size() * sizeof(TraceRecord));
+
+   // Each block holds the records of each core one after another
+   std::stable_sort(records.begin(), records.end(),
+                    [](const TraceRecord &lhs, const TraceRecord &rhs) {
+                       return lhs.timestamp < rhs.timestamp;
+                    });
+
+   for (auto &record : records) {
+      processRecord(state, record);
+   }
+
+   return true;
+}
+
+static void
+printSummary(DecodeState &state)
+{
+   auto order = std::vector<uint32_t> { };
+   for (auto i = 0u; i < state.stats.size(); ++i) {
+      if (state.stats[i].numCalls) {
+         order.push_back(i);
+      }
+   }
+
+   std::sort(order.begin(), order.end(),
+             [&](uint32_t lhs, uint32_t rhs) {
+                return state.stats[lhs].totalTime > state.stats[rhs].totalTime;
+             });
+
+   std::cout << fmt::format("{:<48} {:>10} {:>14} {:>10} {:>12}\n",
+                            "Function", "Calls", "Total (ms)", "Avg (us)", "Max (us)");
+
+   for (auto id : order) {
+      auto &stats = state.stats[id];
+      auto average = stats.numReturns ?
+         (stats.totalTime / static_cast<double>(stats.numReturns)) / 1000.0 : 0.0;
+
+      std::cout << fmt::format("{:<48} {:>10} {:>14.3f} {:>10.3f} {:>12.3f}\n",
+                               getFunctionName(state, id),
+                               stats.numCalls,
+                               stats.totalTime / 1000000.0,
+                               average,
+                               stats.maxTime / 1000.0);
+   }
+
+   std::cout << fmt::format("{} records, {} calls did not return before the trace ended\n",
+                            state.numRecords, state.pendingCalls.size());
+}
+
+static bool
+decodeTrace(const std::string &path,
+            bool summary)
+{
+   std::ifstream file { path, std::ifstream::binary };
+   if (!file.is_open()) {
+      std::cout << "Could not open " << path << std::endl;
+      return false;
+   }
+
+   auto header = TraceFileHeader { };
+   file.read(reinterpret_cast<char *>(&header), sizeof(TraceFileHeader));
+   if (!file || header.magic != TraceMagic) {
+      std::cout << path << " is not a HLE trace" << std::endl;
+      return false;
+   }
+
+   if (header.version != TraceVersion) {
+      std::cout << "Unsupported HLE trace version " << header.version << std::endl;
+      return false;
+   }
+
+   auto state = DecodeState { };
+   auto block = TraceBlock { };
+   auto data = std::vector<char> { };
+   state.summary = summary;
+
+   while (file.read(reinterpret_cast<char *>(&block), sizeof(TraceBlock))) {
+      data.resize(block.size);
+      if (!file.read(data.data(), data.size())) {
+         // The trace was probably not closed cleanly, decode what we have
+         std::cout << "Trace ends with a truncated block" << std::endl;
+         break;
+      }
+
+      auto result = true;
+      if (block.type == TraceBlock::Functions) {
+         result = readFunctions(state, block, data);
+      } else if (block.type == TraceBlock::Records) {
+         result = readRecords(state, block, data);
+      }
+
+      if (!result) {
+         std::cout << "Invalid trace block" << std::endl;
+         return false;
+      }
+   }
+
+   if (summary) {
+      printSummary(state);
+   }
+
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+
+   // Setup command line options
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." });
+
+   parser.add_command("help")
+      .add_argument("command", excmd::value<std::string> { });
+
+   parser.add_command("decode")
+      .add_option("summary",
+                  excmd::description { "Print the number of calls and time spent in each function instead of every call." })
+      .add_argument("trace", excmd::value<std::string> { });
+
+   // Parse command line
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   // Print help
+   if (argc == 1 || options.has("help")) {
+      if (options.has("command")) {
+         std::cout << parser.format_help("hle-trace", options.get<std::string>("command")) << std::endl;
+      } else {
+         std::cout << parser.format_help("hle-trace") << std::endl;
+      }
+
+      std::exit(0);
+   }
+
+   if (options.has("decode")) {
+      auto path = options.get<std::string>("trace");
+      return decodeTrace(path, options.has("summary")) ? 0 : -1;
+   }
+
+   return -1;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
 namespace config
@@ -7,5 +8,6 @@ namespace config
 extern bool dump_drc_frames;
 extern bool dump_tv_frames;
 extern std::string dump_frames_dir;
+extern uint32_t start_frame;
 
 } // namespace config
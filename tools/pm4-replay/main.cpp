@@ -1,4 +1,5 @@
 #include "config.h"
+#include "replay_benchmark.h"
 #include "sdl_window.h"
 
 #include <common/log.h>
@@ -18,6 +19,7 @@ namespace config
 bool dump_drc_frames = false;
 bool dump_tv_frames = false;
 std::string dump_frames_dir = "frames";
+uint32_t start_frame = 0;
 std::string renderer = "vulkan";
 
 } // namespace config
@@ -55,6 +57,19 @@ getCommandLineParser()
                   description { "Which graphics renderer to use." },
                   make_default_value(config::renderer));
 
+   auto captureOptions = parser.add_option_group("Capture Options")
+      .add_option("start-frame",
+                  description { "Start replaying from this frame, requires a chunked capture." },
+                  value<uint32_t> {});
+
+   auto benchmarkOptions = parser.add_option_group("Benchmark Options")
+      .add_option("iterations",
+                  description { "Number of times to replay the trace." },
+                  value<uint32_t> {})
+      .add_option("json",
+                  description { "Write the benchmark results as JSON to this file." },
+                  value<std::string> {});
+
    parser.add_command("help")
       .add_argument("help-command",
                     optional {},
@@ -63,7 +78,14 @@ getCommandLineParser()
    parser.add_command("replay")
       .add_argument("trace file",
                     value<std::string> {})
-      .add_option_group(replayOptions);
+      .add_option_group(replayOptions)
+      .add_option_group(captureOptions);
+
+   parser.add_command("benchmark")
+      .add_argument("trace file",
+                    value<std::string> {})
+      .add_option_group(benchmarkOptions)
+      .add_option_group(captureOptions);
 
    return parser;
 }
@@ -108,7 +130,7 @@ start(excmd::parser &parser,
       std::exit(0);
    }
 
-   if (!options.has("replay")) {
+   if (!options.has("replay") && !options.has("benchmark")) {
       return 0;
    }
 
@@ -128,6 +150,10 @@ start(excmd::parser &parser,
       config::renderer = options.get<std::string>("renderer");
    }
 
+   if (options.has("start-frame")) {
+      config::start_frame = options.get<uint32_t>("start-frame");
+   }
+
    auto traceFile = options.get<std::string>("trace file");
 
    // Initialise libdecaf logger
@@ -135,6 +161,12 @@ start(excmd::parser &parser,
    decafSettings.log.to_file = true;
    decafSettings.log.to_stdout = true;
    decafSettings.log.level = "debug";
+
+   if (options.has("benchmark")) {
+      // Debug logging from the pm4 processor would dominate the timings
+      decafSettings.log.level = "info";
+   }
+
    decaf::setConfig(decafSettings);
    decaf::initialiseLogging("pm4-replay.txt");
 
@@ -149,6 +181,20 @@ start(excmd::parser &parser,
    // Initialise CPU to setup physical memory
    cpu::initialise();
 
+   if (options.has("benchmark")) {
+      auto benchmarkOptions = BenchmarkOptions { };
+
+      if (options.has("iterations")) {
+         benchmarkOptions.iterations = options.get<uint32_t>("iterations");
+      }
+
+      if (options.has("json")) {
+         benchmarkOptions.jsonPath = options.get<std::string>("json");
+      }
+
+      return runBenchmark(traceFile, benchmarkOptions);
+   }
+
    return replay(traceFile);
 }
 
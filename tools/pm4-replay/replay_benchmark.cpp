@@ -0,0 +1,228 @@
+#include "clilog.h"
+#include "config.h"
+#include "replay_benchmark.h"
+#include "replay_benchmark_driver.h"
+#include "replay_parser_pm4.h"
+#include "replay_ringbuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <libgpu/latte/latte_enum_as_string.h>
+#include <thread>
+#include <vector>
+
+static RingBuffer *
+sBenchmarkRingBuffer = nullptr;
+
+void initialiseRegisters(RingBuffer *ringBuffer);
+
+static void
+onBenchmarkGpuInterrupt()
+{
+   gpu::ih::read();
+   sBenchmarkRingBuffer->onGpuInterrupt();
+}
+
+static std::string
+escapeJsonString(const std::string &value)
+{
+   auto result = std::string { };
+   result.reserve(value.size());
+
+   for (auto c : value) {
+      switch (c) {
+      case '"':
+         result += "\\\"";
+         break;
+      case '\\':
+         result += "\\\\";
+         break;
+      case '\n':
+         result += "\\n";
+         break;
+      case '\r':
+         result += "\\r";
+         break;
+      case '\t':
+         result += "\\t";
+         break;
+      default:
+         if (static_cast<unsigned char>(c) < 0x20) {
+            result += fmt::format("\\u{:04x}", static_cast<unsigned int>(c));
+         } else {
+            result += c;
+         }
+      }
+   }
+
+   return result;
+}
+
+struct PacketReport
+{
+   std::string name;
+   BenchmarkDriver::PacketStats stats;
+};
+
+static std::vector<PacketReport>
+getPacketReports(const BenchmarkDriver::Stats &stats)
+{
+   auto reports = std::vector<PacketReport> { };
+
+   if (stats.type0.count) {
+      reports.push_back({ "TYPE0", stats.type0 });
+   }
+
+   for (auto i = 0u; i < stats.type3.size(); ++i) {
+      if (stats.type3[i].count) {
+         auto opcode = static_cast<latte::pm4::IT_OPCODE>(i);
+         reports.push_back({ latte::pm4::to_string(opcode), stats.type3[i] });
+      }
+   }
+
+   std::sort(reports.begin(), reports.end(),
+             [](const PacketReport &lhs, const PacketReport &rhs) {
+                return lhs.stats.totalNs > rhs.stats.totalNs;
+             });
+   return reports;
+}
+
+static bool
+writeJsonReport(const std::string &path,
+                const std::string &tracePath,
+                const std::vector<double> &iterationSeconds,
+                double totalSeconds,
+                const BenchmarkDriver::Stats &stats,
+                const std::vector<PacketReport> &packets)
+{
+   auto out = fmt::memory_buffer { };
+   auto it = std::back_inserter(out);
+   fmt::format_to(it, "{{\n");
+   fmt::format_to(it, "  \"trace\": \"{}\",\n", escapeJsonString(tracePath));
+   fmt::format_to(it, "  \"driver\": \"null\",\n");
+   fmt::format_to(it, "  \"iterations\": {},\n", iterationSeconds.size());
+   fmt::format_to(it, "  \"totalSeconds\": {:.6f},\n", totalSeconds);
+   fmt::format_to(it, "  \"minIterationSeconds\": {:.6f},\n",
+                  *std::min_element(iterationSeconds.begin(), iterationSeconds.end()));
+   fmt::format_to(it, "  \"maxIterationSeconds\": {:.6f},\n",
+                  *std::max_element(iterationSeconds.begin(), iterationSeconds.end()));
+   fmt::format_to(it, "  \"swaps\": {},\n", stats.swaps);
+   fmt::format_to(it, "  \"draws\": {},\n", stats.draws);
+   fmt::format_to(it, "  \"drawsPerSecond\": {:.1f},\n", stats.draws / totalSeconds);
+   fmt::format_to(it, "  \"indices\": {},\n", stats.indices);
+   fmt::format_to(it, "  \"memoryLoads\": {},\n", stats.memoryLoads);
+   fmt::format_to(it, "  \"memoryLoadBytes\": {},\n", stats.memoryLoadBytes);
+
+   fmt::format_to(it, "  \"iterationSeconds\": [");
+   for (auto i = 0u; i < iterationSeconds.size(); ++i) {
+      fmt::format_to(it, "{}{:.6f}", i ? ", " : "", iterationSeconds[i]);
+   }
+   fmt::format_to(it, "],\n");
+
+   fmt::format_to(it, "  \"packets\": [\n");
+   for (auto i = 0u; i < packets.size(); ++i) {
+      auto &packet = packets[i];
+      fmt::format_to(it,
+                     "    {{ \"type\": \"{}\", \"count\": {}, \"totalNs\": {}, \"averageNs\": {:.1f} }}{}\n",
+                     packet.name, packet.stats.count, packet.stats.totalNs,
+                     static_cast<double>(packet.stats.totalNs) / packet.stats.count,
+                     (i + 1 < packets.size()) ? "," : "");
+   }
+   fmt::format_to(it, "  ]\n");
+   fmt::format_to(it, "}}\n");
+
+   auto file = std::ofstream { path, std::ofstream::out | std::ofstream::binary };
+   if (!file.is_open()) {
+      return false;
+   }
+
+   file.write(out.data(), out.size());
+   return !!file;
+}
+
+int
+runBenchmark(const std::string &tracePath,
+             const BenchmarkOptions &options)
+{
+   auto driver = BenchmarkDriver { };
+
+   auto replayHeap = phys_cast<cafe::TinyHeapPhysical *>(phys_addr { 0x34000000 });
+   cafe::TinyHeap_Setup(replayHeap,
+                        0x430,
+                        phys_cast<void *>(phys_addr { 0x34000000 + 0x430 }),
+                        0x1C000000 - 0x430);
+   auto ringBuffer = std::make_unique<RingBuffer>(replayHeap);
+   sBenchmarkRingBuffer = ringBuffer.get();
+
+   auto parser = ReplayParserPM4::Create(&driver, ringBuffer.get(),
+                                         replayHeap, tracePath);
+   if (!parser) {
+      gCliLog->error("Failed to open trace {}", tracePath);
+      return -1;
+   }
+
+   if (!parser->setStartFrame(config::start_frame)) {
+      gCliLog->error("Trace has no frame {}", config::start_frame);
+      return -1;
+   }
+
+   gpu::ih::enable(latte::CP_INT_CNTL::get(0xFFFFFFFF));
+   gpu::ih::setInterruptCallback(onBenchmarkGpuInterrupt);
+
+   auto driverThread = std::thread {
+      [&]() {
+         driver.run();
+      } };
+
+   initialiseRegisters(ringBuffer.get());
+   ringBuffer->waitTimestamp(ringBuffer->flushCommandBuffer());
+
+   auto iterations = std::max(options.iterations, 1u);
+   auto iterationSeconds = std::vector<double> { };
+
+   for (auto i = 0u; i < iterations; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      parser->runUntilTimestamp(0xFFFFFFFFFFFFFFFFull);
+      auto end = std::chrono::steady_clock::now();
+
+      iterationSeconds.push_back(std::chrono::duration<double> { end - start }.count());
+      gCliLog->info("Iteration {} took {:.3f} ms", i, iterationSeconds.back() * 1000.0);
+   }
+
+   driver.stop();
+   driverThread.join();
+   gpu::ih::setInterruptCallback(nullptr);
+
+   auto stats = driver.getStats();
+   auto packets = getPacketReports(stats);
+   auto totalSeconds = 0.0;
+   for (auto seconds : iterationSeconds) {
+      totalSeconds += seconds;
+   }
+
+   gCliLog->info("Replayed {} iterations in {:.3f} s, {} swaps, {} draws, {:.1f} draws/s",
+                 iterations, totalSeconds, stats.swaps, stats.draws,
+                 stats.draws / totalSeconds);
+   gCliLog->info("Loaded {} bytes of memory in {} loads",
+                 stats.memoryLoadBytes, stats.memoryLoads);
+
+   for (auto &packet : packets) {
+      gCliLog->info("{:<32} {:>10} packets {:>12.3f} ms {:>10.1f} ns/packet",
+                    packet.name, packet.stats.count,
+                    packet.stats.totalNs / 1000000.0,
+                    static_cast<double>(packet.stats.totalNs) / packet.stats.count);
+   }
+
+   if (!options.jsonPath.empty()) {
+      if (!writeJsonReport(options.jsonPath, tracePath, iterationSeconds,
+                           totalSeconds, stats, packets)) {
+         gCliLog->error("Failed to write benchmark report to {}", options.jsonPath);
+         return -1;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+struct BenchmarkOptions
+{
+   //! Number of times to replay the whole capture.
+   uint32_t iterations = 10;
+
+   //! Path to write the JSON report to, empty to only log the results.
+   std::string jsonPath;
+};
+
+/**
+ * Replay a capture through a headless Pm4Processor, without a window or a
+ * GPU, and report where the time goes per packet type.
+ */
+int
+runBenchmark(const std::string &tracePath,
+             const BenchmarkOptions &options);
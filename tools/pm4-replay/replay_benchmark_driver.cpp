@@ -0,0 +1,65 @@
+#include "replay_benchmark_driver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <libgpu/gpu_nulldriver.h>
+
+using namespace latte::pm4;
+
+void
+BenchmarkDriver::notifyCpuFlush(phys_addr address,
+                                uint32_t size)
+{
+   mMemoryLoads.fetch_add(1, std::memory_order_relaxed);
+   mMemoryLoadBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+BenchmarkDriver::Stats
+BenchmarkDriver::getStats()
+{
+   auto stats = mStats;
+   auto debugInfo = static_cast<gpu::NullDriverDebugInfo *>(getDebugInfo());
+   stats.draws = debugInfo->numDraws;
+   stats.indices = debugInfo->numIndices;
+   stats.swaps = debugInfo->numSwaps;
+   stats.memoryLoads = mMemoryLoads.load();
+   stats.memoryLoadBytes = mMemoryLoadBytes.load();
+   return stats;
+}
+
+template<typename Handler>
+void
+BenchmarkDriver::timePacket(PacketStats &stats,
+                            Handler &&handler)
+{
+   auto outerNestedNs = mNestedNs;
+   mNestedNs = 0;
+
+   auto start = std::chrono::steady_clock::now();
+   handler();
+   auto end = std::chrono::steady_clock::now();
+
+   auto elapsedNs = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+   stats.count++;
+   stats.totalNs += elapsedNs - std::min(elapsedNs, mNestedNs);
+   mNestedNs = outerNestedNs + elapsedNs;
+}
+
+void
+BenchmarkDriver::handlePacketType0(HeaderType0 header,
+                                   const gsl::span<uint32_t> &data)
+{
+   timePacket(mStats.type0, [&]() {
+      null::Driver::handlePacketType0(header, data);
+   });
+}
+
+void
+BenchmarkDriver::handlePacketType3(HeaderType3 header,
+                                   const gsl::span<uint32_t> &data)
+{
+   timePacket(mStats.type3[header.opcode()], [&]() {
+      null::Driver::handlePacketType3(header, data);
+   });
+}
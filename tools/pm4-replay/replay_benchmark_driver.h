@@ -0,0 +1,61 @@
+#pragma once
+#include <null/null_driver.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * The null graphics driver with every packet timed, so a replay can show
+ * where the pm4 processing time goes.
+ */
+class BenchmarkDriver : public null::Driver
+{
+public:
+   struct PacketStats
+   {
+      uint64_t count = 0;
+
+      //! Time spent in the packet, excluding any packets it runs itself such
+      //! as the contents of an indirect buffer.
+      uint64_t totalNs = 0;
+   };
+
+   struct Stats
+   {
+      PacketStats type0;
+      std::array<PacketStats, 0x100> type3;
+
+      uint64_t draws = 0;
+      uint64_t indices = 0;
+      uint64_t swaps = 0;
+      uint64_t memoryLoads = 0;
+      uint64_t memoryLoadBytes = 0;
+   };
+
+public:
+   ~BenchmarkDriver() override = default;
+
+   void notifyCpuFlush(phys_addr address, uint32_t size) override;
+
+   // Only safe to call once run() has returned.
+   Stats getStats();
+
+protected:
+   void handlePacketType0(HeaderType0 header, const gsl::span<uint32_t> &data) override;
+   void handlePacketType3(HeaderType3 header, const gsl::span<uint32_t> &data) override;
+
+private:
+   template<typename Handler>
+   void timePacket(PacketStats &stats, Handler &&handler);
+
+private:
+   Stats mStats;
+
+   //! Time spent in packets run from within the current packet.
+   uint64_t mNestedNs = 0;
+
+   // notifyCpuFlush is called from the replay thread
+   std::atomic<uint64_t> mMemoryLoads { 0 };
+   std::atomic<uint64_t> mMemoryLoadBytes { 0 };
+};
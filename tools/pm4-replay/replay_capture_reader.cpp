@@ -0,0 +1,82 @@
+#include "replay_capture_reader.h"
+#include "replay_capture_reader_chunked.h"
+
+#include <array>
+#include <fstream>
+
+using decaf::pm4::CapturePacket;
+
+/**
+ * The original capture format, a magic header followed by packets with
+ * their data stored inline.
+ */
+class StreamCaptureReader : public CaptureReader
+{
+public:
+   StreamCaptureReader(std::ifstream &&file) :
+      mFile(std::move(file))
+   {
+   }
+
+   uint32_t
+   numFrames() override
+   {
+      // There is only a register snapshot at the start of the capture
+      return 1;
+   }
+
+   bool
+   seekFrame(uint32_t frame) override
+   {
+      if (frame != 0) {
+         return false;
+      }
+
+      mFile.clear();
+      mFile.seekg(decaf::pm4::CaptureMagic.size(), std::ifstream::beg);
+      return true;
+   }
+
+   bool
+   readPacket(CapturePacket &packet,
+              std::vector<char> &data) override
+   {
+      mFile.read(reinterpret_cast<char *>(&packet), sizeof(CapturePacket));
+      if (!mFile) {
+         return false;
+      }
+
+      data.resize(packet.size);
+      mFile.read(data.data(), data.size());
+      return !!mFile;
+   }
+
+private:
+   std::ifstream mFile;
+};
+
+std::unique_ptr<CaptureReader>
+openCaptureReader(const std::string &path)
+{
+   std::ifstream file;
+   file.open(path, std::ifstream::binary);
+   if (!file.is_open()) {
+      return {};
+   }
+
+   std::array<char, 4> magic;
+   file.read(magic.data(), magic.size());
+   if (!file) {
+      return {};
+   }
+
+   if (magic == decaf::pm4::CaptureMagic) {
+      return std::make_unique<StreamCaptureReader>(std::move(file));
+   }
+
+   if (magic == decaf::pm4::ChunkedCaptureMagic) {
+      return ChunkedCaptureReader::open(std::move(file));
+   }
+
+   return {};
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <libdecaf/decaf_pm4replay.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Reads packets from a pm4 capture file.
+ *
+ * Memory is always returned as a CapturePacket::MemoryLoad packet whose
+ * data is a CaptureMemoryLoad followed by the memory contents, whatever
+ * way the capture stores it.
+ */
+class CaptureReader
+{
+public:
+   virtual ~CaptureReader() = default;
+
+   //! Number of frames which can be seeked to.
+   virtual uint32_t numFrames() = 0;
+
+   //! Seek to the start of a frame, frame 0 is the start of the capture.
+   virtual bool seekFrame(uint32_t frame) = 0;
+
+   virtual bool readPacket(decaf::pm4::CapturePacket &packet,
+                           std::vector<char> &data) = 0;
+};
+
+std::unique_ptr<CaptureReader>
+openCaptureReader(const std::string &path);
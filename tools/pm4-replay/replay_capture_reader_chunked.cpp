@@ -0,0 +1,364 @@
+#include "clilog.h"
+#include "replay_capture_reader_chunked.h"
+
+#include <cstring>
+#include <zlib.h>
+
+using namespace decaf::pm4;
+
+std::unique_ptr<CaptureReader>
+ChunkedCaptureReader::open(std::ifstream &&file)
+{
+   // The magic has already been read by openCaptureReader
+   auto header = CaptureFileHeader { };
+   file.seekg(0, std::ifstream::beg);
+   file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+   if (!file || header.version != ChunkedCaptureVersion) {
+      gCliLog->error("Unsupported capture version {}",
+                     static_cast<uint32_t>(header.version));
+      return {};
+   }
+
+   auto self = std::unique_ptr<ChunkedCaptureReader> { new ChunkedCaptureReader { } };
+   self->mFile = std::move(file);
+   self->mFile.seekg(0, std::ifstream::end);
+   self->mFileSize = static_cast<uint64_t>(self->mFile.tellg());
+
+   if (!self->readIndex()) {
+      gCliLog->warn("Capture has no index, it was probably not closed cleanly. Scanning file instead.");
+
+      if (!self->rebuildIndex()) {
+         return {};
+      }
+   }
+
+   if (self->mFrames.empty()) {
+      gCliLog->error("Capture contains no frames");
+      return {};
+   }
+
+   return self;
+}
+
+uint32_t
+ChunkedCaptureReader::numFrames()
+{
+   return static_cast<uint32_t>(mFrames.size());
+}
+
+bool
+ChunkedCaptureReader::seekFrame(uint32_t frame)
+{
+   if (frame >= mFrames.size()) {
+      return false;
+   }
+
+   mStartFrame = frame;
+   mNextChunkOffset = mFrames[frame].chunkOffset;
+   mChunk.clear();
+   mChunkPosition = 0;
+   return true;
+}
+
+bool
+ChunkedCaptureReader::readPacket(CapturePacket &packet,
+                                 std::vector<char> &data)
+{
+   while (true) {
+      while (mChunkPosition >= mChunk.size()) {
+         if (!nextChunk()) {
+            return false;
+         }
+      }
+
+      if (mChunkPosition + sizeof(CapturePacket) > mChunk.size()) {
+         gCliLog->error("Truncated packet in capture chunk");
+         return false;
+      }
+
+      std::memcpy(&packet, mChunk.data() + mChunkPosition, sizeof(CapturePacket));
+      mChunkPosition += sizeof(CapturePacket);
+
+      if (mChunkPosition + packet.size > mChunk.size()) {
+         gCliLog->error("Truncated packet in capture chunk");
+         return false;
+      }
+
+      auto payload = mChunk.data() + mChunkPosition;
+      mChunkPosition += packet.size;
+
+      if (packet.type != CapturePacket::MemoryReference) {
+         data.resize(packet.size);
+         std::memcpy(data.data(), payload, packet.size);
+         return true;
+      }
+
+      if (packet.size < sizeof(CaptureMemoryReference)) {
+         gCliLog->error("Truncated memory reference in capture chunk");
+         return false;
+      }
+
+      auto reference = CaptureMemoryReference { };
+      std::memcpy(&reference, payload, sizeof(CaptureMemoryReference));
+
+      auto key = BlockKey { { reference.hash[0], reference.hash[1] }, reference.size };
+      auto itr = mBlocks.find(key);
+      if (itr == mBlocks.end()) {
+         gCliLog->error("Capture is missing memory block for 0x{:08X}",
+                        static_cast<uint32_t>(reference.address));
+         continue;
+      }
+
+      auto blockData = getBlockData(itr->second);
+      if (!blockData) {
+         return false;
+      }
+
+      // Present it to the caller as an ordinary memory load
+      auto load = CaptureMemoryLoad { };
+      load.type = reference.type;
+      load.address = reference.address;
+
+      data.resize(sizeof(CaptureMemoryLoad) + reference.size);
+      std::memcpy(data.data(), &load, sizeof(CaptureMemoryLoad));
+      std::memcpy(data.data() + sizeof(CaptureMemoryLoad), blockData, reference.size);
+
+      packet.type = CapturePacket::MemoryLoad;
+      packet.size = static_cast<uint32_t>(data.size());
+      return true;
+   }
+}
+
+bool
+ChunkedCaptureReader::readIndex()
+{
+   auto trailer = CaptureFileTrailer { };
+   if (mFileSize < sizeof(CaptureFileHeader) + sizeof(CaptureFileTrailer)) {
+      return false;
+   }
+
+   mFile.clear();
+   mFile.seekg(mFileSize - sizeof(CaptureFileTrailer), std::ifstream::beg);
+   mFile.read(reinterpret_cast<char *>(&trailer), sizeof(CaptureFileTrailer));
+   if (!mFile || trailer.magic != ChunkedCaptureMagic) {
+      return false;
+   }
+
+   auto header = CaptureChunk { };
+   auto data = std::vector<uint8_t> { };
+   if (!readChunkHeader(trailer.indexOffset, header) ||
+       header.type != CaptureChunk::Index ||
+       !readChunkData(trailer.indexOffset, header, data) ||
+       data.size() < sizeof(CaptureIndexHeader)) {
+      return false;
+   }
+
+   auto index = CaptureIndexHeader { };
+   std::memcpy(&index, data.data(), sizeof(CaptureIndexHeader));
+
+   auto framesSize = index.numFrames * sizeof(CaptureFrameIndex);
+   auto blocksSize = index.numBlocks * sizeof(CaptureBlockIndex);
+   if (data.size() < sizeof(CaptureIndexHeader) + framesSize + blocksSize) {
+      return false;
+   }
+
+   auto position = sizeof(CaptureIndexHeader);
+   mFrames.resize(index.numFrames);
+   std::memcpy(mFrames.data(), data.data() + position, framesSize);
+   position += framesSize;
+
+   mBlocks.clear();
+   mBlocks.reserve(index.numBlocks);
+
+   for (auto i = 0u; i < index.numBlocks; ++i) {
+      auto block = CaptureBlockIndex { };
+      std::memcpy(&block, data.data() + position, sizeof(CaptureBlockIndex));
+      position += sizeof(CaptureBlockIndex);
+
+      mBlocks.emplace(BlockKey { { block.hash[0], block.hash[1] }, block.size }, block);
+   }
+
+   return true;
+}
+
+bool
+ChunkedCaptureReader::rebuildIndex()
+{
+   auto offset = uint64_t { sizeof(CaptureFileHeader) };
+   auto header = CaptureChunk { };
+   auto data = std::vector<uint8_t> { };
+
+   mFrames.clear();
+   mBlocks.clear();
+
+   while (readChunkHeader(offset, header)) {
+      if (header.type == CaptureChunk::Keyframe) {
+         mFrames.push_back(CaptureFrameIndex { offset, 0 });
+      } else if (header.type == CaptureChunk::MemoryBlocks) {
+         if (!readChunkData(offset, header, data)) {
+            break;
+         }
+
+         addBlocks(offset, data);
+      } else if (header.type != CaptureChunk::Packets) {
+         break;
+      }
+
+      offset += sizeof(CaptureChunk) + header.compressedSize;
+   }
+
+   return true;
+}
+
+void
+ChunkedCaptureReader::addBlocks(uint64_t chunkOffset,
+                                const std::vector<uint8_t> &data)
+{
+   auto position = size_t { 0 };
+
+   while (position + sizeof(CaptureMemoryBlock) <= data.size()) {
+      auto header = CaptureMemoryBlock { };
+      std::memcpy(&header, data.data() + position, sizeof(CaptureMemoryBlock));
+      position += sizeof(CaptureMemoryBlock);
+
+      if (position + header.size > data.size()) {
+         break;
+      }
+
+      auto block = CaptureBlockIndex { };
+      block.hash[0] = header.hash[0];
+      block.hash[1] = header.hash[1];
+      block.size = header.size;
+      block.chunkOffset = chunkOffset;
+      block.dataOffset = static_cast<uint32_t>(position);
+      mBlocks.emplace(BlockKey { { block.hash[0], block.hash[1] }, block.size }, block);
+
+      position += header.size;
+   }
+}
+
+bool
+ChunkedCaptureReader::readChunkHeader(uint64_t offset,
+                                      CaptureChunk &header)
+{
+   if (offset + sizeof(CaptureChunk) > mFileSize) {
+      return false;
+   }
+
+   mFile.clear();
+   mFile.seekg(offset, std::ifstream::beg);
+   mFile.read(reinterpret_cast<char *>(&header), sizeof(CaptureChunk));
+   return !!mFile &&
+          offset + sizeof(CaptureChunk) + header.compressedSize <= mFileSize;
+}
+
+bool
+ChunkedCaptureReader::readChunkData(uint64_t offset,
+                                    const CaptureChunk &header,
+                                    std::vector<uint8_t> &data)
+{
+   mFile.clear();
+   mFile.seekg(offset + sizeof(CaptureChunk), std::ifstream::beg);
+   data.resize(header.uncompressedSize);
+
+   if (header.compression == CaptureChunk::None) {
+      if (header.compressedSize != header.uncompressedSize) {
+         return false;
+      }
+
+      mFile.read(reinterpret_cast<char *>(data.data()), data.size());
+      return !!mFile;
+   }
+
+   if (header.compression != CaptureChunk::Zlib) {
+      gCliLog->error("Unsupported capture chunk compression {}",
+                     static_cast<uint32_t>(header.compression));
+      return false;
+   }
+
+   mCompressed.resize(header.compressedSize);
+   mFile.read(reinterpret_cast<char *>(mCompressed.data()), mCompressed.size());
+   if (!mFile) {
+      return false;
+   }
+
+   auto size = static_cast<uLongf>(data.size());
+   auto result = uncompress(data.data(), &size,
+                            mCompressed.data(),
+                            static_cast<uLong>(mCompressed.size()));
+   if (result != Z_OK || size != data.size()) {
+      gCliLog->error("Failed to decompress capture chunk at {}, zlib error {}",
+                     offset, result);
+      return false;
+   }
+
+   return true;
+}
+
+bool
+ChunkedCaptureReader::nextChunk()
+{
+   while (true) {
+      auto offset = mNextChunkOffset;
+      auto header = CaptureChunk { };
+      if (!readChunkHeader(offset, header)) {
+         return false;
+      }
+
+      mNextChunkOffset = offset + sizeof(CaptureChunk) + header.compressedSize;
+
+      switch (header.type) {
+      case CaptureChunk::Packets:
+         break;
+      case CaptureChunk::Keyframe:
+         // Only the keyframe we started from is needed, the following frames
+         // already have that state from replaying the packets before them.
+         if (header.frame != mStartFrame) {
+            continue;
+         }
+         break;
+      case CaptureChunk::MemoryBlocks:
+         // Loaded on demand by getBlockData
+         continue;
+      case CaptureChunk::Index:
+      default:
+         return false;
+      }
+
+      mChunkPosition = 0;
+      return readChunkData(offset, header, mChunk);
+   }
+}
+
+const uint8_t *
+ChunkedCaptureReader::getBlockData(const CaptureBlockIndex &block)
+{
+   for (auto itr = mBlockCache.begin(); itr != mBlockCache.end(); ++itr) {
+      if (itr->offset == block.chunkOffset) {
+         mBlockCache.splice(mBlockCache.begin(), mBlockCache, itr);
+         return mBlockCache.front().data.data() + block.dataOffset;
+      }
+   }
+
+   auto header = CaptureChunk { };
+   auto chunk = CachedChunk { block.chunkOffset };
+   if (!readChunkHeader(block.chunkOffset, header) ||
+       header.type != CaptureChunk::MemoryBlocks ||
+       !readChunkData(block.chunkOffset, header, chunk.data) ||
+       block.dataOffset + block.size > chunk.data.size()) {
+      gCliLog->error("Failed to read capture memory block chunk at {}",
+                     static_cast<uint64_t>(block.chunkOffset));
+      return nullptr;
+   }
+
+   mBlockCacheBytes += chunk.data.size();
+   mBlockCache.emplace_front(std::move(chunk));
+
+   while (mBlockCacheBytes > MaxCachedBlockBytes && mBlockCache.size() > 1) {
+      mBlockCacheBytes -= mBlockCache.back().data.size();
+      mBlockCache.pop_back();
+   }
+
+   return mBlockCache.front().data.data() + block.dataOffset;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "replay_capture_reader.h"
+
+#include <fstream>
+#include <list>
+#include <unordered_map>
+
+/**
+ * Streams a chunked capture, only the chunk currently being replayed and a
+ * bounded cache of memory block chunks are kept in memory.
+ */
+class ChunkedCaptureReader : public CaptureReader
+{
+   //! Maximum size of decompressed memory block chunks kept in memory.
+   static constexpr size_t MaxCachedBlockBytes = 256 * 1024 * 1024;
+
+   struct BlockKey
+   {
+      uint64_t hash[2];
+      uint32_t size;
+
+      bool operator ==(const BlockKey &other) const
+      {
+         return hash[0] == other.hash[0] &&
+                hash[1] == other.hash[1] &&
+                size == other.size;
+      }
+   };
+
+   struct BlockKeyHash
+   {
+      size_t operator()(const BlockKey &key) const
+      {
+         return static_cast<size_t>(key.hash[0] ^ key.hash[1]);
+      }
+   };
+
+   struct CachedChunk
+   {
+      uint64_t offset;
+      std::vector<uint8_t> data;
+   };
+
+public:
+   static std::unique_ptr<CaptureReader>
+   open(std::ifstream &&file);
+
+   uint32_t numFrames() override;
+   bool seekFrame(uint32_t frame) override;
+   bool readPacket(decaf::pm4::CapturePacket &packet,
+                   std::vector<char> &data) override;
+
+private:
+   bool readIndex();
+   bool rebuildIndex();
+   void addBlocks(uint64_t chunkOffset, const std::vector<uint8_t> &data);
+
+   bool readChunkHeader(uint64_t offset, decaf::pm4::CaptureChunk &header);
+   bool readChunkData(uint64_t offset, const decaf::pm4::CaptureChunk &header,
+                      std::vector<uint8_t> &data);
+   bool nextChunk();
+   const uint8_t *getBlockData(const decaf::pm4::CaptureBlockIndex &block);
+
+private:
+   std::ifstream mFile;
+   uint64_t mFileSize = 0;
+
+   std::vector<decaf::pm4::CaptureFrameIndex> mFrames;
+   std::unordered_map<BlockKey, decaf::pm4::CaptureBlockIndex, BlockKeyHash> mBlocks;
+
+   uint32_t mStartFrame = 0;
+   uint64_t mNextChunkOffset = 0;
+   std::vector<uint8_t> mChunk;
+   size_t mChunkPosition = 0;
+   std::vector<uint8_t> mCompressed;
+
+   //! Most recently used chunk at the front.
+   std::list<CachedChunk> mBlockCache;
+   size_t mBlockCacheBytes = 0;
+};
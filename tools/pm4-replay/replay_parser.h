@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string_view>
 
 class ReplayParser
@@ -7,4 +8,7 @@ public:
    virtual ~ReplayParser() = default;
 
    virtual bool runUntilTimestamp(uint64_t timestamp) = 0;
+
+   //! Start replaying from a later frame, returns false if it is not seekable.
+   virtual bool setStartFrame(uint32_t frame) = 0;
 };
@@ -3,6 +3,8 @@
 #include <libdecaf/src/cafe/cafe_tinyheap.h>
 #include <libgpu/latte/latte_pm4_commands.h>
 
+#include <cstring>
+
 using namespace latte::pm4;
 
 std::unique_ptr<ReplayParser>
@@ -11,17 +13,8 @@ ReplayParserPM4::Create(gpu::GraphicsDriver *driver,
                         phys_ptr<cafe::TinyHeapPhysical> heap,
                         const std::string &path)
 {
-   // Try open file
-   std::ifstream file;
-   file.open(path, std::ifstream::binary);
-   if (!file.is_open()) {
-      return {};
-   }
-
-   // Check magic header
-   std::array<char, 4> magic;
-   file.read(magic.data(), 4);
-   if (magic != decaf::pm4::CaptureMagic) {
+   auto reader = openCaptureReader(path);
+   if (!reader) {
       return {};
    }
 
@@ -37,36 +30,37 @@ ReplayParserPM4::Create(gpu::GraphicsDriver *driver,
    self->mRingBuffer = ringBuffer;
    self->mHeap = heap;
    self->mRegisterStorage = phys_cast<uint32_t *>(allocPtr);
-   self->mFile = std::move(file);
+   self->mReader = std::move(reader);
 
    return std::unique_ptr<ReplayParser> { self };
 }
 
+bool
+ReplayParserPM4::setStartFrame(uint32_t frame)
+{
+   if (frame >= mReader->numFrames()) {
+      return false;
+   }
+
+   mStartFrame = frame;
+   return true;
+}
+
 bool
 ReplayParserPM4::runUntilTimestamp(uint64_t timestamp)
 {
    std::vector<char> buffer;
    bool reachedTimestamp = false;
-   mFile.clear();
-   mFile.seekg(4, std::fstream::beg);
-
-   while (true) {
-      decaf::pm4::CapturePacket packet;
-      mFile.read(reinterpret_cast<char *>(&packet), sizeof(decaf::pm4::CapturePacket));
-      if (!mFile) {
-         return false;
-      }
 
+   if (!mReader->seekFrame(mStartFrame)) {
+      return false;
+   }
+
+   decaf::pm4::CapturePacket packet;
+   while (mReader->readPacket(packet, buffer)) {
       switch (packet.type) {
       case decaf::pm4::CapturePacket::CommandBuffer:
       {
-         buffer.resize(packet.size);
-         mFile.read(buffer.data(), buffer.size());
-
-         if (!mFile) {
-            return false;
-         }
-
          handleCommandBuffer(buffer.data(), packet.size);
          break;
       }
@@ -74,7 +68,7 @@ ReplayParserPM4::runUntilTimestamp(uint64_t timestamp)
       {
          decaf_check((packet.size % 4) == 0);
          auto numRegisters = packet.size / 4;
-         mFile.read(reinterpret_cast<char *>(mRegisterStorage.getRawPointer()), packet.size);
+         std::memcpy(mRegisterStorage.getRawPointer(), buffer.data(), packet.size);
 
          // Swap it into big endian, so we can write LOAD_ commands
          for (auto i = 0u; i < numRegisters; ++i) {
@@ -88,7 +82,7 @@ ReplayParserPM4::runUntilTimestamp(uint64_t timestamp)
       case decaf::pm4::CapturePacket::SetBuffer:
       {
          decaf::pm4::CaptureSetBuffer setBuffer;
-         mFile.read(reinterpret_cast<char *>(&setBuffer), sizeof(decaf::pm4::CaptureSetBuffer));
+         std::memcpy(&setBuffer, buffer.data(), sizeof(decaf::pm4::CaptureSetBuffer));
 
          handleSetBuffer(setBuffer);
          mRingBuffer->waitTimestamp(mRingBuffer->flushCommandBuffer());
@@ -97,24 +91,15 @@ ReplayParserPM4::runUntilTimestamp(uint64_t timestamp)
       case decaf::pm4::CapturePacket::MemoryLoad:
       {
          decaf::pm4::CaptureMemoryLoad load;
-         mFile.read(reinterpret_cast<char *>(&load), sizeof(decaf::pm4::CaptureMemoryLoad));
-
-         if (!mFile) {
-            return false;
-         }
-
-         buffer.resize(packet.size - sizeof(decaf::pm4::CaptureMemoryLoad));
-         mFile.read(buffer.data(), buffer.size());
-
-         if (!mFile) {
-            return false;
-         }
+         std::memcpy(&load, buffer.data(), sizeof(decaf::pm4::CaptureMemoryLoad));
+         buffer.erase(buffer.begin(),
+                      buffer.begin() + sizeof(decaf::pm4::CaptureMemoryLoad));
 
          handleMemoryLoad(load, buffer);
          break;
       }
       default:
-         mFile.seekg(packet.size, std::ifstream::cur);
+         break;
       }
 
       if (packet.timestamp >= timestamp) {
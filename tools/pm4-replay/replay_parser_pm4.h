@@ -1,4 +1,5 @@
 #pragma once
+#include "replay_capture_reader.h"
 #include "replay_parser.h"
 #include "replay_ringbuffer.h"
 
@@ -9,7 +10,6 @@
 #include <libgpu/latte/latte_pm4.h>
 
 #include <cstdint>
-#include <fstream>
 #include <memory>
 #include <string>
 
@@ -25,6 +25,7 @@ class ReplayParserPM4 : public ReplayParser
 public:
    virtual ~ReplayParserPM4() = default;
    bool runUntilTimestamp(uint64_t timestamp) override;
+   bool setStartFrame(uint32_t frame) override;
 
    static std::unique_ptr<ReplayParser>
    Create(gpu::GraphicsDriver *driver,
@@ -44,7 +45,8 @@ private:
 private:
    gpu::GraphicsDriver *mGraphicsDriver = nullptr;
    RingBuffer *mRingBuffer = nullptr;
-   std::ifstream mFile;
+   std::unique_ptr<CaptureReader> mReader;
+   uint32_t mStartFrame = 0;
 
    phys_ptr<cafe::TinyHeapPhysical> mHeap = nullptr;
    phys_ptr<uint32_t> mRegisterStorage = nullptr;
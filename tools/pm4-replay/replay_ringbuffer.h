@@ -61,7 +61,11 @@ public:
    flushCommandBuffer()
    {
       auto timestamp = insertRetiredTimestamp();
-      gpu::ringbuffer::write(mBuffer);
+
+      // The GPU reads the buffer in place, so keep it alive until the next
+      // flush, by which time the caller has waited for it to retire.
+      mSubmittedBuffer.swap(mBuffer);
+      gpu::ringbuffer::writeNoCopy(mSubmittedBuffer);
       mBuffer.clear();
       return timestamp;
    }
@@ -119,6 +123,7 @@ public:
 
 private:
    std::vector<uint32_t> mBuffer;
+   std::vector<uint32_t> mSubmittedBuffer;
 
    phys_ptr<cafe::TinyHeapPhysical> mReplayHeap = nullptr;
    phys_ptr<uint64_t> mRetireTimestampMemory = nullptr;
@@ -168,6 +168,11 @@ SDLWindow::run(const std::string &tracePath)
       return false;
    }
 
+   if (!parser->setStartFrame(config::start_frame)) {
+      gCliLog->error("Trace has no frame {}", config::start_frame);
+      return false;
+   }
+
    gpu::ih::enable(latte::CP_INT_CNTL::get(0xFFFFFFFF));
    gpu::ih::setInterruptCallback(onGpuInterrupt);
 
@@ -0,0 +1,159 @@
+#include <array>
+#include <common/align.h>
+#include <cstring>
+#include <excmd.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <libcpu/cpu.h>
+#include <libcpu/mem.h>
+#include <libdecaf/decaf.h>
+#include <libdecaf/decaf_config.h>
+#include <libdecaf/decaf_log.h>
+#include <libdecaf/decaf_pm4replay.h>
+#include <libgpu/gpu_config.h>
+#include <libgpu/gpu_shadercache.h>
+#include <vector>
+
+/**
+ * Runs every command buffer in a PM4 capture through the shader prewarmer
+ * so that the shaders it uses are in the shader cache before the title is
+ * first run.
+ */
+static bool
+prewarmCapture(const std::string &path,
+               const std::string &cacheDir)
+{
+   auto file = std::ifstream { path, std::ifstream::binary };
+   if (!file.is_open()) {
+      std::cerr << fmt::format("Could not open {}", path) << std::endl;
+      return false;
+   }
+
+   auto magic = std::array<char, 4> { };
+   file.read(magic.data(), magic.size());
+   if (!file || magic != decaf::pm4::CaptureMagic) {
+      std::cerr << fmt::format("{} is not a PM4 capture", path) << std::endl;
+      return false;
+   }
+
+   auto prewarmer = gpu::shadercache::Prewarmer { cacheDir };
+   auto buffer = std::vector<char> { };
+
+   while (true) {
+      auto packet = decaf::pm4::CapturePacket { };
+      file.read(reinterpret_cast<char *>(&packet), sizeof(packet));
+      if (!file) {
+         break;
+      }
+
+      switch (packet.type) {
+      case decaf::pm4::CapturePacket::CommandBuffer:
+      {
+         // Keep the buffer word aligned, runCommandBuffer reads it as uint32_t
+         buffer.resize(align_up(packet.size, 4));
+         file.read(buffer.data(), packet.size);
+         if (!file) {
+            return false;
+         }
+
+         prewarmer.runCommandBuffer(reinterpret_cast<uint32_t *>(buffer.data()),
+                                    packet.size / 4);
+         break;
+      }
+      case decaf::pm4::CapturePacket::MemoryLoad:
+      {
+         auto load = decaf::pm4::CaptureMemoryLoad { };
+         file.read(reinterpret_cast<char *>(&load), sizeof(load));
+         buffer.resize(packet.size - sizeof(load));
+         file.read(buffer.data(), buffer.size());
+         if (!file) {
+            return false;
+         }
+
+         std::memcpy(phys_cast<void *>(load.address).getRawPointer(),
+                     buffer.data(), buffer.size());
+         break;
+      }
+      case decaf::pm4::CapturePacket::RegisterSnapshot:
+      {
+         buffer.resize(packet.size);
+         file.read(buffer.data(), buffer.size());
+         if (!file) {
+            return false;
+         }
+
+         prewarmer.loadRegisters(reinterpret_cast<uint32_t *>(buffer.data()),
+                                 packet.size / 4);
+         break;
+      }
+      default:
+         file.seekg(packet.size, std::ifstream::cur);
+      }
+   }
+
+   auto stats = prewarmer.getStats();
+   std::cout << fmt::format("Processed {} draws: {} shaders translated, {} already cached",
+                            stats.draws, stats.translated, stats.cached) << std::endl;
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+   auto defaultCacheDir = gpu::ShaderCacheSettings { }.path;
+
+   // Setup command line options
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." });
+
+   parser.add_command("help")
+      .add_argument("command", excmd::value<std::string> { });
+
+   parser.add_command("prewarm")
+      .add_argument("capture", excmd::value<std::string> { })
+      .add_option("cache-dir",
+                  excmd::description { "Shader cache directory to fill." },
+                  excmd::make_default_value(defaultCacheDir));
+
+   // Parse command line
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   // Print help
+   if (argc == 1 || options.has("help")) {
+      if (options.has("command")) {
+         std::cout << parser.format_help("shadercache-prewarm", options.get<std::string>("command")) << std::endl;
+      } else {
+         std::cout << parser.format_help("shadercache-prewarm") << std::endl;
+      }
+
+      std::exit(0);
+   }
+
+   if (!options.has("prewarm")) {
+      return 0;
+   }
+
+   // The shader translator logs through libdecaf's logger
+   auto decafSettings = decaf::Settings { };
+   decafSettings.log.to_stdout = true;
+   decafSettings.log.level = "warn";
+   decaf::setConfig(decafSettings);
+   decaf::initialiseLogging("shadercache-prewarm.txt");
+
+   // Initialise CPU to setup physical memory
+   cpu::initialise();
+
+   auto cacheDir = defaultCacheDir;
+   if (options.has("cache-dir")) {
+      cacheDir = options.get<std::string>("cache-dir");
+   }
+
+   return prewarmCapture(options.get<std::string>("capture"), cacheDir) ? 0 : -1;
+}